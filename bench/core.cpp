@@ -0,0 +1,233 @@
+/*
+ *   Microbenchmarks for the logic core.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "../core/logic.hpp"
+#include "../core/lisp.hpp"
+#include "../core/buffer.hpp"
+#include "../core/cache.hpp"
+#include "generator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Core;
+
+namespace {
+	// Don't let the compiler optimize away results.
+	volatile std::size_t sink;
+
+	const char *filter = "";
+	const unsigned repetitions = 5;
+
+	/**
+	 * Run a benchmark several times and print the median time.
+	 *
+	 * @param name Name of the benchmark.
+	 * @param ops Number of operations done by a single run.
+	 * @param run Function doing a run, returns something to sink.
+	 */
+	template <typename Function>
+	void measure(const char *name, std::size_t ops, Function run)
+	{
+		if (std::string(name).compare(0, std::string(filter).size(), filter) != 0)
+			return;
+
+		std::vector<double> times;
+		for (unsigned i = 0; i < repetitions; ++i) {
+			auto start = std::chrono::steady_clock::now();
+			sink = run();
+			auto stop = std::chrono::steady_clock::now();
+			times.push_back(std::chrono::duration<double>(stop - start).count());
+		}
+
+		std::sort(times.begin(), times.end());
+		double median = times[repetitions / 2];
+		std::printf("%-24s %10zu ops %10.3f ms %10.1f ns/op\n",
+			name, ops, median * 1e3, median * 1e9 / (ops ? ops : 1));
+	}
+
+	/**
+	 * Parse a theory from memory.
+	 *
+	 * @param text Theory in Lisp syntax.
+	 * @param rules Rules for proofs.
+	 * @param num_threads Number of threads, 1 for the serial parser.
+	 * @return Parsed theory.
+	 */
+	Theory parse(const std::string &text, const Theory *rules, unsigned num_threads = 1)
+	{
+		std::ostream null(nullptr);
+		Parser parser(text.data(), text.data() + text.size(), null, "synthetic");
+		parser.rules = rules;
+		if (num_threads == 1)
+			return parser.parseTheory();
+		else
+			return parser.parseTheoryParallel(num_threads);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Bench::GeneratorOptions options;
+	int arg = 1;
+	while (Bench::parseOption(argc, argv, arg, options));
+	if (arg + 1 < argc) {
+		std::cout << "Usage: " << argv[0] << " [-n <size>] [-d <depth>] [-f <fanout>]"
+			" [-l <proof length>] [-s <seed>] [<benchmark prefix>]\n";
+		return 1;
+	}
+	if (arg < argc)
+		filter = argv[arg];
+
+	// Rules and synthetic theory
+	InputBuffer rules_file("basic/rules.lth");
+	if (!rules_file) {
+		std::cout << "Couldn't read basic/rules.lth\n";
+		return 1;
+	}
+	std::string rules_text(rules_file.begin(), rules_file.end());
+	Theory rules = parse(rules_text, nullptr);
+
+	std::ostringstream stream;
+	Bench::Generator(options).write(stream);
+	const std::string text = stream.str();
+
+	Theory theory = parse(text, &rules);
+	if (!theory.verify()) {
+		std::cout << "Synthetic theory doesn't verify\n";
+		return 1;
+	}
+
+	// Collect the checks done during verification: substituting the proof
+	// step arguments into a rule statement, and comparing their types.
+	struct Check {
+		Substitution subst;
+		const_Expr_ptr target;
+		Context context;
+	};
+	std::vector<Check> checks;
+	std::vector<std::pair<const_Expr_ptr, const_Expr_ptr>> types;
+	std::size_t num_statements = 0;
+	for (const Object_ptr &object : theory) {
+		auto stmt = std::dynamic_pointer_cast<const Statement>(object);
+		if (!stmt)
+			continue;
+		++num_statements;
+		auto step = std::dynamic_pointer_cast<const ProofStep>(stmt->getProof());
+		if (!step)
+			continue;
+
+		const_Rule_ptr rule = step->getRule();
+		Context context;
+		for (const Node_ptr &param : rule->getParams()) {
+			context[param] = (*step)[param];
+			types.emplace_back(param->getType(), (*step)[param]->getType());
+		}
+
+		std::vector<const_Expr_ptr> patterns;
+		if (auto deduction = std::dynamic_pointer_cast<const DeductionRule>(rule))
+			patterns = {deduction->getConclusion()};
+		else if (auto equivalence = std::dynamic_pointer_cast<const EquivalenceRule>(rule))
+			patterns = {equivalence->getStatement1(), equivalence->getStatement2()};
+		for (const_Expr_ptr pattern : patterns)
+			checks.push_back({Substitution(pattern), stmt->getDefinition(), context});
+	}
+
+	std::cout << "Synthetic theory: size " << options.size << ", depth " << options.depth
+		<< ", fanout " << options.fanout << ", length " << options.length
+		<< ", seed " << options.seed << "\n"
+		<< text.size() << " bytes, " << theory.size() << " objects\n\n";
+
+	// Count tokens first.
+	std::size_t num_tokens = 0;
+	{
+		Lexer lexer(text.data(), text.data() + text.size());
+		while (lexer.getToken().getType() != LispToken::ENDOFFILE)
+			++num_tokens;
+	}
+
+	measure("lexer", num_tokens, [&text] () {
+		Lexer lexer(text.data(), text.data() + text.size());
+		std::size_t count = 0;
+		while (lexer.getToken().getType() != LispToken::ENDOFFILE)
+			++count;
+		return count;
+	});
+
+	measure("parser", theory.size(), [&text, &rules] () {
+		return parse(text, &rules).size();
+	});
+
+	measure("parser_parallel", theory.size(), [&text, &rules] () {
+		return parse(text, &rules, 0).size();
+	});
+
+	measure("substitution", checks.size(), [&checks] () {
+		Substitution::State state;
+		std::size_t matches = 0;
+		for (const Check &check : checks)
+			matches += check.subst.check(check.target.get(), check.context, state);
+		return matches;
+	});
+
+	measure("type_comparator", types.size(), [&types] () {
+		TypeComparator compare;
+		std::size_t matches = 0;
+		for (const auto &pair : types)
+			matches += compare(pair.first.get(), pair.second.get());
+		return matches;
+	});
+
+	measure("writer", theory.size(), [&theory] () {
+		std::ostringstream output;
+		{
+			Writer writer(output);
+			theory.accept(&writer);
+		}
+		return output.str().size();
+	});
+
+	measure("verify", num_statements, [&theory] () {
+		return std::size_t(theory.verify());
+	});
+
+	measure("verify_parallel", num_statements, [&theory] () {
+		return std::size_t(theory.verify(0));
+	});
+
+	// After the first run, every proof step is found in the cache.
+	VerificationCache cache;
+	measure("verify_cached", num_statements, [&theory, &cache] () {
+		return std::size_t(theory.verify(1, nullptr, &cache));
+	});
+
+	measure("copy", theory.size(), [&theory] () {
+		return Theory(theory).size();
+	});
+
+	// A fork shares the objects of its base instead of cloning them.
+	auto base = std::make_shared<const Theory>(parse(text, &rules));
+	measure("fork", theory.size(), [&base] () {
+		return Theory(base).getBase()->size();
+	});
+}
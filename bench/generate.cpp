@@ -0,0 +1,37 @@
+/*
+ *   Write a synthetic theory for benchmarks.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "generator.hpp"
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+	Bench::GeneratorOptions options;
+	int arg = 1;
+	while (Bench::parseOption(argc, argv, arg, options));
+
+	if (arg != argc) {
+		std::cout << "Usage: " << argv[0] << " [-n <size>] [-d <depth>] [-f <fanout>]"
+			" [-l <proof length>] [-s <seed>]\n";
+		return 1;
+	}
+
+	Bench::Generator generator(options);
+	generator.write(std::cout);
+}
@@ -0,0 +1,199 @@
+/*
+ *   Generator for synthetic theories.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "generator.hpp"
+#include <cstdlib>
+
+using namespace Bench;
+
+/**
+ * Parse a generator option like "-n 100".
+ *
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @param arg Index of the current argument, advanced if it was an option.
+ * @param options Options to set.
+ * @return True, if the argument was a generator option.
+ */
+bool Bench::parseOption(int argc, char **argv, int &arg, GeneratorOptions &options)
+{
+	if (arg + 1 >= argc || argv[arg][0] != '-' || argv[arg][1] == 0 || argv[arg][2] != 0)
+		return false;
+
+	unsigned value = std::strtoul(argv[arg + 1], nullptr, 10);
+	switch (argv[arg][1]) {
+	case 'n':
+		options.size = value;
+		break;
+	case 'd':
+		options.depth = value;
+		break;
+	case 'f':
+		options.fanout = value ? value : 1;
+		break;
+	case 'l':
+		options.length = value;
+		break;
+	case 's':
+		options.seed = value;
+		break;
+	default:
+		return false;
+	}
+
+	arg += 2;
+	return true;
+}
+
+/**
+ * Construct generator.
+ *
+ * @param options Parameters of the theory.
+ */
+Generator::Generator(const GeneratorOptions &options)
+	: options(options), random(options.seed) {}
+
+/**
+ * Get a random number. We don't use the standard distributions, because
+ * their results differ between implementations.
+ *
+ * @param n Upper bound.
+ * @return Number in [0, n).
+ */
+unsigned Generator::pick(unsigned n)
+{
+	return random() % n;
+}
+
+/**
+ * Generate an atomic statement: a statement variable or a predicate call.
+ *
+ * @param variable Can we use a statement variable?
+ * @return Statement.
+ */
+std::string Generator::atom(bool variable)
+{
+	unsigned index = pick(options.fanout);
+	if (pick(2) && variable)
+		return "s" + std::to_string(index);
+	else
+		return "(p" + std::to_string(index) + " c" + std::to_string(pick(options.fanout)) + ")";
+}
+
+/**
+ * Generate a random statement.
+ *
+ * @param depth Depth of the statement.
+ * @param top Is this a statement of its own? Those shouldn't be single words,
+ *   since they would be taken as name of the statement.
+ * @return Statement.
+ */
+std::string Generator::statement(unsigned depth, bool top)
+{
+	if (depth == 0)
+		return atom(!top);
+
+	// Draw the random numbers in a fixed order.
+	static const char *const connectives[] = {"and", "or", "impl", "equiv"};
+	if (pick(5) == 0)
+		return "(not " + statement(depth - 1, false) + ")";
+
+	const char *connective = connectives[pick(4)];
+	std::string first = statement(depth - 1, false);
+	std::string second = statement(depth - 1, false);
+	return std::string("(") + connective + " " + first + " " + second + ")";
+}
+
+/**
+ * Write a proof step deducing a new statement from the last one.
+ *
+ * @param output Stream to write to.
+ * @param last Last statement of the chain, replaced by the new one.
+ */
+void Generator::step(std::ostream &output, std::string &last)
+{
+	std::string next;
+	switch (pick(4)) {
+	case 0:
+		// Modus ponens with a fresh implication
+		next = statement(options.depth);
+		output << "(axiom (impl " << last << " " << next << "))\n"
+			<< "(lemma " << next << " (ponens (list " << last << " " << next
+			<< ") (list this~1 this~2)))\n";
+		break;
+	case 1:
+		// Double negation
+		next = "(not (not " + last + "))";
+		output << "(lemma " << next << " (double_negation (list " << last
+			<< ") (list this~1)))\n";
+		break;
+	case 2: {
+		// Conjunction with a fresh axiom
+		std::string other = statement(options.depth);
+		next = "(and " + last + " " + other + ")";
+		output << "(axiom " << other << ")\n"
+			<< "(lemma " << next << " (and_compose (list " << last << " " << other
+			<< ") (list this~2 this~1)))\n";
+		break;
+	}
+	case 3: {
+		// Specialization of a universal implication, then modus ponens
+		std::string predicate = "p" + std::to_string(pick(options.fanout));
+		std::string constant = "c" + std::to_string(pick(options.fanout));
+		std::string premiss = "(" + predicate + " " + constant + ")";
+		next = statement(options.depth);
+		std::string lambda = "(lambda (list (t x)) (impl (" + predicate + " x) " + next + "))";
+		output << "(axiom (forall " << lambda << "))\n"
+			<< "(lemma (impl " << premiss << " " << next << ") (specialization (list t "
+			<< lambda << " " << constant << ") (list this~1)))\n"
+			<< "(axiom " << premiss << ")\n"
+			<< "(lemma " << next << " (ponens (list " << premiss << " " << next
+			<< ") (list this~2 this~1)))\n";
+		break;
+	}
+	}
+	last = next;
+}
+
+/**
+ * Write the theory.
+ *
+ * @param output Stream to write to.
+ */
+void Generator::write(std::ostream &output)
+{
+	output << "# Synthetic theory: size " << options.size << ", depth " << options.depth
+		<< ", fanout " << options.fanout << ", length " << options.length
+		<< ", seed " << options.seed << "\n";
+
+	// Declarations
+	output << "(type t)\n";
+	for (unsigned i = 0; i < options.fanout; ++i)
+		output << "(statement s" << i << ")\n"
+			<< "((lambda-type statement (list t)) p" << i << ")\n"
+			<< "(t c" << i << ")\n";
+
+	// Proof chains
+	for (unsigned chain = 0; chain < options.size; ++chain) {
+		std::string last = statement(options.depth);
+		output << "(axiom " << last << ")\n";
+		for (unsigned i = 0; i < options.length; ++i)
+			step(output, last);
+	}
+}
@@ -0,0 +1,68 @@
+/*
+ *   Generator for synthetic theories.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef BENCH_GENERATOR_HPP
+#define BENCH_GENERATOR_HPP
+#include <ostream>
+#include <random>
+#include <string>
+
+/**
+ * Namespace for benchmarks
+ */
+namespace Bench {
+	/**
+	 * Parameters of a synthetic theory.
+	 */
+	struct GeneratorOptions {
+		// Number of independent proof chains
+		unsigned size = 100;
+		// Depth of generated statements
+		unsigned depth = 3;
+		// Number of statement variables, predicates and individuals
+		unsigned fanout = 8;
+		// Number of proof steps per chain
+		unsigned length = 10;
+		// Seed of the random number generator
+		unsigned seed = 1;
+	};
+
+	bool parseOption(int argc, char **argv, int &arg, GeneratorOptions &options);
+
+	/**
+	 * Generator for theories that verify against basic/rules.lth. The output
+	 * only depends on the options, so a theory can be reproduced from them.
+	 */
+	class Generator {
+	public:
+		Generator(const GeneratorOptions &options);
+		void write(std::ostream &output);
+
+	private:
+		std::string statement(unsigned depth, bool top = true);
+		std::string atom(bool variable);
+		unsigned pick(unsigned n);
+		void step(std::ostream &output, std::string &last);
+
+		const GeneratorOptions options;
+		std::mt19937 random;
+	};
+}	// End of namespace Bench
+
+#endif
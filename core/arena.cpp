@@ -0,0 +1,71 @@
+/*
+ *   Region allocation for theories.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "arena.hpp"
+#include <cstdint>
+using namespace Core;
+
+// Round a pointer up to the given alignment.
+static inline void *align(char *pointer, std::size_t alignment)
+{
+	std::uintptr_t address = reinterpret_cast<std::uintptr_t>(pointer);
+	return reinterpret_cast<void *>((address + alignment - 1) & ~(alignment - 1));
+}
+
+/**
+ * Construct an empty arena.
+ *
+ * @param block_size Size of the blocks to allocate.
+ */
+Arena::Arena(std::size_t block_size)
+	: block_size(block_size), current(nullptr), end(nullptr), reserved(0) {}
+
+/**
+ * Allocate memory from the arena.
+ *
+ * @param size Number of bytes.
+ * @param alignment Required alignment, must be a power of two.
+ * @return Pointer to the memory.
+ */
+void *Arena::allocate(std::size_t size, std::size_t alignment)
+{
+	// Big pieces get a block of their own, so we don't waste the current one.
+	if (size > block_size / 4)
+		return align(allocateBlock(size + alignment), alignment);
+
+	std::uintptr_t address = reinterpret_cast<std::uintptr_t>(current);
+	std::uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+	if (!current || aligned + size > reinterpret_cast<std::uintptr_t>(end)) {
+		current = allocateBlock(block_size);
+		end = current + block_size;
+		address = reinterpret_cast<std::uintptr_t>(current);
+		aligned = (address + alignment - 1) & ~(alignment - 1);
+	}
+
+	current += aligned - address + size;
+	return reinterpret_cast<void *>(aligned);
+}
+
+// Allocate a new block of the given size.
+char *Arena::allocateBlock(std::size_t size)
+{
+	blocks.emplace_back(new char[size]);
+	reserved += size;
+	return blocks.back().get();
+}
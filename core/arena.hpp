@@ -0,0 +1,105 @@
+/*
+ *   Region allocation for theories.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_ARENA_HPP
+#define CORE_ARENA_HPP
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Memory region handing out pieces of a few large blocks. Single pieces
+	 * are never freed, all blocks are released together when the arena is
+	 * destroyed. Allocation is not thread-safe.
+	 */
+	class Arena {
+	public:
+		Arena(std::size_t block_size = 1 << 16);
+		Arena(const Arena &) = delete;
+		Arena &operator =(const Arena &) = delete;
+
+		void *allocate(std::size_t size, std::size_t alignment);
+
+		/**
+		 * Get the number of bytes reserved by the arena.
+		 *
+		 * @return Total size of all blocks.
+		 */
+		std::size_t getReserved() const
+			{return reserved;}
+
+	private:
+		char *allocateBlock(std::size_t size);
+
+		const std::size_t block_size;
+		std::vector<std::unique_ptr<char[]>> blocks;
+		char *current, *end;
+		std::size_t reserved;
+	};
+
+	/**
+	 * Standard allocator allocating from an arena. It is meant for
+	 * std::allocate_shared: each allocation keeps the arena alive, so objects
+	 * can safely outlive the theory they were built for.
+	 */
+	template <typename T>
+	class ArenaAllocator {
+	public:
+		typedef T value_type;
+
+		/**
+		 * Construct allocator for an arena.
+		 *
+		 * @param arena Arena to allocate from.
+		 */
+		ArenaAllocator(std::shared_ptr<Arena> arena)
+			: arena(arena) {}
+
+		/**
+		 * Construct allocator from an allocator for another type.
+		 *
+		 * @param other Allocator using the same arena.
+		 */
+		template <typename U>
+		ArenaAllocator(const ArenaAllocator<U> &other)
+			: arena(other.arena) {}
+
+		T *allocate(std::size_t n)
+			{return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));}
+
+		// Memory is given back together with the arena.
+		void deallocate(T *, std::size_t) {}
+
+		std::shared_ptr<Arena> arena;
+	};
+
+	template <typename T, typename U>
+	bool operator ==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+		{return a.arena == b.arena;}
+
+	template <typename T, typename U>
+	bool operator !=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+		{return a.arena != b.arena;}
+}	// End of namespace Core
+
+#endif
@@ -20,9 +20,83 @@
 #include "base.hpp"
 #include "debug.hpp"
 #include "expression.hpp"
+#include "profile.hpp"
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 using namespace Core;
 
+namespace {
+	// Next free type number, the first ones belong to the built-in types.
+	// Numbers are never given back, but with 64 bits we won't run out.
+	std::atomic<TypeId> next_type_id(BuiltInType::RULE + 1);
+
+	// Hash function for lambda type descriptions
+	struct DescriptionHash {
+		std::size_t operator()(const std::vector<TypeId> &description) const
+		{
+			std::size_t hash = 14695981039346656037ULL;
+			for (TypeId id : description)
+				hash = (hash ^ id) * 1099511628211ULL;
+			return hash;
+		}
+	};
+
+	// Numbers of the lambda types that currently exist, by description.
+	struct LambdaTypeTable {
+		std::mutex mutex;
+		std::unordered_map<std::vector<TypeId>, std::weak_ptr<const TypeId>,
+			DescriptionHash> entries;
+	};
+
+	/**
+	 * Get the table of lambda types. It is never destroyed, since types in
+	 * static objects might still release their entries afterwards.
+	 *
+	 * @return Lambda type table.
+	 */
+	LambdaTypeTable &getLambdaTypeTable()
+	{
+		static LambdaTypeTable *table = new LambdaTypeTable;
+		return *table;
+	}
+
+	/**
+	 * Get the number of a lambda type, given by the numbers of its return
+	 * and argument types. Equal lambda types share the number, and its
+	 * entry is dropped with the last of them.
+	 *
+	 * @param description Return type number, followed by argument type numbers.
+	 * @return Shared type number.
+	 */
+	std::shared_ptr<const TypeId> internLambdaType(std::vector<TypeId> &&description)
+	{
+		LambdaTypeTable &table = getLambdaTypeTable();
+		std::lock_guard<std::mutex> lock(table.mutex);
+		std::weak_ptr<const TypeId> &entry = table.entries[description];
+		if (std::shared_ptr<const TypeId> id = entry.lock())
+			return id;
+
+		// If another thread is just dropping the expired entry, it sees that
+		// we have replaced it and leaves it alone.
+		std::vector<TypeId> key(description);
+		std::shared_ptr<const TypeId> id(new TypeId(TypeComparator::newTypeId()),
+			[key] (const TypeId *id) {
+				LambdaTypeTable &table = getLambdaTypeTable();
+				{
+					std::lock_guard<std::mutex> lock(table.mutex);
+					auto it = table.entries.find(key);
+					if (it != table.entries.end() && it->second.expired())
+						table.entries.erase(it);
+				}
+				delete id;
+			});
+		entry = id;
+		return id;
+	}
+}
+
 /**
  * Construct standard type.
  *
@@ -31,16 +105,6 @@ using namespace Core;
 BuiltInType::BuiltInType(Variant variant)
 	: Expression(Expression::BUILTINTYPE), variant(variant) {}
 
-/**
- * Get type of a type expression.
- *
- * @return Type of a type, which is type.
- */
-const_Expr_ptr BuiltInType::getType() const
-{
-	return BuiltInType::type;
-}
-
 void BuiltInType::accept(Visitor *visitor) const
 {
 	visitor->visit(this);
@@ -60,15 +124,15 @@ const const_Expr_ptr
  * @param return_type Type of return value, defaults to statement.
  */
 LambdaType::LambdaType(std::vector<const_Expr_ptr> &&args, const_Expr_ptr return_type)
-	: Expression(Expression::LAMBDATYPE), return_type(return_type), args(std::move(args))
+	: Expression(Expression::LAMBDATYPE), return_type(std::move(return_type)), args(std::move(args))
 {
 	// Is the return type a type?
-	if (return_type->getType() != BuiltInType::type)
-		throw TypeException(return_type->getType(), BuiltInType::type);
+	if (this->return_type->getType() != BuiltInType::type)
+		throw TypeException(this->return_type->getType(), BuiltInType::type);
 
 	// Are the arguments types?
 	auto find = std::find_if(this->args.begin(), this->args.end(),
-		[] (const_Expr_ptr arg) -> bool
+		[] (const const_Expr_ptr &arg) -> bool
 		{return (arg->getType() != BuiltInType::type);}
 	);
 
@@ -77,46 +141,20 @@ LambdaType::LambdaType(std::vector<const_Expr_ptr> &&args, const_Expr_ptr return
 		str << "argument " << find - this->args.begin() + 1;
 		throw TypeException((*find)->getType(), BuiltInType::type, str.str());
 	}
-}
-
-/**
- * Get type of a type expression.
- *
- * @return Type of a type, which is type.
- */
-const_Expr_ptr LambdaType::getType() const
-{
-	return BuiltInType::type;
-}
-
-/**
- * Get the return type of the lambda.
- *
- * @return Pointer to the return type.
- */
-const_Expr_ptr LambdaType::getReturnType() const
-{
-	return return_type;
-}
 
-/**
- * Return an iterator to the beginning of the argument list.
- *
- * @return Begin iterator.
- */
-LambdaType::const_iterator LambdaType::begin() const
-{
-	return args.begin();
-}
+	// Normalize the type once, so that comparisons are cheap.
+	auto is_closed = [] (const Expression *type) -> bool {
+		return type->cls == BUILTINTYPE || (type->cls == LAMBDATYPE
+			&& static_cast<const LambdaType *>(type)->closed);
+	};
 
-/**
- * Return an iterator to the beginning of the argument list.
- *
- * @return End iterator.
- */
-LambdaType::const_iterator LambdaType::end() const
-{
-	return args.end();
+	std::vector<TypeId> description{TypeComparator::getTypeId(this->return_type.get())};
+	closed = is_closed(this->return_type.get());
+	for (const const_Expr_ptr &arg : this->args) {
+		description.push_back(TypeComparator::getTypeId(arg.get()));
+		closed = closed && is_closed(arg.get());
+	}
+	id = internLambdaType(std::move(description));
 }
 
 void LambdaType::accept(Visitor *visitor) const
@@ -131,6 +169,8 @@ void LambdaType::accept(Visitor *visitor) const
  */
 bool TypeComparator::operator()(const Expression *a, const Expression *b)
 {
+	LOGIC_PROFILE_COUNT(type_comparisons);
+
 	// Check if we have types at all
 	if (a->getType() != BuiltInType::type || b->getType() != BuiltInType::type)
 		throw std::logic_error("Trying to compare non-types in TypeComparator");
@@ -139,42 +179,97 @@ bool TypeComparator::operator()(const Expression *a, const Expression *b)
 	if (a == b)
 		return true;
 
-	// Otherwise, write descriptions ...
-	description[0].resize(0);
-	description[1].resize(0);
-	yours = 0;	a->accept(this);
-	yours = 1;	b->accept(this);
+	// Without substitutions, the canonical numbers decide.
+	if (!context || context->empty())
+		return getTypeId(a) == getTypeId(b);
+	else
+		return equal(a, b);
+}
 
-	// ... and compare them
-	return (description[0] == description[1]);
+/**
+ * Get the canonical number of a type, without substitutions.
+ *
+ * @param type Type expression.
+ * @return Type number.
+ */
+TypeId TypeComparator::getTypeId(const Expression *type)
+{
+	switch (type->cls) {
+	case Expression::BUILTINTYPE:
+		return static_cast<const BuiltInType *>(type)->getTypeId();
+	case Expression::LAMBDATYPE:
+		return static_cast<const LambdaType *>(type)->getTypeId();
+	case Expression::ATOMIC:
+		return static_cast<const AtomicExpr *>(type)->getAtom()->getTypeId();
+	default:
+		throw std::logic_error("Trying to get number of non-type in TypeComparator");
+	}
 }
 
-void TypeComparator::visit(const BuiltInType *type)
+/**
+ * Get a new type number, for a type that is different from all others.
+ *
+ * @return Unused type number.
+ */
+TypeId TypeComparator::newTypeId()
 {
-	// The following assumes that small values will never be used as adresses.
-	description[yours].push_back(reinterpret_cast<void *>(type->variant));
+	return next_type_id++;
 }
 
-void TypeComparator::visit(const LambdaType *type)
+/**
+ * Replace substituted type variables by their substitutes.
+ *
+ * @param type Type expression.
+ * @return Type expression that is not substituted.
+ */
+const Expression *TypeComparator::resolve(const Expression *type) const
 {
-	// The following assumes that 0xff..ff and 0xff..fe will never be used as adresses.
-	description[yours].push_back(reinterpret_cast<void *>(-1));
-	type->getReturnType()->accept(this);
-	for (const_Expr_ptr arg_type : *type)
-		arg_type->accept(this);
-	description[yours].push_back(reinterpret_cast<void *>(-2));
+	Context::const_iterator find;
+	while (type->cls == Expression::ATOMIC && (find = context->find(
+			static_cast<const AtomicExpr *>(type)->getAtom())) != context->end())
+		type = find->second.get();
+	return type;
 }
 
-void TypeComparator::visit(const AtomicExpr *type)
+/**
+ * Compare types under substitutions. Closed types have no type variables
+ * and are compared by their numbers.
+ *
+ * @param a First type.
+ * @param b Second type.
+ * @return True, if a==b.
+ */
+bool TypeComparator::equal(const Expression *a, const Expression *b) const
 {
-	// If there is a definition, look at that.
-	const_Node_ptr node = type->getAtom();
+	a = resolve(a);
+	b = resolve(b);
+	if (a == b)
+		return true;
+	if (a->cls != b->cls)
+		return false;
 
-	Context::const_iterator find;
-	if (context && (find = context->find(node)) != context->end())
-		find->second->accept(this);
-	else
-		description[yours].push_back(node.get());
+	switch (a->cls) {
+	case Expression::BUILTINTYPE:
+		return static_cast<const BuiltInType *>(a)->variant
+			== static_cast<const BuiltInType *>(b)->variant;
+	case Expression::ATOMIC:
+		return static_cast<const AtomicExpr *>(a)->getAtom()
+			== static_cast<const AtomicExpr *>(b)->getAtom();
+	case Expression::LAMBDATYPE: {
+		auto lambda_a = static_cast<const LambdaType *>(a);
+		auto lambda_b = static_cast<const LambdaType *>(b);
+		if (lambda_a->isClosed() && lambda_b->isClosed())
+			return lambda_a->getTypeId() == lambda_b->getTypeId();
+		if (lambda_a->end() - lambda_a->begin() != lambda_b->end() - lambda_b->begin()
+				|| !equal(lambda_a->getReturnType().get(), lambda_b->getReturnType().get()))
+			return false;
+		return std::equal(lambda_a->begin(), lambda_a->end(), lambda_b->begin(),
+			[this] (const const_Expr_ptr &arg_a, const const_Expr_ptr &arg_b) -> bool
+			{return equal(arg_a.get(), arg_b.get());});
+	}
+	default:
+		return false;
+	}
 }
 
 /**
@@ -183,13 +278,32 @@ void TypeComparator::visit(const AtomicExpr *type)
  * @param type Type of the object
  * @param name Name or identifier of the object.
  */
-Object::Object(const_Expr_ptr type, const std::string &name)
-	: type(type), name(name)
+Object::Object(const_Expr_ptr type, Symbol name)
+	: type(std::move(type)), name(name)
 {
-	if (type->getType() != BuiltInType::type)
-		throw TypeException(type->getType(), BuiltInType::type);
+	if (this->type->getType() != BuiltInType::type)
+		throw TypeException(this->type->getType(), BuiltInType::type);
 }
 
+/**
+ * Construct a node.
+ *
+ * @param type Type of the node.
+ * @param name Name of the node.
+ */
+Node::Node(const_Expr_ptr type, Symbol name)
+	: Object(std::move(type), name),
+	  type_id(getType() == BuiltInType::type ? TypeComparator::newTypeId() : 0) {}
+
+/**
+ * Copy a node. If it is a type, the copy is a different type.
+ *
+ * @param node Node to copy.
+ */
+Node::Node(const Node &node)
+	: Object(node), expression(node.expression),
+	  type_id(node.type_id ? TypeComparator::newTypeId() : 0) {}
+
 /**
  * Clone node object.
  *
@@ -209,7 +323,7 @@ void Node::setDefinition(Expr_ptr new_expression)
 {
 	TypeComparator compare;
 	if (compare(getType().get(), new_expression->getType().get()))
-		expression = new_expression;
+		expression = std::move(new_expression);
 	else
 		throw TypeException(new_expression->getType(), getType());
 }
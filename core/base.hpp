@@ -20,6 +20,10 @@
 #ifndef CORE_BASE_HPP
 #define CORE_BASE_HPP
 #include "forward.hpp"
+#include "small.hpp"
+#include "symbol.hpp"
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include "traverse.hpp"
@@ -28,6 +32,18 @@
  * Namespace for logic core
  */
 namespace Core {
+	/**
+	 * Tag for constructors that skip the type checks, for input known to be
+	 * well-typed, such as theories that were checked before they were saved.
+	 */
+	struct Unchecked {};
+
+	/**
+	 * Canonical number of a type. Two types are equal if they have the same
+	 * number, as long as no type variables are substituted.
+	 */
+	typedef std::uint64_t TypeId;
+
 	/**
 	 * Abstract class for expressions.
 	 */
@@ -45,18 +61,25 @@ namespace Core {
 		 */
 		virtual void accept(Visitor *visitor) const = 0;
 
-		/**
-		 * Get type of expression.
-		 *
-		 * @return Type of expression.
-		 */
-		virtual const_Expr_ptr getType() const = 0;
+		const const_Expr_ptr &getType() const;
 
 	protected:
 		/**
 		 * Construct expression of certain class.
+		 *
+		 * @param cls Class of the expression.
+		 * @param type Type of the expression, for types this stays empty.
 		 */
-		Expression(Class cls) : cls(cls) {}
+		Expression(Class cls, const_Expr_ptr type = const_Expr_ptr())
+			: cls(cls), type(std::move(type)), hash(0) {}
+
+	private:
+		friend class StructuralHash;
+
+		// Computed once, so that reading it doesn't cost anything
+		const const_Expr_ptr type;
+		// Structural hash of closed expressions, 0 until it is known
+		mutable std::atomic<std::size_t> hash;
 	};
 
 	/**
@@ -68,9 +91,16 @@ namespace Core {
 			const variant;
 
 		BuiltInType(Variant variant);
-		const_Expr_ptr getType() const;
 		void accept(Visitor *visitor) const;
 
+		/**
+		 * Get canonical number of the type.
+		 *
+		 * @return Type number, which is the variant.
+		 */
+		TypeId getTypeId() const
+			{return variant;}
+
 		// Global standard types
 		static const const_Expr_ptr
 			type, statement, rule, undefined;
@@ -83,36 +113,87 @@ namespace Core {
 	public:
 		LambdaType(std::vector<const_Expr_ptr> &&args,
 			const_Expr_ptr return_type = BuiltInType::statement);
-		const_Expr_ptr getType() const;
-		const_Expr_ptr getReturnType() const;
+
+		/**
+		 * Get the return type of the lambda.
+		 *
+		 * @return Return type.
+		 */
+		const const_Expr_ptr &getReturnType() const
+			{return return_type;}
 
 		// Iterate over argument types...
-		typedef std::vector<const_Expr_ptr>::const_iterator const_iterator;
-		const_iterator begin() const;
-		const_iterator end() const;
+		typedef SmallVector<const_Expr_ptr, 2>::const_iterator const_iterator;
+
+		/**
+		 * Return an iterator to the beginning of the argument list.
+		 *
+		 * @return Begin iterator.
+		 */
+		const_iterator begin() const
+			{return args.begin();}
+
+		/**
+		 * Return an iterator to the end of the argument list.
+		 *
+		 * @return End iterator.
+		 */
+		const_iterator end() const
+			{return args.end();}
 
 		void accept(Visitor *visitor) const;
 
+		/**
+		 * Get canonical number of the type, assuming no substitutions.
+		 *
+		 * @return Type number.
+		 */
+		TypeId getTypeId() const
+			{return *id;}
+
+		/**
+		 * Is the type free of type variables that could be substituted?
+		 *
+		 * @return True, if the type contains only built-in and lambda types.
+		 */
+		bool isClosed() const
+			{return closed;}
+
 	private:
 		const_Expr_ptr return_type;
-		std::vector<const_Expr_ptr> args;
+		SmallVector<const_Expr_ptr, 2> args;
+		std::shared_ptr<const TypeId> id;
+		bool closed;
 	};
 
 	/**
-	 * Type comparison class, unfortunately not thread-safe.
+	 * Get type of expression.
+	 *
+	 * @return Type of expression.
 	 */
-	class TypeComparator : public Visitor {
+	inline const const_Expr_ptr &Expression::getType() const
+	{
+		// Types are of type type, including type itself.
+		return type ? type : BuiltInType::type;
+	}
+
+	/**
+	 * Type comparison class. Types are compared by their canonical numbers,
+	 * only types containing substituted type variables need to be traversed.
+	 */
+	class TypeComparator {
 	public:
 		TypeComparator(const Context *context = nullptr) : context(context) {}
 		bool operator()(const Expression *, const Expression *);
-		void visit(const BuiltInType *type);
-		void visit(const LambdaType *type);
-		void visit(const AtomicExpr *type);
+
+		static TypeId getTypeId(const Expression *type);
+		static TypeId newTypeId();
 
 	private:
+		const Expression *resolve(const Expression *type) const;
+		bool equal(const Expression *a, const Expression *b) const;
+
 		const Context *context;
-		int yours;
-		std::vector<const void *> description[2];
 	};
 
 	/**
@@ -129,7 +210,7 @@ namespace Core {
 		 *
 		 * @return Type of node.
 		 */
-		const_Expr_ptr getType() const
+		const const_Expr_ptr &getType() const
 			{return type;}
 
 		/**
@@ -138,16 +219,24 @@ namespace Core {
 		 * @return Name of node.
 		 */
 		const std::string &getName() const
+			{return name.str();}
+
+		/**
+		 * Get name of node as symbol.
+		 *
+		 * @return Interned name of node.
+		 */
+		Symbol getSymbol() const
 			{return name;}
 
 		virtual void accept(Visitor *visitor) const = 0;
 
 	protected:
-		Object(const_Expr_ptr type, const std::string &name);
+		Object(const_Expr_ptr type, Symbol name);
 
 	private:
 		const_Expr_ptr type;
-		const std::string name;
+		const Symbol name;
 	};
 
 	/**
@@ -156,8 +245,8 @@ namespace Core {
 	 */
 	class Node : public Object {
 	public:
-		Node(const_Expr_ptr type, const std::string &name)
-		  : Object(type, name) {}
+		Node(const_Expr_ptr type, Symbol name);
+		Node(const Node &node);
 		Object_ptr clone() const;
 
 		void setDefinition(Expr_ptr new_expression);
@@ -170,10 +259,19 @@ namespace Core {
 		const_Expr_ptr getDefinition() const
 			{return expression;}
 
+		/**
+		 * Get canonical number of the node as type.
+		 *
+		 * @return Type number, if this is a type, otherwise 0.
+		 */
+		TypeId getTypeId() const
+			{return type_id;}
+
 		virtual void accept(Visitor *visitor) const;
 
 	private:
 		Expr_ptr expression;
+		const TypeId type_id;
 	};
 }	// End of namespace Core
 
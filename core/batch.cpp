@@ -0,0 +1,198 @@
+/*
+ *   Verification of many theories against shared rules.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "batch.hpp"
+#include "logic.hpp"
+#include "lisp.hpp"
+#include "buffer.hpp"
+#include "binary.hpp"
+#include <limits>
+#include <mutex>
+#include <sstream>
+
+using namespace Core;
+
+namespace {
+	/**
+	 * Read a theory in text or compiled form.
+	 *
+	 * @param begin Beginning of the buffer.
+	 * @param end End of the buffer.
+	 * @param filename Name of the file, for messages.
+	 * @param rules Theory containing the rules.
+	 * @param output Output stream for errors, warnings and notes.
+	 * @param errors Pointer where the number of errors shall be written to.
+	 * @return Theory, possibly incomplete if there were errors.
+	 */
+	Theory read(const char *begin, const char *end, const std::string &filename,
+		const Theory *rules, std::ostream &output, int *errors)
+	{
+		*errors = 0;
+		try {
+			if (BinaryReader::isBinary(begin, end)) {
+				BinaryReader reader(begin, end);
+				reader.rules = rules;
+				return reader.readTheory();
+			}
+
+			Parser parser(begin, end, output, filename);
+			parser.arena = std::make_shared<Arena>();
+			parser.rules = rules;
+			Theory theory = parser.parseTheory();
+			*errors = parser.getErrors();
+			return theory;
+		}
+		catch (std::exception &ex) {
+			output << filename << ": " << ex.what() << std::endl;
+			*errors = 1;
+			return Theory();
+		}
+	}
+}
+
+/**
+ * Construct batch verifier.
+ *
+ * @param rules Theory containing the rules, which mustn't be changed anymore.
+ * @param num_threads Number of files checked at once, or 0 for the number of
+ *      cores.
+ */
+BatchVerifier::BatchVerifier(std::shared_ptr<const Theory> rules, unsigned num_threads)
+	: cache(nullptr), rules(std::move(rules)), scheduler(num_threads, 1) {}
+
+/**
+ * Parse a rules file, in text or compiled form.
+ *
+ * @param filename Name of the file containing the rules.
+ * @param output Output stream for errors, warnings and notes.
+ * @return Theory containing the rules, or an empty pointer if the file
+ *      couldn't be read or had errors.
+ */
+std::shared_ptr<const Theory> BatchVerifier::loadRules(const std::string &filename,
+	std::ostream &output)
+{
+	InputBuffer file(filename);
+	if (!file) {
+		output << "Couldn't read rules file " << filename << std::endl;
+		return nullptr;
+	}
+
+	int errors;
+	auto rules = std::make_shared<Theory>(read(file.begin(), file.end(), filename, nullptr, output, &errors));
+	if (!errors)
+		return rules;
+
+	output << "Couldn't parse rules file " << filename << std::endl;
+	return nullptr;
+}
+
+/**
+ * Parse and verify a theory file, in text or compiled form.
+ *
+ * @param filename Name of the file containing the theory.
+ * @return Result of the check.
+ */
+BatchResult BatchVerifier::verifyFile(const std::string &filename) const
+{
+	InputBuffer file(filename);
+	if (!file)
+		return BatchResult{filename, -1, false, {},
+			"Couldn't read theory file " + filename + "\n"};
+
+	return verifyBuffer(filename, file.begin(), file.end());
+}
+
+/**
+ * Parse and verify a theory in memory, in text or compiled form.
+ *
+ * @param name Name of the theory, used in messages.
+ * @param begin Beginning of the buffer.
+ * @param end End of the buffer.
+ * @param theory Pointer where the theory shall be written to, or nullptr.
+ * @return Result of the check.
+ */
+BatchResult BatchVerifier::verifyBuffer(const std::string &name, const char *begin,
+	const char *end, std::shared_ptr<const Theory> *theory) const
+{
+	BatchResult result{name, 0, false, {}, ""};
+	std::ostringstream output;
+
+	auto parsed = std::make_shared<Theory>(
+		read(begin, end, name, rules.get(), output, &result.errors));
+	if (result.errors)
+		output << "Couldn't parse theory file " << name << std::endl;
+	else {
+		// Files are checked in parallel, not the statements of a file.
+		std::vector<Theory::const_iterator> failed;
+		result.verified = parsed->verify(1, &failed, cache);
+
+		for (Theory::const_iterator it : failed) {
+			std::size_t position = parsed->position(it);
+			result.failed.push_back(position);
+			auto stmt = std::static_pointer_cast<const Statement>(*it);
+
+			output << "Couldn't verify object " << position + 1;
+			if (stmt->getName() != "")
+				output << " (" << stmt->getName() << ")";
+			output << ": ";
+			{
+				Writer writer(output, std::numeric_limits<int>::max());
+				stmt->getDefinition()->accept(&writer);
+			}
+		}
+	}
+
+	result.messages = output.str();
+	if (theory)
+		*theory = std::move(parsed);
+	return result;
+}
+
+/**
+ * Parse and verify theory files concurrently.
+ *
+ * @param files Names of the files containing the theories.
+ * @param done Function getting the result of every file as soon as it is
+ *      checked. Calls are serialized, but not in the order of the files.
+ */
+void BatchVerifier::verify(const std::vector<std::string> &files,
+	const std::function<void (const BatchResult &)> &done) const
+{
+	std::mutex mutex;
+	scheduler.parallelFor(files.size(), [this, &files, &done, &mutex] (std::size_t i) {
+		BatchResult result = verifyFile(files[i]);
+		std::lock_guard<std::mutex> lock(mutex);
+		done(result);
+	});
+}
+
+/**
+ * Parse and verify theory files concurrently.
+ *
+ * @param files Names of the files containing the theories.
+ * @return Results, in the order of the files.
+ */
+std::vector<BatchResult> BatchVerifier::verify(const std::vector<std::string> &files) const
+{
+	std::vector<BatchResult> results(files.size());
+	scheduler.parallelFor(files.size(), [this, &files, &results] (std::size_t i) {
+		results[i] = verifyFile(files[i]);
+	});
+	return results;
+}
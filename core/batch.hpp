@@ -0,0 +1,87 @@
+/*
+ *   Verification of many theories against shared rules.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_BATCH_HPP
+#define CORE_BATCH_HPP
+#include "forward.hpp"
+#include "parallel.hpp"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Outcome of checking a single theory file.
+	 */
+	struct BatchResult {
+		// Name of the file
+		std::string filename;
+		// Number of parse errors, or -1 if the file couldn't be read
+		int errors;
+		// Could all statements be verified?
+		bool verified;
+		// Positions of statements that couldn't be verified
+		std::vector<std::size_t> failed;
+		// Messages of the parser and a description of the failed statements
+		std::string messages;
+	};
+
+	/**
+	 * Verifier for many theory files against the same rules. The rules are
+	 * parsed only once, and shared by all files. They mustn't be changed, so
+	 * files can be parsed and checked concurrently, one per thread.
+	 */
+	class BatchVerifier {
+	public:
+		BatchVerifier(std::shared_ptr<const Theory> rules, unsigned num_threads = 0);
+
+		static std::shared_ptr<const Theory> loadRules(const std::string &filename,
+			std::ostream &output);
+
+		BatchResult verifyFile(const std::string &filename) const;
+		BatchResult verifyBuffer(const std::string &name, const char *begin, const char *end,
+			std::shared_ptr<const Theory> *theory = nullptr) const;
+		std::vector<BatchResult> verify(const std::vector<std::string> &files) const;
+		void verify(const std::vector<std::string> &files,
+			const std::function<void (const BatchResult &)> &done) const;
+
+		/**
+		 * Get the shared rules.
+		 *
+		 * @return Theory containing the rules.
+		 */
+		const std::shared_ptr<const Theory> &getRules() const
+			{return rules;}
+
+		// Optional cache for rule applications, shared by all files
+		VerificationCache *cache;
+
+	private:
+		const std::shared_ptr<const Theory> rules;
+		mutable WorkStealingScheduler scheduler;
+	};
+}	// End of namespace Core
+
+#endif
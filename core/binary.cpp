@@ -0,0 +1,675 @@
+/*
+ *   Binary format for theories.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "binary.hpp"
+#include "expression.hpp"
+#include "dispatch.hpp"
+#include "logic.hpp"
+#include "debug.hpp"
+#include <cstring>
+
+using namespace Core;
+
+namespace {
+	const char magic[4] = {'L', 'T', 'H', 'B'};
+	const std::uint32_t version = 1;
+
+	// Entity number for absent expressions, like undefined nodes.
+	const std::uint32_t NONE = 0xFFFFFFFF;
+
+	// Record tags
+	enum Tag : std::uint32_t {
+		NODE, ATOMIC, LAMBDACALL, NEGATION, CONNECTIVE, QUANTIFIER, LAMBDA,
+		LAMBDATYPE, TAUTOLOGY, EQUIVRULE, DEDUCTIONRULE, STATEMENT, PROOFSTEP,
+		ADD, PROOF, END
+	};
+
+	void write32(std::ostream &output, std::uint32_t value)
+	{
+		char bytes[4] = {
+			char(value & 0xFF), char((value >> 8) & 0xFF),
+			char((value >> 16) & 0xFF), char((value >> 24) & 0xFF)
+		};
+		output.write(bytes, 4);
+	}
+}
+
+
+////////////////////////////////////
+// Implementation of BinaryWriter //
+////////////////////////////////////
+
+/**
+ * Construct BinaryWriter.
+ *
+ * @param output Stream to write the theory to.
+ */
+BinaryWriter::BinaryWriter(std::ostream &output)
+	: output(output), next_id(4), last(NONE), theory(nullptr)
+{
+	// The built-in types have fixed numbers.
+	ids[BuiltInType::undefined.get()] = BuiltInType::UNDEFINED;
+	ids[BuiltInType::type.get()] = BuiltInType::TYPE;
+	ids[BuiltInType::statement.get()] = BuiltInType::STATEMENT;
+	ids[BuiltInType::rule.get()] = BuiltInType::RULE;
+}
+
+/**
+ * Get the number of an expression, writing it first if necessary.
+ *
+ * @param expr Expression to write.
+ * @return Entity number of the expression.
+ */
+std::uint32_t BinaryWriter::entity(const Expression *expr)
+{
+	if (!expr)
+		return NONE;
+
+	auto it = ids.find(expr);
+	if (it != ids.end())
+		return it->second;
+
+	dispatchVisit(this, expr);
+	return last;
+}
+
+/**
+ * Get the number of an object, writing it first if necessary.
+ *
+ * @param object Object to write.
+ * @return Entity number of the object.
+ */
+std::uint32_t BinaryWriter::entity(const Object *object)
+{
+	auto it = ids.find(object);
+	if (it != ids.end())
+		return it->second;
+
+	object->accept(this);
+	return last;
+}
+
+/**
+ * Get the number of a symbol in the symbol table.
+ *
+ * @param symbol Symbol to look up.
+ * @return Index into the symbol table.
+ */
+std::uint32_t BinaryWriter::symbol(Symbol symbol)
+{
+	auto it = symbol_ids.find(symbol);
+	if (it != symbol_ids.end())
+		return it->second;
+
+	std::uint32_t id = symbols.size();
+	symbols.push_back(symbol);
+	symbol_ids.emplace(symbol, id);
+	return id;
+}
+
+/**
+ * Assign the next entity number to the record just written.
+ *
+ * @param entity Pointer to the entity.
+ */
+void BinaryWriter::define(const void *entity)
+{
+	last = next_id++;
+	ids[entity] = last;
+}
+
+/**
+ * Write parameter nodes and the parameter list.
+ *
+ * @param params Parameter nodes.
+ */
+void BinaryWriter::writeParams(const std::vector<Node_ptr> &params)
+{
+	std::vector<std::uint32_t> param_ids;
+	param_ids.reserve(params.size());
+	for (const Node_ptr &param : params)
+		param_ids.push_back(entity(param.get()));
+
+	records.push_back(param_ids.size());
+	records.insert(records.end(), param_ids.begin(), param_ids.end());
+}
+
+void BinaryWriter::visit(const Node *node)
+{
+	std::uint32_t type = entity(node->getType().get());
+	std::uint32_t definition = entity(node->getDefinition().get());
+	records.insert(records.end(),
+		{NODE, type, symbol(node->getSymbol()), definition});
+	define(node);
+}
+
+void BinaryWriter::visit(const BuiltInType *type)
+{
+	// Another instance of a built-in type, we use the standard one.
+	last = type->variant;
+	ids[type] = last;
+}
+
+void BinaryWriter::visit(const LambdaType *type)
+{
+	std::uint32_t return_type = entity(type->getReturnType().get());
+	std::vector<std::uint32_t> args;
+	for (const const_Expr_ptr &arg : *type)
+		args.push_back(entity(arg.get()));
+
+	records.insert(records.end(), {LAMBDATYPE, return_type,
+		static_cast<std::uint32_t>(args.size())});
+	records.insert(records.end(), args.begin(), args.end());
+	define(type);
+}
+
+void BinaryWriter::visit(const AtomicExpr *expression)
+{
+	std::uint32_t node = entity(expression->getAtom().get());
+	records.insert(records.end(), {ATOMIC, node});
+	define(expression);
+}
+
+void BinaryWriter::visit(const LambdaCallExpr *expression)
+{
+	std::uint32_t node = entity(expression->getLambda().get());
+	std::vector<std::uint32_t> args;
+	for (const Expr_ptr &arg : *expression)
+		args.push_back(entity(arg.get()));
+
+	records.insert(records.end(), {LAMBDACALL, node,
+		static_cast<std::uint32_t>(args.size())});
+	records.insert(records.end(), args.begin(), args.end());
+	define(expression);
+}
+
+void BinaryWriter::visit(const NegationExpr *expression)
+{
+	std::uint32_t expr = entity(expression->getExpr().get());
+	records.insert(records.end(), {NEGATION, expr});
+	define(expression);
+}
+
+void BinaryWriter::visit(const ConnectiveExpr *expression)
+{
+	std::uint32_t first = entity(expression->getFirstExpr().get());
+	std::uint32_t second = entity(expression->getSecondExpr().get());
+	records.insert(records.end(), {CONNECTIVE,
+		static_cast<std::uint32_t>(expression->getVariant()), first, second});
+	define(expression);
+}
+
+void BinaryWriter::visit(const QuantifierExpr *expression)
+{
+	std::uint32_t predicate = entity(expression->getPredicate().get());
+	records.insert(records.end(), {QUANTIFIER,
+		static_cast<std::uint32_t>(expression->getVariant()), predicate});
+	define(expression);
+}
+
+void BinaryWriter::visit(const LambdaExpr *expression)
+{
+	// Parameter nodes must come before the body that uses them.
+	for (const Node_ptr &param : expression->getParams())
+		entity(param.get());
+	std::uint32_t body = entity(expression->getDefinition().get());
+
+	records.push_back(LAMBDA);
+	writeParams(expression->getParams());
+	records.push_back(body);
+	define(expression);
+}
+
+void BinaryWriter::visit(const Tautology *rule)
+{
+	for (const Node_ptr &param : rule->getParams())
+		entity(param.get());
+	std::uint32_t statement = entity(rule->getStatement().get());
+
+	records.insert(records.end(), {TAUTOLOGY, symbol(rule->getSymbol())});
+	writeParams(rule->getParams());
+	records.push_back(statement);
+	define(rule);
+}
+
+void BinaryWriter::visit(const EquivalenceRule *rule)
+{
+	for (const Node_ptr &param : rule->getParams())
+		entity(param.get());
+	std::uint32_t statement1 = entity(rule->getStatement1().get());
+	std::uint32_t statement2 = entity(rule->getStatement2().get());
+
+	records.insert(records.end(), {EQUIVRULE, symbol(rule->getSymbol())});
+	writeParams(rule->getParams());
+	records.insert(records.end(), {statement1, statement2});
+	define(rule);
+}
+
+void BinaryWriter::visit(const DeductionRule *rule)
+{
+	for (const Node_ptr &param : rule->getParams())
+		entity(param.get());
+	std::vector<std::uint32_t> premisses;
+	for (const const_Expr_ptr &premiss : rule->getPremisses())
+		premisses.push_back(entity(premiss.get()));
+	std::uint32_t conclusion = entity(rule->getConclusion().get());
+
+	records.insert(records.end(), {DEDUCTIONRULE, symbol(rule->getSymbol())});
+	writeParams(rule->getParams());
+	records.push_back(premisses.size());
+	records.insert(records.end(), premisses.begin(), premisses.end());
+	records.push_back(conclusion);
+	define(rule);
+}
+
+void BinaryWriter::visit(const Statement *statement)
+{
+	std::uint32_t expr = entity(statement->getDefinition().get());
+	records.insert(records.end(), {STATEMENT, symbol(statement->getSymbol()), expr});
+	define(statement);
+}
+
+void BinaryWriter::visit(const ProofStep *proofstep)
+{
+	const_Rule_ptr rule = proofstep->getRule();
+	std::vector<std::uint32_t> vars;
+	for (const Node_ptr &param : rule->getParams())
+		vars.push_back(entity((*proofstep)[param].get()));
+
+	std::vector<std::uint32_t> refs;
+	for (const Reference &ref : proofstep->getReferences()) {
+		std::size_t position = theory->position(ref.getIterator());
+		if (position == Theory::npos || position == theory->size())
+			throw BinaryFormatException("can't write references to other theories");
+		refs.push_back(position);
+	}
+
+	records.insert(records.end(), {PROOFSTEP, symbol(rule->getSymbol()),
+		static_cast<std::uint32_t>(vars.size())});
+	records.insert(records.end(), vars.begin(), vars.end());
+	records.push_back(refs.size());
+	records.insert(records.end(), refs.begin(), refs.end());
+	define(proofstep);
+}
+
+/**
+ * Refuse to write a lazy proof. Statement::getProof() parses skipped proofs,
+ * so we only get here if the proof has errors.
+ */
+void BinaryWriter::visit(const LazyProof *)
+{
+	throw BinaryFormatException("can't write proofs that don't parse");
+}
+
+/**
+ * Write a theory to the output stream.
+ *
+ * @param theory Theory to write.
+ */
+void BinaryWriter::visit(const Theory *theory)
+{
+	this->theory = theory;
+
+	for (const Object_ptr &object : *theory) {
+		records.insert(records.end(), {ADD, entity(object.get())});
+
+		auto statement = std::dynamic_pointer_cast<const Statement>(object);
+		if (statement && statement->hasProof()) {
+			statement->getProof()->accept(this);
+			records.insert(records.end(), {PROOF, ids[statement.get()], last});
+		}
+	}
+	records.push_back(END);
+
+	// Header and symbol table
+	output.write(magic, 4);
+	write32(output, version);
+	write32(output, symbols.size());
+	for (Symbol symbol : symbols) {
+		const std::string &str = symbol.str();
+		write32(output, str.length());
+		output.write(str.data(), str.length());
+		static const char padding[4] = {};
+		output.write(padding, (4 - str.length() % 4) % 4);
+	}
+
+	// Records
+	write32(output, records.size());
+	for (std::uint32_t word : records)
+		write32(output, word);
+}
+
+
+////////////////////////////////////
+// Implementation of BinaryReader //
+////////////////////////////////////
+
+/**
+ * Construct BinaryReader and read the symbol table.
+ *
+ * @param begin Beginning of the input.
+ * @param end End of the input.
+ */
+BinaryReader::BinaryReader(const char *begin, const char *end)
+	: rules(nullptr), pos(reinterpret_cast<const unsigned char *>(begin)),
+	  end(reinterpret_cast<const unsigned char *>(end)),
+	  entities{{BuiltInType::undefined, nullptr, nullptr},
+		{BuiltInType::type, nullptr, nullptr},
+		{BuiltInType::statement, nullptr, nullptr},
+		{BuiltInType::rule, nullptr, nullptr}}
+{
+	if (!isBinary(begin, end))
+		throw BinaryFormatException("not a binary theory");
+	pos += 4;
+	if (read() != version)
+		throw BinaryFormatException("unsupported version");
+
+	std::uint32_t num_symbols = readCount();
+	for (std::uint32_t i = 0; i < num_symbols; ++i) {
+		std::size_t length = read();
+		std::size_t padded = length + (4 - length % 4) % 4;
+		if (padded > std::size_t(this->end - pos))
+			throw BinaryFormatException("truncated symbol table");
+		symbols.emplace_back(reinterpret_cast<const char *>(pos), length);
+		pos += padded;
+	}
+
+	// Don't read behind the records.
+	std::uint32_t num_words = read();
+	if (num_words > std::size_t(this->end - pos) / 4)
+		throw BinaryFormatException("truncated records");
+	this->end = pos + 4 * std::size_t(num_words);
+}
+
+/**
+ * Does the input start like a binary theory?
+ *
+ * @param begin Beginning of the input.
+ * @param end End of the input.
+ * @return True, if the input has the magic number of the binary format.
+ */
+bool BinaryReader::isBinary(const char *begin, const char *end)
+{
+	return end - begin >= 4 && std::memcmp(begin, magic, 4) == 0;
+}
+
+/**
+ * Read a word from the input.
+ *
+ * @return Next word.
+ */
+std::uint32_t BinaryReader::read()
+{
+	if (end - pos < 4)
+		throw BinaryFormatException("unexpected end of input");
+
+	std::uint32_t value = std::uint32_t(pos[0]) | std::uint32_t(pos[1]) << 8
+		| std::uint32_t(pos[2]) << 16 | std::uint32_t(pos[3]) << 24;
+	pos += 4;
+	return value;
+}
+
+/**
+ * Read the length of a list whose elements take at least a word each.
+ *
+ * @return Number of elements.
+ */
+std::uint32_t BinaryReader::readCount()
+{
+	std::uint32_t count = read();
+	if (count > std::size_t(end - pos) / 4)
+		throw BinaryFormatException("count exceeds input");
+	return count;
+}
+
+/**
+ * Read a symbol reference.
+ *
+ * @return Symbol from the symbol table.
+ */
+Symbol BinaryReader::readSymbol()
+{
+	std::uint32_t id = read();
+	if (id >= symbols.size())
+		throw BinaryFormatException("invalid symbol");
+	return symbols[id];
+}
+
+/**
+ * Get entity by number.
+ *
+ * @param id Entity number.
+ * @return Entity defined before.
+ */
+const BinaryReader::Entity &BinaryReader::entity(std::uint32_t id) const
+{
+	if (id >= entities.size())
+		throw BinaryFormatException("invalid entity");
+	return entities[id];
+}
+
+/**
+ * Read a reference to an expression.
+ *
+ * @return Expression.
+ */
+Expr_ptr BinaryReader::readExpr()
+{
+	const_Expr_ptr expr = entity(read()).expr;
+	if (!expr)
+		throw BinaryFormatException("expected expression");
+	return std::const_pointer_cast<Expression>(expr);
+}
+
+/**
+ * Read a reference to a node.
+ *
+ * @return Node.
+ */
+Node_ptr BinaryReader::readNode()
+{
+	Node_ptr node = std::dynamic_pointer_cast<Node>(entity(read()).object);
+	if (!node)
+		throw BinaryFormatException("expected node");
+	return node;
+}
+
+/**
+ * Read a parameter list.
+ *
+ * @return Parameter nodes.
+ */
+std::vector<Node_ptr> BinaryReader::readParams()
+{
+	std::uint32_t num_params = readCount();
+	std::vector<Node_ptr> params;
+	for (std::uint32_t i = 0; i < num_params; ++i)
+		params.push_back(readNode());
+	return params;
+}
+
+/**
+ * Read the theory.
+ *
+ * @return Theory.
+ */
+Theory BinaryReader::readTheory()
+{
+	Theory theory;
+	Theory::iterator it = theory.begin();
+
+	while (true) {
+		Entity entity;
+		switch (read()) {
+		case NODE: {
+			const_Expr_ptr type = readExpr();
+			Node_ptr node = std::make_shared<Node>(type, readSymbol());
+			std::uint32_t definition = read();
+			if (definition != NONE) {
+				const_Expr_ptr expr = this->entity(definition).expr;
+				if (!expr)
+					throw BinaryFormatException("expected expression");
+				node->setDefinition(std::const_pointer_cast<Expression>(expr));
+			}
+			entity.object = node;
+			break;
+		}
+		case ATOMIC:
+			entity.expr = std::make_shared<AtomicExpr>(readNode());
+			break;
+		case LAMBDACALL: {
+			Node_ptr node = readNode();
+			std::uint32_t num_args = readCount();
+			const const_Expr_ptr &node_type = node->getType();
+			if (node_type->cls != Expression::LAMBDATYPE)
+				throw BinaryFormatException("call of a non-lambda");
+			auto lambda_type = static_cast<const LambdaType *>(node_type.get());
+			if (std::size_t(lambda_type->end() - lambda_type->begin()) != num_args)
+				throw BinaryFormatException("wrong number of lambda arguments");
+			std::vector<Expr_ptr> args;
+			for (std::uint32_t i = 0; i < num_args; ++i)
+				args.push_back(readExpr());
+			entity.expr = std::make_shared<LambdaCallExpr>(node, std::move(args), Unchecked());
+			break;
+		}
+		case NEGATION:
+			entity.expr = std::make_shared<NegationExpr>(readExpr(), Unchecked());
+			break;
+		case CONNECTIVE: {
+			std::uint32_t variant = read();
+			if (variant > ConnectiveExpr::EQUIV)
+				throw BinaryFormatException("invalid connective");
+			Expr_ptr first = readExpr();
+			Expr_ptr second = readExpr();
+			entity.expr = std::make_shared<ConnectiveExpr>(
+				static_cast<ConnectiveExpr::Variant>(variant), first, second, Unchecked());
+			break;
+		}
+		case QUANTIFIER: {
+			std::uint32_t variant = read();
+			if (variant > QuantifierExpr::FORALL)
+				throw BinaryFormatException("invalid quantifier");
+			entity.expr = std::make_shared<QuantifierExpr>(
+				static_cast<QuantifierExpr::Variant>(variant), readExpr(), Unchecked());
+			break;
+		}
+		case LAMBDA: {
+			std::vector<Node_ptr> params = readParams();
+			entity.expr = std::make_shared<LambdaExpr>(std::move(params), readExpr());
+			break;
+		}
+		case LAMBDATYPE: {
+			const_Expr_ptr return_type = readExpr();
+			std::uint32_t num_args = readCount();
+			std::vector<const_Expr_ptr> args;
+			for (std::uint32_t i = 0; i < num_args; ++i)
+				args.push_back(readExpr());
+			entity.expr = std::make_shared<LambdaType>(std::move(args), return_type);
+			break;
+		}
+		case TAUTOLOGY: {
+			Symbol name = readSymbol();
+			std::vector<Node_ptr> params = readParams();
+			entity.object = std::make_shared<Tautology>(name, std::move(params), readExpr());
+			break;
+		}
+		case EQUIVRULE: {
+			Symbol name = readSymbol();
+			std::vector<Node_ptr> params = readParams();
+			Expr_ptr statement1 = readExpr();
+			Expr_ptr statement2 = readExpr();
+			entity.object = std::make_shared<EquivalenceRule>(name, std::move(params),
+				statement1, statement2);
+			break;
+		}
+		case DEDUCTIONRULE: {
+			Symbol name = readSymbol();
+			std::vector<Node_ptr> params = readParams();
+			std::uint32_t num_premisses = readCount();
+			std::vector<Expr_ptr> premisses;
+			for (std::uint32_t i = 0; i < num_premisses; ++i)
+				premisses.push_back(readExpr());
+			entity.object = std::make_shared<DeductionRule>(name, std::move(params),
+				premisses, readExpr());
+			break;
+		}
+		case STATEMENT: {
+			Symbol name = readSymbol();
+			entity.object = std::make_shared<Statement>(name, readExpr());
+			break;
+		}
+		case PROOFSTEP: {
+			Symbol name = readSymbol();
+			if (!rules)
+				throw BinaryFormatException("proof step without rules");
+			Theory::const_iterator rule_it = rules->get(name);
+			const_Rule_ptr rule;
+			if (rule_it == rules->end() ||
+					!(rule = std::dynamic_pointer_cast<const Rule>(*rule_it)))
+				throw NamespaceException(NamespaceException::NOTFOUND, name.str());
+
+			std::uint32_t num_vars = readCount();
+			if (num_vars != rule->getParams().size())
+				throw BinaryFormatException("wrong number of rule parameters");
+			std::vector<Expr_ptr> vars;
+			vars.reserve(num_vars);
+			for (std::uint32_t i = 0; i < num_vars; ++i) {
+				std::uint32_t var = read();
+				vars.push_back(var == NONE ? Expr_ptr() :
+					std::const_pointer_cast<Expression>(this->entity(var).expr));
+			}
+
+			std::uint32_t num_refs = readCount();
+			std::vector<Reference> refs;
+			refs.reserve(num_refs);
+			for (std::uint32_t i = 0; i < num_refs; ++i) {
+				Theory::const_iterator ref = theory.at(read());
+				if (ref == theory.end())
+					throw BinaryFormatException("invalid reference");
+				refs.emplace_back(&theory, ref);
+			}
+
+			entity.proof = std::make_shared<ProofStep>(std::move(rule), std::move(vars),
+				std::move(refs), Unchecked());
+			break;
+		}
+		case ADD: {
+			Object_ptr object = this->entity(read()).object;
+			if (!object)
+				throw BinaryFormatException("expected object");
+			it = theory.add(object, it);
+			continue;
+		}
+		case PROOF: {
+			Statement_ptr statement =
+				std::dynamic_pointer_cast<Statement>(this->entity(read()).object);
+			Proof_ptr proof = this->entity(read()).proof;
+			if (!statement || !proof)
+				throw BinaryFormatException("expected statement and proof");
+			statement->addProof(proof);
+			continue;
+		}
+		case END:
+			return theory;
+		default:
+			throw BinaryFormatException("invalid record");
+		}
+		entities.push_back(std::move(entity));
+	}
+}
@@ -0,0 +1,123 @@
+/*
+ *   Binary format for theories.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_BINARY_HPP
+#define CORE_BINARY_HPP
+#include "forward.hpp"
+#include "symbol.hpp"
+#include "theory.hpp"
+#include "traverse.hpp"
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Writer for the binary theory format.
+	 *
+	 * A file starts with a header and a table of all symbols, followed by a
+	 * sequence of records. Every record except ADD and PROOF defines an
+	 * entity: an expression, type, node, rule, statement or proof step. The
+	 * records only refer to entities defined before, by number, so shared
+	 * subexpressions are stored once. All numbers are 32 bit little endian.
+	 *
+	 * Proof steps name their rule, which is looked up when reading, and refer
+	 * to statements by their position in the theory.
+	 */
+	class BinaryWriter : public Visitor {
+	public:
+		BinaryWriter(std::ostream &output);
+
+		void visit(const Node *node);
+		void visit(const BuiltInType *type);
+		void visit(const LambdaType *type);
+		void visit(const AtomicExpr *expression);
+		void visit(const LambdaCallExpr *expression);
+		void visit(const NegationExpr *expression);
+		void visit(const ConnectiveExpr *expression);
+		void visit(const QuantifierExpr *expression);
+		void visit(const LambdaExpr *expression);
+		void visit(const Tautology *rule);
+		void visit(const EquivalenceRule *rule);
+		void visit(const DeductionRule *rule);
+		void visit(const Statement *statement);
+		void visit(const ProofStep *proofstep);
+		void visit(const LazyProof *proof);
+		void visit(const Theory *theory);
+
+	private:
+		std::uint32_t entity(const Expression *expr);
+		std::uint32_t entity(const Object *object);
+		std::uint32_t symbol(Symbol symbol);
+		void define(const void *entity);
+		void writeParams(const std::vector<Node_ptr> &params);
+
+		std::ostream &output;
+		std::vector<std::uint32_t> records;
+		std::vector<Symbol> symbols;
+		std::unordered_map<Symbol, std::uint32_t> symbol_ids;
+		std::unordered_map<const void *, std::uint32_t> ids;
+		std::uint32_t next_id;
+		std::uint32_t last;
+		const Theory *theory;
+	};
+
+	/**
+	 * Reader for the binary theory format. The input is read in place, so
+	 * it can be a memory-mapped file. Since the contents were checked
+	 * before they were written, the type checks of the constructors are
+	 * skipped. Only what is needed to build the objects safely is checked,
+	 * so that malformed input throws a BinaryFormatException.
+	 */
+	class BinaryReader {
+	public:
+		BinaryReader(const char *begin, const char *end);
+		static bool isBinary(const char *begin, const char *end);
+
+		Theory readTheory();
+
+		// For reading proofs: pointer to a set of rules
+		const Theory *rules;
+
+	private:
+		struct Entity {
+			const_Expr_ptr expr;
+			Object_ptr object;
+			Proof_ptr proof;
+		};
+
+		std::uint32_t read();
+		std::uint32_t readCount();
+		Symbol readSymbol();
+		const Entity &entity(std::uint32_t id) const;
+		Expr_ptr readExpr();
+		Node_ptr readNode();
+		std::vector<Node_ptr> readParams();
+
+		const unsigned char *pos, *end;
+		std::vector<Symbol> symbols;
+		std::vector<Entity> entities;
+	};
+}	// End of namespace Core
+
+#endif
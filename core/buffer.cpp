@@ -0,0 +1,83 @@
+/*
+ *   Read-only input buffers backed by files.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "buffer.hpp"
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CORE_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace Core;
+
+/**
+ * Load a file into memory.
+ *
+ * @param filename Name of the file.
+ */
+InputBuffer::InputBuffer(const std::string &filename)
+	: data(nullptr), length(0), valid(false), mapped(false)
+{
+#ifdef CORE_HAVE_MMAP
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1)
+		return;
+
+	// Only regular, non-empty files can be mapped.
+	struct stat info;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+		void *map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			data = static_cast<const char *>(map);
+			length = info.st_size;
+			valid = mapped = true;
+		}
+	}
+	close(fd);
+
+	if (mapped)
+		return;
+#endif
+
+	// Fall back to reading the file.
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+		return;
+
+	copy.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	data = copy.data();
+	length = copy.size();
+	valid = !file.bad();
+}
+
+/**
+ * Release the buffer.
+ */
+InputBuffer::~InputBuffer()
+{
+#ifdef CORE_HAVE_MMAP
+	if (mapped)
+		munmap(const_cast<char *>(data), length);
+#endif
+}
@@ -0,0 +1,82 @@
+/*
+ *   Read-only input buffers backed by files.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_BUFFER_HPP
+#define CORE_BUFFER_HPP
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Contents of a file in memory. Where possible, the file is mapped into
+	 * memory, otherwise it is read completely.
+	 */
+	class InputBuffer {
+	public:
+		InputBuffer(const std::string &filename);
+		InputBuffer(const InputBuffer &) = delete;
+		InputBuffer &operator =(const InputBuffer &) = delete;
+		~InputBuffer();
+
+		/**
+		 * Could the file be read?
+		 *
+		 * @return True, if the buffer is valid.
+		 */
+		explicit operator bool() const
+			{return valid;}
+
+		/**
+		 * Get beginning of the buffer.
+		 *
+		 * @return Pointer to the first character.
+		 */
+		const char *begin() const
+			{return data;}
+
+		/**
+		 * Get end of the buffer.
+		 *
+		 * @return Pointer behind the last character.
+		 */
+		const char *end() const
+			{return data + length;}
+
+		/**
+		 * Get size of the buffer.
+		 *
+		 * @return Number of characters.
+		 */
+		std::size_t size() const
+			{return length;}
+
+	private:
+		const char *data;
+		std::size_t length;
+		bool valid;
+		bool mapped;
+		std::vector<char> copy;
+	};
+}	// End of namespace Core
+
+#endif
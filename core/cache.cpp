@@ -0,0 +1,171 @@
+/*
+ *   Cache for the results of proof checking.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "cache.hpp"
+#include "expression.hpp"
+#include "hash.hpp"
+#include "logic.hpp"
+#include "tree.hpp"
+#include <algorithm>
+#include <functional>
+
+using namespace Core;
+
+/**
+ * Expressions are hashed with StructuralHash and compared with Substitution,
+ * which both identify them up to renaming of the bound parameters.
+ */
+
+// Are two expressions equal up to renaming of bound parameters?
+static bool equal(const const_Expr_ptr &a, const const_Expr_ptr &b)
+{
+	static const Context empty;
+	thread_local Substitution::State state;
+	return a == b || (a && b && Substitution(a).check(b.get(), empty, state));
+}
+
+/**
+ * Construct cache.
+ *
+ * @param capacity Maximal number of results to keep.
+ */
+VerificationCache::VerificationCache(std::size_t capacity)
+	: capacity(capacity ? capacity : 1), hits(0), misses(0) {}
+
+/**
+ * Validate the application of a rule, or look up the result.
+ *
+ * @param rule Rule to apply.
+ * @param context Arguments for the parameters of the rule.
+ * @param statements References to the statements needed.
+ * @param statement Statement that was deduced.
+ * @return True, if the statement can be deduced in this way.
+ */
+bool VerificationCache::validate(const const_Rule_ptr &rule, const Context &context,
+	const std::vector<Reference> &statements, const const_Expr_ptr &statement)
+{
+	// Build the key
+	StructuralHash hasher;
+	Entry key{std::hash<const void *>()(rule.get()), rule, context, {}, statement, false};
+	for (const auto &pair : context) {
+		combineHash(key.hash, std::hash<const void *>()(pair.first.get()));
+		combineHash(key.hash, hasher(pair.second.get()));
+	}
+	for (const Reference &ref : statements) {
+		auto stmt = std::dynamic_pointer_cast<const Statement>(*ref);
+		key.statements.push_back(stmt ? stmt->getDefinition() : const_Expr_ptr());
+		combineHash(key.hash, hasher(key.statements.back().get()));
+	}
+	combineHash(key.hash, hasher(statement.get()));
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Position position = find(key);
+		if (position != entries.end()) {
+			entries.splice(entries.begin(), entries, position);
+			++hits;
+			return position->result;
+		}
+		++misses;
+	}
+
+	// Check outside of the lock, then insert, unless some other thread did.
+	key.result = rule->validate(context, statements, statement);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (find(key) == entries.end()) {
+		std::size_t hash = key.hash;
+		bool result = key.result;
+		entries.push_front(std::move(key));
+		table.emplace(hash, entries.begin());
+
+		if (entries.size() > capacity) {
+			Position last = std::prev(entries.end());
+			auto range = table.equal_range(last->hash);
+			for (auto it = range.first; it != range.second; ++it)
+				if (it->second == last) {
+					table.erase(it);
+					break;
+				}
+			entries.pop_back();
+		}
+		return result;
+	}
+	return key.result;
+}
+
+/**
+ * Get the number of results in the cache.
+ *
+ * @return Number of entries.
+ */
+std::size_t VerificationCache::size() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+/**
+ * Get the number of validations answered from the cache.
+ *
+ * @return Number of hits.
+ */
+std::size_t VerificationCache::getHits() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return hits;
+}
+
+/**
+ * Get the number of validations that had to be done.
+ *
+ * @return Number of misses.
+ */
+std::size_t VerificationCache::getMisses() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return misses;
+}
+
+/**
+ * Find an entry equal to a key. The mutex must be held.
+ *
+ * @param key Entry to look for.
+ * @return Position of the entry, or entries.end().
+ */
+VerificationCache::Position VerificationCache::find(const Entry &key)
+{
+	auto range = table.equal_range(key.hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		const Entry &entry = *it->second;
+		if (entry.rule != key.rule || entry.context.size() != key.context.size()
+				|| entry.statements.size() != key.statements.size()
+				|| !equal(entry.statement, key.statement))
+			continue;
+
+		bool same = std::equal(entry.context.begin(), entry.context.end(), key.context.begin(),
+			[] (const Context::value_type &a, const Context::value_type &b) {
+				return a.first == b.first && equal(a.second, b.second);
+			});
+		if (same && std::equal(entry.statements.begin(), entry.statements.end(),
+				key.statements.begin(), equal))
+			return it->second;
+	}
+	return entries.end();
+}
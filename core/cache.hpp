@@ -0,0 +1,81 @@
+/*
+ *   Cache for the results of proof checking.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_CACHE_HPP
+#define CORE_CACHE_HPP
+#include "forward.hpp"
+#include "base.hpp"
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Cache for the results of Rule::validate(). Applications of a rule are
+	 * identified by the rule, the arguments for its parameters, the
+	 * referenced statements and the statement that is deduced, where
+	 * expressions are compared structurally up to renaming of bound
+	 * parameters. So identical proof steps in different theories are only
+	 * checked once.
+	 *
+	 * The cache holds a bounded number of results, and forgets the least
+	 * recently used first. It keeps the rules and expressions of its entries
+	 * alive. The cache is thread-safe, so it can be shared between theories
+	 * and threads.
+	 */
+	class VerificationCache {
+	public:
+		VerificationCache(std::size_t capacity = 1 << 16);
+
+		bool validate(const const_Rule_ptr &rule, const Context &context,
+			const std::vector<Reference> &statements, const const_Expr_ptr &statement);
+
+		std::size_t size() const;
+		std::size_t getHits() const;
+		std::size_t getMisses() const;
+
+	private:
+		struct Entry {
+			std::size_t hash;
+			const_Rule_ptr rule;
+			Context context;
+			std::vector<const_Expr_ptr> statements;
+			const_Expr_ptr statement;
+			bool result;
+		};
+		typedef std::list<Entry>::iterator Position;
+
+		Position find(const Entry &key);
+
+		const std::size_t capacity;
+
+		mutable std::mutex mutex;
+		// Entries, most recently used first
+		std::list<Entry> entries;
+		std::unordered_multimap<std::size_t, Position> table;
+		std::size_t hits, misses;
+	};
+}	// End of namespace Core
+
+#endif
@@ -20,6 +20,7 @@
 #include "debug.hpp"
 #include "base.hpp"
 #include "expression.hpp"
+#include "dispatch.hpp"
 #include <stdexcept>
 using namespace Core;
 
@@ -31,19 +32,8 @@ using namespace Core;
  * @param where Short (local) description where the problem occured.
  */
 TypeException::TypeException(const_Expr_ptr type, const_Expr_ptr want, const std::string &where)
-{
-	std::ostringstream str;
-	TypeWriter writer(str);
-	str << "expected ";
-	writer.write(want.get());
-	str << ", but got ";
-	writer.write(type.get());
-	if (where != "")
-		str << " in " << where;
-	description = str.str();
-
-	undefined = (type == BuiltInType::undefined);
-}
+	: type(std::move(type)), want_type(std::move(want)), where(where),
+	  undefined(this->type == BuiltInType::undefined) {}
 
 /**
  * Construct a TypeException.
@@ -53,17 +43,8 @@ TypeException::TypeException(const_Expr_ptr type, const_Expr_ptr want, const std
  * @param where Short (local) description where the problem occured.
  */
 TypeException::TypeException(const_Expr_ptr type, const std::string &want, const std::string &where)
-{
-	std::ostringstream str;
-	TypeWriter writer(str);
-	str << "expected " << want << ", but got ";
-	writer.write(type.get());
-	if (where != "")
-		str << " in " << where;
-	description = str.str();
-
-	undefined = (type == BuiltInType::undefined);
-}
+	: type(std::move(type)), want(want), where(where),
+	  undefined(this->type == BuiltInType::undefined) {}
 
 /**
  * Get description of a type exception.
@@ -72,6 +53,19 @@ TypeException::TypeException(const_Expr_ptr type, const std::string &want, const
  */
 const char *TypeException::what() const noexcept
 {
+	std::ostringstream str;
+	TypeWriter writer(str);
+	str << "expected ";
+	if (want_type)
+		writer.write(want_type.get());
+	else
+		str << want;
+	str << ", but got ";
+	writer.write(type.get());
+	if (where != "")
+		str << " in " << where;
+
+	description = str.str();
 	return description.c_str();
 }
 
@@ -83,7 +77,7 @@ const char *TypeException::what() const noexcept
 void TypeWriter::write(const Expression *type)
 {
 	if (type->getType() == BuiltInType::type)
-		type->accept(this);
+		dispatchVisit(this, type);
 	else
 		throw std::logic_error("Trying to write non-type in TypeWriter");
 }
@@ -110,15 +104,15 @@ void TypeWriter::visit(const LambdaType *type)
 {
 	str << "(";
 	bool first = true;
-	for (const_Expr_ptr arg_type : *type) {
+	for (const const_Expr_ptr &arg_type : *type) {
 		if (!first) {
 			first = true;
 			str << ' ';
 		}
-		arg_type->accept(this);
+		dispatchVisit(this, arg_type.get());
 	}
 	str << ")->";
-	type->getReturnType()->accept(this);
+	dispatchVisit(this, type->getReturnType().get());
 }
 
 void TypeWriter::visit(const AtomicExpr *type)
@@ -28,7 +28,8 @@
  */
 namespace Core {
 	/**
-	 * Exception for mismatched types.
+	 * Exception for mismatched types. The description is only put together
+	 * when it's asked for.
 	 */
 	class TypeException : public std::exception {
 	public:
@@ -40,8 +41,16 @@ namespace Core {
 		bool type_undefined() const noexcept
 			{return undefined;}
 
+		// Get the parts of the description
+		const const_Expr_ptr &getType() const {return type;}
+		const const_Expr_ptr &getWantedType() const {return want_type;}
+		const std::string &getWanted() const {return want;}
+		const std::string &getWhere() const {return where;}
+
 	private:
-		std::string description;
+		const const_Expr_ptr type, want_type;
+		const std::string want, where;
+		mutable std::string description;
 		bool undefined;
 	};
 
@@ -58,6 +67,7 @@ namespace Core {
 		TypeWriter(std::ostream &str) : str(str) {}
 
 		void write(const Expression *type);
+		using Visitor::visit;
 		void visit(const BuiltInType *type);
 		void visit(const LambdaType *type);
 		void visit(const AtomicExpr *type);
@@ -80,6 +90,25 @@ namespace Core {
 		const std::string name;
 		mutable std::string description;
 	};
+
+	/**
+	 * Exception for malformed binary theories
+	 */
+	class BinaryFormatException : public std::exception {
+	public:
+		/**
+		 * Construct exception.
+		 *
+		 * @param description What is wrong with the input.
+		 */
+		BinaryFormatException(const std::string &description)
+			: description(description) {}
+		const char* what() const noexcept
+			{return description.c_str();}
+
+	private:
+		const std::string description;
+	};
 }
 
 #endif
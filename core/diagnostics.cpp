@@ -0,0 +1,195 @@
+/*
+ *   Errors and warnings, recorded now and written later.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "diagnostics.hpp"
+#include "debug.hpp"
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+
+using namespace Core;
+
+namespace {
+	// Order of diagnostics by their place in the input.
+	bool before(const Diagnostic &a, const Diagnostic &b)
+	{
+		return std::tie(*a.descriptor, a.line, a.column)
+			< std::tie(*b.descriptor, b.line, b.column);
+	}
+}
+
+/**
+ * Write the diagnostic on a line of its own.
+ *
+ * @param output Stream to write to.
+ */
+void Diagnostic::write(std::ostream &output) const
+{
+	output << '\n' << *descriptor << ':' << line << ':' << column << ':';
+	switch (level) {
+	case ERROR:
+		output << " error: ";
+		break;
+	case WARNING:
+		output << " warning: ";
+		break;
+	case NOTE:
+		output << " note: ";
+		break;
+	}
+
+	for (const Operand &operand : operands) {
+		switch (operand.kind) {
+		case Operand::TEXT:
+			output << operand.text;
+			break;
+		case Operand::SYMBOL:
+			output << operand.symbol.str();
+			break;
+		case Operand::STRING:
+			output << operand.string;
+			break;
+		case Operand::NUMBER:
+			output << operand.number;
+			break;
+		case Operand::TYPE:
+			TypeWriter(output).write(operand.type.get());
+			break;
+		}
+	}
+}
+
+/**
+ * Add a new diagnostic. Its operands can be added to the result.
+ *
+ * @param level One of Diagnostic::{ERROR|WARNING|NOTE}.
+ * @param descriptor Name of the input.
+ * @param line Line in the input.
+ * @param column Column in the input.
+ * @return The new diagnostic.
+ */
+Diagnostic &DiagnosticBuffer::add(Diagnostic::Level level,
+	std::shared_ptr<const std::string> descriptor, int line, int column)
+{
+	if (level == Diagnostic::ERROR)
+		++error_count;
+	else if (level == Diagnostic::WARNING)
+		++warning_count;
+
+	records.push_back(Diagnostic{level, std::move(descriptor), line, column, {}});
+	return records.back();
+}
+
+/**
+ * Add an operand to the last diagnostic.
+ *
+ * @param kind Kind of the operand, its value is to be set in the result.
+ * @return The new operand.
+ * @pre There is a diagnostic.
+ */
+Diagnostic::Operand &DiagnosticBuffer::addOperand(Diagnostic::Operand::Kind kind)
+{
+	std::vector<Diagnostic::Operand> &operands = records.back().operands;
+	operands.push_back(Diagnostic::Operand{kind, nullptr, Symbol(), std::string(), 0,
+		const_Expr_ptr()});
+	return operands.back();
+}
+
+/**
+ * Move the diagnostics of another buffer to the end of this one.
+ *
+ * @param other Buffer to take the diagnostics from, which is cleared.
+ */
+void DiagnosticBuffer::append(DiagnosticBuffer &&other)
+{
+	if (records.empty())
+		records = std::move(other.records);
+	else
+		std::move(other.records.begin(), other.records.end(), std::back_inserter(records));
+	error_count += other.error_count;
+	warning_count += other.warning_count;
+	other.clear();
+}
+
+/**
+ * Write all diagnostics in order.
+ *
+ * @param output Stream to write to.
+ */
+void DiagnosticBuffer::write(std::ostream &output) const
+{
+	for (const Diagnostic &record : records)
+		record.write(output);
+}
+
+/**
+ * Order the diagnostics by their place in the input. Those at the same place
+ * stay in the order they were added.
+ */
+void DiagnosticBuffer::sort()
+{
+	std::stable_sort(records.begin(), records.end(), before);
+}
+
+/**
+ * Remove all diagnostics and reset the statistics.
+ */
+void DiagnosticBuffer::clear()
+{
+	records.clear();
+	error_count = warning_count = 0;
+}
+
+/**
+ * Hand over the buffer of a thread.
+ *
+ * @param buffer Buffer with the diagnostics of the thread.
+ */
+void Diagnostics::add(DiagnosticBuffer &&buffer)
+{
+	if (buffer.getRecords().empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	buffers.push_back(std::move(buffer));
+}
+
+/**
+ * Merge the buffers handed over so far. Diagnostics are ordered by their
+ * place in the input, those at the same place stay in the order they were
+ * found in.
+ *
+ * @return Buffer with all diagnostics, the collector is empty afterwards.
+ */
+DiagnosticBuffer Diagnostics::merge()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::sort(buffers.begin(), buffers.end(),
+		[] (const DiagnosticBuffer &a, const DiagnosticBuffer &b) -> bool
+		{return before(a.getRecords().front(), b.getRecords().front());});
+
+	DiagnosticBuffer result;
+	for (DiagnosticBuffer &buffer : buffers)
+		result.append(std::move(buffer));
+	buffers.clear();
+
+	result.sort();
+	return result;
+}
@@ -0,0 +1,123 @@
+/*
+ *   Errors and warnings, recorded now and written later.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_DIAGNOSTICS_HPP
+#define CORE_DIAGNOSTICS_HPP
+#include "forward.hpp"
+#include "symbol.hpp"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * An error, warning or note at some place of the input. The message is
+	 * kept as list of operands, and only put together when it's written.
+	 */
+	struct Diagnostic {
+		// Problem level
+		enum Level {ERROR, WARNING, NOTE};
+
+		/**
+		 * Part of a message.
+		 */
+		struct Operand {
+			enum Kind {
+				TEXT,       // String literal
+				SYMBOL,     // Interned string
+				STRING,     // Any other string
+				NUMBER,     // Unsigned number
+				TYPE        // Type, written by TypeWriter
+			};
+
+			Kind kind;
+			const char *text;
+			Symbol symbol;
+			std::string string;
+			std::size_t number;
+			const_Expr_ptr type;
+		};
+
+		Level level;
+		// Input, shared by the diagnostics of a parser, line and column
+		std::shared_ptr<const std::string> descriptor;
+		int line, column;
+		std::vector<Operand> operands;
+
+		void write(std::ostream &output) const;
+	};
+
+	/**
+	 * Diagnostics of a single thread, in the order they were found.
+	 */
+	class DiagnosticBuffer {
+	public:
+		DiagnosticBuffer() : error_count(0), warning_count(0) {}
+
+		Diagnostic &add(Diagnostic::Level level,
+			std::shared_ptr<const std::string> descriptor, int line, int column);
+		Diagnostic::Operand &addOperand(Diagnostic::Operand::Kind kind);
+		void append(DiagnosticBuffer &&other);
+		void write(std::ostream &output) const;
+		void sort();
+		void clear();
+
+		/**
+		 * Get the diagnostics.
+		 *
+		 * @return Diagnostics in the order they were added.
+		 */
+		const std::vector<Diagnostic> &getRecords() const
+			{return records;}
+
+		// Get statistics
+		int getErrors() const {return error_count;}
+		int getWarnings() const {return warning_count;}
+
+	private:
+		std::vector<Diagnostic> records;
+		int error_count;
+		int warning_count;
+	};
+
+	/**
+	 * Collector for the diagnostics of several threads. Every thread keeps
+	 * its own buffer and hands it over when it's done. They are merged in the
+	 * order of their places in the input, so the result doesn't depend on
+	 * the order in which the threads finish, as long as their buffers are
+	 * about different parts of the input.
+	 */
+	class Diagnostics {
+	public:
+		void add(DiagnosticBuffer &&buffer);
+		DiagnosticBuffer merge();
+
+	private:
+		std::mutex mutex;
+		std::vector<DiagnosticBuffer> buffers;
+	};
+}	// End of namespace Core
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ *   Traversal of expressions without virtual calls.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_DISPATCH_HPP
+#define CORE_DISPATCH_HPP
+#include "forward.hpp"
+#include "base.hpp"
+#include "expression.hpp"
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Call a function object with an expression cast to its class. This
+	 * switches on Expression::cls instead of calling Expression::accept(), so
+	 * the compiler sees the function that is called and can inline it.
+	 *
+	 * @param expr Expression to dispatch on.
+	 * @param function Function object with an overload for every expression
+	 *      class, i.e. taking const BuiltInType *, const LambdaType *, ...
+	 * @return Result of the function.
+	 */
+	template <typename Function>
+	inline auto dispatch(const Expression *expr, Function &&function)
+		-> decltype(function(static_cast<const LambdaExpr *>(expr)))
+	{
+		switch (expr->cls) {
+		case Expression::BUILTINTYPE:
+			return function(static_cast<const BuiltInType *>(expr));
+		case Expression::LAMBDATYPE:
+			return function(static_cast<const LambdaType *>(expr));
+		case Expression::ATOMIC:
+			return function(static_cast<const AtomicExpr *>(expr));
+		case Expression::LAMBDACALL:
+			return function(static_cast<const LambdaCallExpr *>(expr));
+		case Expression::NEGATION:
+			return function(static_cast<const NegationExpr *>(expr));
+		case Expression::CONNECTIVE:
+			return function(static_cast<const ConnectiveExpr *>(expr));
+		case Expression::QUANTIFIER:
+			return function(static_cast<const QuantifierExpr *>(expr));
+		case Expression::LAMBDA:
+		default:
+			return function(static_cast<const LambdaExpr *>(expr));
+		}
+	}
+
+	/**
+	 * Function object calling the visit() functions of a visitor class
+	 * directly, instead of through the virtual table.
+	 */
+	template <typename V>
+	struct DirectVisit {
+		V *visitor;
+
+		template <typename T>
+		void operator()(const T *expr) const
+			{visitor->V::visit(expr);}
+	};
+
+	/**
+	 * Visit an expression with the visit() function of V. Use this instead of
+	 * expr->accept(visitor) in the inner loops of a visitor. The visitor needs
+	 * an overload of visit() for every expression class, so visitors that
+	 * only override some of them should say "using Visitor::visit".
+	 *
+	 * @param visitor Visitor to call.
+	 * @param expr Expression to visit.
+	 */
+	template <typename V>
+	inline void dispatchVisit(V *visitor, const Expression *expr)
+	{
+		dispatch(expr, DirectVisit<V>{visitor});
+	}
+}	// End of namespace Core
+
+#endif
@@ -24,14 +24,37 @@
 
 using namespace Core;
 
-/**
- * Get type of an atomic expression.
- *
- * @return Type of the expression.
- */
-const_Expr_ptr AtomicExpr::getType() const
-{
-	return node->getType();
+namespace {
+	/**
+	 * Get the return type of a lambda node, if it is one.
+	 *
+	 * @param node Node to look at.
+	 * @return Return type or an empty pointer.
+	 */
+	const_Expr_ptr returnType(const Node *node)
+	{
+		const Expression *type = node->getType().get();
+		if (type->cls == Expression::LAMBDATYPE)
+			return static_cast<const LambdaType *>(type)->getReturnType();
+		else
+			return const_Expr_ptr();
+	}
+
+	/**
+	 * Build the type of a lambda expression.
+	 *
+	 * @param params Parameters of the lambda.
+	 * @param expression Lambda body.
+	 * @return Lambda type.
+	 */
+	const_Expr_ptr lambdaType(const std::vector<Node_ptr> &params, const Expression *expression)
+	{
+		std::vector<const_Expr_ptr> types;
+		types.reserve(params.size());
+		for (const Node_ptr &node : params)
+			types.push_back(node->getType());
+		return std::make_shared<LambdaType>(std::move(types), expression->getType());
+	}
 }
 
 /**
@@ -41,18 +64,27 @@ const_Expr_ptr AtomicExpr::getType() const
  * @param args Vector of argument expressions.
  */
 LambdaCallExpr::LambdaCallExpr(const_Node_ptr node, std::vector<Expr_ptr> &&args)
-	: Expression(Expression::LAMBDACALL), node(node), args(std::move(args))
+	: Expression(Expression::LAMBDACALL, returnType(node.get())), node(std::move(node)),
+	  args(std::move(args))
 {
 	// Is node a lambda?
-	if (node->getType()->cls != Expression::LAMBDATYPE)
-		throw TypeException(node->getType(), "lambda expression");
+	const const_Expr_ptr &node_type = this->node->getType();
+	if (node_type->cls != Expression::LAMBDATYPE)
+		throw TypeException(node_type, "lambda expression");
 
-	auto pred_type = std::static_pointer_cast<const LambdaType>(node->getType());
+	auto pred_type = static_cast<const LambdaType *>(node_type.get());
+
+	// Do we have the right number of arguments?
+	if (pred_type->end() - pred_type->begin() != this->args.end() - this->args.begin()) {
+		std::ostringstream str;
+		str << "lambda with " << this->args.size() << " arguments";
+		throw TypeException(node_type, str.str());
+	}
 
 	// Do the arguments have the right type?
 	TypeComparator compare;
 	auto mismatch = std::mismatch(pred_type->begin(), pred_type->end(), this->args.begin(),
-		[&compare] (const_Expr_ptr a, Expr_ptr b) -> bool
+		[&compare] (const const_Expr_ptr &a, const Expr_ptr &b) -> bool
 		{return compare(a.get(), b->getType().get());}
 	);
 
@@ -63,50 +95,19 @@ LambdaCallExpr::LambdaCallExpr(const_Node_ptr node, std::vector<Expr_ptr> &&args
 	}
 }
 
-const_Expr_ptr LambdaCallExpr::getType() const
-{
-	auto pred_type = std::static_pointer_cast<const LambdaType>(node->getType());
-	return pred_type->getReturnType();
-}
-
-/**
- * Begin iterator for iterating through the arguments.
- *
- * @return Begin iterator.
- */
-LambdaCallExpr::const_iterator LambdaCallExpr::begin() const
-{
-	return args.begin();
-}
-
-/**
- * End iterator for iterating through the arguments.
- *
- * @return End iterator.
- */
-LambdaCallExpr::const_iterator LambdaCallExpr::end() const
-{
-	return args.end();
-}
-
 /**
  * Construct a negation expression.
  *
  * @param expr %Statement expression to be negated.
  */
 NegationExpr::NegationExpr(Expr_ptr expr)
-	: Expression(Expression::NEGATION), expr(expr)
+	: Expression(Expression::NEGATION, BuiltInType::statement), expr(std::move(expr))
 {
-	const_Expr_ptr type = expr->getType();
+	const const_Expr_ptr &type = this->expr->getType();
 	if (type != BuiltInType::statement)
 		throw TypeException(type, BuiltInType::statement);
 }
 
-const_Expr_ptr NegationExpr::getType() const
-{
-	return BuiltInType::statement;
-}
-
 /**
  * Construct connective expression.
  *
@@ -115,20 +116,16 @@ const_Expr_ptr NegationExpr::getType() const
  * @param seond Second operand of connective
  */
 ConnectiveExpr::ConnectiveExpr(Variant variant, Expr_ptr first, Expr_ptr second)
-	: Expression(Expression::CONNECTIVE), variant(variant), expr{first, second}
+	: Expression(Expression::CONNECTIVE, BuiltInType::statement),
+	  variant(variant), expr{std::move(first), std::move(second)}
 {
-	const_Expr_ptr first_type = first->getType(), second_type = second->getType();
+	const const_Expr_ptr &first_type = expr[0]->getType(), &second_type = expr[1]->getType();
 	if (first_type != BuiltInType::statement)
 		throw TypeException(first_type, BuiltInType::statement, "first operand");
 	if (second_type != BuiltInType::statement)
 		throw TypeException(second_type, BuiltInType::statement, "second operand");
 }
 
-const_Expr_ptr ConnectiveExpr::getType() const
-{
-	return BuiltInType::statement;
-}
-
 /**
  * Construct a quantifier expression.
  *
@@ -136,12 +133,13 @@ const_Expr_ptr ConnectiveExpr::getType() const
  * @param predicate Lambda expression containing the predicate
  */
 QuantifierExpr::QuantifierExpr(Variant variant, const_Expr_ptr predicate)
-	: Expression(Expression::QUANTIFIER), variant(variant), predicate(predicate)
+	: Expression(Expression::QUANTIFIER, BuiltInType::statement),
+	  variant(variant), predicate(std::move(predicate))
 {
-	const_Expr_ptr type = predicate->getType();
+	const const_Expr_ptr &type = this->predicate->getType();
 	if (type->cls == Expression::LAMBDATYPE) {
-		auto pred_type = std::static_pointer_cast<const LambdaType>(type);
-		const_Expr_ptr return_type = pred_type->getReturnType();
+		auto pred_type = static_cast<const LambdaType *>(type.get());
+		const const_Expr_ptr &return_type = pred_type->getReturnType();
 		if (return_type != BuiltInType::statement)
 			throw TypeException(return_type, BuiltInType::statement, "return value");
 	}
@@ -149,11 +147,6 @@ QuantifierExpr::QuantifierExpr(Variant variant, const_Expr_ptr predicate)
 		throw TypeException(type, "lambda expression");
 }
 
-const_Expr_ptr QuantifierExpr::getType() const
-{
-	return BuiltInType::statement;
-}
-
 /**
  * Construct lambda expression.
  *
@@ -161,7 +154,8 @@ const_Expr_ptr QuantifierExpr::getType() const
  * @param expression Lambda body.
  */
 LambdaExpr::LambdaExpr(std::vector<Node_ptr> &&params, const_Expr_ptr expression)
-	: Expression(Expression::LAMBDA), params(std::move(params)), expression(expression) {}
+	: Expression(Expression::LAMBDA, lambdaType(params, expression.get())),
+	  params(std::move(params)), expression(std::move(expression)) {}
 
 /**
  * Set definition expression for lambda.
@@ -175,26 +169,7 @@ void LambdaExpr::setDefinition(const_Expr_ptr new_expression)
 	if (!compare(expression->getType().get(), new_expression->getType().get()))
 		throw TypeException(new_expression->getType(), expression->getType(), "return type");
 
-	expression = new_expression;
-}
-
-/**
- * Get type of Lambda expression.
- *
- * @return Type of Lambda expression.
- */
-const_Expr_ptr LambdaExpr::getType() const
-{
-	// Build type if required
-	if (!type) {
-		// transform can't write to an empty vector, hence initialize with dummy
-		std::vector<const_Expr_ptr> types{const_Expr_ptr()};
-		std::transform(params.begin(), params.end(), types.begin(),
-			[] (const_Node_ptr node) -> const_Expr_ptr {return node->getType();});
-		type = std::make_shared<LambdaType>(std::move(types), expression->getType());
-	}
-
-	return type;
+	expression = std::move(new_expression);
 }
 
 /**
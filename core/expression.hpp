@@ -21,6 +21,7 @@
 #define CORE_EXPRESSION_HPP
 #include "forward.hpp"
 #include "base.hpp"
+#include "small.hpp"
 #include "theory.hpp"
 #include <vector>
 #include "traverse.hpp"
@@ -40,17 +41,16 @@ namespace Core {
 		 * @param node Node the expression should point to.
 		 */
 		AtomicExpr(const_Node_ptr node)
-			: Expression(Expression::ATOMIC), node(node) {}
+			: Expression(Expression::ATOMIC, node->getType()), node(std::move(node)) {}
 
 		/**
 		 * Get corresponding node.
 		 *
 		 * @return Node the expression refers to.
 		 */
-		const_Node_ptr getAtom() const
+		const const_Node_ptr &getAtom() const
 			{return node;}
 
-		const_Expr_ptr getType() const;
 		void accept(Visitor *visitor) const
 			{visitor->visit(this);}
 
@@ -64,30 +64,46 @@ namespace Core {
 	class LambdaCallExpr : public Expression {
 	public:
 		LambdaCallExpr(const_Node_ptr node, std::vector<Expr_ptr> &&args);
+		LambdaCallExpr(const_Node_ptr node, std::vector<Expr_ptr> &&args, Unchecked)
+			: Expression(Expression::LAMBDACALL, static_cast<const LambdaType *>(
+				node->getType().get())->getReturnType()),
+			  node(std::move(node)), args(std::move(args)) {}
 
 		/**
 		 * Get the lambda node that is called.
 		 *
 		 * @return Lambda node.
 		 */
-		const_Node_ptr getLambda() const
+		const const_Node_ptr &getLambda() const
 			{return node;}
 
-		const_Expr_ptr getType() const;
-
 		/**
 		 * Iterator for parameters.
 		 */
-		typedef std::vector<Expr_ptr>::const_iterator const_iterator;
-		const_iterator begin() const;
-		const_iterator end() const;
+		typedef SmallVector<Expr_ptr, 2>::const_iterator const_iterator;
+
+		/**
+		 * Begin iterator for iterating through the arguments.
+		 *
+		 * @return Begin iterator.
+		 */
+		const_iterator begin() const
+			{return args.begin();}
+
+		/**
+		 * End iterator for iterating through the arguments.
+		 *
+		 * @return End iterator.
+		 */
+		const_iterator end() const
+			{return args.end();}
 
 		void accept(Visitor *visitor) const
 			{visitor->visit(this);}
 
 	private:
 		const_Node_ptr node;
-		std::vector<Expr_ptr> args;
+		SmallVector<Expr_ptr, 2> args;
 	};
 
 	/**
@@ -96,17 +112,18 @@ namespace Core {
 	class NegationExpr : public Expression {
 	public:
 		NegationExpr(Expr_ptr expr);
+		NegationExpr(Expr_ptr expr, Unchecked)
+			: Expression(Expression::NEGATION, BuiltInType::statement), expr(std::move(expr)) {}
 
 		/**
 		 * Get negated expression.
 		 *
 		 * @return Negated expression.
 		 */
-		Expr_ptr getExpr() const {return expr;}
+		const Expr_ptr &getExpr() const {return expr;}
 
 		void accept(Visitor *visitor) const
 			{visitor->visit(this);}
-		const_Expr_ptr getType() const;
 
 	private:
 		Expr_ptr expr;
@@ -119,6 +136,9 @@ namespace Core {
 	public:
 		enum Variant {AND, OR, IMPL, EQUIV};
 		ConnectiveExpr(Variant variant, Expr_ptr first, Expr_ptr second);
+		ConnectiveExpr(Variant variant, Expr_ptr first, Expr_ptr second, Unchecked)
+			: Expression(Expression::CONNECTIVE, BuiltInType::statement),
+			  variant(variant), expr{std::move(first), std::move(second)} {}
 
 		/**
 		 * Get variant of connective expression.
@@ -132,16 +152,14 @@ namespace Core {
 		 *
 		 * @return First expression.
 		 */
-		Expr_ptr getFirstExpr() const {return expr[0];}
+		const Expr_ptr &getFirstExpr() const {return expr[0];}
 
 		/**
 		 * Get second subexpression of the connective.
 		 *
 		 * @return Second expression.
 		 */
-		Expr_ptr getSecondExpr() const {return expr[1];}
-
-		const_Expr_ptr getType() const;
+		const Expr_ptr &getSecondExpr() const {return expr[1];}
 
 		void accept(Visitor *visitor) const
 			{visitor->visit(this);}
@@ -158,6 +176,9 @@ namespace Core {
 	public:
 		enum Variant {EXISTS, FORALL};
 		QuantifierExpr(Variant variant, const_Expr_ptr predicate);
+		QuantifierExpr(Variant variant, const_Expr_ptr predicate, Unchecked)
+			: Expression(Expression::QUANTIFIER, BuiltInType::statement),
+			  variant(variant), predicate(std::move(predicate)) {}
 
 		/**
 		 * Is this an universal or existential quantification?
@@ -172,10 +193,9 @@ namespace Core {
 		 *
 		 * @return Predicate expression.
 		 */
-		const_Expr_ptr getPredicate() const
+		const const_Expr_ptr &getPredicate() const
 			{return predicate;}
 
-		const_Expr_ptr getType() const;
 		void accept(Visitor *visitor) const
 			{visitor->visit(this);}
 
@@ -197,10 +217,9 @@ namespace Core {
 		LambdaExpr(std::vector<Node_ptr> &&params, const_Expr_ptr expression);
 		const std::vector<Node_ptr>& getParams() const
 			{return params;}
-		const_Expr_ptr getDefinition() const
+		const const_Expr_ptr &getDefinition() const
 			{return expression;}
 		void setDefinition(const_Expr_ptr new_expression);
-		const_Expr_ptr getType() const;
 
 		// Iterating through arguments
 		std::vector<Node_ptr>::const_iterator begin() const;
@@ -210,7 +229,6 @@ namespace Core {
 
 	private:
 		std::vector<Node_ptr> params;
-		mutable const_Expr_ptr type;
 		const_Expr_ptr expression;
 	};
 }	// End of namespace Core
@@ -27,6 +27,13 @@
  * Namespace for logic core
  */
 namespace Core {
+	// arena.hpp
+	class Arena;
+
+	// batch.hpp
+	struct BatchResult;
+	class BatchVerifier;
+
 	// base.hpp
 	class Expression;
 	typedef std::shared_ptr<Expression> Expr_ptr;
@@ -41,6 +48,14 @@ namespace Core {
 	typedef std::shared_ptr<const Node> const_Node_ptr;
 	typedef std::map<const_Node_ptr, const_Expr_ptr> Context;
 
+	// cache.hpp
+	class VerificationCache;
+
+	// diagnostics.hpp
+	struct Diagnostic;
+	class DiagnosticBuffer;
+	class Diagnostics;
+
 	// expression.hpp
 	class AtomicExpr;
 	class LambdaCallExpr;
@@ -49,6 +64,15 @@ namespace Core {
 	class QuantifierExpr;
 	class LambdaExpr;
 
+	// hash.hpp
+	class StructuralHash;
+
+	// intern.hpp
+	class ExpressionFactory;
+
+	// lazy.hpp
+	class LazyProof;
+
 	// logic.hpp
 	class Rule;
 	typedef std::shared_ptr<Rule> Rule_ptr;
@@ -57,6 +81,23 @@ namespace Core {
 	class EquivalenceRule;
 	class DeductionRule;
 
+	// match.hpp
+	class Matcher;
+
+	// scan.hpp
+	struct ScanBlock;
+	class ScanIndex;
+
+	// search.hpp
+	struct SearchOptions;
+	class ProofSearch;
+
+	// server.hpp
+	class VerificationServer;
+
+	// stream.hpp
+	class StreamingVerifier;
+
 	// theory.hpp
 	class Theory;
 	class Statement;
@@ -0,0 +1,393 @@
+/*
+ *   Structural hashing of expressions and objects.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "hash.hpp"
+#include "dispatch.hpp"
+#include "expression.hpp"
+#include "logic.hpp"
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+using namespace Core;
+
+/**
+ * Cached hashes are only valid for the expression on its own. Reading them is
+ * safe as long as none of its nodes may be bound by an enclosing lambda or
+ * rule, or substituted. We don't know which nodes an expression contains
+ * without walking it, so inside of binders and substitutions we don't read
+ * the cache at all, except for substituted expressions, which are closed.
+ */
+
+namespace {
+	// Hash seeds of objects come after those of the expression classes.
+	enum {
+		NODE = Expression::LAMBDA + 1, TAUTOLOGY, EQUIVALENCE, DEDUCTION,
+		STATEMENT, PROOFSTEP, THEORY
+	};
+
+	const std::size_t none = std::numeric_limits<std::size_t>::max();
+}
+
+/**
+ * Construct hasher.
+ *
+ * @param context If not null, nodes are replaced by their expressions.
+ */
+StructuralHash::StructuralHash(const Context *context)
+	: context(context && !context->empty() ? context : nullptr), hash(0),
+	  lowest(none), env(nullptr), cache(!this->context) {}
+
+/**
+ * Hash an expression.
+ *
+ * @param expression Expression to hash.
+ * @return Hash value, never 0.
+ */
+std::size_t StructuralHash::operator()(const Expression *expression)
+{
+	return hash = expression ? hashExpr(expression) : 0;
+}
+
+/**
+ * Hash an object of a theory.
+ *
+ * @param object Object to hash.
+ * @return Hash value.
+ */
+std::size_t StructuralHash::operator()(const Object *object)
+{
+	hash = 0;
+	if (object)
+		object->accept(this);
+	return hash;
+}
+
+/**
+ * Hash a subexpression, and cache the result if it is closed.
+ *
+ * @param expr Expression to hash.
+ * @return Hash value, never 0.
+ */
+std::size_t StructuralHash::hashExpr(const Expression *expr)
+{
+	if (cache) {
+		std::size_t cached = expr->hash.load(std::memory_order_relaxed);
+		if (cached)
+			return hash = cached;
+	}
+
+	std::size_t outer = lowest, mark = bound.size();
+	lowest = none;
+	dispatchVisit(this, expr);
+	if (!hash)
+		hash = 1;
+
+	// Nothing outside of the expression was used: it's the same everywhere.
+	if (lowest > mark)
+		expr->hash.store(hash, std::memory_order_relaxed);
+	lowest = std::min(outer, lowest);
+	return hash;
+}
+
+/**
+ * Bind parameters of a lambda or rule. The caller restores bound and cache.
+ *
+ * @param result Hash to combine the parameter types into.
+ * @param params Parameters.
+ */
+void StructuralHash::bind(std::size_t &result, const std::vector<Node_ptr> &params)
+{
+	for (const Node_ptr &param : params) {
+		combineHash(result, hashExpr(param->getType().get()));
+		bound.push_back(param.get());
+	}
+	cache = false;
+}
+
+/**
+ * Hash a reference to a node that is not substituted.
+ *
+ * @param node Node referenced.
+ * @return Its distance to the binder for parameters, otherwise its address.
+ */
+std::size_t StructuralHash::reference(const Node *node)
+{
+	auto it = std::find(bound.rbegin(), bound.rend(), node);
+	if (it == bound.rend())
+		return std::hash<const void *>()(node);
+
+	lowest = std::min<std::size_t>(lowest, bound.rend() - it);
+	return std::hash<std::size_t>()(it - bound.rbegin() + 1);
+}
+
+/**
+ * Find the substitution of a node.
+ *
+ * @param node Node to look up.
+ * @param where Arguments of substituted lambdas to look at.
+ * @param expr Set to the substituted expression.
+ * @param scope Set to the lambda arguments the substituted expression sees.
+ * @param cache Set to whether the cache may be read for it.
+ * @return True, if the node is substituted.
+ */
+bool StructuralHash::substitute(const Node *node, const Frame *where,
+	const Expression **expr, const Frame **scope, bool *cache)
+{
+	if (!where && !context)
+		return false;
+	if (std::find(bound.begin(), bound.end(), node) != bound.end())
+		return false;
+
+	for (const Frame *frame = where; frame; frame = frame->next)
+		if (frame->param == node) {
+			*expr = frame->arg;
+			*scope = frame->scope;
+			*cache = frame->cache;
+			return true;
+		}
+
+	if (context) {
+		// Aliasing a null pointer gives us a key without reference counting.
+		auto it = context->find(const_Node_ptr(const_Node_ptr(), node));
+		if (it != context->end()) {
+			*expr = it->second.get();
+			*scope = nullptr;
+			*cache = true;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Hash a substituted expression in its scope.
+ *
+ * @param expr Substituted expression.
+ * @param scope Arguments of substituted lambdas it sees.
+ * @param expr_cache May we read the cache for it?
+ */
+void StructuralHash::hashSubstituted(const Expression *expr, const Frame *scope,
+	bool expr_cache)
+{
+	const Frame *outer_env = env;
+	bool outer_cache = cache;
+	env = scope;
+	cache = expr_cache;
+	hashExpr(expr);
+	env = outer_env;
+	cache = outer_cache;
+	lowest = 0;
+}
+
+void StructuralHash::visit(const BuiltInType *type)
+{
+	std::size_t result = Expression::BUILTINTYPE;
+	combineHash(result, type->variant);
+	hash = result;
+}
+
+void StructuralHash::visit(const LambdaType *type)
+{
+	std::size_t result = Expression::LAMBDATYPE;
+	for (const const_Expr_ptr &arg : *type)
+		combineHash(result, hashExpr(arg.get()));
+	combineHash(result, hashExpr(type->getReturnType().get()));
+	hash = result;
+}
+
+void StructuralHash::visit(const Node *node)
+{
+	std::size_t result = NODE;
+	combineHash(result, hashExpr(node->getType().get()));
+	if (node->getDefinition())
+		combineHash(result, hashExpr(node->getDefinition().get()));
+	hash = result;
+}
+
+void StructuralHash::visit(const AtomicExpr *expression)
+{
+	const Node *node = expression->getAtom().get();
+	const Expression *expr;
+	const Frame *scope;
+	bool expr_cache;
+	if (substitute(node, env, &expr, &scope, &expr_cache)) {
+		hashSubstituted(expr, scope, expr_cache);
+		return;
+	}
+
+	std::size_t result = Expression::ATOMIC;
+	combineHash(result, reference(node));
+	hash = result;
+}
+
+void StructuralHash::visit(const LambdaCallExpr *expression)
+{
+	// Follow substitutions of the called node.
+	const Node *node = expression->getLambda().get();
+	const Frame *where = env;
+	const Expression *expr;
+	const Frame *scope;
+	bool expr_cache;
+	while (substitute(node, where, &expr, &scope, &expr_cache)) {
+		lowest = 0;
+		if (expr->cls == Expression::LAMBDA) {
+			// Bind the parameters to our arguments and hash the definition.
+			auto lambda = static_cast<const LambdaExpr *>(expr);
+			std::vector<Frame> frames;
+			frames.reserve(lambda->getParams().size());
+			const Frame *inner = scope;
+			auto arg = expression->begin();
+			for (const Node_ptr &param : lambda->getParams()) {
+				if (arg == expression->end())
+					break;
+				frames.push_back({param.get(), (arg++)->get(), env, cache, inner});
+				inner = &frames.back();
+			}
+
+			// The cache of the definition might be for free parameters.
+			hashSubstituted(lambda->getDefinition().get(), inner, false);
+			return;
+		}
+		if (expr->cls != Expression::ATOMIC)
+			break;
+		node = static_cast<const AtomicExpr *>(expr)->getAtom().get();
+		where = scope;
+	}
+
+	std::size_t result = Expression::LAMBDACALL;
+	combineHash(result, reference(node));
+	for (const Expr_ptr &arg : *expression)
+		combineHash(result, hashExpr(arg.get()));
+	hash = result;
+}
+
+void StructuralHash::visit(const NegationExpr *expression)
+{
+	std::size_t result = Expression::NEGATION;
+	combineHash(result, hashExpr(expression->getExpr().get()));
+	hash = result;
+}
+
+void StructuralHash::visit(const ConnectiveExpr *expression)
+{
+	std::size_t result = Expression::CONNECTIVE;
+	combineHash(result, expression->getVariant());
+	combineHash(result, hashExpr(expression->getFirstExpr().get()));
+	combineHash(result, hashExpr(expression->getSecondExpr().get()));
+	hash = result;
+}
+
+void StructuralHash::visit(const QuantifierExpr *expression)
+{
+	std::size_t result = Expression::QUANTIFIER;
+	combineHash(result, expression->getVariant());
+	combineHash(result, hashExpr(expression->getPredicate().get()));
+	hash = result;
+}
+
+void StructuralHash::visit(const LambdaExpr *expression)
+{
+	std::size_t result = Expression::LAMBDA, size = bound.size();
+	bool outer_cache = cache;
+	bind(result, expression->getParams());
+	combineHash(result, hashExpr(expression->getDefinition().get()));
+	bound.resize(size);
+	cache = outer_cache;
+	hash = result;
+}
+
+/**
+ * Hash a rule: the types of its parameters, which are bound, and its
+ * statements.
+ *
+ * @param cls Hash seed for the kind of rule.
+ * @param rule Rule to hash.
+ * @param statements Statements of the rule.
+ */
+void StructuralHash::hashRule(std::size_t cls, const Rule *rule,
+	const std::vector<const_Expr_ptr> &statements)
+{
+	std::size_t result = cls, size = bound.size();
+	bool outer_cache = cache;
+	bind(result, rule->getParams());
+	for (const const_Expr_ptr &statement : statements)
+		combineHash(result, hashExpr(statement.get()));
+	bound.resize(size);
+	cache = outer_cache;
+	hash = result;
+}
+
+void StructuralHash::visit(const Tautology *rule)
+{
+	hashRule(TAUTOLOGY, rule, {rule->getStatement()});
+}
+
+void StructuralHash::visit(const EquivalenceRule *rule)
+{
+	hashRule(EQUIVALENCE, rule, {rule->getStatement1(), rule->getStatement2()});
+}
+
+void StructuralHash::visit(const DeductionRule *rule)
+{
+	std::vector<const_Expr_ptr> statements = rule->getPremisses();
+	statements.push_back(rule->getConclusion());
+	hashRule(DEDUCTION, rule, statements);
+}
+
+/**
+ * Statements are hashed by what they state, not by their proof.
+ */
+void StructuralHash::visit(const Statement *statement)
+{
+	std::size_t result = STATEMENT;
+	combineHash(result, hashExpr(statement->getDefinition().get()));
+	hash = result;
+}
+
+/**
+ * References are hashed like the object they refer to.
+ */
+void StructuralHash::visit(const Reference *reference)
+{
+	(*this)((**reference).get());
+}
+
+void StructuralHash::visit(const ProofStep *proofstep)
+{
+	std::size_t result = PROOFSTEP;
+	const_Rule_ptr rule = proofstep->getRule();
+	combineHash(result, (*this)(rule.get()));
+	for (const Node_ptr &param : rule->getParams())
+		combineHash(result, hashExpr((*proofstep)[param].get()));
+	for (const Reference &reference : proofstep->getReferences()) {
+		visit(&reference);
+		combineHash(result, hash);
+	}
+	hash = result;
+}
+
+void StructuralHash::visit(const Theory *theory)
+{
+	std::size_t result = THEORY;
+	for (const Object_ptr &object : *theory)
+		combineHash(result, (*this)(object.get()));
+	hash = result;
+}
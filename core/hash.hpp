@@ -0,0 +1,123 @@
+/*
+ *   Structural hashing of expressions and objects.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_HASH_HPP
+#define CORE_HASH_HPP
+#include "forward.hpp"
+#include "traverse.hpp"
+#include <cstddef>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Combine a hash value into another.
+	 *
+	 * @param seed Hash value to change.
+	 * @param value Value to mix in.
+	 */
+	inline void combineHash(std::size_t &seed, std::size_t value)
+	{
+		seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	}
+
+	/**
+	 * Visitor computing a structural hash. Expressions that are equal up to
+	 * renaming of lambda and rule parameters get the same hash: parameters
+	 * contribute their distance to their binder instead of their address.
+	 * Other nodes are identified by their address, like in Substitution.
+	 *
+	 * With a Context, we hash the expression that we would get by substituting
+	 * it, including the reduction of calls to substituted lambdas, without
+	 * building it. So the rule patterns of a proof step hash like the
+	 * statements they should match.
+	 *
+	 * The hash of an expression without free parameters or substituted nodes
+	 * is cached in the expression itself, so hashing it again is O(1). A hasher
+	 * may be used for any number of objects, but not from several threads.
+	 */
+	class StructuralHash : public Visitor {
+	public:
+		StructuralHash(const Context *context = nullptr);
+
+		std::size_t operator()(const Expression *expression);
+		std::size_t operator()(const Object *object);
+
+		/**
+		 * Get the hash of the last object visited.
+		 *
+		 * @return Hash value.
+		 */
+		std::size_t getHash() const
+			{return hash;}
+
+		void visit(const BuiltInType *type);
+		void visit(const LambdaType *type);
+		void visit(const Node *node);
+		void visit(const AtomicExpr *expression);
+		void visit(const LambdaCallExpr *expression);
+		void visit(const NegationExpr *expression);
+		void visit(const ConnectiveExpr *expression);
+		void visit(const QuantifierExpr *expression);
+		void visit(const LambdaExpr *expression);
+		void visit(const Tautology *rule);
+		void visit(const EquivalenceRule *rule);
+		void visit(const DeductionRule *rule);
+		void visit(const Statement *statement);
+		void visit(const Reference *reference);
+		void visit(const ProofStep *proofstep);
+		void visit(const Theory *theory);
+
+	private:
+		// Parameter of a substituted lambda, bound to an argument of its call.
+		struct Frame {
+			const Node *param;
+			const Expression *arg;
+			const Frame *scope;
+			bool cache;
+			const Frame *next;
+		};
+
+		std::size_t hashExpr(const Expression *expr);
+		void hashRule(std::size_t cls, const Rule *rule,
+			const std::vector<const_Expr_ptr> &statements);
+		void bind(std::size_t &result, const std::vector<Node_ptr> &params);
+		std::size_t reference(const Node *node);
+		bool substitute(const Node *node, const Frame *where,
+			const Expression **expr, const Frame **scope, bool *cache);
+		void hashSubstituted(const Expression *expr, const Frame *scope, bool expr_cache);
+
+		const Context *context;
+		std::size_t hash;
+
+		// Parameters of enclosing lambdas and rules
+		std::vector<const Node *> bound;
+		// Lowest level of bound that was referenced, 0 for substitutions
+		std::size_t lowest;
+
+		// Arguments of substituted lambdas
+		const Frame *env;
+		// May we use cached hashes? Not if nodes might be substituted.
+		bool cache;
+	};
+}	// End of namespace Core
+
+#endif
@@ -0,0 +1,247 @@
+/*
+ *   Incremental verification of theories.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "incremental.hpp"
+#include "logic.hpp"
+#include "parallel.hpp"
+#include "traverse.hpp"
+#include <algorithm>
+
+using namespace Core;
+
+namespace {
+	/**
+	 * Collect the objects a proof depends on: referenced statements and
+	 * the rule.
+	 */
+	class DependencyCollector : public Visitor {
+	public:
+		void visit(const ProofStep *proofstep)
+		{
+			dependencies.push_back(proofstep->getRule().get());
+			for (const Reference &ref : proofstep->getReferences())
+				dependencies.push_back((*ref).get());
+		}
+
+		std::vector<const Object *> dependencies;
+	};
+}
+
+/**
+ * Construct verifier for a theory. Nothing is checked before the first
+ * call to update(), which verifies the whole theory.
+ *
+ * @param theory Theory to verify.
+ */
+IncrementalVerifier::IncrementalVerifier(const Theory &theory)
+	: theory(theory), initialized(false), num_invalid(0), checked(0) {}
+
+/**
+ * Invalidate an object of the theory, after it was added or its proof was
+ * replaced.
+ *
+ * @param it Iterator to the object.
+ */
+void IncrementalVerifier::invalidate(Theory::const_iterator it)
+{
+	pending.push_back(it);
+}
+
+/**
+ * Invalidate an object that is already known, like a statement whose proof
+ * was replaced or a rule of another theory. Everything using a rule is
+ * checked again.
+ *
+ * @param object Object that was changed.
+ */
+void IncrementalVerifier::invalidate(const Object *object)
+{
+	dirty.insert(object);
+}
+
+/**
+ * Record the dependencies of a statement.
+ *
+ * @param statement Statement to look at.
+ * @param entry Entry of the statement.
+ */
+void IncrementalVerifier::link(const Statement *statement, Entry &entry)
+{
+	DependencyCollector collector;
+	if (statement->hasProof())
+		statement->getProof()->accept(&collector);
+
+	entry.dependencies = std::move(collector.dependencies);
+	for (const Object *dependency : entry.dependencies)
+		dependents[dependency].push_back(statement);
+}
+
+/**
+ * Forget the dependencies of a statement.
+ *
+ * @param statement Statement to look at.
+ * @param entry Entry of the statement.
+ */
+void IncrementalVerifier::unlink(const Statement *statement, Entry &entry)
+{
+	for (const Object *dependency : entry.dependencies) {
+		auto it = dependents.find(dependency);
+		if (it == dependents.end())
+			continue;
+
+		std::vector<const Statement *> &list = it->second;
+		auto pos = std::find(list.begin(), list.end(), statement);
+		if (pos != list.end())
+			list.erase(pos);
+		if (list.empty())
+			dependents.erase(it);
+	}
+	entry.dependencies.clear();
+}
+
+/**
+ * Check everything that was invalidated since the last update, and update
+ * the status of all statements depending on it.
+ *
+ * @param num_threads Number of threads to check proofs, 0 for one per core.
+ * @param failed If not null, the statements whose proofs don't check are
+ *      appended in the order in which they appear in the theory.
+ * @return True, if all proofs check, like Theory::verify().
+ */
+bool IncrementalVerifier::update(unsigned num_threads,
+	std::vector<Theory::const_iterator> *failed)
+{
+	if (!initialized) {
+		for (Theory::const_iterator it = theory.begin(); it != theory.end(); ++it)
+			pending.push_back(it);
+		initialized = true;
+	}
+
+	// Find the statements whose proofs have to be checked.
+	std::unordered_set<const Statement *> recheck;
+	for (Theory::const_iterator it : pending)
+		if (auto statement = dynamic_cast<const Statement *>(it->get())) {
+			auto result = entries.emplace(statement, Entry{statement, it, true, VALID, {}});
+			if (!result.second)
+				result.first->second.it = it;
+			recheck.insert(statement);
+		}
+	for (const Object *object : dirty) {
+		auto entry = entries.find(object);
+		if (entry != entries.end())
+			recheck.insert(entry->second.statement);
+		else {
+			auto it = dependents.find(object);
+			if (it != dependents.end())
+				recheck.insert(it->second.begin(), it->second.end());
+		}
+	}
+	pending.clear();
+	dirty.clear();
+
+	// Rebuild their dependencies and check them.
+	std::vector<const Statement *> statements(recheck.begin(), recheck.end());
+	for (const Statement *statement : statements) {
+		Entry &entry = entries[statement];
+		unlink(statement, entry);
+		link(statement, entry);
+	}
+
+	std::vector<char> valid(statements.size());
+	WorkStealingScheduler scheduler(num_threads);
+	scheduler.parallelFor(statements.size(), [&statements, &valid] (std::size_t i) {
+		const Statement *statement = statements[i];
+		valid[i] = !statement->hasProof() || statement->getProof()->proves(*statement);
+	});
+
+	for (std::size_t i = 0; i < statements.size(); ++i) {
+		Entry &entry = entries[statements[i]];
+		if (!entry.proof_valid)
+			--num_invalid;
+		entry.proof_valid = valid[i];
+		if (!entry.proof_valid)
+			++num_invalid;
+	}
+	checked = statements.size();
+
+	// Everything depending on them might have a new status.
+	std::vector<const Statement *> affected = statements;
+	for (std::size_t i = 0; i < affected.size(); ++i) {
+		auto it = dependents.find(affected[i]);
+		if (it != dependents.end())
+			for (const Statement *dependent : it->second)
+				if (recheck.insert(dependent).second)
+					affected.push_back(dependent);
+	}
+
+	// Dependencies come first in the theory, so we go through it in order.
+	std::vector<std::pair<std::size_t, Entry *>> order;
+	order.reserve(affected.size());
+	for (const Statement *statement : affected) {
+		Entry &entry = entries[statement];
+		order.emplace_back(theory.position(entry.it), &entry);
+	}
+	std::sort(order.begin(), order.end());
+
+	for (const auto &element : order) {
+		Entry &entry = *element.second;
+		if (!entry.proof_valid) {
+			entry.status = INVALID;
+			continue;
+		}
+
+		entry.status = VALID;
+		for (const Object *dependency : entry.dependencies) {
+			auto it = entries.find(dependency);
+			if (it != entries.end() && &it->second != &entry && it->second.status != VALID)
+				entry.status = DEPENDS_INVALID;
+		}
+	}
+
+	// Report
+	if (failed && num_invalid) {
+		std::vector<std::pair<std::size_t, Theory::const_iterator>> invalid;
+		for (const auto &element : entries)
+			if (!element.second.proof_valid)
+				invalid.emplace_back(theory.position(element.second.it), element.second.it);
+		std::sort(invalid.begin(), invalid.end(),
+			[] (const std::pair<std::size_t, Theory::const_iterator> &a,
+				const std::pair<std::size_t, Theory::const_iterator> &b) -> bool
+			{return a.first < b.first;});
+		for (const auto &element : invalid)
+			failed->push_back(element.second);
+	}
+
+	return num_invalid == 0;
+}
+
+/**
+ * Get the status of an object, as of the last update.
+ *
+ * @param it Iterator to the object.
+ * @return Status of the object. Objects other than statements are valid.
+ */
+IncrementalVerifier::Status IncrementalVerifier::getStatus(Theory::const_iterator it) const
+{
+	auto entry = entries.find(it->get());
+	if (entry != entries.end())
+		return entry->second.status;
+	else
+		return VALID;
+}
@@ -0,0 +1,94 @@
+/*
+ *   Incremental verification of theories.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_INCREMENTAL_HPP
+#define CORE_INCREMENTAL_HPP
+#include "forward.hpp"
+#include "theory.hpp"
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Verifier keeping the results for a theory that is edited.
+	 *
+	 * The result of checking a proof is cached per statement. Statements
+	 * depend on the statements their proof refers to and on the rule it uses.
+	 * After an object was added, a proof was replaced or a rule changed, only
+	 * the proofs of invalidated statements are checked again, while the
+	 * status of everything depending on them is updated along the
+	 * dependency graph.
+	 *
+	 * The verifier is not thread-safe, and the theory mustn't be changed
+	 * while update() runs.
+	 */
+	class IncrementalVerifier {
+	public:
+		enum Status {
+			VALID,          // Proof checks, and everything it relies on is valid
+			INVALID,        // Proof doesn't check
+			DEPENDS_INVALID // Proof checks, but relies on an invalid statement
+		};
+
+		IncrementalVerifier(const Theory &theory);
+
+		void invalidate(Theory::const_iterator it);
+		void invalidate(const Object *object);
+		bool update(unsigned num_threads = 1,
+			std::vector<Theory::const_iterator> *failed = nullptr);
+
+		Status getStatus(Theory::const_iterator it) const;
+
+		/**
+		 * Get the number of proofs checked by the last update.
+		 *
+		 * @return Number of proofs checked.
+		 */
+		std::size_t getChecked() const
+			{return checked;}
+
+	private:
+		struct Entry {
+			const Statement *statement;
+			Theory::const_iterator it;
+			bool proof_valid;
+			Status status;
+			std::vector<const Object *> dependencies;
+		};
+
+		void link(const Statement *statement, Entry &entry);
+		void unlink(const Statement *statement, Entry &entry);
+
+		const Theory &theory;
+		std::unordered_map<const Object *, Entry> entries;
+		std::unordered_map<const Object *, std::vector<const Statement *>> dependents;
+		std::vector<Theory::const_iterator> pending;
+		std::unordered_set<const Object *> dirty;
+		bool initialized;
+		std::size_t num_invalid;
+		std::size_t checked;
+	};
+}	// End of namespace Core
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ *   Index of rules by the shape of their conclusions.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "index.hpp"
+#include "logic.hpp"
+#include "expression.hpp"
+#include <algorithm>
+using namespace Core;
+
+namespace {
+	typedef std::pair<int, std::uintptr_t> Key;
+
+	// Marks a subexpression that can be substituted by anything.
+	const Key wildcard(-1, 0);
+
+	/**
+	 * Flatten an expression into its preorder sequence of head symbols.
+	 * For each symbol, next gets the index behind its subexpression.
+	 */
+	class Flattener {
+	public:
+		Flattener(const std::vector<Node_ptr> *params, std::vector<Key> &keys,
+			std::vector<std::size_t> *next)
+			: params(params), keys(keys), next(next) {}
+
+		void flatten(const Expression *expr)
+		{
+			std::size_t index = keys.size();
+			keys.push_back(head(expr));
+			if (next)
+				next->push_back(0);
+
+			if (keys.back() != wildcard) {
+				switch (expr->cls) {
+				case Expression::LAMBDACALL: {
+					auto call = static_cast<const LambdaCallExpr *>(expr);
+					for (const Expr_ptr &arg : *call)
+						flatten(arg.get());
+					break;
+					}
+				case Expression::NEGATION:
+					flatten(static_cast<const NegationExpr *>(expr)->getExpr().get());
+					break;
+				case Expression::CONNECTIVE: {
+					auto connective = static_cast<const ConnectiveExpr *>(expr);
+					flatten(connective->getFirstExpr().get());
+					flatten(connective->getSecondExpr().get());
+					break;
+					}
+				case Expression::QUANTIFIER:
+					flatten(static_cast<const QuantifierExpr *>(expr)->getPredicate().get());
+					break;
+				default:
+					break;
+				}
+			}
+
+			if (next)
+				(*next)[index] = keys.size();
+		}
+
+	private:
+		Key head(const Expression *expr) const
+		{
+			switch (expr->cls) {
+			case Expression::ATOMIC: {
+				const Node *node = static_cast<const AtomicExpr *>(expr)->getAtom().get();
+				return isParam(node) ? wildcard : key(expr, node);
+				}
+			case Expression::LAMBDACALL: {
+				const Node *node = static_cast<const LambdaCallExpr *>(expr)->getLambda().get();
+				return isParam(node) ? wildcard : key(expr, node);
+				}
+			case Expression::CONNECTIVE:
+				return Key(expr->cls, static_cast<const ConnectiveExpr *>(expr)->getVariant());
+			case Expression::QUANTIFIER:
+				return Key(expr->cls, static_cast<const QuantifierExpr *>(expr)->getVariant());
+			case Expression::LAMBDA:
+				return Key(expr->cls, static_cast<const LambdaExpr *>(expr)->getParams().size());
+			default:
+				return Key(expr->cls, 0);
+			}
+		}
+
+		static Key key(const Expression *expr, const Node *node)
+			{return Key(expr->cls, reinterpret_cast<std::uintptr_t>(node));}
+
+		bool isParam(const Node *node) const
+		{
+			return params && std::any_of(params->begin(), params->end(),
+				[node] (const Node_ptr &param) {return param.get() == node;});
+		}
+
+		const std::vector<Node_ptr> *params;
+		std::vector<Key> &keys;
+		std::vector<std::size_t> *next;
+	};
+
+	/**
+	 * Collect the statements of a rule that we can prove with it.
+	 */
+	class PatternCollector : public Visitor {
+	public:
+		void visit(const Tautology *rule)
+			{patterns.push_back(rule->getStatement().get());}
+		void visit(const EquivalenceRule *rule)
+		{
+			patterns.push_back(rule->getStatement1().get());
+			patterns.push_back(rule->getStatement2().get());
+		}
+		void visit(const DeductionRule *rule)
+			{patterns.push_back(rule->getConclusion().get());}
+
+		std::vector<const Expression *> patterns;
+	};
+}
+
+/**
+ * Construct an index for all rules of a theory.
+ *
+ * @param rules Theory containing the rules. Other objects are ignored.
+ */
+RuleIndex::RuleIndex(const Theory &rules) : patterns(0)
+{
+	for (const Object_ptr &object : rules)
+		if (object->getType() == BuiltInType::rule)
+			add(std::static_pointer_cast<const Rule>(object));
+}
+
+/**
+ * Add a rule to the index.
+ *
+ * @param rule Rule to add.
+ */
+void RuleIndex::add(const_Rule_ptr rule)
+{
+	PatternCollector collector;
+	rule->accept(&collector);
+	for (const Expression *pattern : collector.patterns)
+		insert(pattern, Candidate{rule, pattern});
+}
+
+/**
+ * Find the rules that could prove a statement.
+ *
+ * @param target Statement expression to prove.
+ * @return Candidate rules together with the fitting statement, in no
+ *      particular order.
+ */
+std::vector<RuleIndex::Candidate> RuleIndex::lookup(const Expression *target) const
+{
+	std::vector<Key> keys;
+	std::vector<std::size_t> next;
+	Flattener(nullptr, keys, &next).flatten(target);
+
+	std::vector<Candidate> result;
+	collect(&root, keys, next, 0, result);
+	return result;
+}
+
+// Insert the path of a pattern into the tree.
+void RuleIndex::insert(const Expression *pattern, const Candidate &candidate)
+{
+	std::vector<Key> keys;
+	Flattener(&candidate.rule->getParams(), keys, nullptr).flatten(pattern);
+
+	TreeNode *node = &root;
+	for (const Key &key : keys) {
+		std::unique_ptr<TreeNode> &child =
+			(key == wildcard) ? node->wildcard : node->children[key];
+		if (!child)
+			child.reset(new TreeNode);
+		node = child.get();
+	}
+
+	node->entries.push_back(candidate);
+	++patterns;
+}
+
+// Walk the tree along the keys of the target, starting at index. A wildcard
+// swallows the complete subexpression at index.
+void RuleIndex::collect(const TreeNode *node, const std::vector<Key> &keys,
+	const std::vector<std::size_t> &next, std::size_t index,
+	std::vector<Candidate> &result) const
+{
+	if (index == keys.size()) {
+		result.insert(result.end(), node->entries.begin(), node->entries.end());
+		return;
+	}
+
+	if (node->wildcard)
+		collect(node->wildcard.get(), keys, next, next[index], result);
+
+	auto child = node->children.find(keys[index]);
+	if (child != node->children.end())
+		collect(child->second.get(), keys, next, index + 1, result);
+}
@@ -0,0 +1,91 @@
+/*
+ *   Index of rules by the shape of their conclusions.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_INDEX_HPP
+#define CORE_INDEX_HPP
+#include "forward.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Discrimination tree over the statements a rule can prove: the
+	 * statement of a tautology, both sides of an equivalence rule and the
+	 * conclusion of a deduction rule.
+	 *
+	 * Expressions are flattened in preorder into a sequence of head symbols.
+	 * Rule parameters, and calls of lambda parameters, can be replaced by
+	 * anything, so they become wildcards standing for a whole subexpression.
+	 * Lambda expressions are leaves, we don't look into them.
+	 *
+	 * A lookup gives a superset of the rules that could prove a statement;
+	 * Rule::validate() still has to decide.
+	 */
+	class RuleIndex {
+	public:
+		/**
+		 * Result of a lookup: a rule and which of its statements fits.
+		 */
+		struct Candidate {
+			const_Rule_ptr rule;
+			const Expression *pattern;
+		};
+
+		RuleIndex() : patterns(0) {}
+		RuleIndex(const Theory &rules);
+
+		void add(const_Rule_ptr rule);
+		std::vector<Candidate> lookup(const Expression *target) const;
+
+		/**
+		 * Get number of indexed statements.
+		 *
+		 * @return Number of statements.
+		 */
+		std::size_t size() const
+			{return patterns;}
+
+	private:
+		// Head symbol: class of the expression and node or variant
+		typedef std::pair<int, std::uintptr_t> Key;
+
+		struct TreeNode {
+			std::map<Key, std::unique_ptr<TreeNode>> children;
+			std::unique_ptr<TreeNode> wildcard;
+			std::vector<Candidate> entries;
+		};
+
+		void insert(const Expression *pattern, const Candidate &candidate);
+		void collect(const TreeNode *node, const std::vector<Key> &keys,
+			const std::vector<std::size_t> &next, std::size_t index,
+			std::vector<Candidate> &result) const;
+
+		TreeNode root;
+		std::size_t patterns;
+	};
+}	// End of namespace Core
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ *   Hash consing of expressions.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Expressions are looked up by a hash over their class, variant and the
+ * addresses of their direct subexpressions. Since the subexpressions have been
+ * interned before, comparing their addresses is enough to decide equality.
+ *
+ * Lambda expressions are different: their parameters are fresh nodes, so two
+ * equal lambdas never share subexpressions that contain the parameters. We
+ * hash them with StructuralHash, which doesn't depend on the names of the
+ * parameters, and compare candidates structurally.
+ */
+
+#include "intern.hpp"
+#include "hash.hpp"
+#include "tree.hpp"
+#include <algorithm>
+#include <functional>
+using namespace Core;
+
+static inline std::size_t hashPointer(const void *pointer)
+{
+	return std::hash<const void *>()(pointer);
+}
+
+/**
+ * Get an atomic expression.
+ *
+ * @param node Node the expression should point to.
+ * @return Interned atomic expression.
+ */
+Expr_ptr ExpressionFactory::makeAtomic(const_Node_ptr node)
+{
+	std::size_t hash = Expression::ATOMIC;
+	combineHash(hash, hashPointer(node.get()));
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Expr_ptr expr = find(hash, [&node] (const Expression *expr) {
+		return expr->cls == Expression::ATOMIC &&
+			static_cast<const AtomicExpr *>(expr)->getAtom() == node;
+	});
+	return expr ? expr : insert(hash, std::make_shared<AtomicExpr>(std::move(node)));
+}
+
+/**
+ * Get a lambda call expression.
+ *
+ * @param node Lambda node that is called.
+ * @param args Arguments for the call.
+ * @return Interned lambda call expression.
+ */
+Expr_ptr ExpressionFactory::makeLambdaCall(const_Node_ptr node, std::vector<Expr_ptr> &&args)
+{
+	std::size_t hash = Expression::LAMBDACALL;
+	combineHash(hash, hashPointer(node.get()));
+	for (const Expr_ptr &arg : args)
+		combineHash(hash, hashPointer(arg.get()));
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Expr_ptr expr = find(hash, [&node, &args] (const Expression *expr) {
+		if (expr->cls != Expression::LAMBDACALL)
+			return false;
+		auto call = static_cast<const LambdaCallExpr *>(expr);
+		return call->getLambda() == node &&
+			(std::size_t)(call->end() - call->begin()) == args.size() &&
+			std::equal(args.begin(), args.end(), call->begin());
+	});
+	return expr ? expr : insert(hash, std::make_shared<LambdaCallExpr>(std::move(node), std::move(args)));
+}
+
+/**
+ * Get a negation expression.
+ *
+ * @param expr Expression to negate.
+ * @return Interned negation expression.
+ */
+Expr_ptr ExpressionFactory::makeNegation(Expr_ptr expr)
+{
+	std::size_t hash = Expression::NEGATION;
+	combineHash(hash, hashPointer(expr.get()));
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Expr_ptr result = find(hash, [&expr] (const Expression *other) {
+		return other->cls == Expression::NEGATION &&
+			static_cast<const NegationExpr *>(other)->getExpr() == expr;
+	});
+	return result ? result : insert(hash, std::make_shared<NegationExpr>(std::move(expr)));
+}
+
+/**
+ * Get a connective expression.
+ *
+ * @param variant One of ConnectiveExpr::{AND|OR|IMPL|EQUIV}.
+ * @param first First operand.
+ * @param second Second operand.
+ * @return Interned connective expression.
+ */
+Expr_ptr ExpressionFactory::makeConnective(ConnectiveExpr::Variant variant,
+	Expr_ptr first, Expr_ptr second)
+{
+	std::size_t hash = Expression::CONNECTIVE;
+	combineHash(hash, variant);
+	combineHash(hash, hashPointer(first.get()));
+	combineHash(hash, hashPointer(second.get()));
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Expr_ptr expr = find(hash, [&] (const Expression *expr) {
+		if (expr->cls != Expression::CONNECTIVE)
+			return false;
+		auto connective = static_cast<const ConnectiveExpr *>(expr);
+		return connective->getVariant() == variant &&
+			connective->getFirstExpr() == first &&
+			connective->getSecondExpr() == second;
+	});
+	return expr ? expr : insert(hash, std::make_shared<ConnectiveExpr>(variant, std::move(first), std::move(second)));
+}
+
+/**
+ * Get a quantifier expression.
+ *
+ * @param variant One of QuantifierExpr::{EXISTS|FORALL}.
+ * @param predicate Predicate to quantify over.
+ * @return Interned quantifier expression.
+ */
+Expr_ptr ExpressionFactory::makeQuantifier(QuantifierExpr::Variant variant,
+	const_Expr_ptr predicate)
+{
+	std::size_t hash = Expression::QUANTIFIER;
+	combineHash(hash, variant);
+	combineHash(hash, hashPointer(predicate.get()));
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Expr_ptr expr = find(hash, [&] (const Expression *expr) {
+		if (expr->cls != Expression::QUANTIFIER)
+			return false;
+		auto quantifier = static_cast<const QuantifierExpr *>(expr);
+		return quantifier->getVariant() == variant &&
+			quantifier->getPredicate() == predicate;
+	});
+	return expr ? expr : insert(hash, std::make_shared<QuantifierExpr>(variant, std::move(predicate)));
+}
+
+/**
+ * Get a lambda expression. If an equal lambda expression up to renaming of
+ * parameters exists, it is returned instead, together with its parameters.
+ *
+ * @param params Parameters of the lambda.
+ * @param expression Definition of the lambda.
+ * @return Interned lambda expression.
+ */
+Expr_ptr ExpressionFactory::makeLambda(std::vector<Node_ptr> &&params,
+	const_Expr_ptr expression)
+{
+	// We need the lambda anyway to compare it with the candidates.
+	Expr_ptr lambda = std::make_shared<LambdaExpr>(std::move(params), std::move(expression));
+	std::size_t hash = StructuralHash()(lambda.get());
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Substitution::State state;
+	Context context;
+	Expr_ptr expr = find(hash, [&] (const Expression *expr) {
+		return expr->cls == Expression::LAMBDA &&
+			Substitution(lambda).check(expr, context, state);
+	});
+	return expr ? expr : insert(hash, std::move(lambda));
+}
+
+/**
+ * Get the number of distinct expressions built so far.
+ *
+ * @return Number of expressions.
+ */
+std::size_t ExpressionFactory::size() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return table.size();
+}
+
+// Find an expression with the given hash satisfying equal. Needs the lock.
+template <typename Equal>
+Expr_ptr ExpressionFactory::find(std::size_t hash, Equal equal) const
+{
+	auto range = table.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+		if (equal(it->second.get()))
+			return it->second;
+
+	return Expr_ptr();
+}
+
+// Insert a new expression. Needs the lock.
+Expr_ptr ExpressionFactory::insert(std::size_t hash, Expr_ptr expr)
+{
+	table.emplace(hash, expr);
+	return expr;
+}
@@ -0,0 +1,66 @@
+/*
+ *   Hash consing of expressions.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_INTERN_HPP
+#define CORE_INTERN_HPP
+#include "forward.hpp"
+#include "expression.hpp"
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Factory for expressions that returns the same object for structurally
+	 * identical expressions. Lambda expressions are identified up to renaming
+	 * of their parameters.
+	 *
+	 * If all subexpressions come from the same factory, structural equality
+	 * is pointer equality. The factory keeps all expressions it has built
+	 * alive, and they must not be changed afterwards, e.g. by
+	 * LambdaExpr::setDefinition(). The factory is thread-safe.
+	 */
+	class ExpressionFactory {
+	public:
+		Expr_ptr makeAtomic(const_Node_ptr node);
+		Expr_ptr makeLambdaCall(const_Node_ptr node, std::vector<Expr_ptr> &&args);
+		Expr_ptr makeNegation(Expr_ptr expr);
+		Expr_ptr makeConnective(ConnectiveExpr::Variant variant,
+			Expr_ptr first, Expr_ptr second);
+		Expr_ptr makeQuantifier(QuantifierExpr::Variant variant,
+			const_Expr_ptr predicate);
+		Expr_ptr makeLambda(std::vector<Node_ptr> &&params, const_Expr_ptr expression);
+
+		std::size_t size() const;
+
+	private:
+		template <typename Equal>
+		Expr_ptr find(std::size_t hash, Equal equal) const;
+		Expr_ptr insert(std::size_t hash, Expr_ptr expr);
+
+		mutable std::mutex mutex;
+		std::unordered_multimap<std::size_t, Expr_ptr> table;
+	};
+}	// End of namespace Core
+
+#endif
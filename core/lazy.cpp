@@ -0,0 +1,86 @@
+/*
+ *   Proofs parsed when they are needed.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "lazy.hpp"
+#include "lisp.hpp"
+#include <sstream>
+
+using namespace Core;
+
+/**
+ * Construct a lazy proof.
+ *
+ * @param text Text of the proof.
+ * @param theory Anchor of the theory containing the statement.
+ * @param it Iterator to the statement.
+ * @param statement Statement to be proven, for inferring arguments.
+ * @param rules Theory containing the rules.
+ * @param descriptor How to call the file in error messages.
+ * @param line Line of the proof in the file.
+ * @param column Column before the proof in the file.
+ */
+LazyProof::LazyProof(std::string &&text, std::shared_ptr<const Theory *const> theory,
+	Theory::iterator it, const_Expr_ptr statement, const Theory *rules,
+	const std::string &descriptor, int line, int column)
+	: text(std::move(text)), theory(std::move(theory)), it(it), statement(statement),
+	  rules(rules), descriptor(descriptor), line(line), column(column), loaded(false) {}
+
+/**
+ * Get the proof, parsing it if that hasn't happened yet. This may be called
+ * from several threads.
+ *
+ * @return Parsed proof, or an empty pointer if it has errors or the theory
+ *      doesn't exist anymore.
+ */
+const_Proof_ptr LazyProof::get() const
+{
+	std::call_once(once, &LazyProof::load, this);
+	return proof;
+}
+
+/**
+ * Parse the proof and drop its text. Called only once, by get().
+ */
+void LazyProof::load() const
+{
+	if (const Theory *current = *theory) {
+		std::ostringstream output;
+		Parser parser(text.data(), text.data() + text.size(), output, descriptor, line, column);
+		parser.rules = rules;
+		// Proofs don't add objects to the theory.
+		proof = parser.parseProof(const_cast<Theory *>(current), it, statement);
+		parser.flushMessages();
+		messages = output.str();
+	}
+	std::string().swap(text);
+	loaded.store(true, std::memory_order_release);
+}
+
+/**
+ * Does the proof prove a statement? Proofs with errors prove nothing.
+ *
+ * @param statement Statement to verify.
+ * @param cache Cache for the results of rule applications, or nullptr.
+ * @return True, if the statement could be verified by the proof.
+ */
+bool LazyProof::proves(const Statement &statement, VerificationCache *cache) const
+{
+	const_Proof_ptr loaded_proof = get();
+	return loaded_proof && loaded_proof->proves(statement, cache);
+}
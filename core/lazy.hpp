@@ -0,0 +1,87 @@
+/*
+ *   Proofs parsed when they are needed.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_LAZY_HPP
+#define CORE_LAZY_HPP
+#include "forward.hpp"
+#include "theory.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Proof that the parser skipped. Its text is kept and parsed the first
+	 * time the proof is needed, by Statement::getProof() or verification.
+	 * The theory containing the statement may be moved in the meantime, but
+	 * the rules must stay where they are.
+	 */
+	class LazyProof : public Proof {
+	public:
+		LazyProof(std::string &&text, std::shared_ptr<const Theory *const> theory,
+			Theory::iterator it, const_Expr_ptr statement, const Theory *rules,
+			const std::string &descriptor, int line, int column);
+
+		const_Proof_ptr get() const;
+
+		/**
+		 * Has the proof been parsed already?
+		 *
+		 * @return True, if get() has been called.
+		 */
+		bool isLoaded() const
+			{return loaded.load(std::memory_order_acquire);}
+
+		/**
+		 * Get the messages of the parser, once the proof has been parsed.
+		 *
+		 * @return Errors and warnings, in the usual format.
+		 */
+		const std::string &getMessages() const
+			{return messages;}
+
+		bool proves(const Statement &statement, VerificationCache *cache = nullptr) const;
+		void accept(Visitor *visitor) const
+			{visitor->visit(this);}
+
+	private:
+		void load() const;
+
+		// What we need to parse the proof
+		mutable std::string text;
+		const std::shared_ptr<const Theory *const> theory;
+		const Theory::iterator it;
+		const const_Expr_ptr statement;
+		const Theory *const rules;
+		const std::string descriptor;
+		const int line, column;
+
+		// The proof, once it's parsed
+		mutable std::once_flag once;
+		mutable std::atomic<bool> loaded;
+		mutable Proof_ptr proof;
+		mutable std::string messages;
+	};
+}	// End of namespace Core
+
+#endif
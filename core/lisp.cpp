@@ -18,16 +18,45 @@
  */
 
 #include "lisp.hpp"
+#include "intern.hpp"
+#include "lazy.hpp"
 #include "logic.hpp"
 #include "expression.hpp"
+#include "dispatch.hpp"
+#include "parallel.hpp"
+#include "profile.hpp"
+#include "scan.hpp"
+#include "stream.hpp"
+#include <algorithm>
+#include <cstring>
 #include <limits>
 #include <stdexcept>
 using namespace Core;
 
+/**
+ * Get the content of a word token.
+ *
+ * @return Content string.
+ * @throw std::logic_error if the token is not a word.
+ */
 const std::string& LispToken::getContent() const
 {
 	if (type == WORD)
-		return content;
+		return symbol ? symbol.str() : content;
+	else
+		throw std::logic_error("Only word tokens have content.");
+}
+
+/**
+ * Get the content of a word token as symbol.
+ *
+ * @return Interned content.
+ * @throw std::logic_error if the token is not a word.
+ */
+Symbol LispToken::getSymbol() const
+{
+	if (type == WORD)
+		return symbol ? symbol : Symbol(content);
 	else
 		throw std::logic_error("Only word tokens have content.");
 }
@@ -37,40 +66,76 @@ const std::string& LispToken::getContent() const
 // Parser helper classes //
 ///////////////////////////
 
-Lexer::Lexer(std::istream &input)
-	: input(input), last(' '), line_number(1), column_number(0) {}
+/**
+ * Construct a lexer reading from a stream.
+ *
+ * @param input Stream to read from.
+ * @param buffer_size Number of characters to read at once.
+ */
+Lexer::Lexer(std::istream &input, std::size_t buffer_size)
+	: input(&input), buffer(buffer_size ? buffer_size : 1), pos(nullptr), end(nullptr),
+	  last(' '), line_number(1), column_number(0) {}
+
+/**
+ * Construct a lexer reading from a buffer. The buffer must stay alive as long
+ * as the lexer and its tokens.
+ *
+ * @param begin Beginning of the buffer.
+ * @param end End of the buffer.
+ * @param line Line number of the beginning, for buffers cut out of a file.
+ * @param column Column before the beginning.
+ */
+Lexer::Lexer(const char *begin, const char *end, int line, int column)
+	: input(nullptr), pos(begin), end(end), last(' '), line_number(line),
+	  column_number(column) {}
 
 LispToken Lexer::getToken()
 {
-	std::string str;
-
-	// Skip any whitespace.
-	while (std::isspace(last))
-		nextChar();
+	for (;;) {
+		// Skip any whitespace.
+		while (isSpace(last)) {
+			skipSpace();
+			nextChar();
+		}
 
-	// Single-line comment
-	if (last == '#') {
+		// Single-line comment
+		if (last != '#')
+			break;
 		skipLine();
-		return getToken();
 	}
 
 	// Check for end of file.
-	if (input.eof())
+	if (last == -1)
 		return LispToken(LispToken::ENDOFFILE);
 
-	// Word tokens: [^ \t\r\n()]*. Since we got here, we can assume
-	// that we are not at eof and last is neither a space nor '#'.
+	// Word tokens: [^ \t\r\n()#]*. Since we got here, we can assume
+	// that we are not at eof and last is neither a space nor '#'. The word
+	// can't contain a newline, so we only have to count columns.
 	if (last != '(' && last != ')') {
-		std::string token;
-		bool valid;
-		do {
-			token += last;
+		if (input) {
+			// Words might go beyond our buffer, so we collect them.
+			std::string token(1, (char)last);
+			for (;;) {
+				const char *word_end = findDelimiter(pos, end);
+				token.append(pos, word_end);
+				column_number += word_end - pos;
+				pos = word_end;
+				if (pos != end || !fill())
+					break;
+			}
+
 			nextChar();
-			valid = !std::isspace(last) && last != -1 && last != '('
-				&& last != ')' && last != '#';
-		} while (valid);
+			return LispToken(Symbol(token));
+		}
+		else {
+			const char *begin = pos - 1;
+			const char *word_end = findDelimiter(pos, end);
+			column_number += word_end - pos;
+			pos = word_end;
 
-		return LispToken(std::move(token));
+			nextChar();
+			return LispToken(Symbol(begin, word_end - begin));
+		}
 	}
 
 	// Otherwise, we will have parantheses
@@ -88,9 +153,56 @@ LispToken Lexer::getToken()
 	return LispToken(type);
 }
 
+/**
+ * Skip the rest of a form without making tokens. The opening paranthesis
+ * must have been the last token. Comments are replaced by line breaks.
+ *
+ * @param text String to append the rest of the form to, up to and including
+ *      the closing paranthesis.
+ * @param line Set to the line of the opening paranthesis.
+ * @param column Set to the column before the opening paranthesis.
+ * @return False, if the input ended before the form.
+ */
+bool Lexer::skipForm(std::string *text, int *line, int *column)
+{
+	*line = line_number - (last == '\n');
+	*column = (last == '\n') ? 0 : column_number - 2;
+
+	int depth = 1;
+	while (last != -1) {
+		if (last == '#') {
+			skipLine();
+			text->push_back('\n');
+			continue;
+		}
+
+		text->push_back(last);
+		if (last == '(')
+			++depth;
+		else if (last == ')' && !--depth) {
+			nextChar();
+			return true;
+		}
+
+		// Take everything up to the next paranthesis, comment or line break.
+		const char *next = findStructural(pos, end);
+		text->append(pos, next);
+		column_number += next - pos;
+		pos = next;
+		nextChar();
+	}
+	return false;
+}
+
 void Lexer::nextChar()
 {
-	last = input.get();
+	if (pos == end && !fill()) {
+		last = -1;
+		++column_number;
+		return;
+	}
+
+	last = (unsigned char)*pos++;
 	if (last == '\n') {
 		++line_number;
 		column_number = 0;
@@ -99,14 +211,72 @@ void Lexer::nextChar()
 		++column_number;
 }
 
+/**
+ * Skip whitespace in the rest of the buffer. The last character is taken to
+ * be whitespace, and is replaced by nextChar() afterwards.
+ */
+void Lexer::skipSpace()
+{
+	int lines;
+	const char *line_begin;
+	const char *next = Core::skipSpace(pos, end, &lines, &line_begin);
+	if (lines) {
+		line_number += lines;
+		column_number = next - line_begin;
+	}
+	else
+		column_number += next - pos;
+	pos = next;
+}
+
 void Lexer::skipLine()
 {
-	input.ignore(std::numeric_limits<int>::max(), '\n');
+	for (;;) {
+		const char *newline = pos == end ? nullptr :
+			static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+		if (newline) {
+			pos = newline + 1;
+			break;
+		}
+
+		pos = end;
+		if (!fill())
+			break;
+	}
+
 	++line_number;
 	column_number = 0;
 	nextChar();
 }
 
+/**
+ * Read more characters from the stream into our buffer.
+ *
+ * @return False, if there is nothing more to read.
+ */
+bool Lexer::fill()
+{
+	if (!input)
+		return false;
+
+	// Take what the stream has buffered, block for more only if there is none.
+	std::streamsize count = input->readsome(buffer.data(), buffer.size());
+	if (count <= 0) {
+		int c = input->get();
+		if (c == std::char_traits<char>::eof())
+			return false;
+
+		buffer[0] = c;
+		count = 1;
+		if (buffer.size() > 1)
+			count += input->readsome(buffer.data() + 1, buffer.size() - 1);
+	}
+
+	pos = buffer.data();
+	end = pos + count;
+	return true;
+}
+
 /**
  * Construct a parser error handler.
  *
@@ -115,59 +285,67 @@ void Lexer::skipLine()
  * @param descriptor String that denotes the input stream, e.g. a file name.
  */
 ParserErrorHandler::ParserErrorHandler(const Lexer &lexer, std::ostream &output, const std::string &descriptor)
-	: lexer(lexer), descriptor(descriptor), error_count(0), warning_count(0), output(output), writer(output) {}
+	: lexer(lexer), descriptor(std::make_shared<const std::string>(descriptor)),
+	  written(0), output(output) {}
 
 /**
- * Desctruct ParserErrorHandler and write error and warning count.
+ * Desctruct ParserErrorHandler and write what is left, and the error and
+ * warning count.
  */
 ParserErrorHandler::~ParserErrorHandler()
 {
-	output << "\n\n*** " << descriptor << ": "
-		<< error_count << " errors, "
-		<< warning_count << " warnings.\n";
+	flush();
+	output << "\n\n*** " << *descriptor << ": "
+		<< buffer.getErrors() << " errors, "
+		<< buffer.getWarnings() << " warnings.\n";
 }
 
 /**
- * Write new error, warning or note.
+ * Start new error, warning or note at the current position of the lexer.
  *
  * @param level One of ParserErrorHandler::{ERROR|WARNING|NOTE}.
  */
 ParserErrorHandler& ParserErrorHandler::operator <<(Level level)
 {
-	output << std::endl << descriptor << ':' << lexer.getLine()
-		<< ':' << lexer.getColumn() << ':';
-
-	switch(level) {
-	case ERROR:
-		output << " error: ";
-		++error_count;
-		break;
-	case WARNING:
-		output << " warning: ";
-		++warning_count;
-		break;
-	case NOTE:
-		output << " note: ";
-		break;
-	}
+	buffer.add(level, descriptor, lexer.getLine(), lexer.getColumn());
+	return *this;
+}
 
+/**
+ * Add interned string.
+ *
+ * @param symbol Symbol.
+ */
+ParserErrorHandler& ParserErrorHandler::operator <<(Symbol symbol)
+{
+	buffer.addOperand(Diagnostic::Operand::SYMBOL).symbol = symbol;
 	return *this;
 }
 
 /**
- * Write string.
+ * Add string.
  *
- * @param str String.
+ * @param str String, which is copied.
  */
 ParserErrorHandler& ParserErrorHandler::operator <<(const std::string &str)
 {
-	output << str;
+	buffer.addOperand(Diagnostic::Operand::STRING).string = str;
+	return *this;
+}
 
+/**
+ * Add number.
+ *
+ * @param number Number.
+ */
+ParserErrorHandler& ParserErrorHandler::operator <<(std::size_t number)
+{
+	buffer.addOperand(Diagnostic::Operand::NUMBER).number = number;
 	return *this;
 }
 
 /**
- * Write token type.
+ * Add token type.
  *
  * @param type Token type.
  */
@@ -175,35 +353,90 @@ ParserErrorHandler& ParserErrorHandler::operator <<(LispToken::Type type)
 {
 	switch(type) {
 	case LispToken::WORD:
-		output << "word";
-		break;
+		return addText("word");
 	case LispToken::OPENING:
-		output << "opening paranthesis";
-		break;
+		return addText("opening paranthesis");
 	case LispToken::CLOSING:
-		output << "closing paranthesis";
-		break;
+		return addText("closing paranthesis");
 	case LispToken::ENDOFFILE:
-		output << "end of file";
-		break;
+	default:
+		return addText("end of file");
 	}
-
-	return *this;
 }
 
 /**
- * Write type signature.
+ * Add type signature.
  *
  * @param type Pointer to type object.
  */
 ParserErrorHandler& ParserErrorHandler::operator <<(const_Expr_ptr type)
 {
-	TypeWriter writer(output);
-	writer.write(type.get());
+	buffer.addOperand(Diagnostic::Operand::TYPE).type = std::move(type);
+	return *this;
+}
 
+/**
+ * Add the description of a type exception, taken apart.
+ *
+ * @param ex Type exception.
+ */
+ParserErrorHandler& ParserErrorHandler::operator <<(const TypeException &ex)
+{
+	*this << "expected ";
+	if (ex.getWantedType())
+		*this << ex.getWantedType();
+	else
+		*this << ex.getWanted();
+	*this << ", but got " << ex.getType();
+	if (ex.getWhere() != "")
+		*this << " in " << ex.getWhere();
+	return *this;
+}
+
+/**
+ * Add string literal.
+ *
+ * @param text String of static storage duration.
+ */
+ParserErrorHandler& ParserErrorHandler::addText(const char *text)
+{
+	buffer.addOperand(Diagnostic::Operand::TEXT).text = text;
 	return *this;
 }
 
+/**
+ * Write the diagnostics that weren't written yet.
+ */
+void ParserErrorHandler::flush()
+{
+	const std::vector<Diagnostic> &records = buffer.getRecords();
+	for (; written < records.size(); ++written)
+		records[written].write(output);
+}
+
+/**
+ * Add diagnostics found elsewhere, e.g. by another thread.
+ *
+ * @param other Diagnostics to take over.
+ */
+void ParserErrorHandler::append(DiagnosticBuffer &&other)
+{
+	buffer.append(std::move(other));
+}
+
+/**
+ * Take the diagnostics instead of writing them.
+ *
+ * @return Diagnostics that weren't written yet.
+ */
+DiagnosticBuffer ParserErrorHandler::take()
+{
+	DiagnosticBuffer result = std::move(buffer);
+	buffer = DiagnosticBuffer();
+	written = 0;
+	return result;
+}
+
 //////////////////////////////////
 // Implementation of the Parser //
 //////////////////////////////////
@@ -217,7 +450,41 @@ ParserErrorHandler& ParserErrorHandler::operator <<(const_Expr_ptr type)
  *      be a file name.
  */
 Parser::Parser(std::istream& input, std::ostream &output, const std::string &descriptor)
-	: lexer(input), error_output(lexer, output, descriptor), token(lexer.getToken()) {}
+	: rules(nullptr), factory(nullptr), verifier(nullptr), lazy(false), lexer(input), error_output(lexer, output, descriptor), token(lexer.getToken()),
+	  buffer_begin(nullptr), buffer_end(nullptr), frozen(Theory::npos), reserved(false), conflict(false),
+	  last_object(nullptr) {}
+
+/**
+ * Construct a parser reading from a buffer in memory, which must stay alive
+ * while parsing.
+ *
+ * @param begin Beginning of the buffer.
+ * @param end End of the buffer.
+ * @param output Output stream for errors, warnings and notes.
+ * @param descriptor How to call the buffer in error messages.
+ * @param line Line number of the beginning, for buffers cut out of a file.
+ * @param column Column before the beginning.
+ */
+Parser::Parser(const char *begin, const char *end, std::ostream &output,
+	const std::string &descriptor, int line, int column)
+	: rules(nullptr), factory(nullptr), verifier(nullptr), lazy(false), lexer(begin, end, line, column), error_output(lexer, output, descriptor), token(lexer.getToken()),
+	  buffer_begin(begin), buffer_end(end), frozen(Theory::npos), reserved(false), conflict(false),
+	  last_object(nullptr) {}
+
+/**
+ * Construct an object for the parse tree, in our arena if we have one.
+ *
+ * @param args Arguments for the constructor of T.
+ * @return Pointer to the new object.
+ */
+template <typename T, typename... Args>
+std::shared_ptr<T> Parser::make(Args&&... args)
+{
+	if (arena)
+		return std::allocate_shared<T>(ArenaAllocator<T>(arena), std::forward<Args>(args)...);
+	else
+		return std::make_shared<T>(std::forward<Args>(args)...);
+}
 
 void Parser::nextToken()
 {
@@ -251,7 +518,14 @@ bool Parser::expect(LispToken::Type type)
  */
 Theory::iterator Parser::addObject(Object_ptr object)
 {
+	last_object = object.get();
 	Theory::iterator it = iterator_stack.top();
+	if (reserved) {
+		*it = object;
+		reserved = false;
+		return it;
+	}
+
 	it = theory_stack.top()->add(object, it);
 	iterator_stack.top() = it;
 	return it;
@@ -264,11 +538,11 @@ Theory::iterator Parser::addObject(Object_ptr object)
  */
 const_Rule_ptr Parser::getRule()
 {
-	Theory::const_iterator it = this->rules->get(token.getContent());
+	Theory::const_iterator it = this->rules->get(token.getSymbol());
 
 	if (it == this->rules->end()) {
 		error_output << ParserErrorHandler::ERROR << "undefined rule "
-			<< token.getContent();
+			<< token.getSymbol();
 		return const_Rule_ptr();
 	}
 	else {
@@ -286,20 +560,26 @@ const_Rule_ptr Parser::getRule()
 const_Node_ptr Parser::getNode()
 {
 	// Look in parameter lists
+	Symbol name = token.getSymbol();
 	for (auto it = parameter_stack.rbegin(); it != parameter_stack.rend(); ++it)
-		for (const_Node_ptr node : *(*it))
-			if (node->getName() == token.getContent())
+		for (const Node_ptr &node : *(*it))
+			if (node->getSymbol() == name)
 				return node;
 
 	// Nothing found? Look in theory.
 	const Theory *theory = theory_stack.top();
-	Theory::const_iterator it = theory->get(token.getContent());
+	Theory::const_iterator it = theory->get(name);
 
 	if (it != theory->end()) {
+		if (frozen != Theory::npos && theory->position(it) >= frozen) {
+			conflict = true;
+			return undefined_node;
+		}
+
 		const_Node_ptr node = std::dynamic_pointer_cast<const Node>(*it);
 		if (!node) {
 			error_output << ParserErrorHandler::ERROR
-				<< "object " << token.getContent() << " isn't a node";
+				<< "object " << token.getSymbol() << " isn't a node";
 			return undefined_node;
 		}
 		return node;
@@ -307,7 +587,7 @@ const_Node_ptr Parser::getNode()
 
 	// Still nothing found? Then this is an error.
 	error_output << ParserErrorHandler::ERROR << "undeclared identifier "
-		<< token.getContent();
+		<< token.getSymbol();
 	return undefined_node;
 }
 
@@ -331,7 +611,7 @@ void Parser::report(const char *where, TypeException &ex)
 {
 	// only report if type was properly defined
 	if (!ex.type_undefined()) {
-		error_output << ParserErrorHandler::ERROR << ex.what() << " in " << where;
+		error_output << ParserErrorHandler::ERROR << ex << " in " << std::string(where);
 	}
 }
 
@@ -360,7 +640,10 @@ const_Expr_ptr Parser::parseType()
 			type = BuiltInType::statement;
 		else {
 			const_Node_ptr node = getNode();
-			type = std::make_shared<AtomicExpr>(node);
+			if (factory)
+				type = factory->makeAtomic(std::move(node));
+			else
+				type = make<AtomicExpr>(std::move(node));
 		}
 
 		nextToken();
@@ -423,7 +706,7 @@ const_Expr_ptr Parser::parseLambdaType()
 
 	// Build type
 	try {
-		return std::make_shared<LambdaType>(std::move(argument_types), return_type);
+		return make<LambdaType>(std::move(argument_types), std::move(return_type));
 	}
 	catch (TypeException &ex) {
 		report("lambda type", ex);
@@ -434,7 +717,7 @@ const_Expr_ptr Parser::parseLambdaType()
 /**
  * Dispatch table for expressions.
  */
-const std::map<std::string, Expr_ptr (Parser::*)()> Parser::expr_dispatch = {
+const std::unordered_map<Symbol, Expr_ptr (Parser::*)()> Parser::expr_dispatch = {
 	{"not", (&Parser::parseNegationExpr)},
 	{"and", (&Parser::parseConnectiveExpr)},
 	{"or", (&Parser::parseConnectiveExpr)},
@@ -463,7 +746,7 @@ Expr_ptr Parser::parseExpression()
 
 		if (expect(LispToken::WORD)) {
 			// Dispatch
-			auto parse_function = expr_dispatch.find(token.getContent());
+			auto parse_function = expr_dispatch.find(token.getSymbol());
 			if (parse_function != expr_dispatch.end())
 				expr = (this->*(parse_function->second))();
 			else
@@ -498,7 +781,9 @@ Expr_ptr Parser::parseAtomicExpr()
 {
 	const_Node_ptr node = getNode();
 	nextToken();
-	return std::make_shared<AtomicExpr>(node);
+	if (factory)
+		return factory->makeAtomic(std::move(node));
+	return make<AtomicExpr>(std::move(node));
 }
 
 /**
@@ -525,7 +810,9 @@ Expr_ptr Parser::parseLambdaCallExpr()
 
 	// build expression
 	try {
-		return std::make_shared<LambdaCallExpr>(lambda_node, std::move(args));
+		if (factory)
+			return factory->makeLambdaCall(std::move(lambda_node), std::move(args));
+		return make<LambdaCallExpr>(std::move(lambda_node), std::move(args));
 	}
 	catch (TypeException &ex) {
 		report("lambda call", ex);
@@ -553,7 +840,9 @@ Expr_ptr Parser::parseNegationExpr()
 		recover();
 
 	try {
-		return std::make_shared<NegationExpr>(expr);
+		if (factory)
+			return factory->makeNegation(std::move(expr));
+		return make<NegationExpr>(std::move(expr));
 	}
 	catch (TypeException &ex) {
 		report("negation expression", ex);
@@ -564,7 +853,7 @@ Expr_ptr Parser::parseNegationExpr()
 /**
  * Dispatch table for connective expressions.
  */
-const std::map<std::string, ConnectiveExpr::Variant> Parser::connective_dispatch = {
+const std::unordered_map<Symbol, ConnectiveExpr::Variant> Parser::connective_dispatch = {
 	{"and", ConnectiveExpr::AND},
 	{"or", ConnectiveExpr::OR},
 	{"impl", ConnectiveExpr::IMPL},
@@ -581,7 +870,7 @@ const std::map<std::string, ConnectiveExpr::Variant> Parser::connective_dispatch
 Expr_ptr Parser::parseConnectiveExpr()
 {
 	// Which kind of connective?
-	auto connective = connective_dispatch.find(token.getContent());
+	auto connective = connective_dispatch.find(token.getSymbol());
 	// By precondition, we have connective != connective_dispatch.end()
 	nextToken();
 
@@ -598,7 +887,9 @@ Expr_ptr Parser::parseConnectiveExpr()
 
 	// Build connective
 	try {
-		return std::make_shared<ConnectiveExpr>(connective->second, expr1, expr2);
+		if (factory)
+			return factory->makeConnective(connective->second, std::move(expr1), std::move(expr2));
+		return make<ConnectiveExpr>(connective->second, std::move(expr1), std::move(expr2));
 	}
 	catch (TypeException &ex) {
 		report("connective expression", ex);
@@ -634,7 +925,9 @@ Expr_ptr Parser::parseQuantifierExpr()
 
 	// Build expression
 	try {
-		return std::make_shared<QuantifierExpr>(variant, expr);
+		if (factory)
+			return factory->makeQuantifier(variant, std::move(expr));
+		return make<QuantifierExpr>(variant, std::move(expr));
 	}
 	catch (TypeException &ex) {
 		report("quantifier expression", ex);
@@ -670,14 +963,16 @@ Expr_ptr Parser::parseLambda()
 		recover();
 
 	// build
-	return std::make_shared<LambdaExpr>(std::move(params), expr);
+	if (factory)
+		return factory->makeLambda(std::move(params), std::move(expr));
+	return make<LambdaExpr>(std::move(params), std::move(expr));
 }
 
 /**
  * Dispatch table for nodes.
  */
 typedef void (Parser::*ObjectParser)();
-const std::map<std::string, ObjectParser> Parser::object_dispatch = {
+const std::unordered_map<Symbol, ObjectParser> Parser::object_dispatch = {
 	{"axiom", &Parser::parseStatement},
 	{"lemma", &Parser::parseStatement},
 	{"tautology", &Parser::parseTautology},
@@ -694,19 +989,23 @@ const std::map<std::string, ObjectParser> Parser::object_dispatch = {
  */
 void Parser::parseObject()
 {
+	LOGIC_PROFILE_SCOPE(scope, Profile::FORM, Symbol());
+	last_object = nullptr;
+
 	// parse (
 	if (!expect(LispToken::OPENING))
 		return;
 	nextToken();
 
 	// Dispatch
-	std::map<std::string, ObjectParser>::const_iterator parse_function;
+	std::unordered_map<Symbol, ObjectParser>::const_iterator parse_function;
 	if (token.getType() == LispToken::WORD &&
-		(parse_function = object_dispatch.find(token.getContent()))
+		(parse_function = object_dispatch.find(token.getSymbol()))
 			!= object_dispatch.end())
 		(this->*(parse_function->second))();
 	else    // it's a normal node
 		addObject(parseNode());
+	LOGIC_PROFILE_NAME(scope, Profile::describe(last_object));
 
 	// parse )
 	if (expect(LispToken::CLOSING))
@@ -731,14 +1030,14 @@ Node_ptr Parser::parseNode()
 	if (!expect(LispToken::WORD))
 		return undefined_node;
 
-	std::shared_ptr<Node> node = std::make_shared<Node>(type, token.getContent());
+	std::shared_ptr<Node> node = make<Node>(type, token.getSymbol());
 
 	// parse Definition, if there is one
 	nextToken();
 	if (token.getType() != LispToken::CLOSING) {
 		Expr_ptr def = parseExpression();
 		try {
-			node->setDefinition(def);
+			node->setDefinition(std::move(def));
 		}
 		catch (TypeException &ex) {
 			report("definition", ex);
@@ -802,7 +1101,7 @@ void Parser::parseTautology()
 		recover();
 		return;
 	}
-	std::string name = token.getContent();
+	Symbol name = token.getSymbol();
 	nextToken();
 
 	// parse parameters
@@ -816,8 +1115,7 @@ void Parser::parseTautology()
 
 	// build
 	try {
-		Object_ptr tautology = std::make_shared<Tautology>(name, std::move(params), expr);
-		addObject(tautology);
+		addObject(make<Tautology>(name, std::move(params), std::move(expr)));
 	}
 	catch (TypeException &ex) {
 		report("tautology", ex);
@@ -840,7 +1138,7 @@ void Parser::parseEquivalenceRule()
 		recover();
 		return;
 	}
-	std::string name = token.getContent();
+	Symbol name = token.getSymbol();
 	nextToken();
 
 	// parse parameters
@@ -856,8 +1154,8 @@ void Parser::parseEquivalenceRule()
 
 	// build
 	try {
-		Object_ptr node = std::make_shared<EquivalenceRule>(name, std::move(params), expr1, expr2);
-		addObject(node);
+		addObject(make<EquivalenceRule>(name, std::move(params),
+			std::move(expr1), std::move(expr2)));
 	}
 	catch (TypeException &ex) {
 		report("equivalence rule", ex);
@@ -880,7 +1178,7 @@ void Parser::parseDeductionRule()
 		recover();
 		return;
 	}
-	std::string name = token.getContent();
+	Symbol name = token.getSymbol();
 	nextToken();
 
 	// parse parameters
@@ -910,8 +1208,8 @@ void Parser::parseDeductionRule()
 
 	// build
 	try {
-		Object_ptr node = std::make_shared<DeductionRule>(name, std::move(params), premisses, conclusion);
-		addObject(node);
+		addObject(make<DeductionRule>(name, std::move(params),
+			std::move(premisses), std::move(conclusion)));
 	}
 	catch (TypeException &ex) {
 		report("deduction rule", ex);
@@ -932,18 +1230,19 @@ void Parser::parseStatement()
 	nextToken();
 
 	// Name
-	std::string name;
+	Symbol name("");
 	if (token.getType() == LispToken::WORD) {
-		name = token.getContent();
+		name = token.getSymbol();
 		nextToken();
 	}
 
 	// Parse expression and build statement
 	Expr_ptr expr = parseExpression();
 	Statement_ptr stmt;
+	Theory::iterator it;
 	try {
-		stmt = std::make_shared<Statement>(name, expr);
-		addObject(stmt);
+		stmt = make<Statement>(name, expr);
+		it = addObject(stmt);
 	}
 	catch (TypeException &ex) {
 		report(expect_proof ? "lemma" : "axiom", ex);
@@ -951,20 +1250,27 @@ void Parser::parseStatement()
 
 	// Parse proof
 	if (expect_proof) {
-		Proof_ptr proof = parseProofStep();
-		if (stmt && proof)
+		Proof_ptr proof = (lazy && stmt && !verifier && token.getType() == LispToken::OPENING)
+			? skipProof(it, expr) : parseProofStep(stmt ? expr : Expr_ptr());
+		if (stmt && proof) {
 			stmt->addProof(proof);
+			if (verifier)
+				verifier->push(stmt, it);
+		}
 	}
 }
 
 /**
- * Parse a ProofStep.
+ * Parse a ProofStep. Without arguments, they are inferred from the
+ * references and the statement.
  *
+ * @param statement Statement proven by the proof step, or nullptr if it
+ *      couldn't be built.
  * @return Pointer to proof
  * @pre The current token is the beginning of a proof step.
  * @post The current token is the token right after the closing paranthesis.
  */
-Proof_ptr Parser::parseProofStep()
+Proof_ptr Parser::parseProofStep(const_Expr_ptr statement)
 {
 	// parse '('
 	if (!expect(LispToken::OPENING))
@@ -1020,8 +1326,37 @@ Proof_ptr Parser::parseProofStep()
 		return Proof_ptr();
 	}
 
+	const std::vector<Node_ptr> &params = rule->getParams();
+	if (var_list.empty() && !params.empty()) {
+		if (!statement)
+			return Proof_ptr();
+
+		// Inference looks at the referenced statements. When parsing in
+		// parallel, those at frozen positions might not be there yet.
+		if (frozen != Theory::npos)
+			for (const Reference &ref : references)
+				if (ref.getTheory() && ref.getIterator() != ref.getTheory()->end()
+						&& ref.getTheory()->position(ref.getIterator()) >= frozen) {
+					conflict = true;
+					return Proof_ptr();
+				}
+
+		Context context;
+		if (!rule->infer(references, statement, context)) {
+			error_output << ParserErrorHandler::ERROR
+				<< "can't infer arguments of rule " << rule->getSymbol();
+			return Proof_ptr();
+		}
+		return make<ProofStep>(rule, std::move(context), std::move(references));
+	}
+	if (var_list.size() != params.size()) {
+		error_output << ParserErrorHandler::ERROR << "rule " << rule->getSymbol()
+			<< " expects " << params.size() << " arguments, got " << var_list.size();
+		return Proof_ptr();
+	}
+
 	try {
-		return std::make_shared<ProofStep>(rule, var_list,
+		return make<ProofStep>(std::move(rule), std::move(var_list),
 			std::move(references));
 	}
 	catch (TypeException &ex) {
@@ -1030,6 +1365,56 @@ Proof_ptr Parser::parseProofStep()
 	}
 }
 
+/**
+ * Skip a proof, keeping its text for later.
+ *
+ * @param it Iterator to the statement.
+ * @param statement Statement proven by the proof.
+ * @return Lazy proof, or an empty pointer if the input ended.
+ * @pre The current token is the opening paranthesis of the proof.
+ * @post The current token is the token right after the proof.
+ */
+Proof_ptr Parser::skipProof(Theory::iterator it, const_Expr_ptr statement)
+{
+	std::string text(1, '(');
+	int line, column;
+	bool complete = lexer.skipForm(&text, &line, &column);
+	nextToken();
+	if (!complete)
+		return Proof_ptr();
+
+	return std::make_shared<LazyProof>(std::move(text), theory_stack.top()->getAnchor(),
+		it, statement, rules, error_output.getDescriptor(), line, column);
+}
+
+/**
+ * Parse the proof of a statement that was skipped before.
+ *
+ * @param theory Theory containing the statement.
+ * @param it Iterator to the statement.
+ * @param statement Statement proven by the proof.
+ * @return Proof, or an empty pointer if there were errors.
+ * @pre The parser is at the beginning of the proof.
+ */
+Proof_ptr Parser::parseProof(Theory *theory, Theory::iterator it, const_Expr_ptr statement)
+{
+	theory_stack.push(theory);
+	iterator_stack.push(it);
+
+	// Like the first time, we mustn't look at what comes after the statement.
+	frozen = theory->position(it);
+	Proof_ptr proof = parseProofStep(statement);
+	if (conflict) {
+		error_output << ParserErrorHandler::ERROR
+			<< "proof refers to objects after the statement";
+		proof.reset();
+	}
+
+	iterator_stack.pop();
+	theory_stack.pop();
+	return getErrors() ? Proof_ptr() : proof;
+}
+
 /**
  * Parse a Reference.
  *
@@ -1040,7 +1425,11 @@ Proof_ptr Parser::parseProofStep()
 Reference Parser::parseReference()
 {
 	if (expect(LispToken::WORD)) {
-		Reference ref(theory_stack.top(), iterator_stack.top(), token.getContent());
+		const Theory *theory = theory_stack.top();
+		Reference ref(theory, iterator_stack.top(), token.getContent());
+		if (frozen != Theory::npos && ref.getIterator() != theory->end()
+				&& theory->position(ref.getIterator()) > theory->position(iterator_stack.top()))
+			conflict = true;
 		nextToken();
 		return ref;
 	}
@@ -1068,7 +1457,18 @@ Theory Parser::parseTheory(bool standalone)
 	}
 
 	Theory theory(parent, default_it);
+	theory.arena = arena;
+	parseObjects(theory);
+	return theory;
+}
 
+/**
+ * Parse objects until the end of the input or a closing paranthesis.
+ *
+ * @param theory Theory to add them to.
+ */
+void Parser::parseObjects(Theory &theory)
+{
 	theory_stack.push(&theory);
 	iterator_stack.push(theory.begin());
 
@@ -1078,15 +1478,231 @@ Theory Parser::parseTheory(bool standalone)
 
 	iterator_stack.pop();
 	theory_stack.pop();
+}
+
+/**
+ * Parse a Theory, where runs of statements are parsed in parallel.
+ *
+ * The input is split into top-level forms. Everything else is parsed in
+ * order, but the places of statements in between are reserved with their
+ * names, and the statements are then parsed concurrently. Every parser
+ * records its diagnostics, and they are merged in the order of the input.
+ * This gives the same result and messages as parseTheory(), unless a
+ * statement looks at one of the statements parsed together with it (also by
+ * inferring the arguments of a proof step from them), an error leaves a form
+ * unfinished or a statement couldn't be built. Then we start over in serial.
+ *
+ * Only parsers reading from a buffer without a verifier parse in parallel.
+ *
+ * @param num_threads Number of threads to use, or 0 for the number of cores.
+ * @return Theory object.
+ * @pre The parser is at the beginning of the buffer.
+ * @post The parser is at the end of the buffer.
+ */
+Theory Parser::parseTheoryParallel(unsigned num_threads)
+{
+	Theory theory;
+	theory.arena = arena;
+	if (lazy)
+		theory.getAnchor();
+
+	std::vector<Form> forms;
+	if (!buffer_begin || verifier || theory_stack.size()
+			|| !splitForms(buffer_begin, buffer_end, &forms)
+			|| !parseForms(theory, forms, num_threads)) {
+		theory.clear();
+		parseObjects(theory);
+	}
+	else
+		token = LispToken(LispToken::ENDOFFILE);
 
 	return theory;
 }
 
+/**
+ * Split a buffer into top-level forms, skipping whitespace and comments.
+ * The characters are classified in blocks by a ScanIndex first.
+ *
+ * @param begin Beginning of the buffer.
+ * @param end End of the buffer.
+ * @param forms Vector to append the forms to.
+ * @return False, if something else than forms is on the top level, or the
+ *      parantheses aren't balanced.
+ */
+bool Parser::splitForms(const char *begin, const char *end, std::vector<Form> *forms)
+{
+	ScanIndex index(begin, end);
+	std::vector<std::pair<std::size_t, std::size_t>> bounds;
+	if (!index.findForms(&bounds))
+		return false;
+
+	int line = 1;
+	std::size_t line_offset = 0;
+	forms->reserve(forms->size() + bounds.size());
+	for (const auto &bound : bounds) {
+		line += index.countNewlines(line_offset, bound.first);
+		line_offset = bound.first;
+		forms->push_back(Form{begin + bound.first, begin + bound.second, false, Symbol(),
+			line, (int)(bound.first - index.lineBegin(bound.first))});
+	}
+	return true;
+}
+
+/**
+ * Parse top-level forms into a theory, statements in parallel.
+ *
+ * @param theory Empty theory to add the objects to.
+ * @param forms Forms in the buffer.
+ * @param num_threads Number of threads to use, or 0 for the number of cores.
+ * @return True, if everything was parsed as it would have been in serial.
+ */
+bool Parser::parseForms(Theory &theory, std::vector<Form> &forms, unsigned num_threads)
+{
+	// Find statements and their names, as parseStatement() does.
+	for (Form &form : forms) {
+		Lexer lexer(form.begin, form.end);
+		lexer.getToken();
+		LispToken head = lexer.getToken();
+		if (head.getType() != LispToken::WORD)
+			continue;
+
+		auto parse_function = object_dispatch.find(head.getSymbol());
+		form.statement = parse_function != object_dispatch.end()
+			&& parse_function->second == &Parser::parseStatement;
+		if (form.statement) {
+			LispToken name = lexer.getToken();
+			form.name = (name.getType() == LispToken::WORD) ? name.getSymbol() : Symbol("");
+		}
+	}
+
+	// Parse the forms [first, last) with a new parser. Statements are
+	// stored in the places starting at slot, everything else is added
+	// after *after. The diagnostics of every parser are collected, and
+	// merged when everything is done. The parser sees the paranthesis
+	// starting the next form, so that the last token is the same as in
+	// serial, and so are the positions of errors there.
+	Diagnostics diagnostics;
+	auto parse = [this, &theory, &forms, &diagnostics]
+		(std::size_t first, std::size_t last, Theory::iterator *after,
+		 const Theory::iterator *slot, std::size_t frozen) -> bool
+	{
+		const char *end = last < forms.size() ? forms[last].begin + 1 : buffer_end;
+		std::ostream null(nullptr);
+		Parser parser(forms[first].begin, end, null,
+			error_output.getDescriptor(), forms[first].line, forms[first].column);
+		parser.rules = rules;
+		parser.factory = factory;
+		parser.lazy = lazy;
+		if (arena)
+			parser.arena = after ? arena : std::make_shared<Arena>();
+		parser.frozen = frozen;
+		parser.theory_stack.push(&theory);
+		parser.iterator_stack.push(after ? *after : *slot);
+
+		try {
+			for (std::size_t i = first; i < last; ++i) {
+				if (slot) {
+					parser.iterator_stack.top() = slot[i - first];
+					parser.reserved = true;
+				}
+				parser.parseObject();
+				if (parser.reserved)
+					return false;
+
+				// After errors, the parser might not have stopped at the
+				// end of the form. The lexer is one character after the
+				// paranthesis starting the next form, or at the end.
+				if (parser.token.getType() != (i + 1 < forms.size()
+							? LispToken::OPENING : LispToken::ENDOFFILE)
+						|| parser.lexer.getPosition() != (i + 1 < last
+							? forms[i + 1].begin + 2 : end))
+					return false;
+			}
+		}
+		catch (std::exception &) {
+			return false;
+		}
+
+		if (after)
+			*after = parser.iterator_stack.top();
+		diagnostics.add(parser.error_output.take());
+		return !parser.conflict;
+	};
+
+	const std::size_t chunk_size = 64;
+	WorkStealingScheduler scheduler(num_threads, 1);
+	Theory::iterator last = theory.begin();
+	std::size_t i = 0;
+	while (i < forms.size()) {
+		// Everything but statements in order.
+		std::size_t j = i;
+		while (j < forms.size() && !forms[j].statement)
+			++j;
+		if (j > i && !parse(i, j, &last, nullptr, Theory::npos))
+			return false;
+
+		// Reserve places for the following statements, then parse them.
+		i = j;
+		while (j < forms.size() && forms[j].statement)
+			++j;
+		if (j == i)
+			continue;
+
+		std::size_t frozen = theory.size();
+		std::vector<Theory::iterator> slots;
+		try {
+			for (std::size_t k = i; k < j; ++k)
+				slots.push_back(last = theory.reserve(forms[k].name, last));
+		}
+		catch (NamespaceException &) {
+			return false;
+		}
+
+		std::size_t num_chunks = (j - i + chunk_size - 1) / chunk_size;
+		std::vector<char> valid(num_chunks);
+		scheduler.parallelFor(num_chunks, [&] (std::size_t chunk) {
+			std::size_t first = i + chunk * chunk_size;
+			std::size_t end = std::min(first + chunk_size, j);
+			valid[chunk] = parse(first, end, nullptr, &slots[first - i], frozen);
+		});
+		for (char chunk_valid : valid)
+			if (!chunk_valid)
+				return false;
+
+		i = j;
+	}
+
+	error_output.append(diagnostics.merge());
+	return true;
+}
+
 
 //////////////////////////////////
 // Implementation of the Writer //
 //////////////////////////////////
 
+// Keywords, interned only once
+static const Symbol type_keyword("type");
+static const Symbol statement_keyword("statement");
+static const Symbol rule_keyword("rule");
+static const Symbol undefined_keyword("undefined");
+static const Symbol lambda_type_keyword("lambda-type");
+static const Symbol list_keyword("list");
+static const Symbol lambda_keyword("lambda");
+static const Symbol not_keyword("not");
+static const Symbol and_keyword("and");
+static const Symbol or_keyword("or");
+static const Symbol impl_keyword("impl");
+static const Symbol equiv_keyword("equiv");
+static const Symbol exists_keyword("exists");
+static const Symbol forall_keyword("forall");
+static const Symbol tautology_keyword("tautology");
+static const Symbol equivrule_keyword("equivrule");
+static const Symbol deductionrule_keyword("deductionrule");
+static const Symbol lemma_keyword("lemma");
+static const Symbol axiom_keyword("axiom");
+
+
 /**
  * Construct Lisp Writer.
  *
@@ -1096,13 +1712,15 @@ Theory Parser::parseTheory(bool standalone)
  * @param tabs Indent with tabs?
  */
 Writer::Writer(std::ostream &output, int line_length, int tab_size, bool tabs)
-	: output(output), depth(0), max_line_length(line_length), line_length(0),
-	  tab_size(tab_size), tabs(tabs), write_depth(0) {}
+	: output(output), batch_depth(0), front(0), popped(0), depth(0),
+	  max_line_length(line_length), line_length(0), tab_size(tab_size), tabs(tabs),
+	  write_depth(0) {}
 
 Writer::~Writer()
 {
 	// flush buffer?
 	writeQueue();
+	flush();
 
 	// We shouldn't throw an exception here, nevertheless check depth.
 	if (depth != 0)
@@ -1113,16 +1731,16 @@ void Writer::visit(const BuiltInType *type)
 {
 	switch (type->variant) {
 	case BuiltInType::TYPE:
-		addToken("type");
+		addToken(type_keyword);
 		break;
 	case BuiltInType::STATEMENT:
-		addToken("statement");
+		addToken(statement_keyword);
 		break;
 	case BuiltInType::RULE:
-		addToken("rule");
+		addToken(rule_keyword);
 		break;
 	default:
-		addToken("undefined");
+		addToken(undefined_keyword);
 		break;
 	}
 }
@@ -1130,12 +1748,12 @@ void Writer::visit(const BuiltInType *type)
 void Writer::visit(const LambdaType *type)
 {
 	addParanthesis(OPENING);
-	addToken("lambda-type");
-	type->getReturnType()->accept(this);
+	addToken(lambda_type_keyword);
+	dispatchVisit(this, type->getReturnType().get());
 	addParanthesis(OPENING);
-	addToken("list");
-	for (const_Expr_ptr arg_type : *type)
-		arg_type->accept(this);
+	addToken(list_keyword);
+	for (const const_Expr_ptr &arg_type : *type)
+		dispatchVisit(this, arg_type.get());
 	addParanthesis(CLOSING);
 	addParanthesis(CLOSING);
 }
@@ -1143,41 +1761,41 @@ void Writer::visit(const LambdaType *type)
 void Writer::visit(const Node *node)
 {
 	addParanthesis(OPENING);
-	node->getType()->accept(this);
-	addToken(node->getName());
+	dispatchVisit(this, node->getType().get());
+	addToken(node->getSymbol());
 	if (const_Expr_ptr expr = node->getDefinition())
-		expr->accept(this);
+		dispatchVisit(this, expr.get());
 	addParanthesis(CLOSING);
 }
 
 void Writer::visit(const LambdaExpr *expression)
 {
 	addParanthesis(OPENING);
-	addToken("lambda");
+	addToken(lambda_keyword);
 	writeNodeList(expression->getParams());
-	expression->getDefinition()->accept(this);
+	dispatchVisit(this, expression->getDefinition().get());
 	addParanthesis(CLOSING);
 }
 
 void Writer::visit(const AtomicExpr *expression)
 {
-	addToken(expression->getAtom()->getName());
+	addToken(expression->getAtom()->getSymbol());
 }
 
 void Writer::visit(const LambdaCallExpr *expression)
 {
 	addParanthesis(OPENING);
-	addToken(expression->getLambda()->getName());
-	for (auto arg : *expression)
-		arg->accept(this);
+	addToken(expression->getLambda()->getSymbol());
+	for (const Expr_ptr &arg : *expression)
+		dispatchVisit(this, arg.get());
 	addParanthesis(CLOSING);
 }
 
 void Writer::visit(const NegationExpr *expression)
 {
 	addParanthesis(OPENING);
-	addToken("not");
-	expression->getExpr()->accept(this);
+	addToken(not_keyword);
+	dispatchVisit(this, expression->getExpr().get());
 	addParanthesis(CLOSING);
 }
 
@@ -1186,20 +1804,20 @@ void Writer::visit(const ConnectiveExpr *expression)
 	addParanthesis(OPENING);
 	switch (expression->getVariant()) {
 		case ConnectiveExpr::AND:
-			addToken("and");
+			addToken(and_keyword);
 			break;
 		case ConnectiveExpr::OR:
-			addToken("or");
+			addToken(or_keyword);
 			break;
 		case ConnectiveExpr::IMPL:
-			addToken("impl");
+			addToken(impl_keyword);
 			break;
 		case ConnectiveExpr::EQUIV:
-			addToken("equiv");
+			addToken(equiv_keyword);
 			break;
 	}
-	expression->getFirstExpr()->accept(this);
-	expression->getSecondExpr()->accept(this);
+	dispatchVisit(this, expression->getFirstExpr().get());
+	dispatchVisit(this, expression->getSecondExpr().get());
 	addParanthesis(CLOSING);
 }
 
@@ -1208,21 +1826,21 @@ void Writer::visit(const QuantifierExpr *expression)
 	addParanthesis(OPENING);
 	switch (expression->getVariant()) {
 	case QuantifierExpr::EXISTS:
-		addToken("exists");
+		addToken(exists_keyword);
 		break;
 	case QuantifierExpr::FORALL:
-		addToken("forall");
+		addToken(forall_keyword);
 		break;
 	}
-	expression->getPredicate()->accept(this);
+	dispatchVisit(this, expression->getPredicate().get());
 	addParanthesis(CLOSING);
 }
 
 void Writer::writeNodeList(const std::vector<Node_ptr> &nodes)
 {
 	addParanthesis(OPENING);
-	addToken("list");
-	for (const_Node_ptr node : nodes)
+	addToken(list_keyword);
+	for (const Node_ptr &node : nodes)
 		node->accept(this);
 	addParanthesis(CLOSING);
 }
@@ -1230,36 +1848,36 @@ void Writer::writeNodeList(const std::vector<Node_ptr> &nodes)
 void Writer::visit(const Tautology *rule)
 {
 	addParanthesis(OPENING);
-	addToken("tautology");
-	addToken(rule->getName());
+	addToken(tautology_keyword);
+	addToken(rule->getSymbol());
 	writeNodeList(rule->getParams());
-	rule->getStatement()->accept(this);
+	dispatchVisit(this, rule->getStatement().get());
 	addParanthesis(CLOSING);
 }
 
 void Writer::visit(const EquivalenceRule *rule)
 {
 	addParanthesis(OPENING);
-	addToken("equivrule");
-	addToken(rule->getName());
+	addToken(equivrule_keyword);
+	addToken(rule->getSymbol());
 	writeNodeList(rule->getParams());
-	rule->getStatement1()->accept(this);
-	rule->getStatement2()->accept(this);
+	dispatchVisit(this, rule->getStatement1().get());
+	dispatchVisit(this, rule->getStatement2().get());
 	addParanthesis(CLOSING);
 }
 
 void Writer::visit(const DeductionRule *rule)
 {
 	addParanthesis(OPENING);
-	addToken("deductionrule");
-	addToken(rule->getName());
+	addToken(deductionrule_keyword);
+	addToken(rule->getSymbol());
 	writeNodeList(rule->getParams());
 	addParanthesis(OPENING);
-	addToken("list");
-	for (const_Expr_ptr expr : rule->getPremisses())
-		expr->accept(this);
+	addToken(list_keyword);
+	for (const const_Expr_ptr &expr : rule->getPremisses())
+		dispatchVisit(this, expr.get());
 	addParanthesis(CLOSING);
-	rule->getConclusion()->accept(this);
+	dispatchVisit(this, rule->getConclusion().get());
 	addParanthesis(CLOSING);
 }
 
@@ -1267,10 +1885,10 @@ void Writer::visit(const Statement *statement)
 {
 	addParanthesis(OPENING);
 	if (statement->hasProof())
-		addToken("lemma");
+		addToken(lemma_keyword);
 	else
-		addToken("axiom");
-	statement->getDefinition()->accept(this);
+		addToken(axiom_keyword);
+	dispatchVisit(this, statement->getDefinition().get());
 	if (statement->hasProof())
 		statement->getProof()->accept(this);
 	addParanthesis(CLOSING);
@@ -1278,20 +1896,21 @@ void Writer::visit(const Statement *statement)
 
 void Writer::visit(const Reference *reference)
 {
-	addToken(reference->getDescription(theory_stack.top(), iterator_stack.top()));
+	addToken(Symbol(reference->getDescription(theory_stack.top(), iterator_stack.top())));
 }
 
 void Writer::visit(const ProofStep *proofstep)
 {
 	addParanthesis(OPENING);
-	addToken(proofstep->getRule()->getName());
+	addToken(proofstep->getRule()->getSymbol());
 	addParanthesis(OPENING);
-	addToken("list");
-	for (const_Node_ptr node : proofstep->getRule()->getParams())
-		(*proofstep)[node]->accept(this);
+	addToken(list_keyword);
+	if (!proofstep->isInferred())
+		for (const Node_ptr &node : proofstep->getRule()->getParams())
+			dispatchVisit(this, (*proofstep)[node].get());
 	addParanthesis(CLOSING);
 	addParanthesis(OPENING);
-	addToken("list");
+	addToken(list_keyword);
 	for (const Reference &ref : proofstep->getReferences())
 		ref.accept(this);
 	addParanthesis(CLOSING);
@@ -1300,7 +1919,9 @@ void Writer::visit(const ProofStep *proofstep)
 
 void Writer::visit(const Theory *theory)
 {
+	// Objects of a theory are given to the stream in large chunks.
 	theory_stack.push(theory);
+	++batch_depth;
 
 	for (Theory::const_iterator it = theory->begin(); it != theory->end(); ++it) {
 		iterator_stack.push(it);
@@ -1308,7 +1929,10 @@ void Writer::visit(const Theory *theory)
 		iterator_stack.pop();
 	}
 
+	--batch_depth;
 	theory_stack.pop();
+	if (!batch_depth)
+		flush();
 }
 
 /**
@@ -1320,53 +1944,71 @@ void Writer::addParanthesis(Change depth_change)
 {
 	depth += (int)depth_change;
 
+	static const std::string opening = "(", closing = ")";
 	if (depth_change == OPENING)
-		push(LispToken(LispToken::OPENING));
+		push(LispToken::OPENING, 1, &opening);
 	else	// CLOSING
-		push(LispToken(LispToken::CLOSING));
+		push(LispToken::CLOSING, 1, &closing);
 
-	// If we are at level 0 or have enough material, write something.
-	if (depth == 0 || line_length > 2*max_line_length)
+	// If we are at level 0 or have enough material, write something. Don't
+	// compute 2*max_line_length, which overflows for "unlimited" lengths.
+	if (depth == 0 || line_length - max_line_length > max_line_length)
 		writeQueue();
+
+	// Give complete objects to the stream, unless we write a theory.
+	if (depth == 0 && (!batch_depth || buffer.size() >= (1 << 16)))
+		flush();
 }
 
 /**
- * Add a token string.
+ * Add a word token. Its string is interned, so we don't have to copy it.
  *
  * @param token Token string.
  */
-void Writer::addToken(const std::string &token)
+void Writer::addToken(Symbol token)
 {
-	push(LispToken(token));
+	const std::string &text = token.str();
+	push(LispToken::WORD, text.length(), &text);
 }
 
 /**
- * Add a token string we can eat up.
+ * Push a token, called by addToken and addParanthesis.
  *
- * @param token Rvalue reference to token.
+ * @param type Type of the token.
+ * @param length Number of characters.
+ * @param text Characters of the token, must stay alive while it is queued.
  */
-void Writer::addToken(std::string &&token)
+void Writer::push(LispToken::Type type, int length, const std::string *text)
 {
-	push(LispToken(std::move(token)));
-}
+	// The length of the preceding token is known now, see tokenLength.
+	std::size_t size = token_queue.size() - front;
+	long long offset = 0;
+	if (size) {
+		const Token &last = token_queue.back();
+		offset = last.offset + last.length +
+			(last.type != LispToken::OPENING && type != LispToken::CLOSING);
+	}
+
+	// Match parantheses, so we know the length of groups.
+	std::size_t number = popped + size;
+	if (type == LispToken::OPENING)
+		open.push_back(number);
+	else if (type == LispToken::CLOSING && !open.empty()) {
+		if (open.back() >= popped)
+			token_queue[front + open.back() - popped].match = number;
+		open.pop_back();
+	}
 
-/**
- * Push a LispToken, called by addToken and addParanthesis.
- *
- * @param token Rvalue reference to a LispToken
- */
-void Writer::push(LispToken &&token)
-{
 	// Add token to queue
-	token_queue.push_back(std::move(token));
+	token_queue.push_back(Token{type, length, text, offset, std::size_t(-1)});
 
 	// Add length of preceding token. This means we haven't accounted for the
 	// last item in queue. The last item will only be flushed if we go back to
 	// level 0, so this is a closing paranthesis.
 	// However, in writeLine we don't account for the last item as well, hence
 	// it won't hurt our character count.
-	if (token_queue.size() >= 2)
-		line_length += tokenLength(token_queue.size() - 2);
+	if (size)
+		line_length += offset - token_queue[token_queue.size() - 2].offset;
 }
 
 /**
@@ -1377,32 +2019,16 @@ void Writer::push(LispToken &&token)
  */
 void Writer::writeQueue()
 {
-	while ((depth == 0 && token_queue.size()) ||
+	while ((depth == 0 && front != token_queue.size()) ||
 			(depth != 0 && line_length > max_line_length)) {
-		LispToken token(token_queue.front());
-
-		// Current line length and index of next token
-		int length = tab_size * write_depth;
-		int index = 1;
-
-		switch (token.getType()) {
-		case LispToken::OPENING:
-			// Then count characters until ')'
-			for (int cur_depth = 1; cur_depth != 0 && length <= max_line_length; ++index) {
-				LispToken::Type type = token_queue[index].getType();
-				if (type == LispToken::OPENING)
-					cur_depth += 1;
-				else if (type == LispToken::CLOSING)
-					cur_depth -= 1;
-
-				length += tokenLength(index);
-			}
-
-			// Does it fit on the line? Then write.
+		switch (token_queue[front].type) {
+		case LispToken::OPENING: {
+			// Does the group up to ')' fit on the line? Then write.
+			long long length = tab_size * write_depth + groupLength(0);
 			if (length <= max_line_length)
-				writeLine(index);
+				writeLine(token_queue[front].match - popped + 1);
 			else {
-				writeLine(token_queue[1].getType() == LispToken::OPENING ? 1 : 2);
+				writeLine(token_queue[front + 1].type == LispToken::OPENING ? 1 : 2);
 
 				// The closing paranthesis will be on an extra line,
 				// hence we don't have to care about it. (*)
@@ -1411,6 +2037,7 @@ void Writer::writeQueue()
 			}
 
 			break;
+		}
 
 		// Closing paranthesis? Decrease depth, write it.
 		case LispToken::CLOSING:
@@ -1424,6 +2051,16 @@ void Writer::writeQueue()
 			break;
 		}
 	}
+
+	// Reuse the queue once it is empty or mostly written.
+	if (front == token_queue.size()) {
+		token_queue.clear();
+		front = 0;
+	}
+	else if (front > token_queue.size() / 2) {
+		token_queue.erase(token_queue.begin(), token_queue.begin() + front);
+		front = 0;
+	}
 }
 
 /**
@@ -1437,53 +2074,41 @@ void Writer::writeLine(int num_tokens)
 {
 	// Indent
 	if (tabs)
-		for (int indent = 0; indent < write_depth; ++indent)
-			output << '\t';
+		buffer.append(write_depth, '\t');
 	else
-		for (int indent = 0; indent < tab_size * write_depth; ++indent)
-			output << ' ';
+		buffer.append(tab_size * write_depth, ' ');
 
 	// Write tokens
 	while (num_tokens--) {
-		LispToken token(token_queue.front());
+		const Token &token = token_queue[front];
 
 		// Write token and compensate in line length
-		writeToken(token);
+		buffer.append(*token.text);
 		// We don't compensate for the last token in the queue, see push.
-		if (token_queue.size() > 1)
+		if (token_queue.size() - front > 1)
 			line_length -= tokenLength(0);
 
-		token_queue.pop_front();
+		++front;
+		++popped;
 
 		// Space after token if it isn't '(' and the next token isn't ')'.
 		// Also, no space after the last token in a line.
-		if (token.getType() != LispToken::OPENING && token_queue.size() &&
-				token_queue.front().getType() != LispToken::CLOSING && num_tokens > 1)
-			output << ' ';
+		if (token.type != LispToken::OPENING && front != token_queue.size() &&
+				token_queue[front].type != LispToken::CLOSING && num_tokens > 1)
+			buffer += ' ';
 	}
 
 	// New line
-	output << std::endl;
+	buffer += '\n';
 }
 
 /**
- * Write a single token.
- *
- * @param token Token to write
+ * Give the buffer to the stream.
  */
-void Writer::writeToken(LispToken token)
+void Writer::flush()
 {
-	switch (token.getType()) {
-	case LispToken::WORD:
-		output << token.getContent();
-		break;
-	case LispToken::OPENING:
-		output << '(';
-		break;
-	case LispToken::CLOSING:
-		output << ')';
-		break;
-	}
+	output.write(buffer.data(), buffer.size());
+	buffer.clear();
 }
 
 /**
@@ -1495,27 +2120,34 @@ void Writer::writeToken(LispToken token)
  * @param index Index of token in the queue
  * @return Length of token including a space after it.
  */
-int Writer::tokenLength(int index)
+int Writer::tokenLength(std::size_t index) const
 {
-	int length = 0;
-
-	switch (token_queue[index].getType()) {
-	case LispToken::WORD:
-		length += token_queue[index].getContent().length();
-		break;
-	case LispToken::OPENING:
-		length += 1;
-		break;
-	case LispToken::CLOSING:
-		length += 1;
-		break;
-	}
+	const Token &token = token_queue[front + index];
+
+	// Account for space after token. If there is no token after it yet, we
+	// count the space, so that the line doesn't get too long in any case.
+	if (token.type != LispToken::OPENING &&
+			(front + index + 1 == token_queue.size() ||
+			token_queue[front + index + 1].type != LispToken::CLOSING))
+		return token.length + 1;
+	else
+		return token.length;
+}
 
-	// Account for space after token.
-	// assert(token_queue.size() > index+1);
-	if (token_queue[index].getType() != LispToken::OPENING &&
-			token_queue[index+1].getType() != LispToken::CLOSING)
-		length += 1;
+/**
+ * Compute the length of a group in parantheses in the queue, without the
+ * opening paranthesis, as if it were written on a single line.
+ *
+ * @param index Index of the opening paranthesis in the queue.
+ * @return Length of the group, or more than any line if it is incomplete.
+ */
+long long Writer::groupLength(std::size_t index) const
+{
+	const Token &token = token_queue[front + index];
+	if (token.match == std::size_t(-1))
+		return std::numeric_limits<long long>::max() / 2;
 
-	return length;
+	std::size_t end = token.match - popped;
+	return token_queue[front + end].offset - token_queue[front + index + 1].offset
+		+ tokenLength(end);
 }
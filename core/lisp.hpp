@@ -21,10 +21,15 @@
 #define CORE_LISP_HPP
 #include "forward.hpp"
 #include "expression.hpp"
+#include "arena.hpp"
+#include "diagnostics.hpp"
+#include "symbol.hpp"
 #include <string>
 #include <stack>
 #include <deque>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 #include "debug.hpp"
 #include "traverse.hpp"
 
@@ -33,7 +38,8 @@
  */
 namespace Core {
 	/**
-	 * Lisp-syntax tokens.
+	 * Lisp-syntax tokens. Word tokens from the lexer are interned symbols,
+	 * other word tokens may own their content.
 	 */
 	class LispToken {
 	public:
@@ -43,31 +49,47 @@ namespace Core {
 			: type(WORD), content(content) {}
 		LispToken(std::string &&content)
 			: type(WORD), content(std::move(content)) {}
+		LispToken(Symbol symbol)
+			: type(WORD), symbol(symbol) {}
 
 		Type getType() const
 			{return type;}
 		const std::string& getContent() const;
+		Symbol getSymbol() const;
 
 	private:
 		Type type;
+		Symbol symbol;
 		std::string content;
 	};
 
 	/**
-	 * Lisp-syntax lexer class.
+	 * Lisp-syntax lexer class. It reads either from a stream or from a buffer
+	 * in memory. Words are interned as symbols.
 	 */
 	class Lexer {
 	public:
-		Lexer(std::istream &input);
+		Lexer(std::istream &input, std::size_t buffer_size = 1 << 16);
+		Lexer(const char *begin, const char *end, int line = 1, int column = 0);
 		LispToken getToken();
+		bool skipForm(std::string *text, int *line, int *column);
 		int getLine() const {return line_number;}
 		int getColumn() const {return column_number;}
+		// Position in the buffer after the last character read
+		const char *getPosition() const {return pos;}
 
 	private:
 		void nextChar();
+		void skipSpace();
 		void skipLine();
+		bool fill();
 
-		std::istream &input;
+		// Input stream, if we have one, and our buffer for it
+		std::istream *input;
+		std::vector<char> buffer;
+
+		// Rest of the current buffer
+		const char *pos, *end;
 
 		// State
 		int last;
@@ -76,34 +98,57 @@ namespace Core {
 	};
 
 	/**
-	 * Parser error-handling.
+	 * Parser error-handling. Errors, warnings and notes are recorded as
+	 * diagnostics, and written when the handler is flushed or destroyed.
 	 */
 	class ParserErrorHandler {
 	public:
 		// Problem level
-		enum Level {ERROR, WARNING, NOTE};
+		typedef Diagnostic::Level Level;
+		static const Level ERROR = Diagnostic::ERROR;
+		static const Level WARNING = Diagnostic::WARNING;
+		static const Level NOTE = Diagnostic::NOTE;
 
 		ParserErrorHandler(const Lexer &lexer, std::ostream &output, const std::string &descriptor);
 		~ParserErrorHandler();
 
-		// Formatting operators
+		// Formatting operators, adding to the last diagnostic
 		ParserErrorHandler& operator <<(Level level);
+		ParserErrorHandler& operator <<(Symbol symbol);
 		ParserErrorHandler& operator <<(const std::string &str);
+		ParserErrorHandler& operator <<(std::size_t number);
 		ParserErrorHandler& operator <<(LispToken::Type type);
 		ParserErrorHandler& operator <<(const_Expr_ptr type);
+		ParserErrorHandler& operator <<(const TypeException &ex);
+
+		/**
+		 * Add a string literal, which is written as it is later.
+		 *
+		 * @param text String literal.
+		 */
+		template <std::size_t N>
+		ParserErrorHandler& operator <<(const char (&text)[N])
+			{return addText(text);}
+
+		void flush();
+		void append(DiagnosticBuffer &&other);
+		DiagnosticBuffer take();
 
 		// Get statistics
-		int getErrors() const {return error_count;}
-		int getWarnings() const {return warning_count;}
+		int getErrors() const {return buffer.getErrors();}
+		int getWarnings() const {return buffer.getWarnings();}
+		const std::string &getDescriptor() const {return *descriptor;}
 
 	private:
+		ParserErrorHandler& addText(const char *text);
+
 		const Lexer &lexer;
-		std::string descriptor;
-		int error_count;
-		int warning_count;
+		std::shared_ptr<const std::string> descriptor;
+		DiagnosticBuffer buffer;
+		// Number of diagnostics already written
+		std::size_t written;
 
 		std::ostream &output;
-		TypeWriter writer;
 	};
 
 	/**
@@ -113,6 +158,8 @@ namespace Core {
 	public:
 		Parser(std::istream &input, std::ostream &output,
 			const std::string &descriptor);
+		Parser(const char *begin, const char *end, std::ostream &output,
+			const std::string &descriptor, int line = 1, int column = 0);
 
 		// Expression parsers
 		const_Expr_ptr parseType();
@@ -136,18 +183,51 @@ namespace Core {
 		void parseDeductionRule();
 
 		void parseStatement();
-		Proof_ptr parseProofStep();
+		Proof_ptr parseProofStep(const_Expr_ptr statement);
 		Reference parseReference();
+		Proof_ptr parseProof(Theory *theory, Theory::iterator it, const_Expr_ptr statement);
 		Theory parseTheory(bool standalone = false);
+		Theory parseTheoryParallel(unsigned num_threads = 0);
 
 		// Get statistics
 		int getErrors() const {return error_output.getErrors();}
 		int getWarnings() const {return error_output.getWarnings();}
 
+		// Write the messages found so far, otherwise they're written when
+		// the parser is destroyed.
+		void flushMessages() {error_output.flush();}
+
 		// For parsing proofs: pointer to a set of rules
 		const Theory *rules;
 
+		// Optional factory for interning expressions, may be null
+		ExpressionFactory *factory;
+
+		// Optional arena to allocate the parsed objects in
+		std::shared_ptr<Arena> arena;
+
+		// Optional verifier stage, gets statements as soon as they're parsed
+		StreamingVerifier *verifier;
+
+		// Skip proofs and parse them when they're needed, see LazyProof.
+		// Ignored if there is a verifier.
+		bool lazy;
+
 	private:
+		// A top-level form in the buffer, see parseTheoryParallel().
+		struct Form {
+			const char *begin, *end;
+			bool statement;
+			Symbol name;
+			// Position of the beginning, for Lexer
+			int line, column;
+		};
+
+		static bool splitForms(const char *begin, const char *end, std::vector<Form> *forms);
+		bool parseForms(Theory &theory, std::vector<Form> &forms, unsigned num_threads);
+		void parseObjects(Theory &theory);
+		Proof_ptr skipProof(Theory::iterator it, const_Expr_ptr statement);
+
 		void nextToken();
 		bool expect(LispToken::Type type);
 		Theory::iterator addObject(Object_ptr object);
@@ -156,6 +236,9 @@ namespace Core {
 		void recover();
 		void report(const char *where, TypeException &ex);
 
+		template <typename T, typename... Args>
+		std::shared_ptr<T> make(Args&&... args);
+
 		// Our lexer object
 		Lexer lexer;
 		// Where we write errors
@@ -164,15 +247,29 @@ namespace Core {
 		// The current token
 		LispToken token;
 
+		// The buffer we're reading from, if we don't read from a stream
+		const char *buffer_begin, *buffer_end;
+
+		// For parsing statements in parallel: objects at and after this
+		// position mustn't be looked at, addObject() stores to a reserved
+		// place, and conflict is set if the result might differ from serial
+		// parsing.
+		std::size_t frozen;
+		bool reserved;
+		bool conflict;
+
+		// Last object added, for profiling
+		const Object *last_object;
+
 		// Theory stack and parameter list stack (for lambdas and rules)
 		std::stack<Theory *> theory_stack;
 		std::stack<Theory::iterator> iterator_stack;
 		std::vector<const std::vector<Node_ptr>*> parameter_stack;
 
 		// Dispatch tables
-		static const std::map<std::string, void (Parser::*)()> object_dispatch;
-		static const std::map<std::string, Expr_ptr (Parser::*)()> expr_dispatch;
-		static const std::map<std::string, ConnectiveExpr::Variant> connective_dispatch;
+		static const std::unordered_map<Symbol, void (Parser::*)()> object_dispatch;
+		static const std::unordered_map<Symbol, Expr_ptr (Parser::*)()> expr_dispatch;
+		static const std::unordered_map<Symbol, ConnectiveExpr::Variant> connective_dispatch;
 
 		// Dummy objects to use in the case of errors
 		static const Node_ptr undefined_node;
@@ -208,20 +305,38 @@ namespace Core {
 	private:
 		enum Change {OPENING = +1, CLOSING = -1};
 
+		// A token in the queue. Words point to interned strings.
+		struct Token {
+			LispToken::Type type;
+			int length;
+			const std::string *text;
+			// Sum of tokenLength() of all tokens before this one
+			long long offset;
+			// For opening paranthesis: number of the closing one, if we had it
+			std::size_t match;
+		};
+
 		// Add tokens
 		void addParanthesis(Change depth_change);
-		void addToken(const std::string &token);
-		void addToken(std::string &&token);
-		void push(LispToken &&token);
+		void addToken(Symbol token);
+		void push(LispToken::Type type, int length, const std::string *text);
 
-		// Write to stream
+		// Write to buffer and stream
 		void writeQueue();
 		void writeLine(int num_tokens);
-		void writeToken(LispToken token);
-		int tokenLength(int index);
+		void flush();
+		int tokenLength(std::size_t index) const;
+		long long groupLength(std::size_t index) const;
 
 		std::ostream &output;
-		std::deque<LispToken> token_queue;
+		std::string buffer;
+		int batch_depth;
+
+		// Token queue: tokens [front, size) of the vector, and the number
+		// of tokens removed from the queue so far.
+		std::vector<Token> token_queue;
+		std::size_t front, popped;
+		std::vector<std::size_t> open;
 		int depth;
 
 		// For pretty printing
@@ -230,7 +345,6 @@ namespace Core {
 		int tab_size;
 		bool tabs;
 		int write_depth;
-		std::stack<int> length;
 
 		// Keeping track of where we are
 		std::stack<const Theory *> theory_stack;
@@ -24,6 +24,11 @@
 #include "debug.hpp"
 using namespace Core;
 
+namespace {
+	// Scratch space for substitution checks, one for each thread.
+	thread_local Substitution::State scratch;
+}
+
 /**
  * Validate the application of a Rule.
  *
@@ -35,7 +40,51 @@ using namespace Core;
 bool Rule::validate(const Context &context,
 	const std::vector<Reference> &statements, const_Expr_ptr statement) const
 {
-	return validate_pass(context, statements, statement);
+	return validate_pass(context, statements, statement, scratch);
+}
+
+/**
+ * Validate the application of a Rule with caller-provided scratch space.
+ *
+ * @param  context        Arguments for the parameters of the Expression.
+ * @param  statements     References to the statements needed.
+ * @param  statement      Statement that was deduced.
+ * @param  state          Scratch space for substitution checks.
+ * @return                True, if the statement can be deduced in this way.
+ */
+bool Rule::validate(const Context &context,
+	const std::vector<Reference> &statements, const_Expr_ptr statement,
+	Substitution::State &state) const
+{
+	return validate_pass(context, statements, statement, state);
+}
+
+/**
+ * Infer the arguments of a rule application, by matching the rule against
+ * the statements it is applied to and the statement deduced.
+ *
+ * @param  statements     References to the statements needed.
+ * @param  statement      Statement that was deduced.
+ * @param  context        Context to fill in with the arguments.
+ * @return                True, if all arguments could be inferred.
+ */
+bool Rule::infer(const std::vector<Reference> &statements, const_Expr_ptr statement,
+	Context &context) const
+{
+	// We can only match against statements.
+	for (const Reference &ref : statements)
+		if (!ref.getTheory() || ref.getIterator() == ref.getTheory()->end()
+				|| !dynamic_cast<const Statement *>((*ref).get()))
+			return false;
+
+	Matcher matcher(params);
+	std::vector<Matcher::Constraint> deferred;
+	if (!infer_pass(matcher, statements, statement, context, deferred)
+			|| !matcher.solve(deferred, context) || !deferred.empty())
+		return false;
+
+	return std::all_of(params.begin(), params.end(),
+		[&context] (const Node_ptr &param) -> bool {return context.count(param);});
 }
 
 /**
@@ -45,11 +94,12 @@ bool Rule::validate(const Context &context,
  * @param params Parameters of the rule.
  * @param statement Statement that is always true.
  */
-Tautology::Tautology(const std::string& name, std::vector<Node_ptr> &&params, Expr_ptr tautology)
-	: Rule(name, std::move(params)), subst(tautology)
+Tautology::Tautology(Symbol name, std::vector<Node_ptr> &&params, Expr_ptr tautology)
+	: Rule(name, std::move(params)), subst(std::move(tautology))
 {
-	if (tautology->getType() != BuiltInType::statement)
-		throw TypeException(tautology->getType(), BuiltInType::statement);
+	const const_Expr_ptr &type = subst.getExpr()->getType();
+	if (type != BuiltInType::statement)
+		throw TypeException(type, BuiltInType::statement);
 }
 
 /**
@@ -63,17 +113,26 @@ Object_ptr Tautology::clone() const
 }
 
 bool Tautology::validate_pass(const Context &context,
-	const std::vector<Reference> &statements, const_Expr_ptr statement) const
+	const std::vector<Reference> &statements, const_Expr_ptr statement,
+	Substitution::State &state) const
 {
 	// Check the number of references, it should be 0
 	if (statements.size() != 0)
 		return false;
 
 	// Check if the statement given is correct
-	bool result = subst.check(statement.get(), context);
+	bool result = subst.check(statement.get(), context, state);
 	return result;
 }
 
+bool Tautology::infer_pass(const Matcher &matcher,
+	const std::vector<Reference> &statements, const_Expr_ptr statement,
+	Context &context, std::vector<Matcher::Constraint> &deferred) const
+{
+	return statements.empty()
+		&& matcher.match(subst.getExpr(), statement, context, &deferred);
+}
+
 /**
  * Construct an equivalence rule: such a rule states that two statements are equivalent.
  *
@@ -82,14 +141,17 @@ bool Tautology::validate_pass(const Context &context,
  * @param statement1 First statement.
  * @param statement2 Second statement.
  */
-EquivalenceRule::EquivalenceRule(const std::string& name, std::vector<Node_ptr> &&params,
+EquivalenceRule::EquivalenceRule(Symbol name, std::vector<Node_ptr> &&params,
 	Expr_ptr statement1, Expr_ptr statement2)
-	: Rule(name, std::move(params)), subst1(statement1), subst2(statement2)
+	: Rule(name, std::move(params)), subst1(std::move(statement1)),
+	  subst2(std::move(statement2))
 {
-	if (statement1->getType() != BuiltInType::statement)
-		throw TypeException(statement1->getType(), BuiltInType::statement, "first statement");
-	if (statement2->getType() != BuiltInType::statement)
-		throw TypeException(statement2->getType(), BuiltInType::statement, "second statement");
+	const const_Expr_ptr &type1 = subst1.getExpr()->getType(),
+		&type2 = subst2.getExpr()->getType();
+	if (type1 != BuiltInType::statement)
+		throw TypeException(type1, BuiltInType::statement, "first statement");
+	if (type2 != BuiltInType::statement)
+		throw TypeException(type2, BuiltInType::statement, "second statement");
 }
 
 /**
@@ -103,7 +165,8 @@ Object_ptr EquivalenceRule::clone() const
 }
 
 bool EquivalenceRule::validate_pass(const Context &context,
-	const std::vector<Reference> &statements, const_Expr_ptr statement) const
+	const std::vector<Reference> &statements, const_Expr_ptr statement,
+	Substitution::State &state) const
 {
 	// Check if we are given one reference
 	if (statements.size() != 1)
@@ -115,13 +178,37 @@ bool EquivalenceRule::validate_pass(const Context &context,
 
 	// Try substitution both ways
 	bool result =
-		(subst1.check(alt_statement.get(), context)
-			&& subst2.check(statement.get(), context))
-		|| (subst1.check(statement.get(), context)
-			&& subst2.check(alt_statement.get(), context));
+		(subst1.check(alt_statement.get(), context, state)
+			&& subst2.check(statement.get(), context, state))
+		|| (subst1.check(statement.get(), context, state)
+			&& subst2.check(alt_statement.get(), context, state));
 	return result;
 }
 
+bool EquivalenceRule::infer_pass(const Matcher &matcher,
+	const std::vector<Reference> &statements, const_Expr_ptr statement,
+	Context &context, std::vector<Matcher::Constraint> &deferred) const
+{
+	if (statements.size() != 1)
+		return false;
+	const_Expr_ptr alt_statement =
+		std::static_pointer_cast<const Statement>(*statements[0])->getDefinition();
+
+	// Try both ways, like validate_pass.
+	Context forward(context);
+	std::vector<Matcher::Constraint> forward_deferred(deferred);
+	if (matcher.match(subst1.getExpr(), alt_statement, forward, &forward_deferred)
+			&& matcher.match(subst2.getExpr(), statement, forward, &forward_deferred)
+			&& matcher.solve(forward_deferred, forward) && forward_deferred.empty()) {
+		context.swap(forward);
+		deferred.clear();
+		return true;
+	}
+
+	return matcher.match(subst1.getExpr(), statement, context, &deferred)
+		&& matcher.match(subst2.getExpr(), alt_statement, context, &deferred);
+}
+
 /**
  * Construct an deduction rule: such a rule states that, given all premisses are
  * true, the conclusion also holds.
@@ -131,26 +218,42 @@ bool EquivalenceRule::validate_pass(const Context &context,
  * @param premisses Vector of premisses.
  * @param statement2 Conclusion statement.
  */
-DeductionRule::DeductionRule(const std::string& name, std::vector<Node_ptr> &&params,
+DeductionRule::DeductionRule(Symbol name, std::vector<Node_ptr> &&params,
 	const std::vector<Expr_ptr> &premisses, Expr_ptr conclusion)
-	: Rule(name, std::move(params)), premisses(premisses), subst_conclusion(conclusion)
+	: DeductionRule(name, std::move(params), std::vector<Expr_ptr>(premisses),
+		std::move(conclusion)) {}
+
+/**
+ * Construct an deduction rule, taking the premisses.
+ *
+ * @param name Name of the rule.
+ * @param params Parameters of the rule.
+ * @param premisses Vector of premisses.
+ * @param statement2 Conclusion statement.
+ */
+DeductionRule::DeductionRule(Symbol name, std::vector<Node_ptr> &&params,
+	std::vector<Expr_ptr> &&premisses, Expr_ptr conclusion)
+	: Rule(name, std::move(params)), premisses(std::move(premisses)),
+	  subst_conclusion(std::move(conclusion))
 {
-	auto find = std::find_if(premisses.begin(), premisses.end(),
-		[] (Expr_ptr expr) -> bool {return (expr->getType() != BuiltInType::statement);}
+	auto find = std::find_if(this->premisses.begin(), this->premisses.end(),
+		[] (const Expr_ptr &expr) -> bool {return (expr->getType() != BuiltInType::statement);}
 	);
 
-	if (find != premisses.end()) {
+	if (find != this->premisses.end()) {
 		std::ostringstream str;
-		str << "premiss number " << find - premisses.begin() + 1;
+		str << "premiss number " << find - this->premisses.begin() + 1;
 		throw TypeException((*find)->getType(), BuiltInType::statement, str.str());
 	}
 
-	if (conclusion->getType() != BuiltInType::statement)
-		throw TypeException(conclusion->getType(), BuiltInType::statement, "conclusion");
+	const const_Expr_ptr &type = subst_conclusion.getExpr()->getType();
+	if (type != BuiltInType::statement)
+		throw TypeException(type, BuiltInType::statement, "conclusion");
 
 	// Build substitution vector
-	for (Expr_ptr premiss : premisses)
-		subst_premisses.push_back(Substitution(premiss));
+	subst_premisses.reserve(this->premisses.size());
+	for (const Expr_ptr &premiss : this->premisses)
+		subst_premisses.emplace_back(premiss);
 }
 
 /**
@@ -176,7 +279,8 @@ const std::vector<const_Expr_ptr>& DeductionRule::getPremisses() const
 }
 
 bool DeductionRule::validate_pass(const Context &context,
-	const std::vector<Reference> &statements, const_Expr_ptr statement) const
+	const std::vector<Reference> &statements, const_Expr_ptr statement,
+	Substitution::State &state) const
 {
 	// Check if we are given the right number of references
 	if (statements.size() != subst_premisses.size())
@@ -184,14 +288,30 @@ bool DeductionRule::validate_pass(const Context &context,
 
 	// Check the premisses
 	auto mismatch = std::mismatch(subst_premisses.begin(), subst_premisses.end(), statements.begin(),
-		[this, context] (Substitution &subst, const Reference ref) -> bool {
+		[&context, &state] (const Substitution &subst, const Reference &ref) -> bool {
 			auto stmt = static_cast<const Statement *>((*ref).get());
-			return subst.check(stmt->getDefinition().get(), context);
+			return subst.check(stmt->getDefinition().get(), context, state);
 		}
 	);
 
 	// Check the conclusion, compute result
 	bool result = (mismatch.first == subst_premisses.end())
-		&& subst_conclusion.check(statement.get(), context);
+		&& subst_conclusion.check(statement.get(), context, state);
 	return result;
 }
+
+bool DeductionRule::infer_pass(const Matcher &matcher,
+	const std::vector<Reference> &statements, const_Expr_ptr statement,
+	Context &context, std::vector<Matcher::Constraint> &deferred) const
+{
+	if (statements.size() != premisses.size())
+		return false;
+
+	// Fail as soon as something doesn't match.
+	for (std::size_t i = 0; i < premisses.size(); ++i) {
+		auto stmt = static_cast<const Statement *>((*statements[i]).get());
+		if (!matcher.match(premisses[i], stmt->getDefinition(), context, &deferred))
+			return false;
+	}
+	return matcher.match(subst_conclusion.getExpr(), statement, context, &deferred);
+}
@@ -21,6 +21,7 @@
 #define CORE_LOGIC_HPP
 #include "forward.hpp"
 #include "theory.hpp"
+#include "match.hpp"
 #include "tree.hpp"
 #include <vector>
 #include <string>
@@ -39,6 +40,11 @@ namespace Core {
 			{return params;}
 		bool validate(const Context &context,
 			const std::vector<Reference> &statements, const_Expr_ptr statement) const;
+		bool validate(const Context &context,
+			const std::vector<Reference> &statements, const_Expr_ptr statement,
+			Substitution::State &state) const;
+		bool infer(const std::vector<Reference> &statements, const_Expr_ptr statement,
+			Context &context) const;
 
 	protected:
 		/**
@@ -47,12 +53,16 @@ namespace Core {
 		 * @param name Name of the rule.
 		 * @param params Parameter list of the rule.
 		 */
-		Rule(const std::string& name, std::vector<Node_ptr> &&params)
+		Rule(Symbol name, std::vector<Node_ptr> &&params)
 			: Object(BuiltInType::rule, name), params(std::move(params)) {}
 
 	private:
 		virtual bool validate_pass(const Context &context,
-			const std::vector<Reference> &statements, const_Expr_ptr statement) const = 0;
+			const std::vector<Reference> &statements, const_Expr_ptr statement,
+			Substitution::State &state) const = 0;
+		virtual bool infer_pass(const Matcher &matcher,
+			const std::vector<Reference> &statements, const_Expr_ptr statement,
+			Context &context, std::vector<Matcher::Constraint> &deferred) const = 0;
 
 		const std::vector<Node_ptr> params;
 	};
@@ -62,7 +72,7 @@ namespace Core {
 	 */
 	class Tautology : public Rule {
 	public:
-		Tautology(const std::string& name, std::vector<Node_ptr> &&params, Expr_ptr tautology);
+		Tautology(Symbol name, std::vector<Node_ptr> &&params, Expr_ptr tautology);
 		Object_ptr clone() const;
 
 		/**
@@ -70,7 +80,7 @@ namespace Core {
 		 *
 		 * @return Tautological statement expression.
 		 */
-		const_Expr_ptr getStatement() const
+		const const_Expr_ptr &getStatement() const
 			{return subst.getExpr();}
 
 		void accept(Visitor *visitor) const
@@ -78,9 +88,13 @@ namespace Core {
 
 	private:
 		bool validate_pass(const Context &context,
-			const std::vector<Reference> &statements, const_Expr_ptr statement) const;
+			const std::vector<Reference> &statements, const_Expr_ptr statement,
+			Substitution::State &state) const;
+		bool infer_pass(const Matcher &matcher,
+			const std::vector<Reference> &statements, const_Expr_ptr statement,
+			Context &context, std::vector<Matcher::Constraint> &deferred) const;
 
-		mutable Substitution subst;
+		const Substitution subst;
 	};
 
 	/**
@@ -88,7 +102,7 @@ namespace Core {
 	 */
 	class EquivalenceRule : public Rule {
 	public:
-		EquivalenceRule(const std::string& name, std::vector<Node_ptr> &&params,
+		EquivalenceRule(Symbol name, std::vector<Node_ptr> &&params,
 			Expr_ptr statement1, Expr_ptr statement2);
 		Object_ptr clone() const;
 
@@ -97,7 +111,7 @@ namespace Core {
 		 *
 		 * @return Statement expression.
 		 */
-		const_Expr_ptr getStatement1() const
+		const const_Expr_ptr &getStatement1() const
 			{return subst1.getExpr();}
 
 		/**
@@ -105,7 +119,7 @@ namespace Core {
 		 *
 		 * @return Statement expression.
 		 */
-		const_Expr_ptr getStatement2() const
+		const const_Expr_ptr &getStatement2() const
 			{return subst2.getExpr();}
 
 		void accept(Visitor *visitor) const
@@ -113,9 +127,13 @@ namespace Core {
 
 	private:
 		bool validate_pass(const Context &context,
-			const std::vector<Reference> &statements, const_Expr_ptr statement) const;
+			const std::vector<Reference> &statements, const_Expr_ptr statement,
+			Substitution::State &state) const;
+		bool infer_pass(const Matcher &matcher,
+			const std::vector<Reference> &statements, const_Expr_ptr statement,
+			Context &context, std::vector<Matcher::Constraint> &deferred) const;
 
-		mutable Substitution subst1, subst2;
+		const Substitution subst1, subst2;
 	};
 
 	/**
@@ -123,8 +141,10 @@ namespace Core {
 	 */
 	class DeductionRule : public Rule {
 	public:
-		DeductionRule(const std::string& name, std::vector<Node_ptr> &&params,
+		DeductionRule(Symbol name, std::vector<Node_ptr> &&params,
 			const std::vector<Expr_ptr> &premisses, Expr_ptr conclusion);
+		DeductionRule(Symbol name, std::vector<Node_ptr> &&params,
+			std::vector<Expr_ptr> &&premisses, Expr_ptr conclusion);
 		Object_ptr clone() const;
 
 		const std::vector<const_Expr_ptr>& getPremisses() const;
@@ -133,7 +153,7 @@ namespace Core {
 		 *
 		 * @return Conclusion expression.
 		 */
-		const_Expr_ptr getConclusion() const
+		const const_Expr_ptr &getConclusion() const
 			{return subst_conclusion.getExpr();}
 
 		void accept(Visitor *visitor) const
@@ -141,11 +161,15 @@ namespace Core {
 
 	private:
 		bool validate_pass(const Context &context,
-			const std::vector<Reference> &statements, const_Expr_ptr statement) const;
+			const std::vector<Reference> &statements, const_Expr_ptr statement,
+			Substitution::State &state) const;
+		bool infer_pass(const Matcher &matcher,
+			const std::vector<Reference> &statements, const_Expr_ptr statement,
+			Context &context, std::vector<Matcher::Constraint> &deferred) const;
 
 		std::vector<Expr_ptr> premisses;
-		mutable std::vector<Substitution> subst_premisses;
-		mutable Substitution subst_conclusion;
+		std::vector<Substitution> subst_premisses;
+		const Substitution subst_conclusion;
 	};
 }	// End of namespace Core
 
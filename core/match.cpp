@@ -0,0 +1,479 @@
+/*
+ *   Matching patterns with parameters against expressions.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "match.hpp"
+#include "expression.hpp"
+#include "debug.hpp"
+#include "tree.hpp"
+#include <algorithm>
+
+using namespace Core;
+
+namespace {
+	// Get the number of arguments of a lambda type or call.
+	template <typename T>
+	std::size_t arity(const T *expr)
+	{
+		return expr->end() - expr->begin();
+	}
+
+	// Is the expression a type?
+	bool isType(const Expression *expr)
+	{
+		return expr->cls == Expression::BUILTINTYPE || expr->cls == Expression::LAMBDATYPE;
+	}
+
+	const_Expr_ptr instantiateType(const const_Expr_ptr &type, const Context &context);
+
+	// Get the expression a node stands for, or an empty pointer.
+	const_Expr_ptr lookup(const const_Node_ptr &node, const Context &context)
+	{
+		auto it = context.find(node);
+		return (it != context.end()) ? it->second : const_Expr_ptr();
+	}
+
+	/**
+	 * Instantiate parameters of lambdas, which might have types depending on
+	 * the context. Renamed parameters are added to the context.
+	 */
+	std::vector<Node_ptr> instantiateParams(const std::vector<Node_ptr> &params,
+		Context &context, bool *changed)
+	{
+		std::vector<Node_ptr> result;
+		result.reserve(params.size());
+		for (const Node_ptr &param : params) {
+			const_Expr_ptr type = instantiateType(param->getType(), context);
+			if (type != param->getType()) {
+				auto renamed = std::make_shared<Node>(type, param->getSymbol());
+				context[param] = std::make_shared<AtomicExpr>(renamed);
+				result.push_back(renamed);
+				*changed = true;
+			}
+			else
+				result.push_back(param);
+		}
+		return result;
+	}
+
+	// Instantiate a type expression.
+	const_Expr_ptr instantiateType(const const_Expr_ptr &type, const Context &context)
+	{
+		if (type->cls == Expression::ATOMIC) {
+			const_Expr_ptr value = lookup(static_cast<const AtomicExpr *>(type.get())->getAtom(),
+				context);
+			return value ? value : type;
+		}
+		else if (type->cls == Expression::LAMBDATYPE) {
+			auto lambda_type = static_cast<const LambdaType *>(type.get());
+			bool changed = false;
+			std::vector<const_Expr_ptr> args;
+			for (const const_Expr_ptr &arg : *lambda_type) {
+				args.push_back(instantiateType(arg, context));
+				changed |= args.back() != arg;
+			}
+			const_Expr_ptr return_type = instantiateType(lambda_type->getReturnType(), context);
+			changed |= return_type != lambda_type->getReturnType();
+			return changed ? std::make_shared<LambdaType>(std::move(args), return_type) : type;
+		}
+		else
+			return type;
+	}
+}
+
+/**
+ * Construct a matcher.
+ *
+ * @param params Parameters in the patterns, usually those of a rule.
+ */
+Matcher::Matcher(const std::vector<Node_ptr> &params) : params(params) {}
+
+/**
+ * Match a pattern against an expression.
+ *
+ * @param pattern Pattern containing parameters.
+ * @param target Expression the pattern should become.
+ * @param context Arguments found so far, extended by the match. It might be
+ *      changed even if the match fails.
+ * @param deferred If not null, unsolvable lambda calls are appended here
+ *      instead of failing.
+ * @return True, if the pattern matches as far as we can tell.
+ */
+bool Matcher::match(const const_Expr_ptr &pattern, const const_Expr_ptr &target,
+	Context &context, std::vector<Constraint> *deferred) const
+{
+	return matchExpr(pattern, target, context, deferred);
+}
+
+/**
+ * Try deferred calls again, until nothing changes anymore. Calls that still
+ * can't be solved stay deferred.
+ *
+ * @param deferred Deferred calls, the solved ones are removed.
+ * @param context Arguments found so far, extended by the match.
+ * @return False, if one of the calls doesn't match.
+ */
+bool Matcher::solve(std::vector<Constraint> &deferred, Context &context) const
+{
+	bool progress = true;
+	while (!deferred.empty() && progress) {
+		std::vector<Constraint> remaining;
+		for (const Constraint &constraint : deferred)
+			if (!matchExpr(constraint.first, constraint.second, context, &remaining))
+				return false;
+		progress = remaining.size() < deferred.size();
+		deferred.swap(remaining);
+	}
+	return true;
+}
+
+/**
+ * Have all parameters in a pattern an argument?
+ *
+ * @param pattern Pattern containing parameters.
+ * @param context Arguments found so far.
+ * @return True, if the pattern can be instantiated completely.
+ */
+bool Matcher::isBound(const Expression *pattern, const Context &context) const
+{
+	switch (pattern->cls) {
+	case Expression::LAMBDATYPE: {
+		auto type = static_cast<const LambdaType *>(pattern);
+		return isBound(type->getReturnType().get(), context) && std::all_of(type->begin(),
+			type->end(), [this, &context] (const const_Expr_ptr &arg) -> bool
+			{return isBound(arg.get(), context);});
+	}
+	case Expression::ATOMIC: {
+		const const_Node_ptr &node = static_cast<const AtomicExpr *>(pattern)->getAtom();
+		return !isParam(node.get()) || context.count(node);
+	}
+	case Expression::LAMBDACALL: {
+		auto call = static_cast<const LambdaCallExpr *>(pattern);
+		if (isParam(call->getLambda().get()) && !context.count(call->getLambda()))
+			return false;
+		return std::all_of(call->begin(), call->end(),
+			[this, &context] (const Expr_ptr &arg) -> bool
+			{return isBound(arg.get(), context);});
+	}
+	case Expression::NEGATION:
+		return isBound(static_cast<const NegationExpr *>(pattern)->getExpr().get(), context);
+	case Expression::CONNECTIVE: {
+		auto connective = static_cast<const ConnectiveExpr *>(pattern);
+		return isBound(connective->getFirstExpr().get(), context)
+			&& isBound(connective->getSecondExpr().get(), context);
+	}
+	case Expression::QUANTIFIER:
+		return isBound(static_cast<const QuantifierExpr *>(pattern)->getPredicate().get(),
+			context);
+	case Expression::LAMBDA: {
+		auto lambda = static_cast<const LambdaExpr *>(pattern);
+		return isBound(lambda->getDefinition().get(), context) && std::all_of(lambda->begin(),
+			lambda->end(), [this, &context] (const Node_ptr &param) -> bool
+			{return isBound(param->getType().get(), context);});
+	}
+	default:
+		return true;
+	}
+}
+
+/**
+ * Substitute the arguments for the parameters of a pattern. Calls of lambda
+ * expressions that come up are reduced. Parts without parameters aren't
+ * copied.
+ *
+ * @param pattern Pattern containing parameters.
+ * @param context Arguments for the parameters.
+ * @return Instantiated pattern.
+ * @throw TypeException if the arguments don't have the right types.
+ */
+const_Expr_ptr Matcher::instantiate(const const_Expr_ptr &pattern, const Context &context)
+{
+	switch (pattern->cls) {
+	case Expression::BUILTINTYPE:
+	case Expression::LAMBDATYPE:
+		return instantiateType(pattern, context);
+	case Expression::ATOMIC: {
+		const_Expr_ptr value = lookup(static_cast<const AtomicExpr *>(pattern.get())->getAtom(),
+			context);
+		return value ? value : pattern;
+	}
+	case Expression::LAMBDACALL: {
+		auto call = static_cast<const LambdaCallExpr *>(pattern.get());
+		bool changed = false;
+		std::vector<Expr_ptr> args;
+		for (const Expr_ptr &arg : *call) {
+			args.push_back(std::const_pointer_cast<Expression>(instantiate(arg, context)));
+			changed |= args.back() != arg;
+		}
+
+		const_Expr_ptr lambda = lookup(call->getLambda(), context);
+		if (!lambda)
+			return changed ? std::make_shared<LambdaCallExpr>(call->getLambda(), std::move(args))
+				: pattern;
+		else if (lambda->cls == Expression::LAMBDA) {
+			// Reduce: substitute the arguments for the parameters.
+			auto expr = static_cast<const LambdaExpr *>(lambda.get());
+			Context inner;
+			for (std::size_t i = 0; i < args.size() && i < expr->getParams().size(); ++i)
+				inner[expr->getParams()[i]] = args[i];
+			return instantiate(expr->getDefinition(), inner);
+		}
+		else if (lambda->cls == Expression::ATOMIC)
+			return std::make_shared<LambdaCallExpr>(
+				static_cast<const AtomicExpr *>(lambda.get())->getAtom(), std::move(args));
+		else
+			throw TypeException(lambda->getType(), "lambda expression or lambda node");
+	}
+	case Expression::NEGATION: {
+		auto negation = static_cast<const NegationExpr *>(pattern.get());
+		const_Expr_ptr expr = instantiate(negation->getExpr(), context);
+		return (expr == negation->getExpr()) ? pattern
+			: std::make_shared<NegationExpr>(std::const_pointer_cast<Expression>(expr));
+	}
+	case Expression::CONNECTIVE: {
+		auto connective = static_cast<const ConnectiveExpr *>(pattern.get());
+		const_Expr_ptr first = instantiate(connective->getFirstExpr(), context);
+		const_Expr_ptr second = instantiate(connective->getSecondExpr(), context);
+		if (first == connective->getFirstExpr() && second == connective->getSecondExpr())
+			return pattern;
+		return std::make_shared<ConnectiveExpr>(connective->getVariant(),
+			std::const_pointer_cast<Expression>(first),
+			std::const_pointer_cast<Expression>(second));
+	}
+	case Expression::QUANTIFIER: {
+		auto quantifier = static_cast<const QuantifierExpr *>(pattern.get());
+		const_Expr_ptr predicate = instantiate(quantifier->getPredicate(), context);
+		return (predicate == quantifier->getPredicate()) ? pattern
+			: std::make_shared<QuantifierExpr>(quantifier->getVariant(), predicate);
+	}
+	case Expression::LAMBDA:
+	default: {
+		auto lambda = static_cast<const LambdaExpr *>(pattern.get());
+		Context inner(context);
+		bool changed = false;
+		std::vector<Node_ptr> params = instantiateParams(lambda->getParams(), inner, &changed);
+		const_Expr_ptr definition = instantiate(lambda->getDefinition(), inner);
+		if (!changed && definition == lambda->getDefinition())
+			return pattern;
+		return std::make_shared<LambdaExpr>(std::move(params), definition);
+	}
+	}
+}
+
+/**
+ * Are two expressions equal up to renaming of bound parameters?
+ *
+ * @param a First expression.
+ * @param b Second expression.
+ * @return True, if they are equal.
+ */
+bool Matcher::equal(const const_Expr_ptr &a, const const_Expr_ptr &b)
+{
+	static const Context empty;
+	thread_local Substitution::State state;
+	if (a == b)
+		return true;
+	if (isType(a.get()) || isType(b.get()))
+		return TypeComparator()(a.get(), b.get());
+	return Substitution(a).check(b.get(), empty, state);
+}
+
+/**
+ * Is the node one of our parameters?
+ *
+ * @param node Node to look for.
+ * @return True, if it is a parameter.
+ */
+bool Matcher::isParam(const Node *node) const
+{
+	return std::any_of(params.begin(), params.end(),
+		[node] (const Node_ptr &param) -> bool {return param.get() == node;});
+}
+
+/**
+ * Match a pattern against an expression, see match().
+ */
+bool Matcher::matchExpr(const const_Expr_ptr &pattern, const const_Expr_ptr &target,
+	Context &context, std::vector<Constraint> *deferred) const
+{
+	switch (pattern->cls) {
+	case Expression::BUILTINTYPE:
+		return isType(target.get()) && TypeComparator()(pattern.get(), target.get());
+	case Expression::LAMBDATYPE: {
+		if (target->cls != Expression::LAMBDATYPE)
+			return false;
+		auto pattern_type = static_cast<const LambdaType *>(pattern.get());
+		auto target_type = static_cast<const LambdaType *>(target.get());
+		if (arity(pattern_type) != arity(target_type))
+			return false;
+		for (std::size_t i = 0; i < arity(pattern_type); ++i)
+			if (!matchExpr(pattern_type->begin()[i], target_type->begin()[i],
+					context, deferred))
+				return false;
+		return matchExpr(pattern_type->getReturnType(), target_type->getReturnType(),
+			context, deferred);
+	}
+	case Expression::ATOMIC: {
+		const const_Node_ptr &node = static_cast<const AtomicExpr *>(pattern.get())->getAtom();
+		const_Expr_ptr value = lookup(node, context);
+		if (value)
+			return equal(value, target);
+		if (!isParam(node.get()))
+			return target->cls == Expression::ATOMIC
+				&& static_cast<const AtomicExpr *>(target.get())->getAtom() == node;
+
+		// Bind the parameter, but look at the types first.
+		if (!matchExpr(node->getType(), target->getType(), context, deferred))
+			return false;
+		context[node] = target;
+		return true;
+	}
+	case Expression::LAMBDACALL:
+		return matchCall(static_cast<const LambdaCallExpr *>(pattern.get()), pattern, target,
+			context, deferred);
+	case Expression::NEGATION:
+		return target->cls == Expression::NEGATION
+			&& matchExpr(static_cast<const NegationExpr *>(pattern.get())->getExpr(),
+				static_cast<const NegationExpr *>(target.get())->getExpr(), context, deferred);
+	case Expression::CONNECTIVE: {
+		if (target->cls != Expression::CONNECTIVE)
+			return false;
+		auto pattern_con = static_cast<const ConnectiveExpr *>(pattern.get());
+		auto target_con = static_cast<const ConnectiveExpr *>(target.get());
+		return pattern_con->getVariant() == target_con->getVariant()
+			&& matchExpr(pattern_con->getFirstExpr(), target_con->getFirstExpr(),
+				context, deferred)
+			&& matchExpr(pattern_con->getSecondExpr(), target_con->getSecondExpr(),
+				context, deferred);
+	}
+	case Expression::QUANTIFIER: {
+		if (target->cls != Expression::QUANTIFIER)
+			return false;
+		auto pattern_quant = static_cast<const QuantifierExpr *>(pattern.get());
+		auto target_quant = static_cast<const QuantifierExpr *>(target.get());
+		return pattern_quant->getVariant() == target_quant->getVariant()
+			&& matchExpr(pattern_quant->getPredicate(), target_quant->getPredicate(),
+				context, deferred);
+	}
+	case Expression::LAMBDA:
+	default: {
+		if (target->cls != Expression::LAMBDA)
+			return false;
+		auto pattern_lambda = static_cast<const LambdaExpr *>(pattern.get());
+		auto target_lambda = static_cast<const LambdaExpr *>(target.get());
+		const std::vector<Node_ptr> &pattern_params = pattern_lambda->getParams();
+		const std::vector<Node_ptr> &target_params = target_lambda->getParams();
+		if (pattern_params.size() != target_params.size())
+			return false;
+
+		// Rename our parameters to those of the target while matching the
+		// definition. Deferred calls don't survive the renaming.
+		for (std::size_t i = 0; i < pattern_params.size(); ++i) {
+			if (!matchExpr(pattern_params[i]->getType(), target_params[i]->getType(),
+					context, deferred))
+				return false;
+			context[pattern_params[i]] = std::make_shared<AtomicExpr>(target_params[i]);
+		}
+		bool result = matchExpr(pattern_lambda->getDefinition(),
+			target_lambda->getDefinition(), context, nullptr);
+		for (const Node_ptr &param : pattern_params)
+			context.erase(param);
+		return result;
+	}
+	}
+}
+
+/**
+ * Match a lambda call against an expression.
+ *
+ * @param pattern Lambda call in the pattern.
+ * @param pattern_ptr The same as shared pointer.
+ * @param target Expression the call should become.
+ * @param context Arguments found so far, extended by the match.
+ * @param deferred If not null, we append the call if we can't solve it yet.
+ * @return True, if the pattern matches as far as we can tell.
+ */
+bool Matcher::matchCall(const LambdaCallExpr *pattern, const const_Expr_ptr &pattern_ptr,
+	const const_Expr_ptr &target, Context &context, std::vector<Constraint> *deferred) const
+{
+	const const_Node_ptr &node = pattern->getLambda();
+	const_Expr_ptr value = lookup(node, context);
+
+	// Known lambda expression: match its definition, then the arguments
+	// against what we found for its parameters.
+	if (value && value->cls == Expression::LAMBDA) {
+		auto lambda = static_cast<const LambdaExpr *>(value.get());
+		Matcher inner(lambda->getParams());
+		Context found;
+		if (!inner.match(lambda->getDefinition(), target, found))
+			return false;
+		for (std::size_t i = 0; i < arity(pattern); ++i) {
+			const_Expr_ptr arg = lookup(lambda->getParams()[i], found);
+			if (arg && !matchExpr(pattern->begin()[i], arg, context, deferred))
+				return false;
+		}
+		return true;
+	}
+
+	// Call of a known node: compare the arguments.
+	if (value || !isParam(node.get())) {
+		const Node *lambda = node.get();
+		if (value) {
+			if (value->cls != Expression::ATOMIC)
+				return false;
+			lambda = static_cast<const AtomicExpr *>(value.get())->getAtom().get();
+		}
+		if (target->cls != Expression::LAMBDACALL)
+			return false;
+		auto target_call = static_cast<const LambdaCallExpr *>(target.get());
+		if (target_call->getLambda().get() != lambda
+				|| arity(target_call) != arity(pattern))
+			return false;
+		for (std::size_t i = 0; i < arity(pattern); ++i)
+			if (!matchExpr(pattern->begin()[i], target_call->begin()[i], context, deferred))
+				return false;
+		return true;
+	}
+
+	// Unknown lambda applied to distinct parameters of enclosing lambdas:
+	// abstract them from the target.
+	std::vector<Node_ptr> abstracted;
+	for (const Expr_ptr &arg : *pattern) {
+		if (arg->cls != Expression::ATOMIC)
+			break;
+		const const_Node_ptr &atom = static_cast<const AtomicExpr *>(arg.get())->getAtom();
+		const_Expr_ptr renamed = lookup(atom, context);
+		if (isParam(atom.get()) || !renamed || renamed->cls != Expression::ATOMIC)
+			break;
+		const const_Node_ptr &param = static_cast<const AtomicExpr *>(renamed.get())->getAtom();
+		if (std::find(abstracted.begin(), abstracted.end(), param) != abstracted.end())
+			break;
+		abstracted.push_back(std::const_pointer_cast<Node>(param));
+	}
+	if (abstracted.size() == arity(pattern)) {
+		auto lambda = std::make_shared<LambdaExpr>(std::move(abstracted), target);
+		if (!matchExpr(node->getType(), lambda->getType(), context, deferred))
+			return false;
+		context[node] = lambda;
+		return true;
+	}
+
+	if (deferred)
+		deferred->push_back(Constraint(pattern_ptr, target));
+	return deferred != nullptr;
+}
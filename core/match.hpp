@@ -0,0 +1,73 @@
+/*
+ *   Matching patterns with parameters against expressions.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_MATCH_HPP
+#define CORE_MATCH_HPP
+#include "forward.hpp"
+#include "base.hpp"
+#include <utility>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Matching of patterns against expressions, finding the arguments for the
+	 * parameters of a rule. While Substitution checks a given context, the
+	 * matcher extends the context by whatever makes the pattern equal to the
+	 * target.
+	 *
+	 * Calls of lambda parameters are only solved in two cases: if the lambda
+	 * is already known, it is applied and the result is matched, otherwise
+	 * the arguments must be distinct parameters of enclosing lambdas. Other
+	 * calls are deferred when a list is given, so that they can be tried
+	 * again once more is known, or fail otherwise.
+	 *
+	 * The matcher might accept more than is right, so the result should be
+	 * checked by Rule::validate().
+	 */
+	class Matcher {
+	public:
+		// Pattern and target left for later
+		typedef std::pair<const_Expr_ptr, const_Expr_ptr> Constraint;
+
+		Matcher(const std::vector<Node_ptr> &params);
+
+		bool match(const const_Expr_ptr &pattern, const const_Expr_ptr &target,
+			Context &context, std::vector<Constraint> *deferred = nullptr) const;
+		bool solve(std::vector<Constraint> &deferred, Context &context) const;
+		bool isBound(const Expression *pattern, const Context &context) const;
+
+		static const_Expr_ptr instantiate(const const_Expr_ptr &pattern, const Context &context);
+		static bool equal(const const_Expr_ptr &a, const const_Expr_ptr &b);
+
+	private:
+		bool isParam(const Node *node) const;
+		bool matchExpr(const const_Expr_ptr &pattern, const const_Expr_ptr &target,
+			Context &context, std::vector<Constraint> *deferred) const;
+		bool matchCall(const LambdaCallExpr *pattern, const const_Expr_ptr &pattern_ptr,
+			const const_Expr_ptr &target, Context &context,
+			std::vector<Constraint> *deferred) const;
+
+		const std::vector<Node_ptr> params;
+	};
+}	// End of namespace Core
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ *   Work-stealing scheduler for parallel loops.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+using namespace Core;
+
+/**
+ * Construct a scheduler.
+ *
+ * @param num_threads Number of threads to use, or 0 for the number of cores.
+ * @param grain Number of iterations per chunk.
+ */
+WorkStealingScheduler::WorkStealingScheduler(unsigned num_threads, std::size_t grain)
+	: num_threads(num_threads), grain(grain ? grain : 1)
+{
+	if (!this->num_threads)
+		this->num_threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * Run body(i) for all i in [0, count). The calls may happen concurrently and
+ * in any order. If a call throws, the remaining chunks are skipped and the
+ * first exception is rethrown.
+ *
+ * @param count Number of iterations.
+ * @param body Function to call for each iteration.
+ */
+void WorkStealingScheduler::parallelFor(std::size_t count,
+	const std::function<void (std::size_t)> &body)
+{
+	unsigned threads = std::min<std::size_t>(num_threads, (count + grain - 1) / grain);
+
+	// Not worth it? Then do it ourselves.
+	if (threads <= 1) {
+		for (std::size_t i = 0; i < count; ++i)
+			body(i);
+		return;
+	}
+
+	// Give every thread a contiguous share of chunks.
+	std::vector<Queue> queues(threads);
+	std::size_t share = (count + threads - 1) / threads;
+	for (unsigned index = 0; index < threads; ++index) {
+		std::size_t end = std::min(count, (index + 1) * share);
+		for (std::size_t begin = index * share; begin < end; begin += grain)
+			queues[index].chunks.push_back({begin, std::min(end, begin + grain)});
+	}
+
+	std::exception_ptr exception;
+	std::mutex exception_mutex;
+	std::atomic<bool> failed(false);
+
+	auto worker = [&] (unsigned index) {
+		try {
+			work(queues, index, body);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(exception_mutex);
+			if (!exception)
+				exception = std::current_exception();
+			failed = true;
+
+			// Make sure that nobody starts new chunks.
+			for (Queue &queue : queues) {
+				std::lock_guard<std::mutex> queue_lock(queue.mutex);
+				queue.chunks.clear();
+			}
+		}
+	};
+
+	// The calling thread is worker 0.
+	std::vector<std::thread> pool;
+	for (unsigned index = 1; index < threads; ++index)
+		pool.emplace_back(worker, index);
+	worker(0);
+	for (std::thread &thread : pool)
+		thread.join();
+
+	if (failed)
+		std::rethrow_exception(exception);
+}
+
+/**
+ * Take a chunk from the back of our own queue.
+ */
+bool WorkStealingScheduler::pop(Queue &queue, Chunk *chunk)
+{
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.chunks.empty())
+		return false;
+
+	*chunk = queue.chunks.back();
+	queue.chunks.pop_back();
+	return true;
+}
+
+/**
+ * Take a chunk from the front of somebody else's queue.
+ */
+bool WorkStealingScheduler::steal(Queue &queue, Chunk *chunk)
+{
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.chunks.empty())
+		return false;
+
+	*chunk = queue.chunks.front();
+	queue.chunks.pop_front();
+	return true;
+}
+
+/**
+ * Work loop of a single thread: first do our own chunks, then steal.
+ */
+void WorkStealingScheduler::work(std::vector<Queue> &queues, unsigned index,
+	const std::function<void (std::size_t)> &body)
+{
+	Chunk chunk;
+	for (;;) {
+		bool found = pop(queues[index], &chunk);
+
+		// Look for victims, starting with our neighbor.
+		for (unsigned offset = 1; !found && offset < queues.size(); ++offset)
+			found = steal(queues[(index + offset) % queues.size()], &chunk);
+
+		// Nothing left anywhere: chunks are never added, so we are done.
+		if (!found)
+			return;
+
+		for (std::size_t i = chunk.begin; i < chunk.end; ++i)
+			body(i);
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ *   Work-stealing scheduler for parallel loops.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_PARALLEL_HPP
+#define CORE_PARALLEL_HPP
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Scheduler distributing the iterations of a loop over threads.
+	 *
+	 * Every thread starts with its own share of the iteration range, split into
+	 * chunks. When a thread runs out of chunks, it steals from the others.
+	 */
+	class WorkStealingScheduler {
+	public:
+		WorkStealingScheduler(unsigned num_threads = 0, std::size_t grain = 16);
+
+		/**
+		 * Get the number of threads used.
+		 *
+		 * @return Number of threads.
+		 */
+		unsigned getThreads() const
+			{return num_threads;}
+
+		void parallelFor(std::size_t count,
+			const std::function<void (std::size_t)> &body);
+
+	private:
+		// A chunk of iterations [begin, end)
+		struct Chunk {
+			std::size_t begin, end;
+		};
+
+		// Chunk queue of a single thread
+		struct Queue {
+			std::mutex mutex;
+			std::deque<Chunk> chunks;
+		};
+
+		bool pop(Queue &queue, Chunk *chunk);
+		bool steal(Queue &queue, Chunk *chunk);
+		void work(std::vector<Queue> &queues, unsigned index,
+			const std::function<void (std::size_t)> &body);
+
+		unsigned num_threads;
+		std::size_t grain;
+	};
+}	// End of namespace Core
+
+#endif
@@ -0,0 +1,254 @@
+/*
+ *   Instrumentation of parsing and verification.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "profile.hpp"
+#include "lisp.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+using namespace Core;
+
+namespace {
+	typedef std::pair<Symbol, ProfileCounters> Entry;
+
+	const char *const kind_names[Profile::NUM_KINDS] = {"rules", "statements", "forms"};
+
+	// Get the entries of a map, most expensive first.
+	std::vector<Entry> sorted(const std::unordered_map<Symbol, ProfileCounters> &entries)
+	{
+		std::vector<Entry> result(entries.begin(), entries.end());
+		std::sort(result.begin(), result.end(), [] (const Entry &a, const Entry &b) -> bool
+			{return a.second.nanoseconds > b.second.nanoseconds
+				|| (a.second.nanoseconds == b.second.nanoseconds
+					&& a.first.str() < b.first.str());});
+		return result;
+	}
+
+	// Write a string in JSON syntax.
+	void writeString(std::ostream &output, const std::string &str)
+	{
+		output << '"';
+		for (char c : str) {
+			if (c == '"' || c == '\\')
+				output << '\\' << c;
+			else if (static_cast<unsigned char>(c) < 0x20) {
+				char escape[7];
+				std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+				output << escape;
+			}
+			else
+				output << c;
+		}
+		output << '"';
+	}
+}
+
+#ifdef LOGIC_PROFILE
+const bool Profile::enabled = true;
+#else
+const bool Profile::enabled = false;
+#endif
+
+thread_local ProfileCounters Profile::local = {0, 0, 0, 0, 0};
+
+/**
+ * Add counters to another set of counters.
+ *
+ * @param other Counters to add.
+ */
+void ProfileCounters::add(const ProfileCounters &other)
+{
+	calls += other.calls;
+	nanoseconds += other.nanoseconds;
+	nodes += other.nodes;
+	mismatches += other.mismatches;
+	type_comparisons += other.type_comparisons;
+}
+
+/**
+ * Get the global profile.
+ *
+ * @return Profile collecting the counters of all threads.
+ */
+Profile &Profile::get()
+{
+	static Profile profile;
+	return profile;
+}
+
+/**
+ * Get the name of an object for the profile. Unnamed statements are written
+ * out, so that they can be told apart.
+ *
+ * @param object Object to describe, may be null.
+ * @return Name of the object, or the null symbol for no object.
+ */
+Symbol Profile::describe(const Object *object)
+{
+	if (!object)
+		return Symbol();
+	if (object->getName() != "")
+		return object->getSymbol();
+
+	auto statement = dynamic_cast<const Statement *>(object);
+	if (!statement)
+		return object->getSymbol();
+
+	std::ostringstream stream;
+	{
+		Writer writer(stream, std::numeric_limits<int>::max());
+		statement->getDefinition()->accept(&writer);
+	}
+	std::string description = stream.str();
+	while (!description.empty() && description.back() == '\n')
+		description.pop_back();
+	return Symbol(description);
+}
+
+/**
+ * Add counters to an entry of the profile.
+ *
+ * @param kind Kind of the entry.
+ * @param name Name of the entry.
+ * @param counters Counters to add.
+ */
+void Profile::add(Kind kind, Symbol name, const ProfileCounters &counters)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto result = entries[kind].emplace(name, counters);
+	if (!result.second)
+		result.first->second.add(counters);
+}
+
+/**
+ * Remove all entries.
+ */
+void Profile::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto &map : entries)
+		map.clear();
+}
+
+/**
+ * Get the counters of an entry.
+ *
+ * @param kind Kind of the entry.
+ * @param name Name of the entry.
+ * @return Counters, all zero if there is no such entry.
+ */
+ProfileCounters Profile::find(Kind kind, Symbol name) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = entries[kind].find(name);
+	if (it != entries[kind].end())
+		return it->second;
+	return ProfileCounters{0, 0, 0, 0, 0};
+}
+
+/**
+ * Write a report with the most expensive entries of every kind.
+ *
+ * @param output Stream to write to.
+ * @param limit Maximal number of entries per kind.
+ */
+void Profile::write(std::ostream &output, std::size_t limit) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int kind = 0; kind < NUM_KINDS; ++kind) {
+		std::vector<Entry> list = sorted(entries[kind]);
+		char line[160];
+		std::snprintf(line, sizeof(line), "%-32s %10s %12s %12s %12s %12s\n",
+			kind_names[kind], "calls", "time (ms)", "nodes", "mismatches", "type checks");
+		output << line;
+
+		for (std::size_t i = 0; i < list.size() && i < limit; ++i) {
+			const std::string &name = list[i].first.str();
+			const ProfileCounters &counters = list[i].second;
+			std::snprintf(line, sizeof(line), "%-32s %10llu %12.3f %12llu %12llu %12llu\n",
+				name.empty() ? "(unnamed)" : name.c_str(),
+				static_cast<unsigned long long>(counters.calls), counters.nanoseconds * 1e-6,
+				static_cast<unsigned long long>(counters.nodes),
+				static_cast<unsigned long long>(counters.mismatches),
+				static_cast<unsigned long long>(counters.type_comparisons));
+			output << line;
+		}
+		if (list.size() > limit)
+			output << "... and " << list.size() - limit << " more\n";
+		output << '\n';
+	}
+}
+
+/**
+ * Write all entries as JSON object, with an array of entries per kind,
+ * most expensive first.
+ *
+ * @param output Stream to write to.
+ */
+void Profile::writeJSON(std::ostream &output) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	output << "{";
+	for (int kind = 0; kind < NUM_KINDS; ++kind) {
+		output << (kind ? ",\n" : "\n") << "  \"" << kind_names[kind] << "\": [";
+		bool first = true;
+		for (const Entry &entry : sorted(entries[kind])) {
+			output << (first ? "\n" : ",\n") << "    {\"name\": ";
+			writeString(output, entry.first.str());
+			output << ", \"calls\": " << entry.second.calls
+				<< ", \"nanoseconds\": " << entry.second.nanoseconds
+				<< ", \"nodes\": " << entry.second.nodes
+				<< ", \"mismatches\": " << entry.second.mismatches
+				<< ", \"type_comparisons\": " << entry.second.type_comparisons << "}";
+			first = false;
+		}
+		output << (first ? "]" : "\n  ]");
+	}
+	output << "\n}\n";
+}
+
+/**
+ * Enter a scope.
+ *
+ * @param kind Kind of the entry to add to.
+ * @param name Name of the entry, may be set later.
+ */
+ProfileScope::ProfileScope(Profile::Kind kind, Symbol name)
+	: kind(kind), name(name), start(Profile::local),
+	  begin(std::chrono::steady_clock::now()) {}
+
+/**
+ * Leave the scope and add what was done in it to the profile.
+ */
+ProfileScope::~ProfileScope()
+{
+	if (!name)
+		return;
+
+	const ProfileCounters &now = Profile::local;
+	ProfileCounters counters{1,
+		static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - begin).count()),
+		now.nodes - start.nodes, now.mismatches - start.mismatches,
+		now.type_comparisons - start.type_comparisons};
+	Profile::get().add(kind, name, counters);
+}
@@ -0,0 +1,128 @@
+/*
+ *   Instrumentation of parsing and verification.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_PROFILE_HPP
+#define CORE_PROFILE_HPP
+#include "forward.hpp"
+#include "symbol.hpp"
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+/**
+ * Instrumentation is compiled in with LOGIC_PROFILE only. Otherwise the
+ * macros below expand to nothing, and the profile stays empty.
+ */
+#ifdef LOGIC_PROFILE
+#define LOGIC_PROFILE_COUNT(counter) (++::Core::Profile::local.counter)
+#define LOGIC_PROFILE_SCOPE(scope, kind, name) ::Core::ProfileScope scope(kind, name)
+#define LOGIC_PROFILE_NAME(scope, name) (scope.setName(name))
+#else
+#define LOGIC_PROFILE_COUNT(counter) ((void)0)
+#define LOGIC_PROFILE_SCOPE(scope, kind, name) ((void)0)
+#define LOGIC_PROFILE_NAME(scope, name) ((void)0)
+#endif
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Counters for a piece of work.
+	 */
+	struct ProfileCounters {
+		// Number of times it was done
+		std::uint64_t calls;
+		// Wall clock time spent on it
+		std::uint64_t nanoseconds;
+		// Expression nodes compared by Substitution::check
+		std::uint64_t nodes;
+		// Mismatches found by Substitution::check
+		std::uint64_t mismatches;
+		// Calls of TypeComparator
+		std::uint64_t type_comparisons;
+
+		void add(const ProfileCounters &other);
+	};
+
+	/**
+	 * Profile of rules, statements and top-level forms. Counters are kept per
+	 * thread while the work is done, and added to the profile by a
+	 * ProfileScope. A single global instance collects everything.
+	 */
+	class Profile {
+	public:
+		enum Kind {
+			RULE,       // Applications of a rule in Rule::validate
+			STATEMENT,  // Checks of the proof of a statement
+			FORM,       // Parsing a top-level form by Parser::parseObject
+			NUM_KINDS
+		};
+
+		// Was instrumentation compiled in?
+		static const bool enabled;
+
+		// Counters of the current thread, running totals
+		static thread_local ProfileCounters local;
+
+		static Profile &get();
+		static Symbol describe(const Object *object);
+
+		void add(Kind kind, Symbol name, const ProfileCounters &counters);
+		void clear();
+		ProfileCounters find(Kind kind, Symbol name) const;
+
+		void write(std::ostream &output, std::size_t limit = 20) const;
+		void writeJSON(std::ostream &output) const;
+
+	private:
+		mutable std::mutex mutex;
+		std::unordered_map<Symbol, ProfileCounters> entries[NUM_KINDS];
+	};
+
+	/**
+	 * Scope adding the counters and time spent in it to an entry of the
+	 * global profile, when it is left. Scopes may be nested, then the work of
+	 * the inner scope counts for the outer scope as well.
+	 */
+	class ProfileScope {
+	public:
+		ProfileScope(Profile::Kind kind, Symbol name = Symbol());
+		~ProfileScope();
+
+		/**
+		 * Set the name of the entry. Scopes with the null symbol as name are
+		 * not recorded.
+		 *
+		 * @param new_name Name of the entry.
+		 */
+		void setName(Symbol new_name)
+			{name = new_name;}
+
+	private:
+		const Profile::Kind kind;
+		Symbol name;
+		const ProfileCounters start;
+		const std::chrono::steady_clock::time_point begin;
+	};
+}	// End of namespace Core
+
+#endif
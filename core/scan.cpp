@@ -0,0 +1,395 @@
+/*
+ *   Classification of characters for the lexer, several at once.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "scan.hpp"
+#include <algorithm>
+#include <cstring>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+using namespace Core;
+
+namespace {
+	// Number of characters classified at once
+	const std::size_t BLOCK_SIZE = 64;
+
+
+	inline int countTrailingZeros(std::uint64_t mask)
+	{
+#ifdef __GNUC__
+		return __builtin_ctzll(mask);
+#else
+		int count = 0;
+		for (; !(mask & 1); mask >>= 1)
+			++count;
+		return count;
+#endif
+	}
+
+	inline int highestBit(std::uint64_t mask)
+	{
+#ifdef __GNUC__
+		return 63 - __builtin_clzll(mask);
+#else
+		int bit = 0;
+		while (mask >>= 1)
+			++bit;
+		return bit;
+#endif
+	}
+
+	inline int popCount(std::uint64_t mask)
+	{
+#ifdef __GNUC__
+		return __builtin_popcountll(mask);
+#else
+		int count = 0;
+		for (; mask; mask &= mask - 1)
+			++count;
+		return count;
+#endif
+	}
+
+	// Get the bits above the lowest bit that is set.
+	inline std::uint64_t after(std::uint64_t mask)
+	{
+		return ~(((mask & -mask) << 1) - 1);
+	}
+
+	// Step to the next block, but not beyond the end.
+	inline const char *nextBlock(const char *pos, const char *end)
+	{
+		return end - pos > (std::ptrdiff_t)BLOCK_SIZE ? pos + BLOCK_SIZE : end;
+	}
+
+	/**
+	 * Classify BLOCK_SIZE characters. Whitespace is ' ' and '\t' to '\r', as
+	 * for std::isspace in the "C" locale.
+	 */
+#if defined(__AVX2__)
+	inline ScanBlock classify(const char *pos)
+	{
+		ScanBlock block = {0, 0, 0, 0, 0};
+		for (int i = 0; i < 2; ++i) {
+			__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos + 32 * i));
+			__m256i control = _mm256_sub_epi8(c, _mm256_set1_epi8('\t'));
+			__m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')),
+				_mm256_cmpeq_epi8(_mm256_min_epu8(control, _mm256_set1_epi8('\r' - '\t')), control));
+			int shift = 32 * i;
+
+			block.space |= (std::uint64_t)(std::uint32_t)_mm256_movemask_epi8(space) << shift;
+			block.open |= (std::uint64_t)(std::uint32_t)_mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(c, _mm256_set1_epi8('('))) << shift;
+			block.close |= (std::uint64_t)(std::uint32_t)_mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(c, _mm256_set1_epi8(')'))) << shift;
+			block.comment |= (std::uint64_t)(std::uint32_t)_mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(c, _mm256_set1_epi8('#'))) << shift;
+			block.newline |= (std::uint64_t)(std::uint32_t)_mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n'))) << shift;
+		}
+		return block;
+	}
+#elif defined(__SSE2__)
+	inline ScanBlock classify(const char *pos)
+	{
+		ScanBlock block = {0, 0, 0, 0, 0};
+		for (int i = 0; i < 4; ++i) {
+			__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos + 16 * i));
+			__m128i control = _mm_sub_epi8(c, _mm_set1_epi8('\t'));
+			__m128i space = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')),
+				_mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control));
+			int shift = 16 * i;
+
+			block.space |= (std::uint64_t)_mm_movemask_epi8(space) << shift;
+			block.open |= (std::uint64_t)_mm_movemask_epi8(
+				_mm_cmpeq_epi8(c, _mm_set1_epi8('('))) << shift;
+			block.close |= (std::uint64_t)_mm_movemask_epi8(
+				_mm_cmpeq_epi8(c, _mm_set1_epi8(')'))) << shift;
+			block.comment |= (std::uint64_t)_mm_movemask_epi8(
+				_mm_cmpeq_epi8(c, _mm_set1_epi8('#'))) << shift;
+			block.newline |= (std::uint64_t)_mm_movemask_epi8(
+				_mm_cmpeq_epi8(c, _mm_set1_epi8('\n'))) << shift;
+		}
+		return block;
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	// Gather the highest bits of 64 comparison results, as movemask on x86.
+	inline std::uint64_t moveMask(const uint8x16_t mask[4])
+	{
+		const uint8x16_t bits = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+		uint8x16_t sum0 = vpaddq_u8(vandq_u8(mask[0], bits), vandq_u8(mask[1], bits));
+		uint8x16_t sum1 = vpaddq_u8(vandq_u8(mask[2], bits), vandq_u8(mask[3], bits));
+		sum0 = vpaddq_u8(sum0, sum1);
+		sum0 = vpaddq_u8(sum0, sum0);
+		return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+	}
+
+	inline ScanBlock classify(const char *pos)
+	{
+		uint8x16_t space[4], open[4], close[4], comment[4], newline[4];
+		for (int i = 0; i < 4; ++i) {
+			uint8x16_t c = vld1q_u8(reinterpret_cast<const std::uint8_t *>(pos + 16 * i));
+			uint8x16_t control = vsubq_u8(c, vdupq_n_u8('\t'));
+			space[i] = vorrq_u8(vceqq_u8(c, vdupq_n_u8(' ')),
+				vcleq_u8(control, vdupq_n_u8('\r' - '\t')));
+			open[i] = vceqq_u8(c, vdupq_n_u8('('));
+			close[i] = vceqq_u8(c, vdupq_n_u8(')'));
+			comment[i] = vceqq_u8(c, vdupq_n_u8('#'));
+			newline[i] = vceqq_u8(c, vdupq_n_u8('\n'));
+		}
+		return ScanBlock{moveMask(space), moveMask(open), moveMask(close),
+			moveMask(comment), moveMask(newline)};
+	}
+#else
+	inline ScanBlock classify(const char *pos)
+	{
+		ScanBlock block = {0, 0, 0, 0, 0};
+		for (std::size_t i = 0; i < BLOCK_SIZE; ++i) {
+			unsigned char c = pos[i];
+			std::uint64_t bit = (std::uint64_t)1 << i;
+			if (isSpace(c))
+				block.space |= bit;
+			if (c == '(')
+				block.open |= bit;
+			if (c == ')')
+				block.close |= bit;
+			if (c == '#')
+				block.comment |= bit;
+			if (c == '\n')
+				block.newline |= bit;
+		}
+		return block;
+	}
+#endif
+}
+
+/**
+ * Classify the characters of a block. If the buffer ends before the block,
+ * the rest of the block is taken to be spaces.
+ *
+ * @param pos Beginning of the block.
+ * @param end End of the buffer.
+ * @return Classes of the characters.
+ */
+ScanBlock Core::scanBlock(const char *pos, const char *end)
+{
+	if (end - pos >= (std::ptrdiff_t)BLOCK_SIZE)
+		return classify(pos);
+
+	char tail[BLOCK_SIZE];
+	std::memset(tail, ' ', BLOCK_SIZE);
+	std::memcpy(tail, pos, end - pos);
+	return classify(tail);
+}
+
+/**
+ * Find the first whitespace, paranthesis or '#' by classifying blocks.
+ *
+ * @param pos Where to start.
+ * @param end End of the buffer.
+ * @return Position of the character, or end.
+ */
+const char *Core::findDelimiterBlocks(const char *pos, const char *end)
+{
+	for (; pos != end; pos = nextBlock(pos, end)) {
+		ScanBlock block = scanBlock(pos, end);
+		std::uint64_t mask = block.space | block.open | block.close | block.comment;
+		if (mask)
+			return std::min(pos + countTrailingZeros(mask), end);
+	}
+	return end;
+}
+
+/**
+ * Find the next paranthesis, '#' or line break by classifying blocks.
+ *
+ * @param pos Where to start.
+ * @param end End of the buffer.
+ * @return Position of the character, or end.
+ */
+const char *Core::findStructuralBlocks(const char *pos, const char *end)
+{
+	for (; pos != end; pos = nextBlock(pos, end)) {
+		ScanBlock block = scanBlock(pos, end);
+		std::uint64_t mask = block.open | block.close | block.comment | block.newline;
+		if (mask)
+			return pos + countTrailingZeros(mask);
+	}
+	return end;
+}
+
+/**
+ * Skip whitespace by classifying blocks, counting the line breaks in it.
+ *
+ * @param pos Where to start.
+ * @param end End of the buffer.
+ * @param lines Incremented by the number of line breaks skipped.
+ * @param line_begin Set to the character after the last line break skipped,
+ *      if there was one.
+ * @return First character that isn't whitespace, or end.
+ */
+const char *Core::skipSpaceBlocks(const char *pos, const char *end, int *lines,
+	const char **line_begin)
+{
+	for (; pos != end; pos = nextBlock(pos, end)) {
+		ScanBlock block = scanBlock(pos, end);
+		std::uint64_t other = ~block.space;
+		std::uint64_t skipped = other ? (other & -other) - 1 : ~(std::uint64_t)0;
+		std::uint64_t newlines = block.newline & skipped;
+		if (newlines) {
+			*lines += popCount(newlines);
+			*line_begin = pos + highestBit(newlines) + 1;
+		}
+		if (other)
+			return pos + countTrailingZeros(other);
+	}
+	return end;
+}
+
+/**
+ * Classify all characters of a buffer.
+ *
+ * @param begin Beginning of the buffer.
+ * @param end End of the buffer.
+ */
+ScanIndex::ScanIndex(const char *begin, const char *end)
+	: length(end - begin)
+{
+	blocks.reserve((length + BLOCK_SIZE - 1) / BLOCK_SIZE);
+	for (const char *pos = begin; pos != end; pos = nextBlock(pos, end))
+		blocks.push_back(scanBlock(pos, end));
+}
+
+/**
+ * Find the top-level forms, skipping whitespace and comments. Blocks inside
+ * of forms without comments, where there are more open parantheses than
+ * closing ones, are passed at once, since the form can't end in them.
+ *
+ * @param forms Vector to append the beginnings and ends of the forms to.
+ * @return False, if something else than forms is on the top level, or the
+ *      parantheses aren't balanced.
+ */
+bool ScanIndex::findForms(std::vector<std::pair<std::size_t, std::size_t>> *forms) const
+{
+	int depth = 0;
+	bool comment = false;
+	std::size_t begin = 0;
+	for (std::size_t block = 0; block < blocks.size(); ++block) {
+		const ScanBlock &scan = blocks[block];
+
+		// Characters outside of comments
+		std::uint64_t valid = ~(std::uint64_t)0;
+		if (comment) {
+			if (!scan.newline)
+				continue;
+			valid = after(scan.newline);
+			comment = false;
+		}
+
+		std::uint64_t close = scan.close & valid;
+		if (depth && !(scan.comment & valid) && popCount(close) < depth) {
+			depth += popCount(scan.open & valid) - popCount(close);
+			continue;
+		}
+
+		std::uint64_t events = (scan.open | scan.close | scan.comment) & valid;
+		std::uint64_t words = ~(scan.space | scan.open | scan.close | scan.comment) & valid;
+		while (events) {
+			std::uint64_t bit = events & -events;
+			std::uint64_t before = bit - 1;
+			std::size_t offset = block * BLOCK_SIZE + countTrailingZeros(bit);
+
+			// Words on the top level
+			if (depth == 0 && (words & before))
+				return false;
+			words &= ~before;
+
+			if (scan.open & bit) {
+				if (depth++ == 0)
+					begin = offset;
+			}
+			else if (scan.close & bit) {
+				if (depth == 0)
+					return false;
+				if (--depth == 0)
+					forms->emplace_back(begin, offset + 1);
+			}
+			else {
+				std::uint64_t newlines = scan.newline & ~before;
+				if (!newlines) {
+					comment = true;
+					words = 0;
+					break;
+				}
+				events &= after(newlines);
+				words &= after(newlines);
+				continue;
+			}
+			events &= events - 1;
+		}
+
+		if (depth == 0 && words)
+			return false;
+	}
+	return depth == 0;
+}
+
+/**
+ * Count the line breaks in a range.
+ *
+ * @param begin Beginning of the range.
+ * @param end End of the range, at most size().
+ * @return Number of line breaks.
+ */
+std::size_t ScanIndex::countNewlines(std::size_t begin, std::size_t end) const
+{
+	std::size_t count = 0;
+	for (std::size_t block = begin / BLOCK_SIZE; block * BLOCK_SIZE < end; ++block) {
+		std::uint64_t mask = blocks[block].newline;
+		if (block == begin / BLOCK_SIZE)
+			mask &= ~(std::uint64_t)0 << (begin % BLOCK_SIZE);
+		if (end - block * BLOCK_SIZE < BLOCK_SIZE)
+			mask &= ((std::uint64_t)1 << (end - block * BLOCK_SIZE)) - 1;
+		count += popCount(mask);
+	}
+	return count;
+}
+
+/**
+ * Get the beginning of the line containing a character.
+ *
+ * @param offset Offset of the character.
+ * @return Offset of the character after the last line break before it, or 0.
+ */
+std::size_t ScanIndex::lineBegin(std::size_t offset) const
+{
+	std::size_t block = offset / BLOCK_SIZE;
+	std::uint64_t mask = (offset % BLOCK_SIZE) ? blocks[block].newline
+		& (((std::uint64_t)1 << (offset % BLOCK_SIZE)) - 1) : 0;
+	while (!mask) {
+		if (block == 0)
+			return 0;
+		mask = blocks[--block].newline;
+	}
+	return block * BLOCK_SIZE + highestBit(mask) + 1;
+}
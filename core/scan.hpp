@@ -0,0 +1,164 @@
+/*
+ *   Classification of characters for the lexer, several at once.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_SCAN_HPP
+#define CORE_SCAN_HPP
+#include "forward.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Classes of 64 consecutive characters, one bit per character. The lowest
+	 * bit stands for the first character. Bits beyond the end of the input
+	 * are set as for spaces.
+	 */
+	struct ScanBlock {
+		// Whitespace, including line breaks
+		std::uint64_t space;
+		// Opening and closing parantheses
+		std::uint64_t open, close;
+		// Beginnings of comments, i.e. '#'
+		std::uint64_t comment;
+		// Line breaks
+		std::uint64_t newline;
+	};
+
+	ScanBlock scanBlock(const char *pos, const char *end);
+
+	const char *findDelimiterBlocks(const char *pos, const char *end);
+	const char *findStructuralBlocks(const char *pos, const char *end);
+	const char *skipSpaceBlocks(const char *pos, const char *end, int *lines,
+		const char **line_begin);
+
+	/**
+	 * Number of characters looked at one by one, before we classify blocks.
+	 * Most words and runs of whitespace are shorter, and for them this is
+	 * faster.
+	 */
+	const std::ptrdiff_t SCAN_PREFIX = 16;
+
+	/**
+	 * Is a character whitespace? This is what std::isspace gives us in the
+	 * "C" locale.
+	 */
+	inline bool isSpace(unsigned char c)
+	{
+		return c == ' ' || (c >= '\t' && c <= '\r');
+	}
+
+	/**
+	 * Is a character a paranthesis or '#'?
+	 */
+	inline bool isStructural(unsigned char c)
+	{
+		return c == '(' || c == ')' || c == '#';
+	}
+
+	/**
+	 * Find the end of a word: the first whitespace, paranthesis or '#'.
+	 *
+	 * @param pos Beginning of the word.
+	 * @param end End of the buffer.
+	 * @return First character after the word, or end.
+	 */
+	inline const char *findDelimiter(const char *pos, const char *end)
+	{
+		const char *prefix_end = end - pos > SCAN_PREFIX ? pos + SCAN_PREFIX : end;
+		for (; pos != prefix_end; ++pos)
+			if (isSpace(*pos) || isStructural(*pos))
+				return pos;
+		return findDelimiterBlocks(pos, end);
+	}
+
+	/**
+	 * Find the next paranthesis, '#' or line break.
+	 *
+	 * @param pos Where to start.
+	 * @param end End of the buffer.
+	 * @return Position of the character, or end.
+	 */
+	inline const char *findStructural(const char *pos, const char *end)
+	{
+		const char *prefix_end = end - pos > SCAN_PREFIX ? pos + SCAN_PREFIX : end;
+		for (; pos != prefix_end; ++pos)
+			if (isStructural(*pos) || *pos == '\n')
+				return pos;
+		return findStructuralBlocks(pos, end);
+	}
+
+	/**
+	 * Skip whitespace, counting the line breaks in it.
+	 *
+	 * @param pos Where to start.
+	 * @param end End of the buffer.
+	 * @param lines Set to the number of line breaks skipped.
+	 * @param line_begin Set to the character after the last line break
+	 *      skipped, if there was one.
+	 * @return First character that isn't whitespace, or end.
+	 */
+	inline const char *skipSpace(const char *pos, const char *end, int *lines,
+		const char **line_begin)
+	{
+		*lines = 0;
+		const char *prefix_end = end - pos > SCAN_PREFIX ? pos + SCAN_PREFIX : end;
+		for (; pos != prefix_end; ++pos) {
+			if (!isSpace(*pos))
+				return pos;
+			if (*pos == '\n') {
+				++*lines;
+				*line_begin = pos + 1;
+			}
+		}
+		return skipSpaceBlocks(pos, end, lines, line_begin);
+	}
+
+	/**
+	 * Classes of all characters in a buffer, for finding its structure
+	 * without looking at every character. Positions are offsets into the
+	 * buffer.
+	 */
+	class ScanIndex {
+	public:
+		ScanIndex(const char *begin, const char *end);
+
+		/**
+		 * Get the size of the buffer.
+		 *
+		 * @return Number of characters.
+		 */
+		std::size_t size() const
+			{return length;}
+
+		bool findForms(std::vector<std::pair<std::size_t, std::size_t>> *forms) const;
+		std::size_t countNewlines(std::size_t begin, std::size_t end) const;
+		std::size_t lineBegin(std::size_t offset) const;
+
+	private:
+		std::vector<ScanBlock> blocks;
+		std::size_t length;
+	};
+}	// End of namespace Core
+
+#endif
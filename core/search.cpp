@@ -0,0 +1,576 @@
+/*
+ *   Bounded search for proofs.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "search.hpp"
+#include "hash.hpp"
+#include "logic.hpp"
+#include "match.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+using namespace Core;
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	// Default heuristic: fewer premisses first, and patterns that are just
+	// a parameter fit anything, so they come late.
+	double defaultCost(const Expression *, const RuleIndex::Candidate &candidate)
+	{
+		double cost = 0;
+		if (auto deduction = dynamic_cast<const DeductionRule *>(candidate.rule.get()))
+			cost = deduction->getPremisses().size();
+		else if (dynamic_cast<const EquivalenceRule *>(candidate.rule.get()))
+			cost = 1;
+		if (candidate.pattern->cls == Expression::ATOMIC)
+			cost += 1;
+		return cost;
+	}
+
+	// Get the pattern of a candidate as shared pointer.
+	const_Expr_ptr getPattern(const RuleIndex::Candidate &candidate)
+	{
+		const Rule *rule = candidate.rule.get();
+		if (auto tautology = dynamic_cast<const Tautology *>(rule))
+			return tautology->getStatement();
+		else if (auto equivalence = dynamic_cast<const EquivalenceRule *>(rule))
+			return (equivalence->getStatement1().get() == candidate.pattern)
+				? equivalence->getStatement1() : equivalence->getStatement2();
+		else
+			return static_cast<const DeductionRule *>(rule)->getConclusion();
+	}
+
+	// Get the statements a candidate needs, which become goals.
+	std::vector<const_Expr_ptr> getPremisses(const RuleIndex::Candidate &candidate)
+	{
+		const Rule *rule = candidate.rule.get();
+		if (auto equivalence = dynamic_cast<const EquivalenceRule *>(rule))
+			return {(equivalence->getStatement1().get() == candidate.pattern)
+				? equivalence->getStatement2() : equivalence->getStatement1()};
+		else if (auto deduction = dynamic_cast<const DeductionRule *>(rule))
+			return deduction->getPremisses();
+		else
+			return {};
+	}
+}
+
+/**
+ * Default options: up to 4 steps deep, one thread, one second and a hundred
+ * thousand goals.
+ */
+SearchOptions::SearchOptions()
+	: max_depth(4), num_threads(1), time_limit(1000), max_states(100000) {}
+
+/**
+ * Search state of a single thread. Statements that were proven are kept in
+ * a theory of their own, so that later steps can refer to them.
+ */
+class ProofSearch::Worker {
+public:
+	Worker(const ProofSearch &search, const std::atomic<bool> &stop, Clock::time_point deadline)
+		: expanded(0), status(NOT_FOUND), search(search), stop(stop), deadline(deadline),
+		  pruned(0) {}
+
+	bool prove(const const_Expr_ptr &goal, unsigned depth, Reference *result);
+	bool apply(const RuleIndex::Candidate &candidate, const const_Expr_ptr &goal,
+		unsigned depth, Reference *result);
+	bool aborted();
+
+	// Goals we're working on, to avoid going in circles
+	std::vector<std::pair<std::size_t, const_Expr_ptr>> path;
+
+	Theory steps;
+	std::size_t expanded;
+	Status status;
+
+private:
+	// Premisses of a rule application in the making
+	struct Application {
+		const Rule *rule;
+		const_Rule_ptr rule_ptr;
+		const Matcher &matcher;
+		const std::vector<const_Expr_ptr> &premisses;
+		const const_Expr_ptr &goal;
+		unsigned depth;
+	};
+
+	bool findProven(const const_Expr_ptr &expr, std::size_t hash, Reference *result) const;
+	bool solve(const Application &application, Context &context,
+		std::vector<Matcher::Constraint> &deferred, std::vector<Reference> &refs,
+		std::vector<char> &done, Reference *result);
+	bool conclude(const Application &application, const Context &context,
+		const std::vector<Reference> &refs, Reference *result);
+
+	const ProofSearch &search;
+	const std::atomic<bool> &stop;
+	const Clock::time_point deadline;
+
+	std::unordered_multimap<std::size_t, Theory::const_iterator> proven;
+	std::unordered_multimap<std::size_t, std::pair<const_Expr_ptr, unsigned>> failed;
+	// Number of goals rejected because they were on the path
+	std::size_t pruned;
+};
+
+/**
+ * Should we stop searching? Sets the status if we ran out of budget.
+ *
+ * @return True, if another thread found a proof or we're out of budget.
+ */
+bool ProofSearch::Worker::aborted()
+{
+	if (status != NOT_FOUND)
+		return true;
+	if (expanded >= search.options.max_states)
+		status = OUT_OF_MEMORY;
+	else if (Clock::now() > deadline)
+		status = TIMEOUT;
+	return status != NOT_FOUND || stop.load(std::memory_order_relaxed);
+}
+
+/**
+ * Look up a statement proven by this worker.
+ *
+ * @param expr Statement to look for.
+ * @param hash Structural hash of the statement.
+ * @param result Reference to fill in, if we find it.
+ * @return True, if we have proven the statement before.
+ */
+bool ProofSearch::Worker::findProven(const const_Expr_ptr &expr, std::size_t hash,
+	Reference *result) const
+{
+	auto range = proven.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		auto stmt = std::static_pointer_cast<const Statement>(*it->second);
+		if (Matcher::equal(stmt->getDefinition(), expr)) {
+			*result = Reference(&steps, it->second);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Prove a goal.
+ *
+ * @param goal Statement to prove.
+ * @param depth Maximal number of rule applications on a path.
+ * @param result Reference to fill in with the proven statement.
+ * @return True, if we found a proof.
+ */
+bool ProofSearch::Worker::prove(const const_Expr_ptr &goal, unsigned depth, Reference *result)
+{
+	std::size_t hash = StructuralHash()(goal.get());
+	if (const Known *known = search.findKnown(goal, hash)) {
+		*result = known->ref;
+		return true;
+	}
+	if (findProven(goal, hash, result))
+		return true;
+	if (!depth || aborted())
+		return false;
+
+	// Did we fail before with as many steps left, or are we going in circles?
+	auto range = failed.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+		if (it->second.second >= depth && Matcher::equal(it->second.first, goal))
+			return false;
+	for (const auto &entry : path)
+		if (entry.first == hash && Matcher::equal(entry.second, goal)) {
+			++pruned;
+			return false;
+		}
+
+	++expanded;
+	std::size_t pruned_before = pruned;
+	path.emplace_back(hash, goal);
+	bool found = false;
+	for (const RuleIndex::Candidate &candidate : search.candidates(goal.get()))
+		if ((found = apply(candidate, goal, depth, result)) || aborted())
+			break;
+	path.pop_back();
+
+	// If some goal below was on the path, we might succeed elsewhere, so
+	// only remember failures that don't depend on the path.
+	if (!found && !aborted() && pruned == pruned_before) {
+		// The recursion may have added to failed, so look again.
+		range = failed.equal_range(hash);
+		auto it = std::find_if(range.first, range.second,
+			[&goal] (const std::pair<const std::size_t, std::pair<const_Expr_ptr, unsigned>> &entry)
+			{return Matcher::equal(entry.second.first, goal);});
+		if (it != range.second)
+			it->second.second = depth;
+		else
+			failed.emplace(hash, std::make_pair(goal, depth));
+	}
+	return found;
+}
+
+/**
+ * Prove a goal by a rule.
+ *
+ * @param candidate Rule and pattern that should fit the goal.
+ * @param goal Statement to prove.
+ * @param depth Maximal number of rule applications on a path.
+ * @param result Reference to fill in with the proven statement.
+ * @return True, if we found a proof.
+ */
+bool ProofSearch::Worker::apply(const RuleIndex::Candidate &candidate,
+	const const_Expr_ptr &goal, unsigned depth, Reference *result)
+{
+	Matcher matcher(candidate.rule->getParams());
+	Context context;
+	std::vector<Matcher::Constraint> deferred;
+	if (!matcher.match(getPattern(candidate), goal, context, &deferred))
+		return false;
+
+	std::vector<const_Expr_ptr> premisses = getPremisses(candidate);
+	Application application{candidate.rule.get(), candidate.rule, matcher, premisses,
+		goal, depth};
+	std::vector<Reference> refs(premisses.size(), Reference(nullptr, Theory::const_iterator()));
+	std::vector<char> done(premisses.size());
+	return solve(application, context, deferred, refs, done, result);
+}
+
+/**
+ * Find the remaining premisses of a rule application.
+ *
+ * @param application Rule application.
+ * @param context Arguments found so far.
+ * @param deferred Calls that couldn't be matched yet.
+ * @param refs References to the premisses found so far.
+ * @param done Which premisses were found?
+ * @param result Reference to fill in with the proven statement.
+ * @return True, if we found all premisses and the rule application works.
+ */
+bool ProofSearch::Worker::solve(const Application &application, Context &context,
+	std::vector<Matcher::Constraint> &deferred, std::vector<Reference> &refs,
+	std::vector<char> &done, Reference *result)
+{
+	const Matcher &matcher = application.matcher;
+	if (!matcher.solve(deferred, context))
+		return false;
+
+	// Premisses we can't state completely are matched against known
+	// statements first, since that is cheap and fixes more parameters. Others
+	// become goals. Lone parameters fit everything, so they come last.
+	std::vector<std::pair<int, std::size_t>> order;
+	for (std::size_t i = 0; i < done.size(); ++i) {
+		if (done[i])
+			continue;
+		const Expression *premiss = application.premisses[i].get();
+		int rank = matcher.isBound(premiss, context) ? 1
+			: (premiss->cls == Expression::ATOMIC) ? 2 : 0;
+		order.emplace_back(rank, i);
+	}
+	if (order.empty())
+		return deferred.empty() && conclude(application, context, refs, result);
+	std::stable_sort(order.begin(), order.end(),
+		[] (const std::pair<int, std::size_t> &a, const std::pair<int, std::size_t> &b)
+		{return a.first < b.first;});
+
+	for (const auto &entry : order) {
+		std::size_t next = entry.second;
+		const const_Expr_ptr &premiss = application.premisses[next];
+		done[next] = true;
+		bool found = false;
+
+		if (entry.first == 1) {
+			// Prove the premiss. It is needed whatever we try, so if this
+			// fails, the rule doesn't help.
+			try {
+				const_Expr_ptr goal = Matcher::instantiate(premiss, context);
+				found = prove(goal, application.depth - 1, &refs[next])
+					&& solve(application, context, deferred, refs, done, result);
+			}
+			catch (std::exception &) {}
+			done[next] = false;
+			return found;
+		}
+
+		// Try the statements we know.
+		auto attempt = [&] (const const_Expr_ptr &expr, const Reference &ref) -> bool {
+			Context extended(context);
+			std::vector<Matcher::Constraint> still(deferred);
+			if (!matcher.match(premiss, expr, extended, &still))
+				return false;
+			refs[next] = ref;
+			return solve(application, extended, still, refs, done, result);
+		};
+		for (const Known &known : search.known)
+			if ((found = attempt(known.expr, known.ref)) || aborted())
+				break;
+		for (auto it = steps.begin(); !found && it != steps.end() && !aborted(); ++it)
+			found = attempt(std::static_pointer_cast<const Statement>(*it)->getDefinition(),
+				Reference(&steps, it));
+		done[next] = false;
+		if (found || aborted())
+			return found;
+	}
+	return false;
+}
+
+/**
+ * Build the rule application and check it.
+ *
+ * @param application Rule application.
+ * @param context Arguments for the parameters of the rule.
+ * @param refs References to the premisses.
+ * @param result Reference to fill in with the proven statement.
+ * @return True, if the rule application works.
+ */
+bool ProofSearch::Worker::conclude(const Application &application, const Context &context,
+	const std::vector<Reference> &refs, Reference *result)
+{
+	std::vector<Expr_ptr> args;
+	for (const Node_ptr &param : application.rule->getParams()) {
+		auto it = context.find(param);
+		if (it == context.end())
+			return false;
+		args.push_back(std::const_pointer_cast<Expression>(it->second));
+	}
+
+	try {
+		auto stmt = std::make_shared<Statement>(Symbol(),
+			std::const_pointer_cast<Expression>(application.goal));
+		auto step = std::make_shared<ProofStep>(application.rule_ptr, args,
+			std::vector<Reference>(refs));
+		stmt->addProof(step);
+		if (!step->proves(*stmt))
+			return false;
+
+		Theory::iterator after = steps.end();
+		if (steps.size())
+			--after;
+		Theory::iterator it = steps.add(stmt, after);
+		proven.emplace(StructuralHash()(application.goal.get()), it);
+		*result = Reference(&steps, it);
+		return true;
+	}
+	catch (std::exception &) {
+		return false;
+	}
+}
+
+/**
+ * Prepare a search.
+ *
+ * @param rules Theory containing the rules.
+ * @param scope Theory containing the statements we may use. It mustn't be
+ *      changed while the search exists, and statements found by the search
+ *      refer to it.
+ * @param options Strategy and budgets.
+ */
+ProofSearch::ProofSearch(const Theory &rules, const Theory &scope, const SearchOptions &options)
+	: index(rules), options(options), expanded(0)
+{
+	for (Theory::const_iterator it = scope.begin(); it != scope.end(); ++it)
+		addKnown(&scope, it);
+
+	// Objects of enclosing theories, up to the one we belong to.
+	for (const Theory *theory = &scope; theory->parent; theory = theory->parent) {
+		const Theory *parent = theory->parent;
+		for (Theory::const_iterator it = parent->begin(); it != parent->end(); ++it) {
+			addKnown(parent, it);
+			if (it == theory->parent_object)
+				break;
+		}
+	}
+}
+
+ProofSearch::~ProofSearch() = default;
+
+/**
+ * Remember a statement we may use.
+ *
+ * @param theory Theory containing the statement.
+ * @param it Iterator to the object, which might not be a statement.
+ */
+void ProofSearch::addKnown(const Theory *theory, Theory::const_iterator it)
+{
+	auto stmt = std::dynamic_pointer_cast<const Statement>(*it);
+	if (!stmt)
+		return;
+	known_hashes.emplace(StructuralHash()(stmt->getDefinition().get()), known.size());
+	known.push_back(Known{stmt->getDefinition(), Reference(theory, it)});
+}
+
+/**
+ * Look up a known statement.
+ *
+ * @param expr Statement to look for.
+ * @param hash Structural hash of the statement.
+ * @return Known statement, or nullptr if we don't know it.
+ */
+const ProofSearch::Known *ProofSearch::findKnown(const const_Expr_ptr &expr,
+	std::size_t hash) const
+{
+	auto range = known_hashes.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+		if (Matcher::equal(known[it->second].expr, expr))
+			return &known[it->second];
+	return nullptr;
+}
+
+/**
+ * Get the rules that might prove a goal, ordered by the heuristic.
+ *
+ * @param goal Statement to prove.
+ * @return Candidate rules, cheapest first.
+ */
+std::vector<RuleIndex::Candidate> ProofSearch::candidates(const Expression *goal) const
+{
+	std::vector<RuleIndex::Candidate> result = index.lookup(goal);
+	const SearchOptions::Heuristic &heuristic = options.heuristic;
+	std::vector<std::pair<double, std::size_t>> costs;
+	for (std::size_t i = 0; i < result.size(); ++i)
+		costs.emplace_back(heuristic ? heuristic(goal, result[i])
+			: defaultCost(goal, result[i]), i);
+	std::sort(costs.begin(), costs.end());
+
+	std::vector<RuleIndex::Candidate> sorted;
+	for (const auto &cost : costs)
+		sorted.push_back(result[cost.second]);
+	return sorted;
+}
+
+/**
+ * Search for a proof of a statement. With increasing depth, the rules that
+ * might prove the goal are handed out to the threads.
+ *
+ * @param goal Statement to prove.
+ * @return Result of the search. Proofs are found by getProof().
+ */
+ProofSearch::Status ProofSearch::search(const const_Expr_ptr &goal)
+{
+	winner.reset();
+	proof.clear();
+	expanded = 0;
+
+	std::size_t hash = StructuralHash()(goal.get());
+	if (findKnown(goal, hash))
+		return FOUND;
+
+	unsigned num_threads = options.num_threads ? options.num_threads
+		: std::max(1u, std::thread::hardware_concurrency());
+	std::atomic<bool> stop(false);
+	Clock::time_point deadline = Clock::now() + options.time_limit;
+	std::vector<std::unique_ptr<Worker>> workers;
+	for (unsigned i = 0; i < num_threads; ++i)
+		workers.emplace_back(new Worker(*this, stop, deadline));
+
+	std::vector<RuleIndex::Candidate> rules = candidates(goal.get());
+	WorkStealingScheduler scheduler(num_threads, 1);
+	std::mutex mutex;
+	std::size_t found = rules.size();
+	Reference result(nullptr, Theory::const_iterator());
+	Status status = NOT_FOUND;
+
+	for (unsigned depth = 1; depth <= options.max_depth && !winner; ++depth) {
+		std::atomic<std::size_t> next(0);
+		scheduler.parallelFor(num_threads, [&] (std::size_t index) {
+			Worker &worker = *workers[index];
+			worker.path.assign(1, std::make_pair(hash, goal));
+			for (std::size_t i; (i = next++) < rules.size() && !worker.aborted(); ) {
+				Reference ref(nullptr, Theory::const_iterator());
+				if (worker.apply(rules[i], goal, depth, &ref)) {
+					std::lock_guard<std::mutex> lock(mutex);
+					if (i < found) {
+						found = i;
+						result = ref;
+						winner.reset(workers[index].release());
+					}
+					stop = true;
+					break;
+				}
+			}
+		});
+
+		for (const std::unique_ptr<Worker> &worker : workers)
+			if (worker && worker->status != NOT_FOUND)
+				status = worker->status;
+		if (status != NOT_FOUND)
+			break;
+	}
+
+	// The goals expanded are counted over all depths, since the workers
+	// remember them.
+	for (const std::unique_ptr<Worker> &worker : workers)
+		if (worker)
+			expanded += worker->expanded;
+	if (!winner)
+		return status;
+	expanded += winner->expanded;
+
+	// Collect the statements that the proof needs.
+	std::vector<char> needed(winner->steps.size());
+	std::vector<Reference> pending{result};
+	while (!pending.empty()) {
+		Reference ref = pending.back();
+		pending.pop_back();
+		std::size_t position = winner->steps.position(ref.getIterator());
+		if (ref.getTheory() != &winner->steps || needed[position])
+			continue;
+		needed[position] = true;
+		auto stmt = std::static_pointer_cast<const Statement>(*ref);
+		auto step = std::static_pointer_cast<const ProofStep>(stmt->getProof());
+		pending.insert(pending.end(), step->getReferences().begin(), step->getReferences().end());
+	}
+	for (std::size_t i = 0; i < needed.size(); ++i)
+		if (needed[i])
+			proof.push_back(std::static_pointer_cast<const Statement>(*winner->steps.at(i)));
+	return FOUND;
+}
+
+/**
+ * Add the proof found by the last search to a theory.
+ *
+ * @param theory Theory to add the statements to, usually the scope.
+ * @param after Iterator to the object after which to insert, which must come
+ *      after all statements of the scope that the proof refers to.
+ * @return Iterator to the last statement inserted, or after if the goal was
+ *      known already.
+ */
+Theory::iterator ProofSearch::insert(Theory &theory, Theory::iterator after) const
+{
+	std::unordered_map<const Object *, Theory::const_iterator> placed;
+	for (const const_Statement_ptr &stmt : proof) {
+		auto step = std::static_pointer_cast<const ProofStep>(stmt->getProof());
+		const_Rule_ptr rule = step->getRule();
+
+		std::vector<Expr_ptr> args;
+		for (const Node_ptr &param : rule->getParams())
+			args.push_back(std::const_pointer_cast<Expression>((*step)[param]));
+		std::vector<Reference> refs;
+		for (const Reference &ref : step->getReferences())
+			if (ref.getTheory() == &winner->steps)
+				refs.emplace_back(&theory, placed.at((*ref).get()));
+			else
+				refs.push_back(ref);
+
+		auto copy = std::make_shared<Statement>(Symbol(),
+			std::const_pointer_cast<Expression>(stmt->getDefinition()));
+		copy->addProof(std::make_shared<ProofStep>(rule, args, std::move(refs)));
+		after = theory.add(copy, after);
+		placed[stmt.get()] = after;
+	}
+	return after;
+}
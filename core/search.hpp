@@ -0,0 +1,143 @@
+/*
+ *   Bounded search for proofs.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_SEARCH_HPP
+#define CORE_SEARCH_HPP
+#include "forward.hpp"
+#include "index.hpp"
+#include "theory.hpp"
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Strategy and budgets of a proof search.
+	 */
+	struct SearchOptions {
+		/**
+		 * Cost of trying a rule on a goal, cheaper rules are tried first.
+		 * The default prefers rules with fewer premisses and specific
+		 * patterns.
+		 */
+		typedef std::function<double (const Expression *goal,
+			const RuleIndex::Candidate &candidate)> Heuristic;
+
+		SearchOptions();
+
+		// Maximal number of rule applications on a path from the goal
+		unsigned max_depth;
+		// Number of threads, 0 for one per core
+		unsigned num_threads;
+		// Time after which we give up
+		std::chrono::milliseconds time_limit;
+		// Maximal number of goals expanded by every thread over all depths,
+		// which bounds the memory used for remembering them
+		std::size_t max_states;
+		// Order of the rules, or empty for the default
+		Heuristic heuristic;
+	};
+
+	/**
+	 * Search for proofs of statements from the statements of a theory, using
+	 * the rules of another theory.
+	 *
+	 * This is an iterative deepening search backwards from the goal. A goal
+	 * is reached if it equals a known statement. Otherwise the rules whose
+	 * conclusion fits the goal, found by a RuleIndex, are tried. Premisses
+	 * that the goal determines become new goals, while the free parameters of
+	 * other premisses are found by matching them against known statements.
+	 * Goals that couldn't be reached are remembered by their structural hash,
+	 * so they aren't tried again with the same or fewer steps left. That is,
+	 * unless we gave up on them because they led back to a goal we were
+	 * working on, since they might work from elsewhere.
+	 *
+	 * With several threads, the rules for the goal are tried in parallel, and
+	 * the first proof found wins. Every step is checked by Rule::validate().
+	 */
+	class ProofSearch {
+	public:
+		enum Status {
+			FOUND,          // There is a proof.
+			NOT_FOUND,      // There is no proof within the maximal depth.
+			TIMEOUT,        // The time limit was reached.
+			OUT_OF_MEMORY   // Too many goals were expanded.
+		};
+
+		ProofSearch(const Theory &rules, const Theory &scope,
+			const SearchOptions &options = SearchOptions());
+		ProofSearch(const ProofSearch &) = delete;
+		ProofSearch &operator =(const ProofSearch &) = delete;
+		~ProofSearch();
+
+		Status search(const const_Expr_ptr &goal);
+
+		/**
+		 * Get the proof found by the last search. The last statement is the
+		 * goal, unless it was known already, then the proof is empty.
+		 *
+		 * @return Statements of the proof, referring to each other and to
+		 *      statements of the scope.
+		 */
+		const std::vector<const_Statement_ptr> &getProof() const
+			{return proof;}
+
+		Theory::iterator insert(Theory &theory, Theory::iterator after) const;
+
+		/**
+		 * Get the number of goals expanded by the last search.
+		 *
+		 * @return Number of goals.
+		 */
+		std::size_t getExpanded() const
+			{return expanded;}
+
+	private:
+		class Worker;
+		friend class Worker;
+
+		struct Known {
+			const_Expr_ptr expr;
+			Reference ref;
+		};
+
+		void addKnown(const Theory *theory, Theory::const_iterator it);
+		const Known *findKnown(const const_Expr_ptr &expr, std::size_t hash) const;
+		std::vector<RuleIndex::Candidate> candidates(const Expression *goal) const;
+
+		const RuleIndex index;
+		const SearchOptions options;
+
+		std::vector<Known> known;
+		std::unordered_multimap<std::size_t, std::size_t> known_hashes;
+
+		// Worker that found the proof, which holds its statements
+		std::unique_ptr<Worker> winner;
+		std::vector<const_Statement_ptr> proof;
+		std::size_t expanded;
+	};
+}	// End of namespace Core
+
+#endif
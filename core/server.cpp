@@ -0,0 +1,198 @@
+/*
+ *   Long-running verification with cached results.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "server.hpp"
+#include "buffer.hpp"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+using namespace Core;
+
+/**
+ * Construct server.
+ *
+ * @param rules Theory containing the rules, which mustn't be changed anymore.
+ * @param capacity Maximal number of theories to keep.
+ */
+VerificationServer::VerificationServer(std::shared_ptr<const Theory> rules, std::size_t capacity)
+	: max_text_length(std::size_t(1) << 26), verifier(std::move(rules), 1),
+	  capacity(capacity ? capacity : 1), hits(0), misses(0) {}
+
+/**
+ * Check a theory, or look up the result if it hasn't changed.
+ *
+ * @param name Name of the theory, used as key and in messages.
+ * @param begin Beginning of the buffer containing the theory.
+ * @param end End of the buffer.
+ * @param cached Pointer where we note if the result was looked up, or nullptr.
+ * @return Result of the check.
+ */
+BatchResult VerificationServer::check(const std::string &name, const char *begin,
+	const char *end, bool *cached)
+{
+	std::string content(begin, end);
+	std::size_t hash = std::hash<std::string>()(content);
+
+	auto it = table.find(name);
+	if (it != table.end()) {
+		Position position = it->second;
+		entries.splice(entries.begin(), entries, position);
+		if (position->hash == hash && position->content == content) {
+			++hits;
+			if (cached)
+				*cached = true;
+			return position->result;
+		}
+		entries.erase(position);
+		table.erase(it);
+	}
+
+	++misses;
+	if (cached)
+		*cached = false;
+	std::shared_ptr<const Theory> theory;
+	BatchResult result = verifier.verifyBuffer(name, content.data(),
+		content.data() + content.size(), &theory);
+
+	entries.push_front(Entry{name, hash, std::move(content), std::move(theory), result});
+	table.emplace(name, entries.begin());
+	if (entries.size() > capacity) {
+		table.erase(entries.back().name);
+		entries.pop_back();
+	}
+	return result;
+}
+
+/**
+ * Check a theory file, or look up the result if it hasn't changed.
+ *
+ * @param filename Name of the file containing the theory.
+ * @param cached Pointer where we note if the result was looked up, or nullptr.
+ * @return Result of the check.
+ */
+BatchResult VerificationServer::checkFile(const std::string &filename, bool *cached)
+{
+	InputBuffer file(filename);
+	if (!file) {
+		if (cached)
+			*cached = false;
+		return BatchResult{filename, -1, false, {},
+			"Couldn't read theory file " + filename + "\n"};
+	}
+	return check(filename, file.begin(), file.end(), cached);
+}
+
+/**
+ * Get a theory that was checked before.
+ *
+ * @param name Name of the theory.
+ * @return Theory as it was parsed, or an empty pointer if it isn't kept.
+ */
+std::shared_ptr<const Theory> VerificationServer::getTheory(const std::string &name) const
+{
+	auto it = table.find(name);
+	if (it != table.end())
+		return it->second->theory;
+	return nullptr;
+}
+
+/**
+ * Answer requests from a stream until it ends or we're told to quit.
+ * Requests are lines of the form
+ *
+ *     file <filename>
+ *     text <length> <name>
+ *     quit
+ *
+ * where "text" is followed by the given number of bytes of theory text.
+ * Every request is answered by a line of the form
+ *
+ *     <status> <cached|fresh> <length> <name>
+ *
+ * followed by the given number of bytes of messages. The status is one of
+ * "verified", "unverified" (proofs don't check), "error" (parse errors,
+ * unreadable file or failed check) or "invalid" (malformed request, or text
+ * longer than max_text_length).
+ *
+ * @param input Stream to read requests from.
+ * @param output Stream to write the answers to.
+ */
+void VerificationServer::serve(std::istream &input, std::ostream &output)
+{
+	std::string line;
+	while (std::getline(input, line)) {
+		std::istringstream request(line);
+		std::string command;
+		request >> command;
+		if (command.empty())
+			continue;
+		if (command == "quit")
+			break;
+
+		bool valid = true, cached = false;
+		BatchResult result;
+		std::size_t length;
+		try {
+			if (command == "file" && request >> std::ws
+					&& std::getline(request, result.filename))
+				result = checkFile(result.filename, &cached);
+			else if (command == "text" && request >> length >> std::ws
+					&& std::getline(request, result.filename)) {
+				if (length > max_text_length) {
+					// Skip the text, so that we find the next request.
+					input.ignore(std::streamsize(std::min<std::size_t>(length,
+						std::numeric_limits<std::streamsize>::max())));
+					valid = false;
+					result.messages = "Text too long: " + std::to_string(length)
+						+ " bytes\n";
+				}
+				else {
+					std::vector<char> text(length);
+					if (!input.read(text.data(), length))
+						break;
+					result = check(result.filename, text.data(), text.data() + length,
+						&cached);
+				}
+			}
+			else {
+				valid = false;
+				result.filename = line;
+				result.messages = "Invalid request: " + line + "\n";
+			}
+		}
+		catch (std::exception &ex) {
+			// Don't let one request take down the server.
+			result.verified = false;
+			result.errors = -1;
+			result.messages = std::string("Couldn't check theory: ") + ex.what() + "\n";
+		}
+
+		if (!valid)
+			output << "invalid fresh ";
+		else
+			output << (result.verified ? "verified" : result.errors ? "error" : "unverified")
+				<< (cached ? " cached " : " fresh ");
+		output << result.messages.size() << ' ' << result.filename << '\n'
+			<< result.messages;
+		output.flush();
+	}
+}
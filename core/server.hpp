@@ -0,0 +1,104 @@
+/*
+ *   Long-running verification with cached results.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_SERVER_HPP
+#define CORE_SERVER_HPP
+#include "forward.hpp"
+#include "batch.hpp"
+#include <cstddef>
+#include <istream>
+#include <list>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Verification server for editors and other tools that check the same
+	 * theories over and over. Parsed and verified theories are kept together
+	 * with their result, keyed by name. When a theory is checked again, it is
+	 * only parsed if its contents have changed. At most a given number of
+	 * theories are kept, the least recently used are dropped first.
+	 *
+	 * Requests can be read from a stream, see serve(). The server is not
+	 * thread-safe.
+	 */
+	class VerificationServer {
+	public:
+		VerificationServer(std::shared_ptr<const Theory> rules, std::size_t capacity = 256);
+
+		BatchResult check(const std::string &name, const char *begin, const char *end,
+			bool *cached = nullptr);
+		BatchResult checkFile(const std::string &filename, bool *cached = nullptr);
+		std::shared_ptr<const Theory> getTheory(const std::string &name) const;
+
+		void serve(std::istream &input, std::ostream &output);
+
+		// Longest theory text accepted by serve(), in bytes
+		std::size_t max_text_length;
+
+		/**
+		 * Get the number of theories kept.
+		 *
+		 * @return Number of theories.
+		 */
+		std::size_t size() const
+			{return entries.size();}
+
+		/**
+		 * Get the number of checks answered without parsing.
+		 *
+		 * @return Number of hits.
+		 */
+		std::size_t getHits() const
+			{return hits;}
+
+		/**
+		 * Get the number of checks that needed parsing.
+		 *
+		 * @return Number of misses.
+		 */
+		std::size_t getMisses() const
+			{return misses;}
+
+	private:
+		struct Entry {
+			std::string name;
+			std::size_t hash;
+			std::string content;
+			std::shared_ptr<const Theory> theory;
+			BatchResult result;
+		};
+		typedef std::list<Entry>::iterator Position;
+
+		const BatchVerifier verifier;
+		const std::size_t capacity;
+
+		// Entries, most recently used first
+		std::list<Entry> entries;
+		std::unordered_map<std::string, Position> table;
+		std::size_t hits, misses;
+	};
+}	// End of namespace Core
+
+#endif
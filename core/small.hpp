@@ -0,0 +1,88 @@
+/*
+ *   Short immutable sequences stored inline.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_SMALL_HPP
+#define CORE_SMALL_HPP
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Sequence that can't be changed after construction, keeping up to N
+	 * elements inside of itself. Only longer sequences are allocated on the
+	 * heap. Argument lists are mostly short, so this saves an allocation per
+	 * expression and a pointer indirection per traversal, compared to
+	 * std::vector.
+	 */
+	template <typename T, std::size_t N>
+	class SmallVector {
+	public:
+		typedef const T *const_iterator;
+
+		/**
+		 * Construct sequence by taking the elements of a vector.
+		 *
+		 * @param elements Elements of the sequence.
+		 */
+		SmallVector(std::vector<T> &&elements)
+			: length(elements.size())
+		{
+			T *data = length <= N ? reinterpret_cast<T *>(&local)
+				: (heap = static_cast<T *>(::operator new(length * sizeof(T))));
+			for (T &element : elements)
+				new (data++) T(std::move(element));
+		}
+
+		SmallVector(const SmallVector &) = delete;
+		SmallVector &operator =(const SmallVector &) = delete;
+
+		~SmallVector()
+		{
+			for (const T *it = begin(); it != end(); ++it)
+				it->~T();
+			if (length > N)
+				::operator delete(heap);
+		}
+
+		const_iterator begin() const
+			{return length <= N ? reinterpret_cast<const T *>(&local) : heap;}
+		const_iterator end() const
+			{return begin() + length;}
+
+		std::size_t size() const
+			{return length;}
+		const T &operator[](std::size_t index) const
+			{return begin()[index];}
+
+	private:
+		union {
+			typename std::aligned_storage<N * sizeof(T), alignof(T)>::type local;
+			T *heap;
+		};
+		std::uint32_t length;
+	};
+}	// End of namespace Core
+
+#endif
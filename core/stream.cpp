@@ -0,0 +1,106 @@
+/*
+ *   Verification while parsing.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stream.hpp"
+#include "logic.hpp"
+
+using namespace Core;
+
+/**
+ * Construct verifier and start its thread.
+ *
+ * @param capacity Maximum number of statements waiting to be checked.
+ * @param drop_proofs Remove proofs after checking them?
+ */
+StreamingVerifier::StreamingVerifier(std::size_t capacity, bool drop_proofs)
+	: capacity(capacity ? capacity : 1), drop_proofs(drop_proofs), done(false),
+	  checked(0), thread(&StreamingVerifier::run, this) {}
+
+/**
+ * Destruct verifier, after checking the remaining statements.
+ */
+StreamingVerifier::~StreamingVerifier()
+{
+	finish();
+}
+
+/**
+ * Hand over a statement to be checked. Waits if the queue is full.
+ *
+ * @param statement Statement with proof.
+ * @param it Iterator to the statement in its theory, which mustn't be
+ *      destroyed before finish() returns.
+ */
+void StreamingVerifier::push(Statement_ptr statement, Theory::const_iterator it)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		not_full.wait(lock, [this] {return queue.size() < capacity;});
+		queue.push_back(Item{std::move(statement), it});
+	}
+	not_empty.notify_one();
+}
+
+/**
+ * Check the remaining statements and stop the thread. No statements can be
+ * pushed afterwards.
+ *
+ * @param failed If not null, the statements whose proofs don't check are
+ *      appended in the order in which they were pushed.
+ * @return True, if all proofs check.
+ */
+bool StreamingVerifier::finish(std::vector<Theory::const_iterator> *failed)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done = true;
+	}
+	not_empty.notify_one();
+	if (thread.joinable())
+		thread.join();
+
+	if (failed)
+		failed->insert(failed->end(), invalid.begin(), invalid.end());
+	return invalid.empty();
+}
+
+/**
+ * Check statements until finish() is called and the queue is empty.
+ */
+void StreamingVerifier::run()
+{
+	while (true) {
+		Item item;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			not_empty.wait(lock, [this] {return done || !queue.empty();});
+			if (queue.empty())
+				return;
+			item = std::move(queue.front());
+			queue.pop_front();
+		}
+		not_full.notify_one();
+
+		if (!item.statement->getProof()->proves(*item.statement))
+			invalid.push_back(item.it);
+		else if (drop_proofs)
+			item.statement->addProof(Proof_ptr());
+		++checked;
+	}
+}
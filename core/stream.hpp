@@ -0,0 +1,87 @@
+/*
+ *   Verification while parsing.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_STREAM_HPP
+#define CORE_STREAM_HPP
+#include "forward.hpp"
+#include "theory.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Verifier stage for a parser: statements are handed over as soon as
+	 * their proof is parsed, and checked on a separate thread. The queue in
+	 * between is bounded, so the parser waits when it gets too far ahead.
+	 *
+	 * Proofs are never referenced by later objects, only the statements
+	 * themselves. So the proof of a statement can be dropped after it was
+	 * checked, which keeps memory usage low for large theories.
+	 */
+	class StreamingVerifier {
+	public:
+		StreamingVerifier(std::size_t capacity = 1024, bool drop_proofs = false);
+		StreamingVerifier(const StreamingVerifier &) = delete;
+		StreamingVerifier &operator =(const StreamingVerifier &) = delete;
+		~StreamingVerifier();
+
+		void push(Statement_ptr statement, Theory::const_iterator it);
+		bool finish(std::vector<Theory::const_iterator> *failed = nullptr);
+
+		/**
+		 * Get the number of proofs checked so far.
+		 *
+		 * @return Number of proofs checked.
+		 */
+		std::size_t getChecked() const
+			{return checked;}
+
+	private:
+		struct Item {
+			Statement_ptr statement;
+			Theory::const_iterator it;
+		};
+
+		void run();
+
+		const std::size_t capacity;
+		const bool drop_proofs;
+
+		std::mutex mutex;
+		std::condition_variable not_empty, not_full;
+		std::deque<Item> queue;
+		bool done;
+
+		// Only accessed by the verifier thread until it is stopped
+		std::vector<Theory::const_iterator> invalid;
+		std::atomic<std::size_t> checked;
+
+		std::thread thread;
+	};
+}	// End of namespace Core
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ *   Interned symbols for names.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "symbol.hpp"
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+using namespace Core;
+
+namespace {
+	// Characters we look up, possibly not owned by the table, and their hash.
+	struct Key {
+		const char *data;
+		std::size_t length;
+		std::size_t hash;
+
+		bool operator ==(const Key &other) const
+		{
+			return length == other.length &&
+				std::memcmp(data, other.data, length) == 0;
+		}
+	};
+
+	// FNV-1a
+	std::size_t hashChars(const char *data, std::size_t length)
+	{
+		std::size_t hash = 2166136261u;
+		for (std::size_t i = 0; i < length; ++i) {
+			hash ^= (unsigned char)data[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	struct KeyHash {
+		std::size_t operator ()(const Key &key) const
+			{return key.hash;}
+	};
+
+	/**
+	 * Global symbol table. It is split into shards by hash, each with its
+	 * own lock, so that threads interning different strings rarely wait for
+	 * each other. The strings live in a deque, so their addresses never
+	 * change; the keys point into them.
+	 */
+	class SymbolTable {
+	public:
+		const std::string *intern(const char *data, std::size_t length)
+		{
+			Key key{data, length, hashChars(data, length)};
+			Shard &shard = shards[shardOf(key)];
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			auto it = shard.entries.find(key);
+			if (it != shard.entries.end())
+				return it->second;
+
+			shard.strings.emplace_back(data, length);
+			const std::string *entry = &shard.strings.back();
+			shard.entries.emplace(Key{entry->data(), entry->size(), key.hash}, entry);
+			return entry;
+		}
+
+		const std::string *find(const char *data, std::size_t length)
+		{
+			Key key{data, length, hashChars(data, length)};
+			Shard &shard = shards[shardOf(key)];
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			auto it = shard.entries.find(key);
+			return it != shard.entries.end() ? it->second : nullptr;
+		}
+
+	private:
+		struct Shard {
+			std::mutex mutex;
+			std::deque<std::string> strings;
+			std::unordered_map<Key, const std::string *, KeyHash> entries;
+		};
+
+		// The maps use the low bits of the hash, so we take higher ones.
+		static const std::size_t num_shards = 64;
+		static std::size_t shardOf(const Key &key)
+			{return (key.hash >> 16) % num_shards;}
+
+		Shard shards[num_shards];
+	};
+
+	// Constructed on first use, so symbols can be created during static
+	// initialization of other translation units.
+	SymbolTable &table()
+	{
+		static SymbolTable instance;
+		return instance;
+	}
+}
+
+// String of the null symbol
+const std::string &Symbol::null()
+{
+	static const std::string empty;
+	return empty;
+}
+
+/**
+ * Intern a string.
+ *
+ * @param name String to intern.
+ */
+Symbol::Symbol(const std::string &name)
+	: entry(table().intern(name.data(), name.size())) {}
+
+/**
+ * Intern a null-terminated string.
+ *
+ * @param name String to intern.
+ */
+Symbol::Symbol(const char *name)
+	: entry(table().intern(name, std::strlen(name))) {}
+
+/**
+ * Intern a sequence of characters.
+ *
+ * @param data Pointer to the first character.
+ * @param length Number of characters.
+ */
+Symbol::Symbol(const char *data, std::size_t length)
+	: entry(table().intern(data, length)) {}
+
+/**
+ * Look up a string without interning it.
+ *
+ * @param name String to look up.
+ * @return Symbol for the string, or the null symbol if it was never interned.
+ */
+Symbol Symbol::find(const std::string &name)
+{
+	return Symbol(table().find(name.data(), name.size()));
+}
@@ -0,0 +1,94 @@
+/*
+ *   Interned symbols for names.
+ *   Copyright (C) 2014 Aaron Puchert
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CORE_SYMBOL_HPP
+#define CORE_SYMBOL_HPP
+#include <cstddef>
+#include <functional>
+#include <string>
+
+/**
+ * Namespace for logic core
+ */
+namespace Core {
+	/**
+	 * Interned string. There is only one copy of every string in a global
+	 * table, so symbols can be compared and hashed by address. Symbols are
+	 * never removed from the table. Interning is thread-safe.
+	 */
+	class Symbol {
+	public:
+		/**
+		 * Construct a null symbol, which is different from all interned
+		 * strings, including the empty one.
+		 */
+		Symbol() : entry(nullptr) {}
+		Symbol(const std::string &name);
+		Symbol(const char *name);
+		Symbol(const char *data, std::size_t length);
+
+		static Symbol find(const std::string &name);
+
+		/**
+		 * Get the string.
+		 *
+		 * @return Interned string, or an empty string for the null symbol.
+		 */
+		const std::string &str() const
+			{return entry ? *entry : null();}
+
+		/**
+		 * Is this an interned string or the null symbol?
+		 *
+		 * @return True, if this is not the null symbol.
+		 */
+		explicit operator bool() const
+			{return entry;}
+
+		bool operator ==(Symbol other) const
+			{return entry == other.entry;}
+		bool operator !=(Symbol other) const
+			{return entry != other.entry;}
+
+		/**
+		 * Hash value, consistent with operator ==.
+		 *
+		 * @return Hash value.
+		 */
+		std::size_t hash() const
+			{return std::hash<const std::string *>()(entry);}
+
+	private:
+		explicit Symbol(const std::string *entry) : entry(entry) {}
+
+		static const std::string &null();
+
+		const std::string *entry;
+	};
+}	// End of namespace Core
+
+namespace std {
+	template <>
+	struct hash<Core::Symbol> {
+		std::size_t operator ()(Core::Symbol symbol) const
+			{return symbol.hash();}
+	};
+}
+
+#endif
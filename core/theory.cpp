@@ -18,43 +18,45 @@
  */
 
 #include "theory.hpp"
+#include "cache.hpp"
+#include "lazy.hpp"
 #include "logic.hpp"
+#include "parallel.hpp"
+#include "profile.hpp"
 #include <algorithm>
 #include "debug.hpp"
 using namespace Core;
 
-namespace {
-	/**
-	 * Dummy node class for searching.
-	 */
-	class SearchObject : public Object {
-	public:
-		SearchObject(const std::string& name)
-			: Object(BuiltInType::undefined, name) {}
-		Object_ptr clone() const
-			{return std::make_shared<SearchObject>(*this);}
-		void accept(Visitor *visitor) const
-			{}
-	};
-}
-
-/**
- * Compare function object for nodes, similar to std::less.
- */
-bool Theory::NodeCompare::operator ()(const Object *x, const Object *y) const
-{
-	return (x->getName() < y->getName());
-}
-
 /**
  * Construct a theory.
  *
  * @param parent The parent theory, if this is a subtheory, otherwise nullptr.
  * @param parent_node Iterator to the object referring to this theory.
  */
-Theory::Theory(Theory *parent, Theory::iterator parent_object)
+Theory::Theory(Theory *parent, Theory::const_iterator parent_object)
 	: parent(parent), parent_object(parent_object) {}
 
+namespace {
+	// Get the last object of a theory, or its end if it's empty.
+	Theory::const_iterator last(const Theory &theory)
+	{
+		Theory::const_iterator it = theory.end();
+		return theory.size() ? --it : it;
+	}
+}
+
+/**
+ * Fork a theory. This takes constant time, since the objects of the base
+ * are shared, not copied. Statements of the fork may refer to objects of the
+ * base by name, or relative to the last object by "parent~<n>". Adding an
+ * object with the name of a base object overrides it in the fork.
+ *
+ * @param base Theory to fork, which mustn't be changed anymore.
+ */
+Theory::Theory(std::shared_ptr<const Theory> base)
+	: parent(base.get()), parent_object(last(*base)), arena(base->arena),
+	  base(std::move(base)) {}
+
 /**
  * Construct a theory from a list of nodes.
  *
@@ -63,20 +65,66 @@ Theory::Theory(Theory *parent, Theory::iterator parent_object)
 Theory::Theory(std::initializer_list<Object_ptr> objects) : parent(nullptr)
 {
 	iterator it = begin();
-	for (Object_ptr node : objects)
+	for (const Object_ptr &node : objects)
 		it = add(node, it);
 }
 
 /**
- * Copy construct a theory.
+ * Copy construct a theory. The objects are cloned, but a fork stays a fork
+ * of the same base. Proofs are parsed if they were skipped, and refer to the
+ * statements of the copy instead of the original.
  *
  * @param theory Other theory.
  */
-Theory::Theory(const Theory &theory) : parent(nullptr)
+Theory::Theory(const Theory &theory)
+	: parent(theory.base ? theory.parent : nullptr),
+	  parent_object(theory.base ? theory.parent_object : const_iterator()),
+	  arena(theory.arena), base(theory.base)
 {
 	iterator it = begin();
-	for (const_Object_ptr node : theory)
+	for (const Object_ptr &node : theory)
 		it = add(node->clone(), it);
+
+	// Proofs might refer to statements after them, so do that afterwards.
+	for (const Object_ptr &object : objects)
+		if (auto statement = dynamic_cast<Statement *>(object.get()))
+			statement->rebase(&theory, this);
+}
+
+/**
+ * Move construct a theory. Objects and iterators stay the same, and lazy
+ * proofs find the theory at its new place.
+ *
+ * @param theory Other theory.
+ */
+Theory::Theory(Theory &&theory)
+	: parent(theory.parent), parent_object(theory.parent_object),
+	  arena(std::move(theory.arena)), base(std::move(theory.base)),
+	  anchor(std::move(theory.anchor)), objects(std::move(theory.objects)),
+	  name_space(std::move(theory.name_space)), order(std::move(theory.order)),
+	  index(std::move(theory.index))
+{
+	if (anchor)
+		*anchor = this;
+}
+
+Theory::~Theory()
+{
+	if (anchor)
+		*anchor = nullptr;
+}
+
+/**
+ * Get a pointer that always points to this theory, even if it's moved, and
+ * is null once the theory is destroyed.
+ *
+ * @return Shared pointer to the address of this theory.
+ */
+std::shared_ptr<const Theory *const> Theory::getAnchor()
+{
+	if (!anchor)
+		anchor = std::make_shared<const Theory *>(this);
+	return anchor;
 }
 
 /**
@@ -89,16 +137,66 @@ Theory::Theory(const Theory &theory) : parent(nullptr)
  */
 Theory::iterator Theory::add(Object_ptr object, iterator after)
 {
-	auto entry = name_space.find(object.get());
+	Symbol name = object->getSymbol();
+	return insert(name, std::move(object), after);
+}
+
+/**
+ * Reserve a place for an object that is stored later by assigning to the
+ * returned iterator. Its name can already be looked up, but the object
+ * mustn't be accessed before it was stored.
+ *
+ * @param name Name of the object, possibly empty.
+ * @param after Iterator pointing to the node after which to insert.
+ * @return Iterator to the empty place.
+ * @throw Core::NamespaceException if an object of the same name already exists.
+ */
+Theory::iterator Theory::reserve(Symbol name, iterator after)
+{
+	return insert(name, Object_ptr(), after);
+}
+
+/**
+ * Remove all objects.
+ */
+void Theory::clear()
+{
+	objects.clear();
+	name_space.clear();
+	order.clear();
+	index.clear();
+}
+
+/**
+ * Insert object into the list and the indices.
+ *
+ * @param name Name of the object, possibly empty.
+ * @param object Object to add, might be null.
+ * @param after Iterator pointing to the node after which to insert.
+ * @return Iterator to the newly inserted object.
+ * @throw Core::NamespaceException if an object of the same name already exists.
+ *      In forks, objects of the base may be overridden, so only the fork's own
+ *      objects count.
+ */
+Theory::iterator Theory::insert(Symbol name, Object_ptr object, iterator after)
+{
+	auto entry = name_space.find(name);
 	if (entry == name_space.end()) {
-		iterator position = objects.insert(++after, object);
-		if (object->getName() != "")
-			name_space[object.get()] = position;
+		iterator next = ++after;
+		iterator position = objects.insert(next, std::move(object));
+		if (name.str() != "")
+			name_space.emplace(name, position);
+
+		// Update the positional index. Appending is cheap, inserting
+		// elsewhere means renumbering all objects after the new one.
+		std::size_t number = (next == objects.end()) ? order.size() : index[&*next];
+		order.insert(order.begin() + number, position);
+		for (std::size_t i = number; i < order.size(); ++i)
+			index[&*order[i]] = i;
 		return position;
 	}
 	else
-		throw NamespaceException(NamespaceException::DUPLICATE,
-			object->getName());
+		throw NamespaceException(NamespaceException::DUPLICATE, name.str());
 }
 
 /**
@@ -109,14 +207,58 @@ Theory::iterator Theory::add(Object_ptr object, iterator after)
  */
 Theory::const_iterator Theory::get(const std::string& reference) const
 {
-	// construct a dummy node
-	SearchObject node(reference);
+	// If the name was never interned, nobody can have it.
+	Symbol symbol = Symbol::find(reference);
+	if (!symbol)
+		return objects.end();
+
+	return get(symbol);
+}
 
-	auto entry = name_space.find(&node);
-	if (entry != name_space.end())
-		return entry->second;
-	else if (parent != nullptr)
-		return parent->get(reference);
+/**
+ * Get the object having a specific name. We walk up the chain of enclosing
+ * theories, which costs one hash table lookup per scope.
+ *
+ * @param reference Identifier to search for.
+ * @return Iterator to the node or to the end, if no such node exists.
+ */
+Theory::const_iterator Theory::get(Symbol reference) const
+{
+	for (const Theory *scope = this; scope; scope = scope->parent) {
+		auto entry = scope->name_space.find(reference);
+		if (entry != scope->name_space.end())
+			return entry->second;
+	}
+
+	return objects.end();
+}
+
+/**
+ * Get the position of an object in the theory.
+ *
+ * @param it Iterator into this theory, or end().
+ * @return Position of the object, size() for end(), or npos if the iterator
+ *      doesn't belong to this theory.
+ */
+std::size_t Theory::position(const_iterator it) const
+{
+	if (it == objects.end())
+		return order.size();
+
+	auto entry = index.find(&*it);
+	return (entry != index.end()) ? entry->second : npos;
+}
+
+/**
+ * Get the object at some position.
+ *
+ * @param position Position of the object.
+ * @return Iterator to the object, or end() if the position is out of range.
+ */
+Theory::const_iterator Theory::at(std::size_t position) const
+{
+	if (position < order.size())
+		return order[position];
 	else
 		return objects.end();
 }
@@ -148,9 +290,9 @@ Theory::const_iterator Theory::end() const
  */
 bool Theory::verify() const
 {
-	return std::all_of(objects.begin(), objects.end(), [] (Object_ptr object) -> bool {
+	return std::all_of(objects.begin(), objects.end(), [] (const Object_ptr &object) -> bool {
 		if (object->getType() == BuiltInType::statement) {
-			auto stmt = std::dynamic_pointer_cast<Statement>(object);
+			auto stmt = dynamic_cast<const Statement *>(object.get());
 			if (stmt && stmt->hasProof())
 				return stmt->getProof()->proves(*stmt);
 		}
@@ -158,16 +300,59 @@ bool Theory::verify() const
 	});
 }
 
+/**
+ * Verify the theory in parallel. Other than verify(), this doesn't stop at the
+ * first statement that can't be verified.
+ *
+ * @param num_threads Number of threads to use, or 0 for the number of cores.
+ * @param failed If not null, the statements that couldn't be verified are
+ *      appended in the order in which they appear in the theory.
+ * @param cache Cache for the results of rule applications, or nullptr.
+ * @return True, when the theory verifies, false if it doesn't.
+ */
+bool Theory::verify(unsigned num_threads, std::vector<const_iterator> *failed,
+	VerificationCache *cache) const
+{
+	// Collect the statements that have proofs.
+	std::vector<const_iterator> statements;
+	for (const_iterator it = objects.begin(); it != objects.end(); ++it)
+		if ((*it)->getType() == BuiltInType::statement) {
+			auto stmt = dynamic_cast<const Statement *>(it->get());
+			if (stmt && stmt->hasProof())
+				statements.push_back(it);
+		}
+
+	// Check them. We don't use std::vector<bool>, since concurrent writes to
+	// different elements have to be safe.
+	std::vector<char> valid(statements.size());
+	WorkStealingScheduler scheduler(num_threads);
+	scheduler.parallelFor(statements.size(), [&statements, &valid, cache] (std::size_t i) {
+		auto stmt = static_cast<const Statement *>(statements[i]->get());
+		valid[i] = stmt->getProof()->proves(*stmt, cache);
+	});
+
+	// Report
+	bool result = true;
+	for (std::size_t i = 0; i < statements.size(); ++i)
+		if (!valid[i]) {
+			result = false;
+			if (failed)
+				failed->push_back(statements[i]);
+		}
+
+	return result;
+}
+
 /**
  * Construct a statement node.
  *
  * @param name Name of the statement.
  * @param expr Contents of the statement.
  */
-Statement::Statement(const std::string &name, Expr_ptr expr)
+Statement::Statement(Symbol name, Expr_ptr expr)
 	: Node(BuiltInType::statement, name)
 {
-	const_Expr_ptr type = expr->getType();
+	const const_Expr_ptr &type = expr->getType();
 	if (type == BuiltInType::statement)
 		setDefinition(expr);
 	else
@@ -184,6 +369,33 @@ Object_ptr Statement::clone() const
 	return std::make_shared<Statement>(*this);
 }
 
+/**
+ * Get proof of the statement, not necessarily valid. Proofs that were skipped
+ * by the parser are parsed now.
+ *
+ * @return Proof of the statement.
+ */
+const_Proof_ptr Statement::getProof() const
+{
+	if (auto lazy = dynamic_cast<const LazyProof *>(proof.get())) {
+		// If it doesn't parse, we keep the lazy proof, which proves nothing.
+		const_Proof_ptr loaded = lazy->get();
+		return loaded ? loaded : proof;
+	}
+	return proof;
+}
+
+/**
+ * Is the proof of the statement there, or does it still have to be parsed?
+ *
+ * @return False, if the proof has been skipped and wasn't needed yet.
+ */
+bool Statement::isLoaded() const
+{
+	auto lazy = dynamic_cast<const LazyProof *>(proof.get());
+	return !lazy || lazy->isLoaded();
+}
+
 /**
  * Add a proof to a statement.
  *
@@ -194,6 +406,20 @@ void Statement::addProof(Proof_ptr proof)
 	this->proof = proof;
 }
 
+/**
+ * Let the proof refer to the statements of another theory instead, e.g.
+ * after the statement was cloned into a copy of its theory. Proofs that
+ * were skipped are parsed first.
+ *
+ * @param from Theory the proof refers to now.
+ * @param to Theory with objects at the same positions.
+ */
+void Statement::rebase(const Theory *from, const Theory *to)
+{
+	if (auto step = std::dynamic_pointer_cast<const ProofStep>(getProof()))
+		proof = step->rebase(from, to);
+}
+
 /**
  * Construct a reference.
  *
@@ -206,6 +432,8 @@ Reference::Reference(const Theory *theory, Theory::const_iterator it)
 /**
  * Construct reference from description string.
  *
+ * @param this_theory Theory which contains `this`.
+ * @param this_it Iterator to `this`.
  * @param description Description string.
  */
 Reference::Reference(const Theory *this_theory, Theory::const_iterator this_it,
@@ -215,8 +443,8 @@ Reference::Reference(const Theory *this_theory, Theory::const_iterator this_it,
 	int diff = 0;
 
 	// Absolute or relative?
-	int pos_tilde = description.find('~');
-	if (pos_tilde) {
+	std::size_t pos_tilde = description.find('~');
+	if (pos_tilde != std::string::npos) {
 		// Relative: Use the hierarchy or stack
 		base = description.substr(0, pos_tilde);
 		std::istringstream str(description.substr(pos_tilde+1));
@@ -235,7 +463,7 @@ Reference::Reference(const Theory *this_theory, Theory::const_iterator this_it,
 		ref = this_theory->parent_object;
 	}
 	// - parent^<n>
-	else if (base.substr(0, 6) == "parent^") {
+	else if (base.substr(0, 7) == "parent^") {
 		int level;
 		std::istringstream str(base.substr(7));
 		str >> level;
@@ -244,19 +472,32 @@ Reference::Reference(const Theory *this_theory, Theory::const_iterator this_it,
 		theory = this_theory;
 		ref = this_it;
 		while (level--) {
-			theory = theory->parent;
 			ref = theory->parent_object;
+			theory = theory->parent;
 		}
 	}
 	// - <name>
 	else {
-		// How do we get base_theory? We might not need it, but this is ugly.
 		ref = this_theory->get(base);
+
+		// In forks, a name overridden after this still means the base object.
+		if (this_theory->getBase() && ref != this_theory->end()
+				&& this_theory->position(ref) != Theory::npos
+				&& this_theory->position(ref) > this_theory->position(this_it)) {
+			Theory::const_iterator original = this_theory->getBase()->get(base);
+			if (original != this_theory->getBase()->end())
+				ref = original;
+		}
+
+		// Find the theory containing it.
+		theory = this_theory;
+		if (ref != this_theory->end())
+			while (theory->parent && theory->position(ref) == Theory::npos)
+				theory = theory->parent;
 	}
 
 	// Now step back...
-	while (diff--)
-		--ref;
+	*this -= diff;
 }
 
 /**
@@ -268,28 +509,21 @@ Reference::Reference(const Theory *this_theory, Theory::const_iterator this_it,
 std::string Reference::getDescription(const Theory *this_theory,
 	Theory::const_iterator this_it) const
 {
-	// Does the referred statement have a name?
-	if ((*ref)->getName() != "")
+	// Does the referred statement have a name? In forks, it might be
+	// overridden, then we can't use it.
+	if ((*ref)->getName() != "" && this_theory->get((*ref)->getSymbol()) == ref)
 		return (*ref)->getName();
 
 	// What about name~n?
 
-	// Try to find the referenced statement
+	// Go up until we are in the theory of the referenced statement.
 	Theory::const_iterator level_head(this_it);
 	int level_val = 0;
-	int diff;
-
-	for (const Theory *level = this_theory; level; level = level->parent) {
-		for (diff = 0; (level_head != level->end())
-			&& (level_head != ref); ++diff) --level_head;
-
-		// level up
-		if (level->parent && level_head != ref) {
-			level_head = level->parent_object;
-			++level_val;
-		}
-		else
-			break;
+	const Theory *level = this_theory;
+	while (level != theory && level->parent) {
+		level_head = level->parent_object;
+		level = level->parent;
+		++level_val;
 	}
 
 	// What should we do if we don't find anything:
@@ -297,6 +531,7 @@ std::string Reference::getDescription(const Theory *this_theory,
 	// 2. Use some kind of hash?
 
 	// Found it? Return <base>~<diff>.
+	int diff = level->position(level_head) - level->position(ref);
 	std::ostringstream stream;
 	if (level_val) {
 		if (level_val > 1)
@@ -317,8 +552,8 @@ std::string Reference::getDescription(const Theory *this_theory,
  */
 Reference& Reference::operator -=(int diff)
 {
-	while (diff--)
-		--ref;
+	if (diff && theory)
+		ref = theory->at(theory->position(ref) - diff);
 	return *this;
 }
 
@@ -345,11 +580,13 @@ int Core::operator -(const Reference& a, const Reference& b)
 {
 	if (a.theory != b.theory)
 		return -1;
+	if (!a.theory)
+		return (a.ref == b.ref) ? 0 : -1;
 
-	int diff = 0;
-	for (Theory::const_iterator it = a.ref; it != b.ref; ++it)
-		++diff;
-	return diff;
+	std::size_t pos_a = a.theory->position(a.ref), pos_b = a.theory->position(b.ref);
+	if (pos_a == Theory::npos || pos_b == Theory::npos || pos_b < pos_a)
+		return -1;
+	return pos_b - pos_a;
 }
 
 
@@ -361,24 +598,93 @@ int Core::operator -(const Reference& a, const Reference& b)
  * @param statement_list List of statements referenced.
  */
 ProofStep::ProofStep(const_Rule_ptr rule, const std::vector<Expr_ptr>& var_list, std::vector< Reference >&& statement_list )
-	: rule(rule), ref_statement_list(std::move(statement_list))
+	: ProofStep(std::move(rule), std::vector<Expr_ptr>(var_list), std::move(statement_list)) {}
+
+/**
+ * Initialize a proof step, taking the substitutions.
+ *
+ * @param rule Pointer to the rule to be used.
+ * @param var_list List of expressions which substitute the rule variables.
+ * @param statement_list List of statements referenced.
+ */
+ProofStep::ProofStep(const_Rule_ptr rule, std::vector<Expr_ptr> &&var_list,
+	std::vector<Reference> &&statement_list)
+	: rule(std::move(rule)), ref_statement_list(std::move(statement_list)), inferred(false)
 {
 	// Do we have a rule?
-	if (rule->getType() != BuiltInType::rule)
-		throw TypeException(rule->getType(), BuiltInType::rule);
+	if (this->rule->getType() != BuiltInType::rule)
+		throw TypeException(this->rule->getType(), BuiltInType::rule);
 
 	TypeComparator compare(&subst);
 
 	// Create context and check types
-	auto param_it = rule->getParams().begin();
+	const std::vector<Node_ptr> &params = this->rule->getParams();
+	auto param_it = params.begin();
 	auto sub_it = var_list.begin();
-	for (;  param_it != rule->getParams().end(); ++param_it, ++sub_it) {
+	for (;  param_it != params.end(); ++param_it, ++sub_it) {
 		if (!compare((*param_it)->getType().get(), (*sub_it)->getType().get()))
 			throw TypeException((*param_it)->getType(), (*sub_it)->getType());
-		subst.insert({*param_it, *sub_it});
+		subst.emplace(*param_it, std::move(*sub_it));
 	}
 }
 
+/**
+ * Initialize a proof step without checking the types of the substitutions.
+ *
+ * @param rule Pointer to the rule to be used.
+ * @param var_list List of expressions which substitute the rule variables.
+ * @param statement_list List of statements referenced.
+ */
+ProofStep::ProofStep(const_Rule_ptr rule, const std::vector<Expr_ptr> &var_list,
+	std::vector<Reference> &&statement_list, Unchecked)
+	: ProofStep(std::move(rule), std::vector<Expr_ptr>(var_list), std::move(statement_list),
+		Unchecked()) {}
+
+/**
+ * Initialize a proof step without checking the types, taking the
+ * substitutions.
+ *
+ * @param rule Pointer to the rule to be used.
+ * @param var_list List of expressions which substitute the rule variables.
+ * @param statement_list List of statements referenced.
+ */
+ProofStep::ProofStep(const_Rule_ptr rule, std::vector<Expr_ptr> &&var_list,
+	std::vector<Reference> &&statement_list, Unchecked)
+	: rule(std::move(rule)), ref_statement_list(std::move(statement_list)), inferred(false)
+{
+	auto sub_it = var_list.begin();
+	for (const Node_ptr &param : this->rule->getParams())
+		subst.emplace(param, std::move(*sub_it++));
+}
+
+/**
+ * Initialize a proof step with arguments found by Rule::infer().
+ *
+ * @param rule Pointer to the rule to be used.
+ * @param inferred Arguments for the rule parameters.
+ * @param statement_list List of statements referenced.
+ */
+ProofStep::ProofStep(const_Rule_ptr rule, Context &&inferred,
+	std::vector<Reference> &&statement_list)
+	: rule(std::move(rule)), subst(std::move(inferred)), ref_statement_list(std::move(statement_list)),
+	  inferred(true) {}
+
+/**
+ * Copy the proof step, with references to another theory instead.
+ *
+ * @param from Theory whose objects are referred to now.
+ * @param to Theory with objects at the same positions.
+ * @return Copy of the proof step.
+ */
+Proof_ptr ProofStep::rebase(const Theory *from, const Theory *to) const
+{
+	auto step = std::make_shared<ProofStep>(*this);
+	for (Reference &ref : step->ref_statement_list)
+		if (ref.getTheory() == from)
+			ref = Reference(to, to->at(from->position(ref.getIterator())));
+	return step;
+}
+
 /**
  * Get the substitute of a certain node.
  *
@@ -398,9 +704,16 @@ const_Expr_ptr ProofStep::operator[](const_Node_ptr node) const
  * Does the proof step prove a certain statement?
  *
  * @param statement Statement to prove
+ * @param cache Cache for the results of rule applications, or nullptr.
  * @return True, if the statement can be proven this way.
  */
-bool ProofStep::proves(const Statement &statement) const
+bool ProofStep::proves(const Statement &statement, VerificationCache *cache) const
 {
-	return rule->validate(subst, ref_statement_list, statement.getDefinition());
+	LOGIC_PROFILE_SCOPE(statement_scope, Profile::STATEMENT, Profile::describe(&statement));
+	LOGIC_PROFILE_SCOPE(rule_scope, Profile::RULE, rule->getSymbol());
+
+	if (cache)
+		return cache->validate(rule, subst, ref_statement_list, statement.getDefinition());
+	else
+		return rule->validate(subst, ref_statement_list, statement.getDefinition());
 }
@@ -25,6 +25,7 @@
 #include <vector>
 #include <list>
 #include <map>
+#include <unordered_map>
 #include <initializer_list>
 #include "traverse.hpp"
 
@@ -37,7 +38,15 @@ namespace Core {
 	 *
 	 * The objects are arranged in a list. To add an object, one has to have
 	 * an iterator into that list after which to insert. Theories are
-	 * searchable by name.
+	 * searchable by name, and objects can be addressed by their position.
+	 *
+	 * A theory can be forked from a base theory that isn't changed anymore.
+	 * The fork shares the objects and names of its base instead of copying
+	 * them, and only holds the objects added to it. Names are looked up
+	 * through the chain of bases, while iteration and positions only cover
+	 * the objects of the fork itself, like for subtheories. An object added
+	 * under the name of a base object overrides it for the fork, from there
+	 * on, while the base and its own references stay as they were.
 	 */
 	class Theory {
 	public:
@@ -45,10 +54,12 @@ namespace Core {
 		using iterator = std::list<Object_ptr>::iterator;
 		using const_iterator = std::list<Object_ptr>::const_iterator;
 
-		Theory(Theory *parent = nullptr, iterator parent_object = iterator());
+		Theory(Theory *parent = nullptr, const_iterator parent_object = const_iterator());
+		explicit Theory(std::shared_ptr<const Theory> base);
 		Theory(std::initializer_list<Object_ptr> objects);
 		Theory(const Theory &theory);
-		Theory(Theory &&theory) = default;
+		Theory(Theory &&theory);
+		~Theory();
 
 		// Iterate through objects
 		iterator begin();
@@ -58,23 +69,60 @@ namespace Core {
 
 		// Add and get objects: declarations, definitions, and statements.
 		iterator add(Object_ptr object, iterator after);
+		iterator reserve(Symbol name, iterator after);
+		void clear();
 		const_iterator get(const std::string& reference) const;
+		const_iterator get(const char *reference) const
+			{return get(std::string(reference));}
+		const_iterator get(Symbol reference) const;
+
+		// Positional access
+		static const std::size_t npos = -1;
+		std::size_t size() const
+			{return order.size();}
+		std::size_t position(const_iterator it) const;
+		const_iterator at(std::size_t position) const;
 
 		// Miscellaneous
 		void accept(Visitor *visitor) const
 			{visitor->visit(this);}
 		bool verify() const;
+		bool verify(unsigned num_threads,
+			std::vector<const_iterator> *failed = nullptr,
+			VerificationCache *cache = nullptr) const;
 
 		const Theory *parent;
-		const iterator parent_object;
+		const const_iterator parent_object;
+
+		/**
+		 * Get the theory this was forked from.
+		 *
+		 * @return Base theory, or an empty pointer if this isn't a fork.
+		 */
+		const std::shared_ptr<const Theory> &getBase() const
+			{return base;}
+
+		std::shared_ptr<const Theory *const> getAnchor();
+
+		// Arena the objects were allocated in, if any
+		std::shared_ptr<Arena> arena;
 
 	private:
+		iterator insert(Symbol name, Object_ptr object, iterator after);
+
+		// Theory we were forked from; it is our parent, too.
+		std::shared_ptr<const Theory> base;
+
+		// Where we are, kept up to date when we're moved
+		std::shared_ptr<const Theory *> anchor;
+
 		// Dependencies?
 		std::list<Object_ptr> objects;
-		struct NodeCompare : public std::binary_function<Object *, Object *, bool> {
-			bool operator ()(const Object *, const Object *) const;
-		};
-		std::map<Object *, iterator, NodeCompare> name_space;
+		std::unordered_map<Symbol, iterator> name_space;
+
+		// Positional index: objects in order and the position of each list entry
+		std::vector<iterator> order;
+		std::unordered_map<const Object_ptr *, std::size_t> index;
 	};
 
 	/**
@@ -82,7 +130,7 @@ namespace Core {
 	 */
 	class Statement : public Node {
 	public:
-		Statement(const std::string &name, Expr_ptr expr);
+		Statement(Symbol name, Expr_ptr expr);
 		Object_ptr clone() const;
 
 		/**
@@ -93,15 +141,10 @@ namespace Core {
 		bool hasProof() const
 			{return (bool)proof;}
 
-		/**
-		 * Get proof of the statement, not necessarily valid.
-		 *
-		 * @return Proof of the statement.
-		 */
-		const_Proof_ptr getProof() const
-			{return proof;}
-
+		const_Proof_ptr getProof() const;
+		bool isLoaded() const;
 		void addProof(Proof_ptr proof);
+		void rebase(const Theory *from, const Theory *to);
 
 		void accept(Visitor *visitor) const
 			{visitor->visit(this);}
@@ -130,6 +173,22 @@ namespace Core {
 		const_Object_ptr operator *() const
 			{return *ref;}
 
+		/**
+		 * Get the theory containing the referenced object.
+		 *
+		 * @return Theory of the reference.
+		 */
+		const Theory *getTheory() const
+			{return theory;}
+
+		/**
+		 * Get iterator to the referenced object.
+		 *
+		 * @return Iterator into getTheory().
+		 */
+		Theory::const_iterator getIterator() const
+			{return ref;}
+
 		Reference& operator -=(int diff);
 
 		void accept(Visitor *visitor) const
@@ -158,9 +217,11 @@ namespace Core {
 		 * Does the proof prove a statement?
 		 *
 		 * @param statement Statement to verify.
+		 * @param cache Cache for the results of rule applications, or nullptr.
 		 * @return True, if the statement could be verified by the proof.
 		 */
-		virtual bool proves(const Statement &statement) const = 0;
+		virtual bool proves(const Statement &statement,
+			VerificationCache *cache = nullptr) const = 0;
 
 		/**
 		 * Accept a Visitor.
@@ -178,6 +239,17 @@ namespace Core {
 		ProofStep(const_Rule_ptr rule,
 			const std::vector<Expr_ptr> &var_list,
 			std::vector<Reference> &&statement_list);
+		ProofStep(const_Rule_ptr rule,
+			std::vector<Expr_ptr> &&var_list,
+			std::vector<Reference> &&statement_list);
+		ProofStep(const_Rule_ptr rule,
+			const std::vector<Expr_ptr> &var_list,
+			std::vector<Reference> &&statement_list, Unchecked);
+		ProofStep(const_Rule_ptr rule,
+			std::vector<Expr_ptr> &&var_list,
+			std::vector<Reference> &&statement_list, Unchecked);
+		ProofStep(const_Rule_ptr rule, Context &&inferred,
+			std::vector<Reference> &&statement_list);
 
 		/**
 		 * Get the rule used in this proof step.
@@ -189,6 +261,14 @@ namespace Core {
 
 		const_Expr_ptr operator[](const_Node_ptr node) const;
 
+		/**
+		 * Were the arguments inferred instead of given?
+		 *
+		 * @return True, if the arguments were inferred.
+		 */
+		bool isInferred() const
+			{return inferred;}
+
 		/**
 		 * Get a vector of the references used.
 		 *
@@ -197,7 +277,8 @@ namespace Core {
 		const std::vector<Reference>& getReferences() const
 			{return ref_statement_list;}
 
-		bool proves(const Statement &statement) const;
+		bool proves(const Statement &statement, VerificationCache *cache = nullptr) const;
+		Proof_ptr rebase(const Theory *from, const Theory *to) const;
 		void accept(Visitor *visitor) const
 			{visitor->visit(this);}
 
@@ -205,6 +286,7 @@ namespace Core {
 		const_Rule_ptr rule;
 		Context subst;
 		std::vector<Reference> ref_statement_list;
+		bool inferred;
 	};
 }	// End of namespace Core
 
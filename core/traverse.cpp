@@ -98,6 +98,11 @@ void Visitor::visit(const ProofStep *proofstep)
 	//
 }
 
+void Visitor::visit(const LazyProof *proof)
+{
+	//
+}
+
 void Visitor::visit(const Theory *theory)
 {
 	//
@@ -45,6 +45,7 @@ namespace Core {
 		virtual void visit(const Statement *statement);
 		virtual void visit(const Reference *reference);
 		virtual void visit(const ProofStep *proofstep);
+		virtual void visit(const LazyProof *proof);
 		virtual void visit(const Theory *theory);
 
 	protected:
@@ -23,23 +23,29 @@
  * and the result is compared to the target.
  *
  * Since we have to traverse the syntax tree to compare the two expressions,
- * we derived the class from the visitor class. The visiting functions traverse
- * the target expression, while we keep track of where we are in the other
- * expression or substitute expressions via a stack.
+ * we walk through the target expression, while we keep track of where we are
+ * in the other expression or substitute expressions via a stack.
  *
- * The visit functions only have to compare the nodes on the highest level and
- * then push the kids of the stack expressions on the stack, while at the same
- * time letting their on kids (in the target) accept the visitor.
+ * The compare functions only have to compare the nodes on the highest level
+ * and then push the kids of the stack expressions on the stack, while at the
+ * same time comparing their own kids (in the target).
  *
  * The real work of substituting is then done when we push an expression on the
  * stack: if an expression refers to a node, such as an atomic expression, and
  * we have a definition for that node in the parameter list, then we push that
  * definition instead of the atomic expression or whatever it is.
+ *
+ * The parameter list is the context given by the caller, which we never copy,
+ * and a stack of additional bindings for lambda parameters on top of it. All
+ * of this lives in a State object, where we only use plain pointers, so the
+ * reference counts of the expressions are never touched.
  */
 
 #include "tree.hpp"
 #include "expression.hpp"
+#include "profile.hpp"
 #include <algorithm>
+#include <stdexcept>
 using namespace Core;
 
 /**
@@ -47,7 +53,7 @@ using namespace Core;
  *
  * @param expr Expression to substitute in.
  */
-Substitution::Substitution(const_Expr_ptr expr) : expr(expr) {}
+Substitution::Substitution(const_Expr_ptr expr) : expr(std::move(expr)) {}
 
 /**
  * Check if substituting certain expressions for variables in the expression
@@ -55,327 +61,398 @@ Substitution::Substitution(const_Expr_ptr expr) : expr(expr) {}
  *
  * @param target Target expression.
  * @param context Replacement context.
+ * @param state Scratch space for the check, also holds the mismatch.
  * @return Return true, if the target matches.
  */
-bool Substitution::check(const Expression *target, const Context &context)
+bool Substitution::check(const Expression *target, const Context &context,
+	State &state) const
 {
-	offender.first.reset();
-
-	// Initialize our context
-	substitutions = context;
+	// Initialize our state
+	state.context = &context;
+	state.bindings.clear();
+	state.stack.clear();
+	state.offender = match(nullptr, nullptr);
 
 	// Traverse expression target, and compare with expr
-	push(expr);
-	target->accept(this);
-	pop();
+	push(expr.get(), 0, state);
+	bool result = compare(target, state);
+	pop(state);
 
-	return !offender.first;
+	return result;
+}
+
+/**
+ * Check if substituting certain expressions for variables in the expression
+ * gives the target expression, using our own scratch space.
+ *
+ * @param target Target expression.
+ * @param context Replacement context.
+ * @return Return true, if the target matches.
+ */
+bool Substitution::check(const Expression *target, const Context &context)
+{
+	return check(target, context, state);
 }
 
 /**
- * Get mismatch.
+ * Get mismatch of the last check without explicit State.
  *
- * @return Return a pair of mismatching expressions or a pair with first pointer reset.
+ * @return Return a pair of mismatching expressions or a pair of null pointers.
  */
 Substitution::match Substitution::getMismatch() const
 {
-	return offender;
+	return state.getMismatch();
+}
+
+/**
+ * Compare the target with the expression on top of the stack.
+ *
+ * @param target Expression in target
+ * @return True, if they are the same.
+ */
+bool Substitution::compare(const Expression *target, State &state) const
+{
+	LOGIC_PROFILE_COUNT(nodes);
+
+	// Without any substitutions, identical expressions always match. With
+	// interned expressions, this makes equality checks O(1).
+	if (state.stack.back().expr == target && state.bindings.empty()
+			&& state.context->empty())
+		return true;
+
+	switch (target->cls) {
+	case Expression::ATOMIC:
+		return compare(static_cast<const AtomicExpr *>(target), state);
+	case Expression::LAMBDACALL:
+		return compare(static_cast<const LambdaCallExpr *>(target), state);
+	case Expression::NEGATION:
+		return compare(static_cast<const NegationExpr *>(target), state);
+	case Expression::CONNECTIVE:
+		return compare(static_cast<const ConnectiveExpr *>(target), state);
+	case Expression::QUANTIFIER:
+		return compare(static_cast<const QuantifierExpr *>(target), state);
+	case Expression::LAMBDA:
+		return compare(static_cast<const LambdaExpr *>(target), state);
+	default:
+		// Types are not compared here.
+		return true;
+	}
 }
 
 /**
  * Compare atomic expression in target. Of course we want to know if they refer
  * to the same node
  *
- * @param expression Atomic expression in target
+ * @param target Atomic expression in target
  */
-void Substitution::visit(const AtomicExpr *expression)
+bool Substitution::compare(const AtomicExpr *target, State &state) const
 {
 	// Then we really should have an atomic expression on the other side.
-	const_Expr_ptr expr = stack.top();
-	if (expr->cls == Expression::ATOMIC) {
-		auto expr_atomic = std::static_pointer_cast<const AtomicExpr>(expr);
-
-		if (expr_atomic->getAtom() == expression->getAtom())
-			return;
-	}
+	const State::Entry &entry = state.stack.back();
+	if (entry.expr->cls == Expression::ATOMIC && entry.atom == target->getAtom().get())
+		return true;
 
-	mismatch(expr, expression);
+	return mismatch(target, state);
 }
 
 /**
  * Compare a lambda call expression: for this we have to know if the same lambda
  * was called and if the parameters compare.
  *
- * @param expression Lambda call expression in target
+ * @param target Lambda call expression in target
  */
-void Substitution::visit(const LambdaCallExpr *expression)
+bool Substitution::compare(const LambdaCallExpr *target, State &state) const
 {
-	const_Expr_ptr expr = stack.top();
-	if (expr->cls == Expression::LAMBDACALL) {
-		auto expr_call = std::static_pointer_cast<const LambdaCallExpr>(expr);
-
-		// Compare the lambda node
-		if (expr_call->getLambda() == expression->getLambda()) {
-			// Compare the arguments
-			for (LambdaCallExpr::const_iterator it_target = expression->begin(),
-				it_expr = expr_call->begin(); it_target != expression->end() &&
-				it_expr != expr_call->end(); ++it_expr, ++it_target
-			) {
-				push(*it_expr);
-				(*it_target)->accept(this);
-				pop();
-			}
-
-			return;
+	const State::Entry &entry = state.stack.back();
+	if (entry.expr->cls == Expression::LAMBDACALL && entry.atom == target->getLambda().get()) {
+		auto expr_call = static_cast<const LambdaCallExpr *>(entry.expr);
+
+		// Compare the arguments
+		for (LambdaCallExpr::const_iterator it_target = target->begin(),
+			it_expr = expr_call->begin(); it_target != target->end() &&
+			it_expr != expr_call->end(); ++it_expr, ++it_target
+		) {
+			push(it_expr->get(), state.bindings.size(), state);
+			bool result = compare(it_target->get(), state);
+			pop(state);
+			if (!result)
+				return false;
 		}
+
+		return true;
 	}
 
-	mismatch(expr, expression);
+	return mismatch(target, state);
 }
 
 /**
  * Compare a negation expression.
  *
- * @param expression Negation expression in target
+ * @param target Negation expression in target
  */
-void Substitution::visit(const NegationExpr *expression)
+bool Substitution::compare(const NegationExpr *target, State &state) const
 {
 	// Do we have a negation in the expr?
-	const_Expr_ptr expr = stack.top();
+	const Expression *expr = state.stack.back().expr;
 	if (expr->cls == Expression::NEGATION) {
-		auto expr_neg = std::static_pointer_cast<const NegationExpr>(expr);
+		auto expr_neg = static_cast<const NegationExpr *>(expr);
 
 		// Push and go on
-		push(expr_neg->getExpr());
-		expression->getExpr()->accept(this);
-		pop();
+		push(expr_neg->getExpr().get(), state.bindings.size(), state);
+		bool result = compare(target->getExpr().get(), state);
+		pop(state);
+		return result;
 	}
-	else
-		mismatch(expr, expression);
+
+	return mismatch(target, state);
 }
 
 /**
  * Compare a connective expression. We need the same variant and then to compare
  * the two operands.
  *
- * @param expression Connective expression in target
+ * @param target Connective expression in target
  */
-void Substitution::visit(const ConnectiveExpr *expression)
+bool Substitution::compare(const ConnectiveExpr *target, State &state) const
 {
 	// Do we have a connective in the expr?
-	const_Expr_ptr expr = stack.top();
+	const Expression *expr = state.stack.back().expr;
 	if (expr->cls == Expression::CONNECTIVE) {
-		auto expr_con = std::static_pointer_cast<const ConnectiveExpr>(expr);
+		auto expr_con = static_cast<const ConnectiveExpr *>(expr);
 
 		// Do we have the same variant?
-		if (expr_con->getVariant() == expression->getVariant()) {
+		if (expr_con->getVariant() == target->getVariant()) {
 			// Check first operand
-			push(expr_con->getFirstExpr());
-			expression->getFirstExpr()->accept(this);
-			pop();
+			push(expr_con->getFirstExpr().get(), state.bindings.size(), state);
+			bool result = compare(target->getFirstExpr().get(), state);
+			pop(state);
+			if (!result)
+				return false;
 
 			// Check second operand
-			push(expr_con->getSecondExpr());
-			expression->getSecondExpr()->accept(this);
-			pop();
-
-			return;
+			push(expr_con->getSecondExpr().get(), state.bindings.size(), state);
+			result = compare(target->getSecondExpr().get(), state);
+			pop(state);
+			return result;
 		}
 	}
 
-	mismatch(expr, expression);
+	return mismatch(target, state);
 }
 
 /**
  * Compare a quantifier expression. We compare the variant and the contained
  * predicate lambda.
  *
- * @param expression Quantifier expression in target
+ * @param target Quantifier expression in target
  */
-void Substitution::visit(const QuantifierExpr *expression)
+bool Substitution::compare(const QuantifierExpr *target, State &state) const
 {
 	// Do we have a quantifier expression?
-	const_Expr_ptr expr = stack.top();
+	const Expression *expr = state.stack.back().expr;
 	if (expr->cls == Expression::QUANTIFIER) {
-		auto expr_quant = std::static_pointer_cast<const QuantifierExpr>(expr);
+		auto expr_quant = static_cast<const QuantifierExpr *>(expr);
 
-		if (expr_quant->getVariant() == expression->getVariant()) {
+		if (expr_quant->getVariant() == target->getVariant()) {
 			// Push and go on
-			push(expr_quant->getPredicate());
-			expression->getPredicate()->accept(this);
-			pop();
-
-			return;
+			push(expr_quant->getPredicate().get(), state.bindings.size(), state);
+			bool result = compare(target->getPredicate().get(), state);
+			pop(state);
+			return result;
 		}
 	}
 
-	mismatch(expr, expression);
+	return mismatch(target, state);
 }
 
 /**
  * Compare a lambda expression.
  * First we have to compare their type signature. Then to match the contained
- * expressions, we add them to the list of substitutions.
+ * expressions, we rename our parameters to those of the target.
  *
- * @param expression Lambda expression in target
+ * @param target Lambda expression in target
  */
-void Substitution::visit(const LambdaExpr *expression)
+bool Substitution::compare(const LambdaExpr *target, State &state) const
 {
 	// Do we have a lambda expression on the other side?
-	const_Expr_ptr expr = stack.top();
+	const Expression *expr = state.stack.back().expr;
 	if (expr->cls == Expression::LAMBDA) {
-		auto expr_lambda = std::static_pointer_cast<const LambdaExpr>(expr);
+		auto expr_lambda = static_cast<const LambdaExpr *>(expr);
 
 		// Do the type signatures match?
-		TypeComparator compare;
-		if (compare(expression->getType().get(), expr_lambda->getType().get())) {
+		if (state.compare(target->getType().get(), expr_lambda->getType().get())) {
 			// Try to match parameter lists
-			subst_stack.push(&expr_lambda->getParams());
-
+			std::size_t mark = state.bindings.size();
 			auto param_it = expr_lambda->getParams().begin();
-			auto subst_it = expression->getParams().begin();
+			auto subst_it = target->getParams().begin();
 			for (; param_it != expr_lambda->getParams().end(); ++param_it, ++subst_it)
-				add(*param_it, std::make_shared<AtomicExpr>(*subst_it));
+				rename(param_it->get(), subst_it->get(), state);
 
 			// Compare the definition
-			push(expr_lambda->getDefinition());
-			expression->getDefinition()->accept(this);
-			pop();
-
-			return;
+			push(expr_lambda->getDefinition().get(), mark, state);
+			bool result = compare(target->getDefinition().get(), state);
+			pop(state);
+			return result;
 		}
 	}
 
-	mismatch(expr, expression);
+	return mismatch(target, state);
 }
 
 /**
  * Push an expression to the stack and do substitutions, if necessary.
  *
  * @param expr Expression to push to stack
+ * @param mark Number of bindings to keep when popping the expression.
  */
-void Substitution::push(const_Expr_ptr expr)
+void Substitution::push(const Expression *expr, std::size_t mark, State &state) const
 {
+	const Expression *def;
+	const Node *atom;
+
 	switch (expr->cls) {
 	case Expression::ATOMIC: {        // For atomics, when we can: resolve
-		auto atomic = std::static_pointer_cast<const AtomicExpr>(expr);
-		const_Expr_ptr def = have(atomic->getAtom());
-		if (def) {
-			// Push definition on stack
-			// A null pointer on the parameter stack serves as a placeholder.
-			subst_stack.push(nullptr);
-			stack.push(def);
+		auto atomic = static_cast<const AtomicExpr *>(expr);
+		if (have(atomic->getAtom().get(), &def, &atom, state)) {
+			if (def) {
+				// Push definition on stack
+				if (def->cls == Expression::ATOMIC)
+					atom = static_cast<const AtomicExpr *>(def)->getAtom().get();
+				else if (def->cls == Expression::LAMBDACALL)
+					atom = static_cast<const LambdaCallExpr *>(def)->getLambda().get();
+				state.stack.push_back({def, atom, mark});
+			}
+			else	// Renamed node
+				state.stack.push_back({expr, atom, mark});
 			return;
 		}
+		state.stack.push_back({expr, atomic->getAtom().get(), mark});
+		return;
 		}	// case end
-		break;
 	case Expression::LAMBDACALL: {
-		auto call = std::static_pointer_cast<const LambdaCallExpr>(expr);
-		const_Expr_ptr lambda_def = have(call->getLambda());
-		if (lambda_def) {
-			// Is it atomic? Then just substitute.
-			if (lambda_def->cls == Expression::ATOMIC) {
-				auto atomic = std::static_pointer_cast<const AtomicExpr>(lambda_def);
-				// TODO
-				throw -1;
+		auto call = static_cast<const LambdaCallExpr *>(expr);
+		if (have(call->getLambda().get(), &def, &atom, state)) {
+			// Is it atomic? Then just substitute the node.
+			if (!def) {
+				state.stack.push_back({expr, atom, mark});
+				return;
+			}
+			if (def->cls == Expression::ATOMIC) {
+				atom = static_cast<const AtomicExpr *>(def)->getAtom().get();
+				state.stack.push_back({expr, atom, mark});
+				return;
 			}
-			else {
+			if (def->cls == Expression::LAMBDA) {
 				// Otherwise it is a lambda. Then we have to plug in.
-				auto lambda = std::static_pointer_cast<const LambdaExpr>(lambda_def);
+				auto lambda = static_cast<const LambdaExpr *>(def);
 
 				// Write substitutions.
-				subst_stack.push(&lambda->getParams());
 				auto param_it = lambda->getParams().begin();
 				auto arg_it = call->begin();
 				for (; param_it != lambda->getParams().end(); ++param_it, ++arg_it)
-					add(*param_it, *arg_it);
+					add(param_it->get(), arg_it->get(), state);
 
 				// Recursively push definition
-				push(lambda->getDefinition());
+				push(lambda->getDefinition().get(), mark, state);
+				return;
 			}
-
-			return;
 		}
+		state.stack.push_back({expr, call->getLambda().get(), mark});
+		return;
 		}	// case end
-		break;
+	default:
+		// If there's nothing to substitute: just push the expression.
+		state.stack.push_back({expr, nullptr, mark});
 	}
-
-	// If there's nothing to substitute: just push the expression.
-	// A null pointer on the parameter stack serves as a placeholder.
-	subst_stack.push(nullptr);
-	stack.push(expr);
 }
 
 /**
- * Pop an expression from the stack.
+ * Pop an expression from the stack, and forget about the bindings that were
+ * made for it.
  */
-void Substitution::pop()
+void Substitution::pop(State &state) const
 {
-	// Pop null parameter list
-	if (subst_stack.top())
-		throw std::logic_error("Non-null parameter list pointer on substitutions stack in pop");
-	subst_stack.pop();
-
-	// Pop all parameter lists until the next null list
-	while (subst_stack.size() && subst_stack.top())
-		pop_params();
-
-	stack.pop();
+	state.bindings.resize(state.stack.back().mark);
+	state.stack.pop_back();
 }
 
 /**
- * Add substitution to map.
+ * Add substitution to our bindings.
  *
  * @param node Node to substitute.
  * @param expr Expression to substitute with.
  */
-void Substitution::add(const_Node_ptr node, const_Expr_ptr expr)
+void Substitution::add(const Node *node, const Expression *expr, State &state) const
 {
 	// If expr is atomic, look it up. This is to create shortcuts.
 	if (expr->cls == Expression::ATOMIC) {
-		auto atomic = std::static_pointer_cast<const AtomicExpr>(expr);
-		auto find = substitutions.find(atomic->getAtom());
-		if (find != substitutions.end())
-			expr = find->second;
+		const Expression *def;
+		const Node *atom;
+		if (have(static_cast<const AtomicExpr *>(expr)->getAtom().get(), &def, &atom, state)) {
+			state.bindings.push_back({node, def, atom});
+			return;
+		}
 	}
 
-	substitutions.insert({node, expr});
+	state.bindings.push_back({node, expr, nullptr});
 }
 
 /**
- * Pop parameters from stack and forget about the substitutions.
+ * Rename a node to another, i.e. substitute it by an atomic expression.
  *
+ * @param node Node to substitute.
+ * @param atom Node to substitute with.
  */
-void Substitution::pop_params()
+void Substitution::rename(const Node *node, const Node *atom, State &state) const
 {
-	const std::vector<Node_ptr> *params = subst_stack.top();
-	for (const_Node_ptr node : *params)
-		substitutions.erase(node);
-	subst_stack.pop();
+	// Again, create shortcuts.
+	const Expression *def;
+	const Node *def_atom;
+	if (have(atom, &def, &def_atom, state))
+		state.bindings.push_back({node, def, def_atom});
+	else
+		state.bindings.push_back({node, nullptr, atom});
 }
 
 /**
- * Get our variant of a certain node.
+ * Get our variant of a certain node. The most recent binding wins, then we
+ * look into the context.
  *
  * @param node Node referred to in the expression.
- * @return Node from our parameter stack with the right definition.
+ * @param expr Here we write the expression to substitute, if there is one.
+ * @param atom Otherwise, here we write the node to substitute.
+ * @return True, if we have a substitution for the node.
  */
-const_Expr_ptr Substitution::have(const_Node_ptr node)
+bool Substitution::have(const Node *node, const Expression **expr,
+	const Node **atom, const State &state) const
 {
-	auto find = substitutions.find(node);
-	if (find != substitutions.end())
-		return find->second;
-	else
-		return Expr_ptr();
+	for (auto it = state.bindings.rbegin(); it != state.bindings.rend(); ++it)
+		if (it->node == node) {
+			*expr = it->expr;
+			*atom = it->atom;
+			return true;
+		}
+
+	// Search the context with a non-owning pointer, to avoid reference counting.
+	auto find = state.context->find(const_Node_ptr(const_Node_ptr(), node));
+	if (find != state.context->end()) {
+		*expr = find->second.get();
+		*atom = nullptr;
+		return true;
+	}
+
+	return false;
 }
 
 /**
  * Report mismatch of expressions on the top level.
  *
- * @param expr Subexpression to compared against.
  * @param target_expr Subexpression of target.
+ * @return False, for convenience.
  */
-void Substitution::mismatch(const_Expr_ptr expr, const Expression *target_expr)
+bool Substitution::mismatch(const Expression *target_expr, State &state) const
 {
-	offender = match(expr, target_expr);
+	LOGIC_PROFILE_COUNT(mismatches);
+	state.offender = match(state.stack.back().expr, target_expr);
+	return false;
 }
@@ -22,8 +22,8 @@
 #include "forward.hpp"
 #include "base.hpp"
 #include "traverse.hpp"
-#include <stack>
 #include <map>
+#include <vector>
 
 /**
  * Namespace for logic core
@@ -35,8 +35,12 @@ namespace Core {
 	 *   substitution without producing it.
 	 * - we would like to know if a certain pattern fits on an expression and
 	 *   what the parameters would be.
+	 *
+	 * The object itself is never changed by a check, all intermediate data
+	 * lives in a State object owned by the caller. So any number of checks
+	 * may run concurrently, as long as each has its own State.
 	 */
-	class Substitution : public Visitor {
+	class Substitution {
 	public:
 		Substitution(const_Expr_ptr expr);
 
@@ -45,39 +49,79 @@ namespace Core {
 		 *
 		 * @return Expression.
 		 */
-		const_Expr_ptr getExpr() const
+		const const_Expr_ptr &getExpr() const
 			{return expr;}
 
-		bool check(const Expression *target, const Context &context);
+		// Mismatching pair of subexpressions: ours and the target's
+		typedef std::pair<const Expression *, const Expression *> match;
 
-		// Get mismatch, if something didn't work
-		typedef std::pair<const_Expr_ptr, const Expression *> match;
-		match getMismatch() const;
+		/**
+		 * Scratch space for checks. It can be reused for any number of checks,
+		 * which avoids allocations once it has grown big enough.
+		 */
+		class State {
+		public:
+			State() : context(nullptr), offender(nullptr, nullptr) {}
+
+			/**
+			 * Get mismatch of the last check, if something didn't work.
+			 *
+			 * @return Pair of mismatching expressions or a pair of null pointers.
+			 */
+			match getMismatch() const
+				{return offender;}
+
+		private:
+			friend class Substitution;
+
+			// A node is either replaced by an expression or renamed to another node.
+			struct Binding {
+				const Node *node;
+				const Expression *expr;
+				const Node *atom;
+			};
 
-		// Visitor functions
-		void visit(const AtomicExpr *expression);
-		void visit(const LambdaCallExpr *expression);
-		void visit(const NegationExpr *expression);
-		void visit(const ConnectiveExpr *expression);
-		void visit(const QuantifierExpr *expression);
-		void visit(const LambdaExpr *expression);
+			// Expression on our side. For atomic and lambda call expressions,
+			// atom is the node actually referred to. When the entry is popped,
+			// we forget about all bindings after mark.
+			struct Entry {
+				const Expression *expr;
+				const Node *atom;
+				std::size_t mark;
+			};
+
+			const Context *context;
+			std::vector<Binding> bindings;
+			std::vector<Entry> stack;
+			match offender;
+			TypeComparator compare;
+		};
+
+		bool check(const Expression *target, const Context &context, State &state) const;
+		bool check(const Expression *target, const Context &context);
+		match getMismatch() const;
 
 	private:
-		void push(const_Expr_ptr expr);
-		void pop();
+		bool compare(const Expression *target, State &state) const;
+		bool compare(const AtomicExpr *target, State &state) const;
+		bool compare(const LambdaCallExpr *target, State &state) const;
+		bool compare(const NegationExpr *target, State &state) const;
+		bool compare(const ConnectiveExpr *target, State &state) const;
+		bool compare(const QuantifierExpr *target, State &state) const;
+		bool compare(const LambdaExpr *target, State &state) const;
 
-		void add(const_Node_ptr node, const_Expr_ptr expr);
-		void pop_params();
-		const_Expr_ptr have(const_Node_ptr node);
+		void push(const Expression *expr, std::size_t mark, State &state) const;
+		void pop(State &state) const;
 
-		void mismatch(const_Expr_ptr expr, const Expression *target_expr);
+		void add(const Node *node, const Expression *expr, State &state) const;
+		void rename(const Node *node, const Node *atom, State &state) const;
+		bool have(const Node *node, const Expression **expr, const Node **atom,
+			const State &state) const;
 
-		const_Expr_ptr expr;
-		Context substitutions;
+		bool mismatch(const Expression *target_expr, State &state) const;
 
-		std::stack<const_Expr_ptr> stack;
-		std::stack<const std::vector<Node_ptr> *> subst_stack;
-		match offender;
+		const_Expr_ptr expr;
+		State state;
 	};
 }
 
@@ -2,6 +2,23 @@
 #include "../core/expression.hpp"
 #include "../core/lisp.hpp"
 #include "../core/debug.hpp"
+#include "../core/intern.hpp"
+#include "../core/buffer.hpp"
+#include "../core/index.hpp"
+#include "../core/batch.hpp"
+#include "../core/binary.hpp"
+#include "../core/server.hpp"
+#include "../core/cache.hpp"
+#include "../core/hash.hpp"
+#include "../core/dispatch.hpp"
+#include "../core/incremental.hpp"
+#include "../core/stream.hpp"
+#include "../core/profile.hpp"
+#include "../core/match.hpp"
+#include "../core/lazy.hpp"
+#include "../core/search.hpp"
+#include "../core/scan.hpp"
+#include "../core/diagnostics.hpp"
 #define BOOST_TEST_MODULE CoreTest
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/unit_test.hpp>
@@ -10,6 +27,9 @@
 #include <fstream>
 #include <boost/test/output_test_stream.hpp>
 #include <functional>
+#include <thread>
+#include <atomic>
+#include <random>
 
 using namespace Core;
 using std::make_shared;
@@ -43,6 +63,53 @@ BOOST_AUTO_TEST_CASE(type_comparator_test)
 	BOOST_CHECK(!compare(lambda[0].get(), lambda[1].get()));
 }
 
+BOOST_AUTO_TEST_CASE(type_id_test)
+{
+	Node_ptr type_node = make_shared<Node>(BuiltInType::type, "type");
+	Node_ptr param = make_shared<Node>(BuiltInType::type, "T");
+	Expr_ptr type = make_shared<AtomicExpr>(type_node);
+	Expr_ptr var = make_shared<AtomicExpr>(param);
+
+	// Equal lambda types built separately share their number.
+	Expr_ptr lambda[3];
+	lambda[0] = make_shared<LambdaType>(std::vector<const_Expr_ptr>{type});
+	lambda[1] = make_shared<LambdaType>(std::vector<const_Expr_ptr>{
+		make_shared<AtomicExpr>(type_node)});
+	lambda[2] = make_shared<LambdaType>(std::vector<const_Expr_ptr>{var});
+	auto id = [] (const Expr_ptr &type) {return TypeComparator::getTypeId(type.get());};
+	BOOST_CHECK_EQUAL(id(lambda[0]), id(lambda[1]));
+	BOOST_CHECK_NE(id(lambda[0]), id(lambda[2]));
+	BOOST_CHECK(!std::static_pointer_cast<const LambdaType>(lambda[0])->isClosed());
+
+	// The number goes away with the last of them and is not used again.
+	TypeId shared = id(lambda[0]);
+	Expr_ptr other = make_shared<LambdaType>(std::vector<const_Expr_ptr>{type, type});
+	TypeId dropped = id(other);
+	other.reset();
+	other = make_shared<LambdaType>(std::vector<const_Expr_ptr>{type, type});
+	BOOST_CHECK_NE(id(other), dropped);
+	BOOST_CHECK_EQUAL(id(make_shared<LambdaType>(std::vector<const_Expr_ptr>{type})), shared);
+
+	// Copies of a type are different types.
+	BOOST_CHECK_NE(type_node->getTypeId(), Node(*type_node).getTypeId());
+
+	// Type variables are resolved through the context.
+	TypeComparator plain;
+	BOOST_CHECK(!plain(lambda[0].get(), lambda[2].get()));
+	Context context{{param, type}};
+	TypeComparator compare(&context);
+	BOOST_CHECK(compare(lambda[0].get(), lambda[2].get()));
+	BOOST_CHECK(compare(var.get(), type.get()));
+	BOOST_CHECK(!compare(var.get(), BuiltInType::statement.get()));
+	Expr_ptr closed[2] = {
+		make_shared<LambdaType>(std::vector<const_Expr_ptr>{BuiltInType::statement}),
+		make_shared<LambdaType>(std::vector<const_Expr_ptr>{BuiltInType::statement})
+	};
+	BOOST_CHECK(std::static_pointer_cast<const LambdaType>(closed[0])->isClosed());
+	BOOST_CHECK(compare(closed[0].get(), closed[1].get()));
+	BOOST_CHECK(!compare(closed[0].get(), lambda[2].get()));
+}
+
 //////////////////////
 // Test type checks //
 //////////////////////
@@ -127,6 +194,16 @@ BOOST_AUTO_TEST_CASE(type_check_test)
 		TypeException,
 		type_exception_pred("expected statement, but got (var_type)->statement")
 	);
+
+	// Types are computed once and stored in the expressions.
+	Expr_ptr call = make_shared<LambdaCallExpr>(lambda[1], std::vector<Expr_ptr>{atomic[0]});
+	BOOST_CHECK(&call->getType() == &call->getType());
+	BOOST_CHECK(call->getType() == var_type);
+	BOOST_CHECK(atomic[0]->getType() == var_type);
+	BOOST_CHECK(neg_expr->getType() == BuiltInType::statement);
+	BOOST_CHECK(lambda_def->getType()->cls == Expression::LAMBDATYPE);
+	BOOST_CHECK(lambda_type[0]->getType() == BuiltInType::type);
+	BOOST_CHECK(BuiltInType::type->getType() == BuiltInType::type);
 }
 
 //////////////////////////////////////////
@@ -317,6 +394,32 @@ BOOST_AUTO_TEST_CASE(theory_writer_test)
 	BOOST_CHECK(theory.verify());
 }
 
+BOOST_AUTO_TEST_CASE(writer_wrap_test)
+{
+	auto write = [] (const Theory &theory, int line_length) {
+		std::ostringstream stream;
+		{
+			Writer writer(stream, line_length);
+			theory.accept(&writer);
+		}
+		return stream.str();
+	};
+
+	std::ifstream file("basic/rules.lth");
+	Parser parser(file, std::cout, "basic/rules.lth");
+	Theory theory = parser.parseTheory();
+	const std::string unwrapped = write(theory, std::numeric_limits<int>::max());
+
+	// However we wrap lines, we get the same theory back.
+	for (int line_length : {10, 20, 40, 80, 120}) {
+		std::string wrapped = write(theory, line_length);
+		std::istringstream stream(wrapped);
+		Parser wrapped_parser(stream, std::cout, "wrapped");
+		BOOST_CHECK_EQUAL(write(wrapped_parser.parseTheory(), std::numeric_limits<int>::max()),
+			unwrapped);
+	}
+}
+
 //////////////////////
 // Check the parser //
 //////////////////////
@@ -340,3 +443,1346 @@ BOOST_AUTO_TEST_CASE(parser_theory_test)
 	// Verify the theory
 	BOOST_CHECK(simple.verify());
 }
+
+BOOST_AUTO_TEST_CASE(parallel_verify_test)
+{
+	// Many independent lemmas, every tenth of them is wrong.
+	std::ostringstream input;
+	input << "(statement a) (statement b) (axiom ab (impl a b)) (axiom aa a)\n";
+	for (int i = 0; i < 200; ++i)
+		input << "(lemma l" << i << ' ' << (i % 10 ? 'b' : 'a')
+			<< " (ponens (list a b) (list ab aa)))\n";
+
+	std::istringstream stream(input.str());
+	Parser parser(stream, std::cout, "parallel");
+	parser.rules = &rules;
+	Theory theory = parser.parseTheory();
+	BOOST_CHECK_EQUAL(parser.getErrors(), 0);
+
+	std::vector<Theory::const_iterator> serial_failed, parallel_failed;
+	BOOST_CHECK(!theory.verify());
+	BOOST_CHECK(!theory.verify(1, &serial_failed));
+	BOOST_CHECK(!theory.verify(4, &parallel_failed));
+	BOOST_CHECK_EQUAL(serial_failed.size(), 20);
+	BOOST_CHECK(serial_failed == parallel_failed);
+
+	// The failed statements should be reported in order.
+	Theory::const_iterator it = theory.begin();
+	std::advance(it, 4);
+	BOOST_CHECK(parallel_failed.front() == it);
+}
+
+BOOST_AUTO_TEST_CASE(verification_cache_test)
+{
+	// Applications of ponens with three different substitutions, of which
+	// the one for lx is wrong. Repeated applications are equal up to the
+	// statement objects.
+	const std::string text =
+		"(statement a) (statement b) (statement c)\n"
+		"(axiom ab (impl a b)) (axiom bc (impl b c)) (axiom aa a)\n"
+		"(lemma lb b (ponens (list a b) (list ab aa)))\n"
+		"(lemma lc c (ponens (list b c) (list bc lb)))\n"
+		"(lemma lb2 b (ponens (list a b) (list ab aa)))\n"
+		"(lemma lx c (ponens (list a c) (list ab aa)))\n"
+		"(lemma lb3 b (ponens (list a b) (list ab aa)))\n"
+		"(lemma lc2 c (ponens (list b c) (list bc lb)))\n";
+	auto parse = [&text] {
+		std::istringstream stream(text);
+		Parser parser(stream, std::cout, "cache");
+		parser.rules = &rules;
+		return parser.parseTheory();
+	};
+	Theory theory = parse(), other = parse();
+
+	// Only the same substitution hits. The least recently used result is
+	// dropped: lx replaces the result for lc, not the older one for lb.
+	VerificationCache small(2);
+	std::vector<Theory::const_iterator> failed;
+	BOOST_CHECK(!theory.verify(1, &failed, &small));
+	BOOST_CHECK(failed.size() == 1 && failed.front() == theory.get("lx"));
+	BOOST_CHECK_EQUAL(small.size(), 2u);
+	BOOST_CHECK_EQUAL(small.getHits(), 2u);
+	BOOST_CHECK_EQUAL(small.getMisses(), 4u);
+
+	// Shared between threads, with the same results.
+	VerificationCache cache;
+	std::vector<Theory::const_iterator> parallel_failed;
+	BOOST_CHECK(!theory.verify(4, &parallel_failed, &cache));
+	BOOST_CHECK(parallel_failed == failed);
+	BOOST_CHECK_EQUAL(cache.size(), 3u);
+	BOOST_CHECK_EQUAL(cache.getHits() + cache.getMisses(), 6u);
+
+	// Another theory has other nodes, so nothing is shared.
+	BOOST_CHECK(!other.verify(1, nullptr, &cache));
+	BOOST_CHECK_EQUAL(cache.size(), 6u);
+}
+
+BOOST_AUTO_TEST_CASE(incremental_verify_test)
+{
+	// l1 has a wrong proof, l2 relies on it.
+	std::istringstream stream("(statement a) (statement b) (statement c)\n"
+		"(axiom ab (impl a b)) (axiom bc (impl b c)) (axiom aa a)\n"
+		"(lemma l1 b (ponens (list a b) (list ab ab)))\n"
+		"(lemma l2 c (ponens (list b c) (list bc l1)))\n");
+	Parser parser(stream, std::cout, "incremental");
+	parser.rules = &rules;
+	Theory theory = parser.parseTheory();
+	BOOST_CHECK_EQUAL(parser.getErrors(), 0);
+
+	IncrementalVerifier verifier(theory);
+	std::vector<Theory::const_iterator> failed;
+	BOOST_CHECK(!verifier.update(1, &failed));
+	BOOST_CHECK_EQUAL(verifier.getChecked(), 5);
+	BOOST_CHECK(failed.size() == 1 && failed.front() == theory.get("l1"));
+	BOOST_CHECK_EQUAL(verifier.getStatus(theory.get("l1")), IncrementalVerifier::INVALID);
+	BOOST_CHECK_EQUAL(verifier.getStatus(theory.get("l2")), IncrementalVerifier::DEPENDS_INVALID);
+	BOOST_CHECK_EQUAL(verifier.getStatus(theory.get("a")), IncrementalVerifier::VALID);
+
+	// Nothing changed, nothing to check.
+	BOOST_CHECK(!verifier.update());
+	BOOST_CHECK_EQUAL(verifier.getChecked(), 0);
+
+	// Fix the proof of l1: only l1 is checked, l2 becomes valid.
+	Expr_ptr a = make_shared<AtomicExpr>(std::static_pointer_cast<Node>(*theory.get("a")));
+	Expr_ptr b = make_shared<AtomicExpr>(std::static_pointer_cast<Node>(*theory.get("b")));
+	Expr_ptr c = make_shared<AtomicExpr>(std::static_pointer_cast<Node>(*theory.get("c")));
+	const_Rule_ptr ponens = std::static_pointer_cast<const Rule>(*rules.get("ponens"));
+	Statement_ptr l1 = std::static_pointer_cast<Statement>(*theory.get("l1"));
+	l1->addProof(make_shared<ProofStep>(ponens, std::vector<Expr_ptr>{a, b},
+		std::vector<Reference>{Reference(&theory, theory.get("ab")),
+			Reference(&theory, theory.get("aa"))}));
+	verifier.invalidate(l1.get());
+	BOOST_CHECK(verifier.update(4));
+	BOOST_CHECK_EQUAL(verifier.getChecked(), 1);
+	BOOST_CHECK_EQUAL(verifier.getStatus(theory.get("l1")), IncrementalVerifier::VALID);
+	BOOST_CHECK_EQUAL(verifier.getStatus(theory.get("l2")), IncrementalVerifier::VALID);
+
+	// Add a new lemma with a wrong proof at the end.
+	Statement_ptr l3 = make_shared<Statement>("l3", a);
+	l3->addProof(make_shared<ProofStep>(ponens, std::vector<Expr_ptr>{b, c},
+		std::vector<Reference>{Reference(&theory, theory.get("bc")),
+			Reference(&theory, theory.get("l1"))}));
+	Theory::iterator last = theory.begin();
+	std::advance(last, theory.size() - 1);
+	verifier.invalidate(theory.add(l3, last));
+	BOOST_CHECK(!verifier.update());
+	BOOST_CHECK_EQUAL(verifier.getChecked(), 1);
+	BOOST_CHECK_EQUAL(verifier.getStatus(theory.get("l3")), IncrementalVerifier::INVALID);
+	BOOST_CHECK_EQUAL(verifier.getStatus(theory.get("l2")), IncrementalVerifier::VALID);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_parse_test)
+{
+	auto parse = [] (const std::string &input, unsigned num_threads,
+		std::string *theory_output, std::string *errors) -> int
+	{
+		std::ostringstream error_stream;
+		int num_errors;
+		{
+			Parser parser(input.data(), input.data() + input.size(), error_stream, "parallel");
+			parser.rules = &rules;
+			Theory theory = (num_threads == 1) ? parser.parseTheory()
+				: parser.parseTheoryParallel(num_threads);
+			num_errors = parser.getErrors();
+			if (!num_errors) {
+				std::ostringstream stream;
+				Writer writer(stream, std::numeric_limits<int>::max());
+				theory.accept(&writer);
+				*theory_output = stream.str();
+				BOOST_CHECK(theory.verify());
+			}
+		}
+		*errors = error_stream.str();
+		return num_errors;
+	};
+
+	// Several chunks of statements between declarations, with comments.
+	std::ostringstream good;
+	good << "# Declarations (with a paranthesis\n(statement a) (statement b)\n";
+	for (int i = 0; i < 300; ++i) {
+		if (i % 100 == 0)
+			good << "(axiom ab" << i << " (impl a b)) (axiom aa" << i << " a) # )\n"
+				<< "(statement c" << i << ")\n";
+		good << "(lemma l" << i << " b\n\t(ponens (list a b) (list ab" << (i / 100 * 100)
+			<< " aa" << (i / 100 * 100) << ")))\n";
+		if (i % 10 == 0)
+			good << "(lemma (not (not b)) (double_negation (list b) (list this~1)))\n";
+	}
+
+	// Statements referring to statements parsed with them.
+	const std::string depending = good.str() + "(axiom n1 a) (axiom (impl n1 b))\n"
+		"(lemma l (not (not a)) (double_negation (list a) (list n1)))\n";
+
+	// Errors
+	const std::string bad = good.str() + "(axiom (impl a d))\n"
+		"(lemma (not a) (unknown (list) (list)))\n(axiom (not c0))";
+
+	const std::string inputs[] = {good.str(), depending, bad};
+	for (const std::string &input : inputs) {
+		std::string serial, parallel, serial_errors, parallel_errors;
+		int num_errors = parse(input, 1, &serial, &serial_errors);
+		BOOST_CHECK_EQUAL(parse(input, 4, &parallel, &parallel_errors), num_errors);
+		BOOST_CHECK_EQUAL(parallel, serial);
+		BOOST_CHECK_EQUAL(parallel_errors, serial_errors);
+		BOOST_CHECK_EQUAL(num_errors != 0, &input == &inputs[2]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(stream_verify_test)
+{
+	std::ostringstream input;
+	input << "(statement a) (statement b) (axiom ab (impl a b)) (axiom aa a)\n";
+	for (int i = 0; i < 100; ++i)
+		input << "(lemma l" << i << ' ' << (i % 10 ? 'b' : 'a')
+			<< " (ponens (list a b) (list ab aa)))\n";
+
+	for (bool drop_proofs : {false, true}) {
+		std::vector<Theory::const_iterator> failed;
+		StreamingVerifier verifier(4, drop_proofs);
+		std::istringstream stream(input.str());
+		Parser parser(stream, std::cout, "stream");
+		parser.rules = &rules;
+		parser.verifier = &verifier;
+		Theory theory = parser.parseTheory();
+		BOOST_CHECK_EQUAL(parser.getErrors(), 0);
+
+		BOOST_CHECK(!verifier.finish(&failed));
+		BOOST_CHECK_EQUAL(verifier.getChecked(), 100);
+		BOOST_CHECK_EQUAL(failed.size(), 10);
+		std::vector<Theory::const_iterator> expected;
+		theory.verify(1, &expected);
+		BOOST_CHECK(failed == expected);
+
+		// Only the proofs of verified statements are dropped.
+		auto l0 = std::static_pointer_cast<const Statement>(*theory.get("l0"));
+		auto l1 = std::static_pointer_cast<const Statement>(*theory.get("l1"));
+		BOOST_CHECK(l0->hasProof());
+		BOOST_CHECK_EQUAL(l1->hasProof(), !drop_proofs);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(symbol_test)
+{
+	const char buffer[] = "symbol_test_name";
+	Symbol symbol("symbol_test_name");
+	BOOST_CHECK(symbol == Symbol(std::string(buffer)));
+	BOOST_CHECK(symbol == Symbol(buffer, sizeof(buffer) - 1));
+	BOOST_CHECK(symbol != Symbol(buffer, 6));
+	BOOST_CHECK_EQUAL(symbol.str(), buffer);
+	BOOST_CHECK(Symbol::find(buffer) == symbol);
+	BOOST_CHECK(!Symbol::find("symbol_test_never_interned"));
+	BOOST_CHECK(Symbol("") && !Symbol());
+
+	// Interning from several threads gives the same symbols.
+	std::vector<std::thread> threads;
+	std::atomic<int> failures(0);
+	for (int i = 0; i < 4; ++i)
+		threads.emplace_back([&failures] {
+			for (int j = 0; j < 1000; ++j) {
+				std::string name = "symbol_test_" + std::to_string(j);
+				if (Symbol(name).str() != name || Symbol(name) != Symbol::find(name))
+					++failures;
+			}
+		});
+	for (std::thread &thread : threads)
+		thread.join();
+	BOOST_CHECK_EQUAL(failures, 0);
+
+	// Lookup through nested theories
+	Theory outer{make_shared<Node>(BuiltInType::type, "symbol_test_type")};
+	Theory inner(&outer, outer.begin());
+	inner.add(make_shared<Node>(BuiltInType::type, "symbol_test_inner"), inner.begin());
+	BOOST_CHECK(inner.get("symbol_test_type") == outer.begin());
+	BOOST_CHECK(inner.get(Symbol("symbol_test_inner")) == inner.begin());
+	BOOST_CHECK(outer.get("symbol_test_inner") == outer.end());
+	BOOST_CHECK(inner.get("symbol_test_never_interned") == inner.end());
+}
+
+BOOST_AUTO_TEST_CASE(lexer_test)
+{
+	const std::string input = "(a bc)# comment\n\t(d #x\n)e#";
+	std::istringstream stream(input);
+	Lexer stream_lexer(stream, 3);
+	Lexer buffer_lexer(input.data(), input.data() + input.size());
+
+	// Tokens and positions after reading them
+	struct {LispToken::Type type; const char *content; int line, column;} expected[] = {
+		{LispToken::OPENING, "", 1, 2},
+		{LispToken::WORD, "a", 1, 3},
+		{LispToken::WORD, "bc", 1, 6},
+		{LispToken::CLOSING, "", 1, 7},
+		{LispToken::OPENING, "", 2, 3},
+		{LispToken::WORD, "d", 2, 4},
+		{LispToken::CLOSING, "", 3, 2},
+		{LispToken::WORD, "e", 3, 3},
+		{LispToken::ENDOFFILE, "", 4, 1},
+	};
+
+	for (auto &token : expected) {
+		for (Lexer *lexer : {&stream_lexer, &buffer_lexer}) {
+			LispToken result = lexer->getToken();
+			BOOST_CHECK_EQUAL(result.getType(), token.type);
+			if (token.type == LispToken::WORD)
+				BOOST_CHECK_EQUAL(result.getContent(), token.content);
+			BOOST_CHECK_EQUAL(lexer->getLine(), token.line);
+			BOOST_CHECK_EQUAL(lexer->getColumn(), token.column);
+		}
+	}
+
+	// Parse from a file buffer.
+	InputBuffer file("examples/simple.lth");
+	BOOST_REQUIRE(file);
+	Parser parser(file.begin(), file.end(), std::cout, "examples/simple.lth");
+	parser.rules = &rules;
+	Theory simple = parser.parseTheory();
+	BOOST_CHECK_EQUAL(parser.getErrors(), 0);
+	BOOST_CHECK(simple.verify());
+	BOOST_CHECK(!InputBuffer("does/not/exist"));
+}
+
+BOOST_AUTO_TEST_CASE(reference_test)
+{
+	std::istringstream stream("(statement a) (axiom named a) (axiom (not a)) (axiom (impl a a))");
+	Parser parser(stream, std::cout, "reference");
+	Theory theory = parser.parseTheory();
+	BOOST_CHECK_EQUAL(parser.getErrors(), 0);
+	BOOST_CHECK_EQUAL(theory.size(), 4);
+
+	Theory::const_iterator last = theory.at(3);
+	BOOST_CHECK(std::next(theory.begin(), 3) == last);
+	BOOST_CHECK_EQUAL(theory.position(last), 3);
+	BOOST_CHECK_EQUAL(theory.position(theory.end()), 4);
+	BOOST_CHECK(theory.at(4) == theory.end());
+
+	// Relative and named references to the same object are equal.
+	Reference relative(&theory, last, "this~2");
+	Reference named(&theory, last, "named");
+	BOOST_CHECK(relative == named);
+	BOOST_CHECK(*relative == *theory.at(1));
+	BOOST_CHECK_EQUAL(relative - Reference(&theory, last), 2);
+	BOOST_CHECK_EQUAL(Reference(&theory, last) - relative, -1);
+	BOOST_CHECK(relative - 1 == Reference(&theory, theory.begin()));
+
+	// Descriptions
+	BOOST_CHECK_EQUAL(named.getDescription(&theory, last), "named");
+	BOOST_CHECK_EQUAL(Reference(&theory, last, "this~1").getDescription(&theory, last), "this~1");
+
+	// Inserting in the middle renumbers the objects after it.
+	Theory::iterator it = theory.begin();
+	theory.add(std::make_shared<Statement>("", std::make_shared<AtomicExpr>(
+		std::static_pointer_cast<Node>(*it))), it);
+	BOOST_CHECK_EQUAL(theory.position(last), 4);
+	BOOST_CHECK(*Reference(&theory, last, "this~3") == *std::next(theory.begin()));
+	BOOST_CHECK(*Reference(&theory, last, "this~2") == *named);
+}
+
+BOOST_AUTO_TEST_CASE(rule_index_test)
+{
+	std::ifstream file("basic/rules.lth");
+	Parser parser(file, std::cout, "basic/rules.lth");
+	Theory basic = parser.parseTheory();
+	RuleIndex index(basic);
+	BOOST_CHECK(index.size() > 0);
+
+	auto names = [&index] (const Expression *target) {
+		std::vector<std::string> result;
+		for (const RuleIndex::Candidate &candidate : index.lookup(target))
+			result.push_back(candidate.rule->getName());
+		return result;
+	};
+	auto contains = [] (const std::vector<std::string> &names, const char *name) {
+		return std::find(names.begin(), names.end(), name) != names.end();
+	};
+
+	// Every rule is a candidate for its own statements.
+	for (const Object_ptr &object : basic) {
+		std::vector<const Expression *> patterns;
+		if (auto rule = std::dynamic_pointer_cast<const Tautology>(object))
+			patterns = {rule->getStatement().get()};
+		else if (auto rule = std::dynamic_pointer_cast<const EquivalenceRule>(object))
+			patterns = {rule->getStatement1().get(), rule->getStatement2().get()};
+		else if (auto rule = std::dynamic_pointer_cast<const DeductionRule>(object))
+			patterns = {rule->getConclusion().get()};
+
+		for (const Expression *pattern : patterns)
+			BOOST_CHECK(contains(names(pattern), object->getName().c_str()));
+	}
+
+	// (or p (not p))
+	Node_ptr p = make_shared<Node>(BuiltInType::statement, "p");
+	Expr_ptr atom = make_shared<AtomicExpr>(p);
+	Expr_ptr target = make_shared<ConnectiveExpr>(ConnectiveExpr::OR, atom,
+		make_shared<NegationExpr>(atom));
+	std::vector<std::string> candidates = names(target.get());
+	BOOST_CHECK(contains(candidates, "excluded_middle"));
+	BOOST_CHECK(contains(candidates, "commutative_or"));
+	BOOST_CHECK(contains(candidates, "ponens"));
+	BOOST_CHECK(!contains(candidates, "noncontradiction"));
+	BOOST_CHECK(!contains(candidates, "demorgan_and"));
+	BOOST_CHECK(!contains(candidates, "distributive_or"));
+}
+
+////////////////////////////
+// Check the substitution //
+////////////////////////////
+
+BOOST_AUTO_TEST_CASE(substitution_test)
+{
+	Node_ptr type_def = make_shared<Node>(BuiltInType::type, "T");
+	Expr_ptr type = make_shared<AtomicExpr>(type_def);
+	Expr_ptr pred_type = make_shared<LambdaType>(std::vector<const_Expr_ptr>{type});
+	Node_ptr pred[2] = {make_shared<Node>(pred_type, "P"), make_shared<Node>(pred_type, "Q")};
+	Node_ptr var[2] = {make_shared<Node>(type, "x"), make_shared<Node>(type, "y")};
+	Expr_ptr atomic[2] = {make_shared<AtomicExpr>(var[0]), make_shared<AtomicExpr>(var[1])};
+
+	// Pattern: (impl (P x) (not (P x)))
+	Expr_ptr call = make_shared<LambdaCallExpr>(pred[0], std::vector<Expr_ptr>{atomic[0]});
+	const Substitution subst(make_shared<ConnectiveExpr>(ConnectiveExpr::IMPL,
+		call, make_shared<NegationExpr>(call)));
+
+	// Substitute P by Q, which is an atomic expression, and x by y.
+	Context context{{pred[0], make_shared<AtomicExpr>(pred[1])}, {var[0], atomic[1]}};
+	Expr_ptr target_call = make_shared<LambdaCallExpr>(pred[1], std::vector<Expr_ptr>{atomic[1]});
+	Expr_ptr target = make_shared<ConnectiveExpr>(ConnectiveExpr::IMPL,
+		target_call, make_shared<NegationExpr>(target_call));
+
+	Substitution::State state;
+	BOOST_CHECK(subst.check(target.get(), context, state));
+	BOOST_CHECK(!state.getMismatch().first);
+
+	// Now put in a non-matching argument and check the reported mismatch.
+	Expr_ptr wrong_call = make_shared<LambdaCallExpr>(pred[1], std::vector<Expr_ptr>{atomic[0]});
+	Expr_ptr wrong = make_shared<ConnectiveExpr>(ConnectiveExpr::IMPL,
+		target_call, make_shared<NegationExpr>(wrong_call));
+	BOOST_CHECK(!subst.check(wrong.get(), context, state));
+	BOOST_CHECK(state.getMismatch().first == atomic[1].get());
+	BOOST_CHECK(state.getMismatch().second == atomic[0].get());
+
+	// Several threads checking against the same substitution
+	std::vector<std::thread> threads;
+	std::atomic<int> failures(0);
+	for (int i = 0; i < 4; ++i)
+		threads.emplace_back([&] {
+			Substitution::State local;
+			for (int j = 0; j < 1000; ++j)
+				if (!subst.check(target.get(), context, local)
+						|| subst.check(wrong.get(), context, local))
+					++failures;
+		});
+	for (std::thread &thread : threads)
+		thread.join();
+	BOOST_CHECK_EQUAL(failures, 0);
+}
+
+BOOST_AUTO_TEST_CASE(small_vector_test)
+{
+	// Short sequences are kept inline, longer ones on the heap.
+	auto counter = make_shared<int>();
+	for (std::size_t length = 0; length < 5; ++length) {
+		{
+			SmallVector<std::shared_ptr<int>, 2> vector(
+				std::vector<std::shared_ptr<int>>(length, counter));
+			BOOST_CHECK_EQUAL(vector.size(), length);
+			BOOST_CHECK_EQUAL(vector.end() - vector.begin(), length);
+			BOOST_CHECK_EQUAL(counter.use_count(), length + 1);
+			for (const std::shared_ptr<int> &element : vector)
+				BOOST_CHECK(element == counter);
+		}
+		BOOST_CHECK_EQUAL(counter.use_count(), 1);
+	}
+
+	// Lambda calls with more arguments than fit inline
+	Node_ptr type_def = make_shared<Node>(BuiltInType::type, "T");
+	Expr_ptr type = make_shared<AtomicExpr>(type_def);
+	Expr_ptr rel_type = make_shared<LambdaType>(std::vector<const_Expr_ptr>{type, type, type});
+	Node_ptr rel = make_shared<Node>(rel_type, "R");
+	std::vector<Expr_ptr> args;
+	for (const char *name : {"x", "y", "z"})
+		args.push_back(make_shared<AtomicExpr>(make_shared<Node>(type, name)));
+	std::vector<Expr_ptr> copy = args;
+	auto call = make_shared<LambdaCallExpr>(rel, std::move(copy));
+	BOOST_CHECK(std::equal(call->begin(), call->end(), args.begin()));
+	BOOST_CHECK_THROW(make_shared<LambdaCallExpr>(rel, std::vector<Expr_ptr>(2, args[0])),
+		TypeException);
+}
+
+BOOST_AUTO_TEST_CASE(dispatch_test)
+{
+	// Map every class to the expression class it was cast to.
+	struct Classify {
+		Expression::Class operator()(const BuiltInType *) {return Expression::BUILTINTYPE;}
+		Expression::Class operator()(const LambdaType *) {return Expression::LAMBDATYPE;}
+		Expression::Class operator()(const AtomicExpr *) {return Expression::ATOMIC;}
+		Expression::Class operator()(const LambdaCallExpr *) {return Expression::LAMBDACALL;}
+		Expression::Class operator()(const NegationExpr *) {return Expression::NEGATION;}
+		Expression::Class operator()(const ConnectiveExpr *) {return Expression::CONNECTIVE;}
+		Expression::Class operator()(const QuantifierExpr *) {return Expression::QUANTIFIER;}
+		Expression::Class operator()(const LambdaExpr *) {return Expression::LAMBDA;}
+	};
+
+	Node_ptr type_def = make_shared<Node>(BuiltInType::type, "T");
+	Expr_ptr type = make_shared<AtomicExpr>(type_def);
+	Expr_ptr pred_type = make_shared<LambdaType>(std::vector<const_Expr_ptr>{type});
+	Node_ptr pred = make_shared<Node>(pred_type, "P");
+	Node_ptr param = make_shared<Node>(type, "x");
+	Expr_ptr call = make_shared<LambdaCallExpr>(pred,
+		std::vector<Expr_ptr>{make_shared<AtomicExpr>(param)});
+	Expr_ptr lambda = make_shared<LambdaExpr>(std::vector<Node_ptr>{param}, call);
+
+	const_Expr_ptr expressions[] = {BuiltInType::statement, pred_type, type, call,
+		make_shared<NegationExpr>(call),
+		make_shared<ConnectiveExpr>(ConnectiveExpr::AND, call, call),
+		make_shared<QuantifierExpr>(QuantifierExpr::FORALL, lambda), lambda};
+	for (const const_Expr_ptr &expr : expressions)
+		BOOST_CHECK_EQUAL(dispatch(expr.get(), Classify()), expr->cls);
+
+	// Visitors called directly write the same as through accept().
+	std::ostringstream direct, virtual_call;
+	TypeWriter direct_writer(direct), virtual_writer(virtual_call);
+	dispatchVisit(&direct_writer, pred_type.get());
+	pred_type->accept(&virtual_writer);
+	BOOST_CHECK_EQUAL(direct.str(), virtual_call.str());
+}
+
+BOOST_AUTO_TEST_CASE(structural_hash_test)
+{
+	Node_ptr type_def = make_shared<Node>(BuiltInType::type, "T");
+	Expr_ptr type = make_shared<AtomicExpr>(type_def);
+	Expr_ptr pred_type = make_shared<LambdaType>(std::vector<const_Expr_ptr>{type});
+	Node_ptr pred = make_shared<Node>(pred_type, "P");
+	Node_ptr var = make_shared<Node>(type, "c");
+
+	// Lambdas equal up to renaming of parameters have the same hash.
+	Expr_ptr lambda[3];
+	const char *names[3] = {"x", "y", "x"};
+	for (int i = 0; i < 3; ++i) {
+		Node_ptr param = make_shared<Node>(type, names[i]);
+		Expr_ptr atomic = make_shared<AtomicExpr>(i < 2 ? param : var);
+		Expr_ptr body = make_shared<LambdaCallExpr>(pred, std::vector<Expr_ptr>{atomic});
+		lambda[i] = make_shared<LambdaExpr>(std::vector<Node_ptr>{param}, body);
+	}
+	StructuralHash hasher;
+	std::size_t hash = hasher(lambda[0].get());
+	BOOST_CHECK_EQUAL(hash, hasher(lambda[1].get()));
+	BOOST_CHECK_NE(hash, hasher(lambda[2].get()));
+	BOOST_CHECK_EQUAL(hash, StructuralHash()(lambda[0].get()));
+
+	// So do rules.
+	std::istringstream rule_input(
+		"(deductionrule r1 (list (statement a) (statement b)) (list (impl a b) a) b)\n"
+		"(deductionrule r2 (list (statement c) (statement d)) (list (impl c d) c) d)\n"
+		"(deductionrule r3 (list (statement a) (statement b)) (list (impl a b) b) a)\n");
+	Parser rule_parser(rule_input, std::cout, "rules");
+	Theory renamed = rule_parser.parseTheory();
+	std::size_t rule_hash[3];
+	for (std::size_t i = 0; i < 3; ++i)
+		rule_hash[i] = hasher(renamed.at(i)->get());
+	BOOST_CHECK_EQUAL(rule_hash[0], rule_hash[1]);
+	BOOST_CHECK_NE(rule_hash[0], rule_hash[2]);
+
+	// Rule patterns under the context of a proof step hash like the
+	// statements they match, including the call of a substituted lambda.
+	std::ifstream file("examples/simple.lth");
+	Parser parser(file, std::cout, "examples/simple.lth");
+	parser.rules = &rules;
+	Theory simple = parser.parseTheory();
+	int steps = 0;
+	for (const Object_ptr &object : simple) {
+		auto statement = std::dynamic_pointer_cast<const Statement>(object);
+		if (!statement || !statement->hasProof())
+			continue;
+		auto step = std::static_pointer_cast<const ProofStep>(statement->getProof());
+		auto rule = std::static_pointer_cast<const DeductionRule>(step->getRule());
+		Context context;
+		for (const Node_ptr &param : rule->getParams())
+			context[param] = (*step)[param];
+
+		StructuralHash substituted(&context);
+		BOOST_CHECK_EQUAL(substituted(rule->getConclusion().get()),
+			hasher(statement->getDefinition().get()));
+		for (std::size_t i = 0; i < rule->getPremisses().size(); ++i) {
+			auto premiss = std::static_pointer_cast<const Statement>(*step->getReferences()[i]);
+			BOOST_CHECK_EQUAL(substituted(rule->getPremisses()[i].get()),
+				hasher(premiss->getDefinition().get()));
+		}
+		++steps;
+	}
+	BOOST_CHECK_EQUAL(steps, 2);
+}
+
+BOOST_AUTO_TEST_CASE(intern_test)
+{
+	ExpressionFactory factory;
+	Node_ptr type_def = make_shared<Node>(BuiltInType::type, "T");
+	Expr_ptr type = factory.makeAtomic(type_def);
+	Expr_ptr pred_type = make_shared<LambdaType>(std::vector<const_Expr_ptr>{type});
+	Node_ptr pred = make_shared<Node>(pred_type, "P");
+	Node_ptr var = make_shared<Node>(type, "c");
+
+	// Same structure gives the same object.
+	Expr_ptr call[2];
+	for (Expr_ptr &expr : call)
+		expr = factory.makeLambdaCall(pred, {factory.makeAtomic(var)});
+	BOOST_CHECK(call[0] == call[1]);
+	BOOST_CHECK(factory.makeNegation(call[0]) == factory.makeNegation(call[1]));
+	BOOST_CHECK(factory.makeConnective(ConnectiveExpr::AND, call[0], call[1])
+		!= factory.makeConnective(ConnectiveExpr::OR, call[0], call[1]));
+
+	// Lambdas are equal up to renaming of parameters.
+	Expr_ptr lambda[3];
+	const char *names[3] = {"x", "y", "x"};
+	for (int i = 0; i < 3; ++i) {
+		Node_ptr param = make_shared<Node>(type, names[i]);
+		Expr_ptr body = factory.makeLambdaCall(pred, {factory.makeAtomic(i < 2 ? param : var)});
+		lambda[i] = factory.makeLambda({param}, body);
+	}
+	BOOST_CHECK(lambda[0] == lambda[1]);
+	BOOST_CHECK(lambda[0] != lambda[2]);
+	BOOST_CHECK(factory.makeQuantifier(QuantifierExpr::FORALL, lambda[0])
+		== factory.makeQuantifier(QuantifierExpr::FORALL, lambda[1]));
+
+	// Parse and verify a theory with interning.
+	std::ifstream file("examples/simple.lth");
+	Parser parser(file, std::cout, "examples/simple.lth");
+	parser.rules = &rules;
+	parser.factory = &factory;
+	Theory simple = parser.parseTheory();
+	BOOST_CHECK_EQUAL(parser.getErrors(), 0);
+	BOOST_CHECK(simple.verify());
+
+	// The axiom (schüler? fritz) is shared with the first lemma.
+	Theory::const_iterator it = simple.begin();
+	std::advance(it, 4);
+	auto axiom = std::static_pointer_cast<const Statement>(*it);
+	std::advance(it, 2);
+	auto lemma = std::static_pointer_cast<const Statement>(*it);
+	auto impl = std::static_pointer_cast<const ConnectiveExpr>(lemma->getDefinition());
+	BOOST_CHECK(axiom->getDefinition() == impl->getFirstExpr());
+}
+
+BOOST_AUTO_TEST_CASE(arena_test)
+{
+	Arena arena(256);
+	void *small = arena.allocate(3, 1);
+	void *aligned = arena.allocate(8, 8);
+	BOOST_CHECK_EQUAL(reinterpret_cast<std::uintptr_t>(aligned) % 8, 0);
+	BOOST_CHECK(static_cast<char *>(aligned) >= static_cast<char *>(small) + 3);
+	BOOST_CHECK_EQUAL(arena.getReserved(), 256);
+	arena.allocate(100, 1);
+	BOOST_CHECK_EQUAL(arena.getReserved(), 357);
+
+	// Parse into an arena and keep an expression beyond the theory.
+	const_Expr_ptr expr;
+	{
+		std::ifstream file("examples/simple.lth");
+		Parser parser(file, std::cout, "examples/simple.lth");
+		parser.rules = &rules;
+		parser.arena = std::make_shared<Arena>();
+		Theory simple = parser.parseTheory();
+		BOOST_CHECK_EQUAL(parser.getErrors(), 0);
+		BOOST_CHECK(simple.arena == parser.arena);
+		BOOST_CHECK(simple.arena->getReserved() > 0);
+		BOOST_CHECK(simple.verify());
+
+		Theory::const_iterator it = simple.begin();
+		std::advance(it, 5);
+		expr = std::static_pointer_cast<const Node>(*it)->getDefinition();
+	}
+	BOOST_CHECK_EQUAL(expr->cls, Expression::QUANTIFIER);
+}
+
+BOOST_AUTO_TEST_CASE(binary_test)
+{
+	auto write = [] (const Theory &theory) {
+		std::ostringstream stream;
+		{
+			Writer writer(stream, std::numeric_limits<int>::max());
+			theory.accept(&writer);
+		}
+		return stream.str();
+	};
+
+	std::ifstream rules_file("basic/rules.lth");
+	Parser rules_parser(rules_file, std::cout, "basic/rules.lth");
+	Theory basic = rules_parser.parseTheory();
+
+	std::ifstream file("examples/simple.lth");
+	Parser parser(file, std::cout, "examples/simple.lth");
+	parser.rules = &basic;
+	Theory simple = parser.parseTheory();
+	BOOST_CHECK_EQUAL(parser.getErrors(), 0);
+
+	for (const Theory *theory : {&basic, &simple}) {
+		std::ostringstream output;
+		BinaryWriter writer(output);
+		theory->accept(&writer);
+		std::string data = output.str();
+		BOOST_CHECK(BinaryReader::isBinary(data.data(), data.data() + data.size()));
+
+		BinaryReader reader(data.data(), data.data() + data.size());
+		reader.rules = &basic;
+		Theory loaded = reader.readTheory();
+		BOOST_CHECK_EQUAL(loaded.size(), theory->size());
+		BOOST_CHECK_EQUAL(write(loaded), write(*theory));
+		BOOST_CHECK(loaded.verify());
+
+		// Truncated input is rejected.
+		for (std::size_t length : {data.size() - 4, data.size() / 2, std::size_t(9)})
+			BOOST_CHECK_THROW(BinaryReader(data.data(), data.data() + length).readTheory(),
+				BinaryFormatException);
+	}
+
+	// Proofs need the rules they were written with.
+	std::ostringstream output;
+	BinaryWriter writer(output);
+	simple.accept(&writer);
+	std::string data = output.str();
+	BinaryReader reader(data.data(), data.data() + data.size());
+	Theory empty;
+	reader.rules = &empty;
+	BOOST_CHECK_THROW(reader.readTheory(), NamespaceException);
+
+	// Malformed input: a symbol longer than the input, a call of a node
+	// that isn't a lambda, and a count larger than the input.
+	auto words = [] (std::initializer_list<std::uint32_t> list) {
+		std::string result = "LTHB";
+		for (std::uint32_t word : list)
+			for (int shift = 0; shift < 32; shift += 8)
+				result.push_back(char((word >> shift) & 0xFF));
+		return result;
+	};
+	const std::string malformed[] = {
+		words({1, 1, 0xFFFFFFFF, 0, 0}),
+		words({1, 1, 1, 'x', 8, 0, 1, 0, 0xFFFFFFFF, 2, 4, 0, 15}),
+		words({1, 0, 4, 7, 2, 0xFFFFFFF0, 15})
+	};
+	for (const std::string &input : malformed)
+		BOOST_CHECK_THROW(BinaryReader(input.data(), input.data() + input.size()).readTheory(),
+			BinaryFormatException);
+
+	std::string text = "(type a)";
+	BOOST_CHECK(!BinaryReader::isBinary(text.data(), text.data() + text.size()));
+	BOOST_CHECK_THROW(BinaryReader(text.data(), text.data() + text.size()),
+		BinaryFormatException);
+}
+
+BOOST_AUTO_TEST_CASE(profile_test)
+{
+	Profile &profile = Profile::get();
+	profile.clear();
+
+	// Verification is counted per rule.
+	std::ifstream file("examples/simple.lth");
+	Parser parser(file, std::cout, "examples/simple.lth");
+	parser.rules = &rules;
+	Theory simple = parser.parseTheory();
+	BOOST_CHECK(simple.verify());
+	if (Profile::enabled) {
+		ProfileCounters ponens = profile.find(Profile::RULE, Symbol("ponens"));
+		BOOST_CHECK(ponens.calls > 0);
+		BOOST_CHECK(ponens.nodes > 0);
+	}
+	else
+		BOOST_CHECK_EQUAL(profile.find(Profile::RULE, Symbol("ponens")).calls, 0u);
+
+	// Entries add up and are written out.
+	profile.clear();
+	Symbol name("\"quoted\"");
+	profile.add(Profile::STATEMENT, name, ProfileCounters{1, 100, 5, 1, 2});
+	profile.add(Profile::STATEMENT, name, ProfileCounters{1, 50, 3, 0, 1});
+	ProfileCounters sum = profile.find(Profile::STATEMENT, name);
+	BOOST_CHECK_EQUAL(sum.calls, 2u);
+	BOOST_CHECK_EQUAL(sum.nanoseconds, 150u);
+	BOOST_CHECK_EQUAL(sum.nodes, 8u);
+	BOOST_CHECK_EQUAL(sum.mismatches, 1u);
+	BOOST_CHECK_EQUAL(sum.type_comparisons, 3u);
+
+	std::ostringstream json;
+	profile.writeJSON(json);
+	BOOST_CHECK(json.str().find("{\"name\": \"\\\"quoted\\\"\", \"calls\": 2, \"nanoseconds\": 150")
+		!= std::string::npos);
+	profile.clear();
+}
+
+BOOST_AUTO_TEST_CASE(batch_test)
+{
+	std::ostringstream messages;
+	std::shared_ptr<const Theory> shared = BatchVerifier::loadRules("examples/rules.lth", messages);
+	BOOST_REQUIRE(shared);
+	BOOST_CHECK(!BatchVerifier::loadRules("nonexistent.lth", messages));
+
+	// A theory with a wrong proof.
+	const char *wrong = "batch_test.lth";
+	{
+		std::ofstream file(wrong);
+		file << "(statement a)\n(axiom (not (not a)))\n"
+			"(lemma (not a) (ponens (list (not (not a)) (not a)) (list this~1 this~1)))\n";
+	}
+
+	std::vector<std::string> files;
+	for (int i = 0; i < 8; ++i)
+		files.push_back(i == 5 ? wrong : "examples/simple.lth");
+	files.push_back("nonexistent.lth");
+
+	BatchVerifier verifier(shared, 4);
+	std::vector<BatchResult> results = verifier.verify(files);
+	BOOST_REQUIRE_EQUAL(results.size(), files.size());
+	for (std::size_t i = 0; i < files.size(); ++i) {
+		BOOST_CHECK_EQUAL(results[i].filename, files[i]);
+		if (i == 5) {
+			BOOST_CHECK_EQUAL(results[i].errors, 0);
+			BOOST_CHECK(!results[i].verified);
+			BOOST_CHECK(results[i].failed == std::vector<std::size_t>{2});
+			BOOST_CHECK(results[i].messages.find("Couldn't verify object 3: (not a)")
+				!= std::string::npos);
+		}
+		else if (i == 8) {
+			BOOST_CHECK_EQUAL(results[i].errors, -1);
+			BOOST_CHECK(!results[i].verified);
+		}
+		else {
+			BOOST_CHECK_EQUAL(results[i].errors, 0);
+			BOOST_CHECK(results[i].verified);
+		}
+	}
+
+	// Results as they come, with a shared cache.
+	VerificationCache cache;
+	verifier.cache = &cache;
+	std::size_t verified = 0, count = 0;
+	verifier.verify(files, [&verified, &count] (const BatchResult &result) {
+		++count;
+		verified += result.verified;
+	});
+	BOOST_CHECK_EQUAL(count, files.size());
+	BOOST_CHECK_EQUAL(verified, 7u);
+	BOOST_CHECK(cache.getMisses() > 0);
+
+	std::remove(wrong);
+}
+
+BOOST_AUTO_TEST_CASE(server_test)
+{
+	std::ostringstream messages;
+	VerificationServer server(BatchVerifier::loadRules("examples/rules.lth", messages), 2);
+
+	// Unchanged theories are looked up.
+	bool cached;
+	BatchResult result = server.checkFile("examples/simple.lth", &cached);
+	BOOST_CHECK(result.verified && !cached);
+	std::shared_ptr<const Theory> theory = server.getTheory("examples/simple.lth");
+	BOOST_REQUIRE(theory);
+	BOOST_CHECK_EQUAL(theory->size(), 8u);
+	result = server.checkFile("examples/simple.lth", &cached);
+	BOOST_CHECK(result.verified && cached);
+	BOOST_CHECK_EQUAL(server.getTheory("examples/simple.lth"), theory);
+
+	// Changed theories are parsed again.
+	std::string good = "(statement a)\n(axiom (not (not a)))\n";
+	std::string bad = "(statement a)\n(axiom (not (not a)))\n"
+		"(lemma (not a) (ponens (list (not (not a)) (not a)) (list this~1 this~1)))\n";
+	result = server.check("edited", good.data(), good.data() + good.size(), &cached);
+	BOOST_CHECK(result.verified && !cached);
+	result = server.check("edited", bad.data(), bad.data() + bad.size(), &cached);
+	BOOST_CHECK(!result.verified && !cached);
+	BOOST_CHECK(result.failed == std::vector<std::size_t>{2});
+	result = server.check("edited", bad.data(), bad.data() + bad.size(), &cached);
+	BOOST_CHECK(!result.verified && cached);
+	BOOST_CHECK_EQUAL(server.size(), 2u);
+	BOOST_CHECK_EQUAL(server.getHits(), 2u);
+	BOOST_CHECK_EQUAL(server.getMisses(), 3u);
+
+	// The least recently used theory is dropped.
+	server.check("other", good.data(), good.data() + good.size());
+	BOOST_CHECK_EQUAL(server.size(), 2u);
+	BOOST_CHECK(!server.getTheory("examples/simple.lth"));
+
+	// Requests from a stream. Too long texts are skipped.
+	server.max_text_length = 1000;
+	std::istringstream input("file examples/simple.lth\nfile examples/simple.lth\n"
+		"text " + std::to_string(bad.size()) + " edited\n" + bad + "bogus\n"
+		"text 1001 long\n" + std::string(1001, '(') + "file examples/simple.lth\n"
+		"quit\nfile x\n");
+	std::ostringstream output;
+	server.serve(input, output);
+	std::istringstream answers(output.str());
+	std::string line;
+	std::vector<std::string> headers;
+	while (std::getline(answers, line)) {
+		headers.push_back(line.substr(0, line.find(' ', line.find(' ') + 1)));
+		std::size_t length = std::stoul(line.substr(headers.back().size() + 1));
+		answers.ignore(length);
+	}
+	BOOST_CHECK(headers == (std::vector<std::string>{"verified fresh", "verified cached",
+		"unverified fresh", "invalid fresh", "invalid fresh", "verified cached"}));
+}
+
+BOOST_AUTO_TEST_CASE(fork_test)
+{
+	std::ifstream file("examples/simple.lth");
+	Parser parser(file, std::cout, "examples/simple.lth");
+	parser.rules = &rules;
+	auto base = std::make_shared<const Theory>(parser.parseTheory());
+	BOOST_REQUIRE_EQUAL(base->size(), 8u);
+
+	// Forks share the objects of their base.
+	Theory fork(base);
+	BOOST_CHECK_EQUAL(fork.getBase(), base);
+	BOOST_CHECK_EQUAL(fork.size(), 0u);
+	BOOST_CHECK(fork.get("fritz") == base->get("fritz"));
+	BOOST_CHECK(fork.get("nobody") == fork.end());
+
+	// Prove (dumm? fritz) again, referring to statements of the base.
+	auto node = [&base] (const char *name)
+		{return std::static_pointer_cast<const Node>(*base->get(name));};
+	Expr_ptr fritz = make_shared<AtomicExpr>(node("fritz"));
+	Expr_ptr student = make_shared<LambdaCallExpr>(node("schüler?"), std::vector<Expr_ptr>{fritz});
+	Expr_ptr dumb = make_shared<LambdaCallExpr>(node("dumm?"), std::vector<Expr_ptr>{fritz});
+	Theory::const_iterator impl = base->at(6), premiss = base->at(4);
+	auto ponens = std::static_pointer_cast<const Rule>(*rules.get("ponens"));
+
+	auto again = make_shared<Statement>(Symbol("again"), dumb);
+	again->addProof(make_shared<ProofStep>(ponens, std::vector<Expr_ptr>{student, dumb},
+		std::vector<Reference>{Reference(base.get(), impl), Reference(base.get(), premiss)}));
+	Theory::iterator it = fork.add(again, fork.begin());
+	auto wrong = make_shared<Statement>(Symbol("wrong"), student);
+	wrong->addProof(make_shared<ProofStep>(ponens, std::vector<Expr_ptr>{student, dumb},
+		std::vector<Reference>{Reference(base.get(), impl), Reference(base.get(), premiss)}));
+	fork.add(wrong, it);
+
+	std::vector<Theory::const_iterator> failed;
+	BOOST_CHECK(!fork.verify(1, &failed));
+	BOOST_REQUIRE_EQUAL(failed.size(), 1u);
+	BOOST_CHECK_EQUAL((*failed[0])->getName(), "wrong");
+	BOOST_CHECK_EQUAL(fork.size(), 2u);
+	BOOST_CHECK_EQUAL(base->size(), 8u);
+	BOOST_CHECK(base->get("again") == base->end());
+
+	// Unnamed base objects are referred to relative to the last one.
+	BOOST_CHECK_EQUAL(Reference(base.get(), impl).getDescription(&fork, it), "parent~1");
+	BOOST_CHECK(Reference(&fork, it, "parent~3") == Reference(base.get(), premiss));
+
+	// Copies stay forks, and forks can be forked again.
+	Theory copy(fork);
+	BOOST_CHECK_EQUAL(copy.getBase(), base);
+	BOOST_CHECK_EQUAL(copy.size(), 2u);
+	BOOST_CHECK(copy.get("fritz") == base->get("fritz"));
+	auto first = std::make_shared<const Theory>(std::move(copy));
+	Theory second(first);
+	BOOST_CHECK(second.get("fritz") == base->get("fritz"));
+	BOOST_CHECK(second.get("again") != second.end());
+
+	// Forks can override objects of their base by name, but not their own.
+	Theory::const_iterator original = first->get("again");
+	Theory::iterator early = second.add(make_shared<Statement>(Symbol("early"), dumb),
+		second.begin());
+	auto proven = make_shared<Statement>(Symbol("again"), dumb);
+	proven->addProof(make_shared<ProofStep>(ponens, std::vector<Expr_ptr>{student, dumb},
+		std::vector<Reference>{Reference(base.get(), impl), Reference(base.get(), premiss)}));
+	Theory::iterator replaced = second.add(proven, early);
+	BOOST_CHECK(second.get("again") == replaced);
+	BOOST_CHECK(first->get("again") == original);
+	BOOST_CHECK(second.verify());
+	BOOST_CHECK_THROW(second.add(make_shared<Statement>(Symbol("again"), dumb), replaced),
+		NamespaceException);
+
+	// Before the override, the name still means the object of the base.
+	BOOST_CHECK(Reference(&second, replaced, "again") == Reference(&second, replaced));
+	BOOST_CHECK(Reference(&second, early, "again") == Reference(first.get(), original));
+	BOOST_CHECK_EQUAL(Reference(first.get(), original).getDescription(&second, replaced),
+		"parent~1");
+}
+
+BOOST_AUTO_TEST_CASE(search_test)
+{
+	// The axioms of simple.lth, without the lemmas.
+	std::istringstream stream(
+		"(type person)\n"
+		"((lambda-type statement (list person)) schüler?)\n"
+		"((lambda-type statement (list person)) dumm?)\n"
+		"(person fritz)\n"
+		"(person franz)\n"
+		"(axiom (schüler? fritz))\n"
+		"(axiom (forall (lambda (list (person x)) (impl (schüler? x) (dumm? x)))))\n");
+	Parser parser(stream, std::cout, "axioms");
+	parser.rules = &rules;
+	auto axioms = std::make_shared<const Theory>(parser.parseTheory());
+	BOOST_REQUIRE_EQUAL(axioms->size(), 7u);
+
+	auto node = [&axioms] (const char *name)
+		{return std::static_pointer_cast<const Node>(*axioms->get(name));};
+	Expr_ptr fritz = make_shared<AtomicExpr>(node("fritz"));
+	Expr_ptr franz = make_shared<AtomicExpr>(node("franz"));
+	Expr_ptr dumb = make_shared<LambdaCallExpr>(node("dumm?"), std::vector<Expr_ptr>{fritz});
+
+	// Known statements need no proof.
+	Theory fork(axioms);
+	SearchOptions options;
+	ProofSearch search(rules, fork, options);
+	Expr_ptr student = make_shared<LambdaCallExpr>(node("schüler?"), std::vector<Expr_ptr>{fritz});
+	BOOST_CHECK_EQUAL(search.search(student), ProofSearch::FOUND);
+	BOOST_CHECK(search.getProof().empty());
+
+	// Specialization and modus ponens.
+	BOOST_REQUIRE_EQUAL(search.search(dumb), ProofSearch::FOUND);
+	BOOST_CHECK(search.getExpanded() > 0u);
+	const std::vector<const_Statement_ptr> &proof = search.getProof();
+	BOOST_REQUIRE(!proof.empty());
+	BOOST_CHECK(Matcher::equal(proof.back()->getDefinition(), dumb));
+	Theory::iterator last = search.insert(fork, fork.end());
+	BOOST_CHECK_EQUAL(fork.size(), proof.size());
+	BOOST_CHECK(std::static_pointer_cast<const Statement>(*last)->getDefinition() == dumb);
+	BOOST_CHECK(fork.verify());
+
+	// Nothing is known about franz, and we can't go on forever.
+	Expr_ptr franz_dumb = make_shared<LambdaCallExpr>(node("dumm?"), std::vector<Expr_ptr>{franz});
+	BOOST_CHECK_EQUAL(search.search(franz_dumb), ProofSearch::NOT_FOUND);
+	options.max_states = 1;
+	ProofSearch small(rules, *axioms, options);
+	BOOST_CHECK_EQUAL(small.search(franz_dumb), ProofSearch::OUT_OF_MEMORY);
+
+	// Several threads find the same.
+	options.max_states = 100000;
+	options.num_threads = 4;
+	ProofSearch parallel(rules, *axioms, options);
+	BOOST_CHECK_EQUAL(parallel.search(dumb), ProofSearch::FOUND);
+	Theory copy(axioms);
+	parallel.insert(copy, copy.end());
+	BOOST_CHECK(copy.verify());
+
+	// The goal (impl k k) can be reached from (equiv k k), which takes five
+	// steps but fails on (not k), or from (not (and k k)), which needs (or k k)
+	// and (equiv k k) further down. Trying (or k k) below (equiv k k) first
+	// only leads back to the goal, which must not make it fail later.
+	std::istringstream cycle_rules_stream(
+		"(deductionrule g_x (list (statement a)) (list (equiv a a) (not a)) (impl a a))\n"
+		"(deductionrule g_w (list (statement a)) (list (not (and a a))) (impl a a))\n"
+		"(deductionrule w_z (list (statement a)) (list (not (or a a))) (not (and a a)))\n"
+		"(deductionrule z_s (list (statement a)) (list (or a a)) (not (or a a)))\n"
+		"(deductionrule s_y (list (statement a)) (list (and a a)) (or a a))\n"
+		"(deductionrule y_g (list (statement a)) (list (impl a a)) (and a a))\n"
+		"(deductionrule y_x (list (statement a)) (list (equiv a a)) (and a a))\n"
+		"(deductionrule x_s (list (statement a)) (list (or a a)) (equiv a a))\n"
+		"(deductionrule x_p (list (statement a)) (list (equiv a (not a))) (equiv a a))\n"
+		"(deductionrule p_q (list (statement a)) (list (or a (not a))) (equiv a (not a)))\n"
+		"(deductionrule q_r (list (statement a)) (list (and a (not a))) (or a (not a)))\n"
+		"(deductionrule r_t (list (statement a)) (list (impl a (not a))) (and a (not a)))\n"
+		"(deductionrule t_k (list (statement a)) (list a) (impl a (not a)))\n");
+	Parser cycle_rules_parser(cycle_rules_stream, std::cout, "cycle rules");
+	Theory cycle_rules = cycle_rules_parser.parseTheory();
+	BOOST_REQUIRE_EQUAL(cycle_rules_parser.getErrors(), 0);
+	std::istringstream cycle_stream("(statement k) (axiom ak k)\n");
+	Parser cycle_parser(cycle_stream, std::cout, "cycle");
+	Theory cycle = cycle_parser.parseTheory();
+	BOOST_REQUIRE_EQUAL(cycle_parser.getErrors(), 0);
+
+	SearchOptions cycle_options;
+	cycle_options.max_depth = 6;
+	cycle_options.num_threads = 1;
+	cycle_options.heuristic = [] (const Expression *, const RuleIndex::Candidate &candidate)
+		{
+			const std::string &name = candidate.rule->getName();
+			return name == "g_x" || name == "x_s" || name == "y_g" ? 0.0 : 1.0;
+		};
+	ProofSearch cycle_search(cycle_rules, cycle, cycle_options);
+	Expr_ptr k = make_shared<AtomicExpr>(std::static_pointer_cast<Node>(*cycle.get("k")));
+	BOOST_CHECK_EQUAL(cycle_search.search(make_shared<ConnectiveExpr>(ConnectiveExpr::IMPL, k, k)),
+		ProofSearch::FOUND);
+
+	// The goals expanded are counted over all depths.
+	Expr_ptr not_k = make_shared<NegationExpr>(k);
+	Expr_ptr hopeless = make_shared<ConnectiveExpr>(ConnectiveExpr::IMPL, not_k, not_k);
+	BOOST_CHECK_EQUAL(cycle_search.search(hopeless), ProofSearch::NOT_FOUND);
+	cycle_options.max_states = cycle_search.getExpanded();
+	ProofSearch bounded(cycle_rules, cycle, cycle_options);
+	BOOST_CHECK_EQUAL(bounded.search(hopeless), ProofSearch::OUT_OF_MEMORY);
+}
+
+BOOST_AUTO_TEST_CASE(inference_test)
+{
+	// simple.lth, with the arguments of the proof steps left out.
+	const char *const text =
+		"(type person)\n"
+		"((lambda-type statement (list person)) schüler?)\n"
+		"((lambda-type statement (list person)) dumm?)\n"
+		"(person fritz)\n"
+		"(axiom (schüler? fritz))\n"
+		"(axiom (forall (lambda (list (person x)) (impl (schüler? x) (dumm? x)))))\n"
+		"(lemma (impl (schüler? fritz) (dumm? fritz)) (specialization (list) (list this~1)))\n"
+		"(lemma (dumm? fritz) (ponens (list) (list this~1 this~3)))\n"
+		"(lemma (not (not (dumm? fritz))) (double_negation (list) (list this~1)))\n"
+		"(lemma (dumm? fritz) (double_negation (list) (list this~1)))\n"
+		"(lemma (or (dumm? fritz) (not (dumm? fritz))) (excluded_middle (list) (list)))\n";
+	std::istringstream stream(text);
+	Parser parser(stream, std::cout, "inferred");
+	parser.rules = &rules;
+	Theory theory = parser.parseTheory();
+	BOOST_CHECK_EQUAL(parser.getErrors(), 0);
+	BOOST_REQUIRE_EQUAL(theory.size(), 11u);
+	BOOST_CHECK(theory.verify());
+
+	// The arguments are there, but they aren't written.
+	auto step = std::static_pointer_cast<const ProofStep>(
+		std::static_pointer_cast<const Statement>(*theory.at(7))->getProof());
+	BOOST_CHECK(step->isInferred());
+	auto rule = step->getRule();
+	BOOST_CHECK_EQUAL(rule->getName(), "ponens");
+	BOOST_CHECK(Matcher::equal((*step)[rule->getParams()[1]],
+		std::static_pointer_cast<const Statement>(*theory.at(7))->getDefinition()));
+	std::ostringstream output;
+	Writer writer(output, std::numeric_limits<int>::max());
+	theory.accept(&writer);
+	BOOST_CHECK_EQUAL(output.str(), text);
+
+	// Arguments that don't fit, and wrong numbers of arguments.
+	std::istringstream wrong(
+		"(statement a) (statement b)\n"
+		"(axiom ab (impl a b)) (axiom aa a)\n"
+		"(lemma la a (ponens (list) (list ab aa)))\n"
+		"(lemma lb b (ponens (list a) (list ab aa)))\n"
+		"(lemma lc b (ponens (list) (list ab aa)))\n");
+	Parser wrong_parser(wrong, std::cout, "wrong");
+	wrong_parser.rules = &rules;
+	Theory wrong_theory = wrong_parser.parseTheory();
+	BOOST_CHECK_EQUAL(wrong_parser.getErrors(), 2);
+
+	// Inferred steps referring to statements parsed in parallel with them.
+	std::ostringstream chained;
+	chained << "(statement a) (axiom l0 a)\n";
+	for (int i = 1; i < 300; ++i)
+		chained << "(lemma l" << i << (i % 2 ? " (not (not a))" : " a")
+			<< " (double_negation (list) (list l" << (i - 1) << ")))\n";
+	std::string input = chained.str();
+	Parser parallel_parser(input.data(), input.data() + input.size(), std::cout, "chained");
+	parallel_parser.rules = &rules;
+	Theory parallel_theory = parallel_parser.parseTheoryParallel(4);
+	BOOST_CHECK_EQUAL(parallel_parser.getErrors(), 0);
+	BOOST_CHECK(parallel_theory.verify());
+}
+
+BOOST_AUTO_TEST_CASE(lazy_test)
+{
+	// Proofs are skipped, and parsed when they're needed.
+	std::ifstream file("examples/simple.lth");
+	Parser parser(file, std::cout, "examples/simple.lth");
+	parser.rules = &rules;
+	parser.lazy = true;
+	Theory simple = parser.parseTheory();
+	BOOST_CHECK_EQUAL(parser.getErrors(), 0);
+	BOOST_REQUIRE_EQUAL(simple.size(), 8u);
+	auto lemma = std::static_pointer_cast<const Statement>(*simple.at(7));
+	BOOST_CHECK(lemma->hasProof());
+	BOOST_CHECK(!lemma->isLoaded());
+	BOOST_CHECK(std::static_pointer_cast<const Statement>(*simple.at(4))->isLoaded());
+
+	auto step = std::dynamic_pointer_cast<const ProofStep>(lemma->getProof());
+	BOOST_REQUIRE(step);
+	BOOST_CHECK(lemma->isLoaded());
+	BOOST_CHECK_EQUAL(step->getRule()->getName(), "ponens");
+	BOOST_CHECK(!std::static_pointer_cast<const Statement>(*simple.at(6))->isLoaded());
+
+	// Copies have their own proofs, which still work when the original is gone.
+	Theory *original = new Theory(simple);
+	Theory *copy = new Theory(*original);
+	delete original;
+	auto copied = std::static_pointer_cast<const Statement>(*copy->at(6));
+	BOOST_CHECK(copied->isLoaded());
+	auto copied_step = std::dynamic_pointer_cast<const ProofStep>(copied->getProof());
+	BOOST_REQUIRE(copied_step);
+	BOOST_CHECK(copied_step->getReferences().front().getTheory() == copy);
+	BOOST_CHECK(copy->verify());
+	delete copy;
+
+	// The theory can be moved before the proofs are parsed.
+	Theory moved(std::move(simple));
+	BOOST_CHECK(moved.verify(2));
+	checkResult(&moved, "examples/simple.lth");
+
+	// Errors are found when the proof is parsed.
+	std::string text =
+		"(statement a) (statement b)\n"
+		"(axiom ab (impl a b)) (axiom aa a)\n"
+		"(lemma lb b (ponens (list a b) (list ab aa)))\n"
+		"(lemma la a\n\t(ponens (list a nothing) (list ab aa)))\n"
+		"(lemma lc b (ponens (list a b) (list ab lc2)))\n"
+		"(statement lc2)\n";
+	Parser wrong_parser(text.data(), text.data() + text.size(), std::cout, "wrong");
+	wrong_parser.rules = &rules;
+	wrong_parser.lazy = true;
+	Theory wrong = wrong_parser.parseTheoryParallel(2);
+	BOOST_CHECK_EQUAL(wrong_parser.getErrors(), 0);
+
+	std::vector<Theory::const_iterator> failed;
+	BOOST_CHECK(!wrong.verify(1, &failed));
+	BOOST_REQUIRE_EQUAL(failed.size(), 2u);
+	BOOST_CHECK_EQUAL((*failed[0])->getName(), "la");
+	BOOST_CHECK_EQUAL((*failed[1])->getName(), "lc");
+	auto lazy = std::dynamic_pointer_cast<const LazyProof>(
+		std::static_pointer_cast<const Statement>(*failed[0])->getProof());
+	BOOST_REQUIRE(lazy);
+	BOOST_CHECK(lazy->getMessages().find("wrong:5:25: error: undeclared identifier nothing")
+		!= std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(scan_test)
+{
+	// Random text with long runs of every class, crossing block boundaries
+	std::mt19937 random(42);
+	const char alphabet[] = "  \t\n\n()#abc";
+	std::string text;
+	while (text.size() < 1000) {
+		char c = alphabet[random() % (sizeof(alphabet) - 1)];
+		text.append(random() % 70 + 1, c);
+	}
+	const char *begin = text.data(), *end = begin + text.size();
+
+	auto space = [] (char c) {return c == ' ' || (c >= '\t' && c <= '\r');};
+	auto structural = [] (char c) {return c == '(' || c == ')' || c == '#';};
+	for (const char *pos = begin; pos <= end; ++pos) {
+		BOOST_CHECK(findDelimiter(pos, end) == std::find_if(pos, end,
+			[&] (char c) {return space(c) || structural(c);}));
+		BOOST_CHECK(findStructural(pos, end) == std::find_if(pos, end,
+			[&] (char c) {return structural(c) || c == '\n';}));
+
+		int lines;
+		const char *line_begin = nullptr;
+		const char *next = skipSpace(pos, end, &lines, &line_begin);
+		BOOST_CHECK(next == std::find_if_not(pos, end, space));
+		BOOST_CHECK_EQUAL(lines, std::count(pos, next, '\n'));
+		if (lines)
+			BOOST_CHECK(*(line_begin - 1) == '\n' && std::find(line_begin, next, '\n') == next);
+	}
+
+	ScanIndex index(begin, end);
+	BOOST_CHECK_EQUAL(index.size(), text.size());
+	for (std::size_t offset = 0; offset <= text.size(); ++offset) {
+		BOOST_CHECK_EQUAL(index.countNewlines(offset / 2, offset),
+			std::count(begin + offset / 2, begin + offset, '\n'));
+		std::size_t line_begin = text.rfind('\n', offset ? offset - 1 : std::string::npos);
+		BOOST_CHECK_EQUAL(index.lineBegin(offset),
+			(offset && line_begin != std::string::npos) ? line_begin + 1 : 0);
+	}
+
+	// Forms nested deeply enough to pass whole blocks, with comments
+	std::string forms_text;
+	std::vector<std::pair<std::size_t, std::size_t>> expected_forms;
+	for (int i = 0; i < 50; ++i) {
+		forms_text.append(random() % 3, '\n');
+		if (random() % 4 == 0)
+			forms_text += "# (comment) ( \n";
+		std::size_t form_begin = forms_text.size();
+		int depth = random() % 20 + 1;
+		forms_text.append(depth, '(');
+		for (int j = 0; j < depth; ++j) {
+			forms_text.append(random() % 70, ' ');
+			if (random() % 8 == 0)
+				forms_text += "#)\n";
+			forms_text += ")";
+		}
+		expected_forms.emplace_back(form_begin, forms_text.size());
+	}
+	std::vector<std::pair<std::size_t, std::size_t>> forms;
+	BOOST_CHECK(ScanIndex(forms_text.data(), forms_text.data() + forms_text.size())
+		.findForms(&forms));
+	BOOST_CHECK(forms == expected_forms);
+
+	for (std::string wrong : {"(a) b", "(a))", "((a)", ") (a)"}) {
+		forms.clear();
+		BOOST_CHECK(!ScanIndex(wrong.data(), wrong.data() + wrong.size()).findForms(&forms));
+	}
+
+	// Lexing the buffer gives the same tokens and positions as lexing a
+	// stream one character at a time.
+	std::istringstream stream(text);
+	Lexer buffer_lexer(begin, end), stream_lexer(stream, 1);
+	for (;;) {
+		LispToken token = buffer_lexer.getToken(), expected = stream_lexer.getToken();
+		BOOST_REQUIRE_EQUAL(token.getType(), expected.getType());
+		if (token.getType() == LispToken::WORD)
+			BOOST_CHECK_EQUAL(token.getContent(), expected.getContent());
+		BOOST_CHECK_EQUAL(buffer_lexer.getLine(), stream_lexer.getLine());
+		BOOST_CHECK_EQUAL(buffer_lexer.getColumn(), stream_lexer.getColumn());
+		if (token.getType() == LispToken::ENDOFFILE)
+			break;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(diagnostics_test)
+{
+	// Errors in proofs of statements parsed in different chunks, some of
+	// them inferred from statements parsed together with them
+	std::ostringstream text;
+	text << "(statement a) (statement b)\n(axiom ab (impl a b)) (axiom aa a)\n";
+	for (int i = 0; i < 300; ++i) {
+		text << "(lemma l" << i << " b\n\t";
+		if (i % 50 == 7)
+			text << "(ponens (list a nothing) (list ab aa)))\n";
+		else if (i % 50 == 21)
+			text << "(ponens (list a) (list ab aa)))\n";
+		else if (i % 50 == 33)
+			text << "(double_negation (list) (list l" << (i - 1) << ")))\n";
+		else if (i % 25 == 12)
+			text << "(ponens (list) (list ab aa)))\n";
+		else
+			text << "(ponens (list a b) (list ab aa)))\n";
+		if (i == 150)
+			text << "(statement c d)\n";
+	}
+	std::string input = text.str();
+
+	// Without rules, every form has errors, also where the chunks end.
+	Theory no_rules;
+	for (Theory *parser_rules : {&rules, &no_rules}) {
+		std::ostringstream serial_output, parallel_output;
+		int serial_errors, parallel_errors;
+		{
+			Parser parser(input.data(), input.data() + input.size(), serial_output, "chunks");
+			parser.rules = parser_rules;
+			parser.parseTheory();
+			serial_errors = parser.getErrors();
+		}
+		{
+			Parser parser(input.data(), input.data() + input.size(), parallel_output, "chunks");
+			parser.rules = parser_rules;
+			parser.parseTheoryParallel(4);
+			parallel_errors = parser.getErrors();
+		}
+		BOOST_CHECK_EQUAL(serial_errors, parser_rules == &rules ? 25 : 307);
+		BOOST_CHECK_EQUAL(parallel_errors, serial_errors);
+		BOOST_CHECK_EQUAL(parallel_output.str(), serial_output.str());
+	}
+
+	std::ostringstream output;
+	{
+		Parser parser(input.data(), input.data() + input.size(), output, "chunks");
+		parser.rules = &rules;
+		parser.parseTheoryParallel(4);
+	}
+	BOOST_CHECK(output.str().find("chunks:18:25: error: undeclared identifier nothing")
+		!= std::string::npos);
+
+	// Only identifiers are interned, not the name of the input.
+	BOOST_CHECK(!Symbol::find("chunks"));
+
+	// Buffers are merged in the order of the input.
+	DiagnosticBuffer first, second;
+	auto merged_name = std::make_shared<const std::string>("merged");
+	first.add(Diagnostic::ERROR, merged_name, 3, 1);
+	first.addOperand(Diagnostic::Operand::TEXT).text = "third";
+	first.addOperand(Diagnostic::Operand::STRING).string = " one";
+	second.add(Diagnostic::WARNING, merged_name, 1, 5);
+	second.addOperand(Diagnostic::Operand::NUMBER).number = 1;
+	second.add(Diagnostic::NOTE, merged_name, 7, 0);
+	second.addOperand(Diagnostic::Operand::TYPE).type = BuiltInType::statement;
+
+	Diagnostics diagnostics;
+	diagnostics.add(std::move(second));
+	diagnostics.add(std::move(first));
+	DiagnosticBuffer merged = diagnostics.merge();
+	BOOST_CHECK_EQUAL(merged.getErrors(), 1);
+	BOOST_CHECK_EQUAL(merged.getWarnings(), 1);
+	output.str("");
+	merged.write(output);
+	BOOST_CHECK_EQUAL(output.str(), "\nmerged:1:5: warning: 1\nmerged:3:1: error: third one"
+		"\nmerged:7:0: note: statement");
+}
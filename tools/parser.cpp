@@ -20,41 +20,212 @@
 #include "../core/logic.hpp"
 #include "../core/lisp.hpp"
 #include "../core/debug.hpp"
+#include "../core/buffer.hpp"
+#include "../core/batch.hpp"
+#include "../core/binary.hpp"
+#include "../core/server.hpp"
+#include "../core/stream.hpp"
+#include "../core/profile.hpp"
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
 
 /**
  * Parser file and return theory.
  * @param filename Name of the file containing the theory.
  * @param num_errors Pointer where the number of errors shall be written to.
  * @param rules Theory containing the rules, when parsing a theory with proofsteps., or nullptr.
+ * @param verifier Verifier getting the statements while parsing, or nullptr.
+ *      Compiled theories aren't handed to it.
+ * @param num_threads Number of threads for parsing without a verifier.
  * @return Parsed theory.
  */
-Core::Theory parse(const char *filename, int *num_errors, const Core::Theory *rules = nullptr)
+Core::Theory parse(const char *filename, int *num_errors, const Core::Theory *rules = nullptr,
+	Core::StreamingVerifier *verifier = nullptr, unsigned num_threads = 1)
 {
-	std::ifstream file(filename);
+	Core::InputBuffer file(filename);
 	if (!file) {
 		*num_errors = -1;
 		return Core::Theory();
 	}
 
-	Core::Parser parser(file, std::cout, filename);
+	// Compiled theories don't need to be parsed.
+	if (Core::BinaryReader::isBinary(file.begin(), file.end())) {
+		try {
+			Core::BinaryReader reader(file.begin(), file.end());
+			if (rules)
+				reader.rules = rules;
+			*num_errors = 0;
+			return reader.readTheory();
+		}
+		catch (std::exception &ex) {
+			std::cout << filename << ": " << ex.what() << std::endl;
+			*num_errors = 1;
+			return Core::Theory();
+		}
+	}
+
+	Core::Parser parser(file.begin(), file.end(), std::cout, filename);
+	// Memory of dropped proofs isn't given back by the arena.
+	if (!verifier)
+		parser.arena = std::make_shared<Core::Arena>();
 	if (rules)
 		parser.rules = rules;
-	Core::Theory res = parser.parseTheory();
+	parser.verifier = verifier;
+	Core::Theory res = (num_threads == 1) ? parser.parseTheory()
+		: parser.parseTheoryParallel(num_threads);
 
 	*num_errors = parser.getErrors();
 	return res;
 }
 
+/**
+ * Write the statements that couldn't be verified.
+ * @param theory Theory containing the statements.
+ * @param failed Iterators to the statements.
+ */
+void report(const Core::Theory &theory,
+	const std::vector<Core::Theory::const_iterator> &failed)
+{
+	for (Core::Theory::const_iterator it : failed) {
+		int index = std::distance(theory.begin(), it) + 1;
+		auto stmt = std::static_pointer_cast<const Core::Statement>(*it);
+
+		std::cout << "Couldn't verify object " << index;
+		if (stmt->getName() != "")
+			std::cout << " (" << stmt->getName() << ")";
+		std::cout << ": ";
+		{
+			Core::Writer writer(std::cout, std::numeric_limits<int>::max());
+			stmt->getDefinition()->accept(&writer);
+		}
+	}
+}
+
+/**
+ * Verify several theories against the same rules.
+ * @param rules_file Name of the file containing the rules.
+ * @param files Names of the files containing the theories.
+ * @param num_threads Number of theories checked at once.
+ * @param profile Format of the profile, or empty for none.
+ * @return 0 if all theories were verified, 1 otherwise.
+ */
+int verifyBatch(const char *rules_file, const std::vector<std::string> &files,
+	unsigned num_threads, const std::string &profile)
+{
+	std::shared_ptr<const Core::Theory> rules = Core::BatchVerifier::loadRules(rules_file, std::cout);
+	if (!rules)
+		return 1;
+	Core::Profile::get().clear();
+
+	Core::BatchVerifier verifier(rules, num_threads);
+	int num_failed = 0;
+	verifier.verify(files, [&num_failed] (const Core::BatchResult &result) {
+		std::cout << result.messages;
+		if (result.verified)
+			std::cout << "Verified theory " << result.filename << "!\n";
+		else {
+			if (!result.errors)
+				std::cout << "Couldn't verify theory " << result.filename << ".\n";
+			++num_failed;
+		}
+	});
+	std::cout << files.size() - num_failed << " of " << files.size()
+		<< " theories verified.\n";
+
+	if (profile == "text")
+		Core::Profile::get().write(std::cout);
+	else if (profile == "json")
+		Core::Profile::get().writeJSON(std::cout);
+	return num_failed ? 1 : 0;
+}
+
+/**
+ * Answer verification requests on standard input until it ends.
+ * @param rules_file Name of the file containing the rules.
+ * @return 0 if the rules could be parsed, 1 otherwise.
+ */
+int serve(const char *rules_file)
+{
+	// Standard output is for answers only.
+	std::shared_ptr<const Core::Theory> rules = Core::BatchVerifier::loadRules(rules_file, std::cerr);
+	if (!rules)
+		return 1;
+
+	Core::VerificationServer server(rules);
+	server.serve(std::cin, std::cout);
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
-	if (argc == 1)
-		std::cout << "Usage: " << argv[0] << " <theory file> [<rules file>]\n";
+	// Options
+	unsigned num_threads = 1;
+	const char *output_file = nullptr;
+	std::size_t queue_size = 0;
+	bool drop_proofs = false;
+	bool batch = false;
+	bool server = false;
+	std::string profile;
+	int arg = 1;
+	while (argc >= arg + 2) {
+		std::string option = argv[arg];
+		if (option == "-S") {
+			server = true;
+			++arg;
+			continue;
+		}
+		else if (option == "-b" || option == "-d") {
+			(option == "-b" ? batch : drop_proofs) = true;
+			++arg;
+			continue;
+		}
+		else if (option == "-j")
+			num_threads = std::atoi(argv[arg + 1]);
+		else if (option == "-o")
+			output_file = argv[arg + 1];
+		else if (option == "-p")
+			profile = argv[arg + 1];
+		else if (option == "-s")
+			queue_size = std::atoi(argv[arg + 1]);
+		else
+			break;
+		arg += 2;
+	}
+
+	if (argc <= arg || (drop_proofs && output_file)
+			|| (batch && (argc <= arg + 1 || output_file || queue_size || drop_proofs))
+			|| (server && (argc > arg + 1 || batch || output_file || queue_size
+				|| drop_proofs || profile != ""))
+			|| (profile != "" && profile != "text" && profile != "json")) {
+		std::cout << "Usage: " << argv[0] << " [-j <threads>] [-o <output file>]"
+			" [-p text|json] [-s <queue size> [-d]] <theory file> [<rules file>]\n"
+			"       " << argv[0] << " [-j <threads>] [-p text|json] -b <rules file>"
+			" <theory file>...\n"
+			"       " << argv[0] << " -S <rules file>\n"
+			"The options -d and -o can't be combined.\n";
+		return 1;
+	}
+	if (profile != "" && !Core::Profile::enabled) {
+		std::cout << "Profiling needs a build with PROFILE=1.\n";
+		return 1;
+	}
+	if (drop_proofs && !queue_size)
+		queue_size = 1024;
+
+	if (server)
+		return serve(argv[arg]);
+	if (batch)
+		return verifyBatch(argv[arg], std::vector<std::string>(argv + arg + 1, argv + argc),
+			num_threads, profile);
 
+	const char *theory_file = argv[arg];
 	const char *rules_file;
-	if (argc >= 3)
-		rules_file = argv[2];
+	if (argc > arg + 1)
+		rules_file = argv[arg + 1];
 	else
 		rules_file = "basic/rules.lth";
 
@@ -66,16 +237,54 @@ int main(int argc, char **argv)
 		return err_num;
 	}
 
-	// Parse file itself
-	Core::Theory theory = parse(argv[1], &err_num, &rules);
+	// Only profile the theory itself.
+	Core::Profile::get().clear();
+
+	// Parse file itself, and verify while parsing if we stream.
+	std::unique_ptr<Core::StreamingVerifier> verifier;
+	if (queue_size)
+		verifier.reset(new Core::StreamingVerifier(queue_size, drop_proofs));
+	Core::Theory theory = parse(theory_file, &err_num, &rules, verifier.get(), num_threads);
+	std::vector<Core::Theory::const_iterator> failed;
+	bool verified = true;
+	if (verifier)
+		verified = verifier->finish(&failed);
 	if (err_num) {
-		std::cout << "Couldn't parse theory file " << argv[1] << std::endl;
+		std::cout << "Couldn't parse theory file " << theory_file << std::endl;
 		return err_num;
 	}
 
-	// Verify the theory
-	if (theory.verify())
+	// Verify the theory, unless that was done while parsing.
+	if (!verifier || !verifier->getChecked())
+		verified = theory.verify(num_threads, &failed);
+	if (verified)
 		std::cout << "Verified theory!\n";
-	else
+	else {
+		report(theory, failed);
 		std::cout << "Couldn't verify theory.\n";
+	}
+
+	if (profile == "text")
+		Core::Profile::get().write(std::cout);
+	else if (profile == "json")
+		Core::Profile::get().writeJSON(std::cout);
+
+	// Save the theory, but only if it's correct
+	if (verified && output_file) {
+		std::ofstream output(output_file, std::ios::binary);
+		try {
+			Core::BinaryWriter writer(output);
+			theory.accept(&writer);
+		}
+		catch (std::exception &ex) {
+			std::cout << "Couldn't write " << output_file << ": " << ex.what() << std::endl;
+			output.close();
+			std::remove(output_file);
+			return 1;
+		}
+		if (!output) {
+			std::cout << "Couldn't write " << output_file << std::endl;
+			return 1;
+		}
+	}
 }